@@ -0,0 +1,208 @@
+/** @file
+ *
+ *  @ingroup example_module
+ *
+ *  @brief Connect and disconnect a large number of loopback TCP connections to one
+ *  TCP acceptor, timing how long the acceptor takes to register the connections and to
+ *  handle a mass disconnect.
+ *
+ *  The connections are made with blocking connects in this process, so two file
+ *  descriptors are used per connection; the open file limit is raised to the hard limit
+ *  and the number of connections is reduced if it is still not enough. On Linux the
+ *  client sockets are bound to a range of 127.0.0.x addresses, since one source address
+ *  only has enough ephemeral ports for about 28k connections to the same port.
+ *
+ *  The client sockets close with a zero linger time (a reset), so that repeated runs are
+ *  not limited by ports held in the TIME_WAIT state.
+ *
+ *  Three phases are timed: all connections registered by the acceptor, all client sockets
+ *  closed at once (the acceptor removes each connection as its read completes with an
+ *  error), and after connecting again, the acceptor stopped with every connection live.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *  Sample make file:
+g++ -std=c++17 -O2 -Wall -Werror \
+-I ../include \
+-I ../../utility-rack/include/ \
+-I ../../utility-rack/third_party/ \
+-I ../../asio/asio/include/ \
+tcp_acceptor_churn_demo.cpp -lpthread -o tcp_acceptor_churn
+ *
+ */
+
+#include <iostream>
+#include <cstdlib> // EXIT_SUCCESS, std::atoi
+#include <cstddef> // std::size_t
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <system_error>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "asio/ip/tcp.hpp"
+#include "asio/io_context.hpp"
+
+#include "net_ip/net_ip.hpp"
+#include "net_ip/net_entity.hpp"
+#include "net_ip/io_type_decls.hpp"
+#include "net_ip_component/worker.hpp"
+
+using const_buf = asio::const_buffer;
+using io_output = chops::net::tcp_io_output;
+using tcp_io_interface = chops::net::tcp_io_interface;
+using endpoint = asio::ip::tcp::endpoint;
+using clock_type = std::chrono::steady_clock;
+
+const std::string PORT = "30660";
+const std::string HOST = "127.0.0.1";
+constexpr std::size_t conns_per_source_addr = 25000u;
+
+const std::string HELP_PRM = "-h";
+
+auto print_usage = [] () {
+    std::cout << "./tcp_acceptor_churn [-h] [num connections]\n"
+                 "   -h      Print usage\n"
+                 "   num connections   Default: 100000" << std::endl;
+};
+
+// returns the number of connections the open file limit allows
+std::size_t raise_file_limit(std::size_t num_conns) {
+#ifndef _WIN32
+    ::rlimit lim;
+    if (::getrlimit(RLIMIT_NOFILE, &lim) != 0) {
+        return num_conns;
+    }
+    lim.rlim_cur = lim.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &lim);
+    ::getrlimit(RLIMIT_NOFILE, &lim);
+    // both ends of each connection are in this process, plus some spare descriptors
+    std::size_t max_conns = lim.rlim_cur > 200u ? (lim.rlim_cur - 200u) / 2u : 0u;
+    return num_conns < max_conns ? num_conns : max_conns;
+#else
+    return num_conns;
+#endif
+}
+
+bool connect_all(asio::io_context& ioc, std::vector<asio::ip::tcp::socket>& socks,
+                 std::size_t num_conns) {
+    endpoint remote(asio::ip::make_address(HOST), static_cast<unsigned short>(std::stoi(PORT)));
+    for (std::size_t i = 0u; i < num_conns; ++i) {
+        asio::ip::tcp::socket sock(ioc);
+        std::error_code ec;
+        sock.open(asio::ip::tcp::v4(), ec);
+#if defined(__linux__)
+        // 127.0.0.2 and up, any 127.x.x.x address is local on Linux
+        auto src = asio::ip::address_v4(asio::ip::address_v4::loopback().to_uint() + 1u +
+                                        static_cast<unsigned int>(i / conns_per_source_addr));
+        sock.bind(endpoint(src, 0u), ec);
+#endif
+        if (!ec) {
+            sock.set_option(asio::socket_base::linger(true, 0), ec);
+        }
+        if (!ec) {
+            sock.connect(remote, ec);
+        }
+        if (ec) {
+            std::cerr << "Connect " << i << " failed: " << ec.message() << std::endl;
+            return false;
+        }
+        socks.push_back(std::move(sock));
+    }
+    return true;
+}
+
+double wait_for_count(const std::atomic_size_t& cnt, std::size_t target,
+                      clock_type::time_point start) {
+    while (cnt.load() != target) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::chrono::duration<double> elapsed = clock_type::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t num_conns = 100000u;
+    if (argc > 1) {
+        if (argv[1] == HELP_PRM) {
+            print_usage();
+            return EXIT_SUCCESS;
+        }
+        auto n = std::atoi(argv[1]);
+        if (n <= 0) {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+        num_conns = static_cast<std::size_t>(n);
+    }
+    auto n = raise_file_limit(num_conns);
+    if (n < num_conns) {
+        std::cout << "Open file limit allows " << n << " connections, instead of "
+                  << num_conns << std::endl;
+        num_conns = n;
+    }
+
+    chops::net::worker wk;
+    wk.start();
+    chops::net::net_ip nip(wk.get_io_context());
+
+    // live connection count as seen by the acceptor, set from the IO state change
+    std::atomic_size_t live { 0u };
+    auto acc = nip.make_tcp_acceptor(PORT, HOST);
+    acc.start([&live] (tcp_io_interface iof, std::size_t num, bool starting) {
+            if (starting) {
+                // reads only complete when the client closes
+                iof.start_io(1u, [] (const_buf, io_output, endpoint) { return true; } );
+            }
+            live.store(num);
+        },
+        [] (tcp_io_interface, std::error_code) { }
+    );
+
+    asio::io_context client_ioc; // blocking operations only, not run
+    std::vector<asio::ip::tcp::socket> socks;
+    socks.reserve(num_conns);
+
+    auto start = clock_type::now();
+    if (!connect_all(client_ioc, socks, num_conns)) {
+        wk.stop();
+        return EXIT_FAILURE;
+    }
+    auto secs = wait_for_count(live, num_conns, start);
+    std::cout << num_conns << " connections registered, secs: " << secs << std::endl;
+
+    start = clock_type::now();
+    for (auto& sock : socks) {
+        std::error_code ec;
+        sock.close(ec);
+    }
+    secs = wait_for_count(live, 0u, start);
+    std::cout << num_conns << " client closes handled, secs: " << secs << std::endl;
+    socks.clear();
+
+    if (!connect_all(client_ioc, socks, num_conns)) {
+        wk.stop();
+        return EXIT_FAILURE;
+    }
+    wait_for_count(live, num_conns, clock_type::now());
+    start = clock_type::now();
+    acc.stop();
+    secs = wait_for_count(live, 0u, start);
+    std::cout << num_conns << " connections closed by acceptor stop, secs: " << secs << std::endl;
+
+    socks.clear();
+    nip.remove_all();
+    wk.reset();
+    return EXIT_SUCCESS;
+}
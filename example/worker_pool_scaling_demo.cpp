@@ -0,0 +1,183 @@
+/** @file
+ *
+ *  @ingroup example_module
+ *
+ *  @brief TCP ping-pong throughput of one or more @c net_ip objects run by a
+ *  @c worker_pool, for an increasing number of threads.
+ *
+ *  A number of TCP connections are made over the local loop, each with a window of
+ *  fixed size messages in flight that are echoed back and forth by the acceptor and the
+ *  connector. The messages per second handled by all connections are reported for each
+ *  thread count. By default all threads run one @c io_context (and one @c net_ip), with
+ *  the @c -c option each thread runs its own @c io_context and @c net_ip, with the
+ *  connections spread across them.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *  Sample make file:
+g++ -std=c++17 -O2 -Wall -Werror \
+-I ../include \
+-I ../../utility-rack/include/ \
+-I ../../utility-rack/third_party/ \
+-I ../../asio/asio/include/ \
+worker_pool_scaling_demo.cpp -lpthread -o worker_pool_scaling
+ *
+ */
+
+#include <iostream>
+#include <cstdlib> // EXIT_SUCCESS, std::atoi
+#include <cstddef> // std::size_t
+#include <string>
+#include <vector>
+#include <memory> // std::unique_ptr
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "net_ip/net_ip.hpp"
+#include "net_ip/net_entity.hpp"
+#include "net_ip/io_type_decls.hpp"
+#include "net_ip_component/worker_pool.hpp"
+
+#include "marshall/shared_buffer.hpp"
+
+using const_buf = asio::const_buffer;
+using io_output = chops::net::tcp_io_output;
+using tcp_io_interface = chops::net::tcp_io_interface;
+using endpoint = asio::ip::tcp::endpoint;
+
+const std::string PORT_BASE = "30650";
+const std::string HOST = "127.0.0.1";
+
+constexpr std::size_t msg_size = 64u;
+constexpr int num_conns = 32;
+constexpr int window = 8;
+constexpr int secs = 3;
+
+const std::string HELP_PRM = "-h";
+const std::string CTX_PRM = "-c";
+
+auto print_usage = [] () {
+    std::cout << "./worker_pool_scaling [-h] [-c] [thread counts...]\n"
+                 "   -h      Print usage\n"
+                 "   -c      One io_context and net_ip per thread, default one shared by all threads\n"
+                 "   thread counts   Default: 1 2 4 8 16" << std::endl;
+};
+
+// echo every message back, on both the acceptor and connector side
+auto make_echo_state_chg(std::atomic_size_t& cnt, bool start_window) {
+    return [&cnt, start_window] (tcp_io_interface iof, std::size_t, bool starting) {
+        if (!starting) {
+            return;
+        }
+        iof.start_io(msg_size, [&cnt] (const_buf buf, io_output io_out, endpoint) {
+                cnt.fetch_add(1u, std::memory_order_relaxed);
+                io_out.send(buf.data(), buf.size());
+                return true;
+            }
+        );
+        if (start_window) {
+            auto io_out = iof.make_io_output();
+            chops::const_shared_buffer msg { chops::mutable_shared_buffer(msg_size) };
+            for (int i = 0; i < window; ++i) {
+                io_out->send(msg);
+            }
+        }
+    };
+}
+
+double run(std::size_t num_threads, bool ctx_per_thread, int port_offset) {
+
+    chops::net::worker_pool wp(num_threads, ctx_per_thread ? num_threads : 1u);
+    wp.start();
+
+    std::vector<std::unique_ptr<chops::net::net_ip>> nips;
+    for (std::size_t i = 0u; i < wp.num_io_contexts(); ++i) {
+        nips.push_back(std::make_unique<chops::net::net_ip>(wp.get_io_context(i)));
+    }
+
+    std::atomic_size_t cnt { 0u };
+    auto err_func = [] (tcp_io_interface, std::error_code) { };
+
+    // one acceptor per net_ip, each connector connects to the acceptor of its net_ip
+    for (std::size_t i = 0u; i < nips.size(); ++i) {
+        auto port = std::to_string(std::stoi(PORT_BASE) + port_offset + static_cast<int>(i));
+        auto acc = nips[i]->make_tcp_acceptor(port, HOST);
+        acc.start(make_echo_state_chg(cnt, false), err_func);
+    }
+    for (int c = 0; c < num_conns; ++c) {
+        auto i = static_cast<std::size_t>(c) % nips.size();
+        auto port = std::to_string(std::stoi(PORT_BASE) + port_offset + static_cast<int>(i));
+        auto conn = nips[i]->make_tcp_connector(port, HOST);
+        conn.start(make_echo_state_chg(cnt, true), err_func);
+    }
+
+    // let the connections come up before measuring
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    auto start_cnt = cnt.load();
+    auto start_tm = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(secs));
+    auto end_cnt = cnt.load();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_tm;
+
+    for (auto& nip : nips) {
+        nip->stop_all();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    for (auto& nip : nips) {
+        nip->remove_all();
+    }
+    wp.stop();
+    return static_cast<double>(end_cnt - start_cnt) / elapsed.count();
+}
+
+int main(int argc, char* argv[]) {
+
+    bool ctx_per_thread = false;
+    std::vector<std::size_t> thread_cnts;
+
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i] == HELP_PRM) {
+            print_usage();
+            return EXIT_SUCCESS;
+        }
+        if (argv[i] == CTX_PRM) {
+            ctx_per_thread = true;
+            continue;
+        }
+        auto n = std::atoi(argv[i]);
+        if (n <= 0) {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+        thread_cnts.push_back(static_cast<std::size_t>(n));
+    }
+    if (thread_cnts.empty()) {
+        thread_cnts = { 1u, 2u, 4u, 8u, 16u };
+    }
+
+    std::cout << num_conns << " connections, " << window << " messages of " << msg_size
+              << " bytes in flight per connection, "
+              << (ctx_per_thread ? "one io_context per thread" : "one shared io_context")
+              << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+    double base = 0.0;
+    int port_offset = 0;
+    for (auto n : thread_cnts) {
+        auto rate = run(n, ctx_per_thread, port_offset);
+        // a new set of ports for each run, avoiding any lingering connections
+        port_offset += static_cast<int>(n) + 1;
+        if (base == 0.0) {
+            base = rate;
+        }
+        std::cout << "threads: " << n << ", msgs/sec: " << static_cast<std::size_t>(rate)
+                  << ", scaling: " << (base > 0.0 ? rate / base : 0.0) << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
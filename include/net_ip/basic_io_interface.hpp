@@ -23,6 +23,7 @@
 #include <system_error>
 #include <cstddef> // std::size_t, std::byte
 #include <utility> // std::forward, std::move
+#include <chrono>
 
 #include "nonstd/expected.hpp"
 
@@ -30,6 +31,8 @@
 #include "net_ip/basic_io_output.hpp"
 
 #include "net_ip/simple_variable_len_msg_frame.hpp"
+#include "net_ip/fixed_len_prefix_frame.hpp"
+#include "net_ip/varint_len_prefix_frame.hpp"
 
 #include "net_ip/detail/wp_access.hpp"
 
@@ -171,6 +174,23 @@ public:
           [] (std::shared_ptr<IOT> sp) { return sp->is_io_started(); } );
   }
 
+/**
+ *  @brief Return output queue statistics and cumulative traffic counts for the 
+ *  associated IO handler.
+ *
+ *  This is the same information as returned by the @c basic_io_output 
+ *  @c get_output_queue_stats method.
+ *
+ *  @return @c nonstd::expected - @c output_queue_stats on success; on error (if no
+ *  associated IO handler), a @c std::error_code is returned.
+ *
+ */
+  auto get_output_queue_stats() const ->
+        nonstd::expected<output_queue_stats, std::error_code> {
+    return detail::wp_access<output_queue_stats>( m_ioh_wptr,
+          [] (std::shared_ptr<IOT> sp) { return sp->get_output_queue_stats(); } );
+  }
+
 /**
  *  @brief Provide an application supplied function object which will be called with a 
  *  reference to the associated IO handler socket.
@@ -195,6 +215,281 @@ public:
             sp->visit_socket(func); return std::error_code { }; } );
   }
 
+/**
+ *  @brief Set the gather write batch limits for the associated network IO handler.
+ *
+ *  By default each buffer in the output queue is written with a separate write call. 
+ *  When batching is enabled, each write completion drains up to @c max_bufs buffers 
+ *  (or @c max_bytes bytes) from the output queue and writes them with a single 
+ *  scatter / gather write. This reduces the number of system calls and handler 
+ *  invocations when the output queue is backed up (e.g. with a slow consumer and many 
+ *  small messages). At least one buffer is always written, even if larger than 
+ *  @c max_bytes.
+ *
+ *  For UDP IO handlers each buffer is still sent as its own datagram (possibly to 
+ *  different destinations), but a batch is sent with one @c sendmmsg system call on 
+ *  Linux (see also @c set_segmentation_offload). Other POSIX platforms send the batch
+ *  with one @c sendmsg call per datagram, and on Windows UDP writes are not batched.
+ *
+ *  This method can be called at any time, including before or after @c start_io. The 
+ *  actual batch sizes are reported through the @c basic_io_output 
+ *  @c get_output_queue_stats method.
+ *
+ *  @param max_bufs Maximum number of buffers per write, a value of 1 (or 0) disables
+ *  batching.
+ *
+ *  @param max_bytes Maximum number of bytes per write, a value of 0 means no byte limit.
+ *
+ *  @return @c nonstd::expected - batch limits are set on success; on error (if no 
+ *  associated IO handler), a @c std::error_code is returned.
+ */
+  auto set_write_batch_limits(std::size_t max_bufs, std::size_t max_bytes) ->
+        nonstd::expected<void, std::error_code> {
+    return detail::wp_access_void( m_ioh_wptr, [max_bufs, max_bytes] (std::shared_ptr<IOT> sp) {
+            sp->set_write_batch_limits(max_bufs, max_bytes); return std::error_code { }; } );
+  }
+
+/**
+ *  @brief Enable UDP generic segmentation offload (GSO) for batched sends in the 
+ *  associated UDP IO handler, implemented only for UDP IO handlers.
+ *
+ *  With write batching enabled (see @c set_write_batch_limits), runs of queued datagrams
+ *  in a batch that go to the same destination and have the same size (the last datagram
+ *  of a run can be shorter), no larger than @c max_segment_size, are passed to the kernel
+ *  as one message with the @c UDP_SEGMENT option (up to 64 datagrams). The kernel, or 
+ *  the network card, then splits the message into the individual datagrams, which is 
+ *  much cheaper than passing each datagram through the network stack. This suits 
+ *  sending snapshots or other bulk data of fixed size datagrams.
+ *
+ *  The max segment size must not be larger than the path MTU less the IP and UDP 
+ *  headers (e.g. 1472 bytes for IPv4 over Ethernet); batches the kernel refuses to 
+ *  segment are sent without segmentation.
+ *
+ *  @param max_segment_size Maximum datagram size for segmentation offload, a value of 0
+ *  disables it.
+ *
+ *  @return @c nonstd::expected - segmentation offload is set on success; on error (if no
+ *  associated IO handler, or the platform does not support UDP GSO), a 
+ *  @c std::error_code is returned.
+ */
+  auto set_segmentation_offload(std::size_t max_segment_size) ->
+        nonstd::expected<void, std::error_code> {
+    return detail::wp_access_void( m_ioh_wptr, [max_segment_size] (std::shared_ptr<IOT> sp) {
+            return sp->set_segmentation_offload(max_segment_size); } );
+  }
+
+/**
+ *  @brief Set the size of a read buffer for message frame based reads in the associated
+ *  TCP IO handler, implemented only for TCP IO handlers.
+ *
+ *  By default the @c start_io methods taking a header size (with a message frame function
+ *  object, a header decoder function, or a fixed read size) read exactly the size of each
+ *  header and body, so every message takes at least one read call and completion handler
+ *  dispatch per piece. With a read buffer, each read takes as much data as is available
+ *  up to the buffer size, then the message frame is run over all of the buffered data and
+ *  the message handler is invoked for every complete message before the next read. This
+ *  greatly reduces the number of reads for high rate streams of small messages.
+ *
+ *  The message frame is called with the same sequence of header and body pieces as
+ *  without a buffer, and the message handler buffer refers directly into the read
+ *  buffer, valid only for the duration of the call. The buffer grows if a message
+ *  does not fit.
+ *
+ *  This method must be called before @c start_io, it has no effect on IO already started.
+ *  Delimiter based reads always use a read buffer, handling every complete message in
+ *  it per read; this sets its initial size (the default is 4096 bytes).
+ *
+ *  @param sz Size of the read buffer, a value of 0 disables buffered reads (or uses the
+ *  default size for delimiter based reads).
+ *
+ *  @return @c nonstd::expected - read buffer size is set on success; on error (if no
+ *  associated IO handler), a @c std::error_code is returned.
+ */
+  auto set_read_buffer_size(std::size_t sz) ->
+        nonstd::expected<void, std::error_code> {
+    return detail::wp_access_void( m_ioh_wptr, [sz] (std::shared_ptr<IOT> sp) {
+            sp->set_read_buffer_size(sz); return std::error_code { }; } );
+  }
+
+/**
+ *  @brief Set the number of datagrams received per read in the associated UDP IO
+ *  handler, implemented only for UDP IO handlers.
+ *
+ *  By default each datagram takes one receive call and one completion handler dispatch.
+ *  With a batch size, the IO handler waits for the socket to be readable and then 
+ *  receives up to @c max_msgs datagrams without blocking, on Linux with a single 
+ *  @c recvmmsg system call, into a read buffer holding a slot of the @c start_io maximum
+ *  size for each datagram. The message handler is then invoked for each datagram in 
+ *  turn, with the same signature as without batching. This greatly reduces the per
+ *  datagram cost for high rate feeds (e.g. multicast market data).
+ *
+ *  Batch statistics are reported through the @c basic_io_output @c get_output_queue_stats
+ *  method, along with the number of datagrams that were truncated (larger than the 
+ *  maximum size) and, on Linux, the number of datagrams dropped by the kernel for the 
+ *  socket (e.g. when the socket receive buffer is full).
+ *
+ *  This method must be called before @c start_io, it has no effect on IO already started.
+ *
+ *  @param max_msgs Maximum number of datagrams per read, a value of 1 (or 0) disables
+ *  batched receives.
+ *
+ *  @return @c nonstd::expected - batch size is set on success; on error (if no 
+ *  associated IO handler, or the platform does not support batched receives), a 
+ *  @c std::error_code is returned.
+ */
+  auto set_receive_batch_size(std::size_t max_msgs) ->
+        nonstd::expected<void, std::error_code> {
+    return detail::wp_access_void( m_ioh_wptr, [max_msgs] (std::shared_ptr<IOT> sp) {
+            return sp->set_receive_batch_size(max_msgs); } );
+  }
+
+/**
+ *  @brief Enable Linux @c MSG_ZEROCOPY sends for large buffers in the associated TCP IO 
+ *  handler, implemented only for TCP IO handlers.
+ *
+ *  The @c SO_ZEROCOPY socket option is set, and buffers of at least @c min_size bytes 
+ *  that are written on their own (i.e. not part of a gather write batch) are sent with 
+ *  @c MSG_ZEROCOPY. The kernel then sends directly from the buffer memory instead of 
+ *  copying it. The buffer (or the application owned memory of a @c send_no_copy) is held
+ *  until the kernel's completion notification arrives, which is later than the write
+ *  completion reported through @c send_with_completion.
+ *
+ *  This also holds when the connection is closed: data already handed to the kernel is
+ *  still sent from the buffer memory, so the socket is kept open (and shut down for 
+ *  sending) until the last notification arrives. If that takes longer than 10 seconds
+ *  (e.g. the peer stopped reading) the connection is reset, which discards the unsent
+ *  data, and the buffers are then released.
+ *
+ *  Zero copy has a fixed cost per send (page pinning and a notification), and typically
+ *  only pays off for buffers in the hundreds of kilobytes or more. On the loopback 
+ *  interface the kernel always copies the data, so zero copy is slower there. 
+ *
+ *  @param min_size Minimum buffer size for zero copy sends, a value of 0 disables
+ *  zero copy.
+ *
+ *  @return @c nonstd::expected - zero copy mode is set on success; on error (if no 
+ *  associated IO handler, or the platform or kernel does not support @c MSG_ZEROCOPY), 
+ *  a @c std::error_code is returned.
+ */
+  auto set_zero_copy(std::size_t min_size) ->
+        nonstd::expected<void, std::error_code> {
+    return detail::wp_access_void( m_ioh_wptr, [min_size] (std::shared_ptr<IOT> sp) {
+            return sp->set_zero_copy(min_size); } );
+  }
+
+/**
+ *  @brief Set read and write timeouts in the associated TCP IO handler, implemented only
+ *  for TCP IO handlers created through a @c net_ip object.
+ *
+ *  The IO handler is closed with the @c net_ip_errc::io_read_timeout error if no data
+ *  is received for the read timeout, and with the @c net_ip_errc::io_write_timeout 
+ *  error if a write in progress makes no progress for the write timeout (e.g. a peer 
+ *  that has stopped reading). The closes are reported the same as any other IO handler
+ *  close, through the IO state change and error callbacks.
+ *
+ *  The timeouts are implemented with a timer wheel shared by all of the IO handlers of
+ *  the @c net_ip object, and the timeout resolution is set in the @c net_ip constructor
+ *  (100 milliseconds by default); a timeout expires between the timeout value and the
+ *  timeout value plus two resolution periods. Each read or write only updates a 
+ *  timestamp, so timeouts have no per message timer operations.
+ *
+ *  The read timeout starts when this method is called, typically just before or after 
+ *  @c start_io. The timeouts can be changed at any time.
+ *
+ *  @param read_timeout Maximum time without receiving data, a value of 0 disables the
+ *  read timeout.
+ *
+ *  @param write_timeout Maximum time for a write to make progress, a value of 0
+ *  disables the write timeout.
+ *
+ *  @return @c nonstd::expected - timeouts are set on success; on error (if no 
+ *  associated IO handler, or the IO handler was not created through a @c net_ip object),
+ *  a @c std::error_code is returned.
+ */
+  auto set_io_timeouts(std::chrono::milliseconds read_timeout, 
+                       std::chrono::milliseconds write_timeout) ->
+        nonstd::expected<void, std::error_code> {
+    return detail::wp_access_void( m_ioh_wptr, [read_timeout, write_timeout] 
+                                                  (std::shared_ptr<IOT> sp) {
+            return sp->set_io_timeouts(read_timeout, write_timeout); } );
+  }
+
+/**
+ *  @brief Set a limit on the number of buffers queued for output in the associated 
+ *  network IO handler, and the policy applied when a send finds the queue at the limit.
+ *
+ *  By default the output queue is unbounded, so a slow or stuck peer can make it grow 
+ *  without limit. With a limit set, the outcome of each @c send is reported in the
+ *  returned @c send_result, and overflows are counted in the @c output_queue_stats. 
+ *  Storage for the limit is allocated when this method is called, after which queueing
+ *  does not allocate.
+ *
+ *  The buffer being written is not counted against the limit. If the limit is lowered 
+ *  below the current queue size, queued buffers are not discarded, but new sends will
+ *  overflow until the queue drains below the limit.
+ *
+ *  With the @c queue_overflow_policy::close_io policy, the IO handler is closed and the
+ *  error function object is invoked with @c net_ip_errc::output_queue_overflow.
+ *
+ *  @param max_bufs Maximum number of queued buffers, a value of 0 means unbounded.
+ *
+ *  @param policy Overflow policy, one of @c queue_overflow_policy::reject, 
+ *  @c queue_overflow_policy::drop_oldest, @c queue_overflow_policy::drop_newest, or 
+ *  @c queue_overflow_policy::close_io.
+ *
+ *  @return @c nonstd::expected - queue limit is set on success; on error (if no 
+ *  associated IO handler), a @c std::error_code is returned.
+ */
+  auto set_output_queue_limit(std::size_t max_bufs, queue_overflow_policy policy) ->
+        nonstd::expected<void, std::error_code> {
+    return detail::wp_access_void( m_ioh_wptr, [max_bufs, policy] (std::shared_ptr<IOT> sp) {
+            sp->set_output_queue_limit(max_bufs, policy); return std::error_code { }; } );
+  }
+
+/**
+ *  @brief Set output queue high and low water marks for the associated network IO
+ *  handler, along with a function object called when the queue crosses them.
+ *
+ *  Water marks allow applications to pause and resume data producers (e.g. throttle 
+ *  upstream consumption) without polling the output queue stats. The function object 
+ *  is called with @c true when the output queue reaches a high water mark, and with 
+ *  @c false when it has drained back to the low water marks. Each crossing results in 
+ *  at most one call, always alternating between @c true and @c false (starting with 
+ *  @c true), and always from the IO thread. The queue level is evaluated when the IO 
+ *  thread checks it, not when it changes, so a short spike above the high water mark 
+ *  that has drained by the time of the check is not reported. After IO is stopped and
+ *  started again, the next call is again @c true.
+ *
+ *  The function object must have the following signature:
+ *
+ *  @code
+ *    // TCP io:
+ *    void (chops::net::tcp_io_output, bool);
+ *    // UDP io:
+ *    void (chops::net::udp_io_output, bool);
+ *  @endcode
+ *
+ *  The buffer being written is not counted in the queue levels. Calling this method 
+ *  again replaces the water marks and function object (and the queue level is evaluated
+ *  right away against the new water marks). An empty function object (e.g. @c nullptr) 
+ *  disables water mark notifications.
+ *
+ *  @param wm @c output_queue_water_marks specifying high and low values for the number
+ *  of queued buffers, queued bytes, or both.
+ *
+ *  @param func Function object called on each water mark crossing.
+ *
+ *  @return @c nonstd::expected - water marks are set on success; on error (if no 
+ *  associated IO handler), a @c std::error_code is returned.
+ */
+  template <typename F>
+  auto set_output_queue_water_marks(const output_queue_water_marks& wm, F&& func) ->
+        nonstd::expected<void, std::error_code> {
+    return detail::wp_access_void( m_ioh_wptr, [&wm, &func] (std::shared_ptr<IOT> sp) {
+            sp->set_output_queue_water_marks(wm, std::forward<F>(func)); 
+            return std::error_code { }; } );
+  }
+
 /**
  *  @brief Enable IO processing for the associated network IO handler with message 
  *  frame logic.
@@ -229,8 +524,41 @@ public:
  *  endpoint that sent the data (not used in the @c send method call, but may be
  *  useful for other purposes). 
  *
+ *  The buffer references internal storage that is reused once the message handler
+ *  returns, so a handler passing the message to another thread must copy it. To avoid
+ *  the copy, the first parameter of the message handler can instead be a
+ *  @c chops::const_shared_buffer, which the handler owns:
+ *
+ *  @code
+ *    bool (chops::const_shared_buffer,
+ *          chops::net::tcp_io_output, // basic_io_output<tcp_io>
+ *          asio::ip::tcp::endpoint);
+ *  @endcode
+ *
+ *  The read buffer is then moved into the shared buffer and replaced for the next 
+ *  message, without copying the data. With a read buffer size set (see 
+ *  @c set_read_buffer_size) each message is copied into the shared buffer instead,
+ *  since the read buffer holds multiple messages.
+ *
+ *  When a read buffer size is set, a single read can complete many small messages. A
+ *  batch message handler receives all of the complete messages of one read in one call,
+ *  instead of one call per message:
+ *
+ *  @code
+ *    bool (chops::net::tcp_msg_batch, // range of asio::const_buffer
+ *          chops::net::tcp_io_output, // basic_io_output<tcp_io>
+ *          asio::ip::tcp::endpoint);
+ *  @endcode
+ *
+ *  Each buffer in the batch references a full message, in arrival order, and all of the
+ *  buffers are only valid until the handler returns. Without a read buffer size the 
+ *  batch always holds one message. If a message frame error is found, the messages
+ *  before the error are delivered before the connection is closed.
+ *
  *  Returning @c false from the message handler callback causes the connection to be 
- *  closed.
+ *  closed. With a read buffer size set, where one read can complete many messages, the
+ *  output already queued (e.g. replies to earlier messages of the same read) is sent 
+ *  first, waiting up to 10 seconds; sends after the @c false return are refused.
  *
  *  The message handler function object is moved if possible, otherwise it is copied. 
  *  State data should be movable or copyable.
@@ -248,6 +576,13 @@ public:
  *  The callback returns the size of the next read, or zero as a notification that the 
  *  complete message has been called and the message handler is to be invoked.
  *
+ *  The callback can also return @c msg_frame_error for an invalid message, which closes 
+ *  the connection with the @c net_ip_errc::message_frame_error error. The 
+ *  @c fixed_len_prefix_frame class template is a message frame for the common case of
+ *  a length field at a fixed offset in a fixed size header, and the
+ *  @c varint_len_prefix_frame class is a message frame for varint (Protocol Buffers 
+ *  style) length prefixes.
+ *
  *  If there is non-trivial processing that is performed in the message frame
  *  object and the application wishes to keep any resulting state (typically to
  *  use within the message handler), one option is to design a single class that provides 
@@ -302,8 +637,14 @@ public:
  *  endpoint that sent the data (not used in the @c send method call, but may be
  *  useful for other purposes). 
  *
+ *  As with the message frame @c start_io, the first parameter of the message handler 
+ *  can instead be an owned @c chops::const_shared_buffer, or the handler can be a batch
+ *  message handler taking a @c chops::net::tcp_msg_batch.
+ *
  *  Returning @c false from the message handler callback causes the connection to be 
- *  closed.
+ *  closed. With a read buffer size set, where one read can complete many messages, the
+ *  output already queued (e.g. replies to earlier messages of the same read) is sent 
+ *  first, waiting up to 10 seconds; sends after the @c false return are refused.
  *
  *  The message handler function object is moved if possible, otherwise it is copied. 
  *  State data should be movable or copyable.
@@ -351,7 +692,18 @@ public:
  *  The buffer points to the complete message including the delimiter sequence. The 
  *  @c basic_io_output can be used for sending a reply, and the endpoint is the remote 
  *  endpoint that sent the data. Returning @c false from the message handler callback 
- *  causes the connection to be closed.
+ *  causes the connection to be closed. Since one read can complete many messages, the 
+ *  output already queued is sent first, waiting up to 10 seconds; sends after the 
+ *  @c false return are refused.
+ *
+ *  As with the message frame @c start_io, the first parameter of the message handler 
+ *  can instead be an owned @c chops::const_shared_buffer. The message is moved out
+ *  of the read buffer when no data following the delimiter has been read, otherwise
+ *  it is copied.
+ *
+ *  The handler can also be a batch message handler taking a @c chops::net::tcp_msg_batch,
+ *  as with the message frame @c start_io, receiving every delimited message found in
+ *  one read.
  *
  *  The message handler function object is moved if possible, otherwise it is copied. 
  *  State data should be movable or copyable.
@@ -404,6 +756,10 @@ public:
  *  Returning @c false from the message handler callback causes the TCP connection or UDP socket to 
  *  be closed.
  *
+ *  For TCP IO handlers, the first parameter of the message handler can instead be an 
+ *  owned @c chops::const_shared_buffer, or a @c chops::net::tcp_msg_batch (always holding
+ *  one message), as with the message frame @c start_io.
+ *
  *  The message handler function object is moved if possible, otherwise it is copied. 
  *  State data should be movable or copyable.
  *
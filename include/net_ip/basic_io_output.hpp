@@ -2,8 +2,8 @@
  *
  *  @ingroup net_ip_module
  *
- *  @brief @c basic_io_output class template, providing @c send and
- *  @c get_output_queue_stats methods.
+ *  @brief @c basic_io_output class template, providing @c send, @c send_no_copy,
+ *  @c send_file, @c send_with_completion and @c get_output_queue_stats methods.
  *
  *  @author Cliff Green
  *
@@ -20,14 +20,18 @@
 #include <memory> // std::weak_ptr, std::shared_ptr
 #include <system_error>
 #include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
 #include <utility> // std::move
+#include <future> // std::promise, std::future
 
 #include "nonstd/expected.hpp"
 
 #include "marshall/shared_buffer.hpp"
 #include "net_ip/queue_stats.hpp"
+#include "net_ip/net_ip_error.hpp"
 
 #include "net_ip/detail/wp_access.hpp"
+#include "net_ip/detail/file_send.hpp"
 
 namespace chops {
 namespace net {
@@ -50,6 +54,9 @@ namespace net {
  *  accessing the same network IO handler.
  *
  *  All @c basic_io_output @c send methods can be called concurrently from multiple threads.
+ *  They return a @c send_result, which converts to @c true if the data was written or
+ *  queued, and also reports what happened when the output queue is at its limit (see
+ *  @c basic_io_interface @c set_output_queue_limit).
  *
  */
 
@@ -94,6 +101,11 @@ public:
  *  @brief Return output queue statistics, allowing application monitoring of output queue
  *  sizes.
  *
+ *  Cumulative traffic counts (buffers and bytes sent, messages and bytes received, and
+ *  the number of write and read completions) for the life of the IO handler are also 
+ *  returned. These are updated with relaxed atomic stores by the IO thread only, so 
+ *  the counters are not guaranteed to be consistent with each other at any instant.
+ *
  *  @return @c nonstd::expected - @c output_queue_stats on success; on error (if no
  *  associated IO handler), a @c std::error_code is returned.
  *
@@ -114,11 +126,14 @@ public:
  *
  *  @param sz Size of buffer.
  *
- *  @return @c true if buffer written or queued for output, @c false otherwise (no IO handler
- *  association, or IO handler stopped).
+ *  @return @c send_result, @c true if buffer written or queued for output, @c false otherwise
+ *  (no IO handler association, IO handler stopped, or output queue overflow); the status
+ *  reports the specific outcome.
  *
  */
-  bool send(const void* buf, std::size_t sz) const { return send(chops::const_shared_buffer(buf, sz)); }
+  send_result send(const void* buf, std::size_t sz) const {
+    return send(chops::const_shared_buffer(buf, sz));
+  }
 
 /**
  *  @brief Send a reference counted buffer through the associated network IO handler.
@@ -127,13 +142,14 @@ public:
  *
  *  @param buf @c chops::const_shared_buffer containing data.
  *
- *  @return @c true if buffer written or queued for output, @c false otherwise (no IO handler
- *  association, or IO handler stopped).
+ *  @return @c send_result, @c true if buffer written or queued for output, @c false otherwise
+ *  (no IO handler association, IO handler stopped, or output queue overflow); the status
+ *  reports the specific outcome.
  *
  */
-  bool send(const chops::const_shared_buffer& buf) const {
+  send_result send(const chops::const_shared_buffer& buf) const {
     auto sp = m_ioh_wptr.lock();
-    return sp ?  sp->send(buf) : false;
+    return sp ?  sp->send(buf) : send_result();
   }
 
 /**
@@ -154,11 +170,12 @@ public:
  *
  *  @param buf @c chops::mutable_shared_buffer containing data.
  *
- *  @return @c true if buffer written or queued for output, @c false otherwise (no IO handler
- *  association, or IO handler stopped).
+ *  @return @c send_result, @c true if buffer written or queued for output, @c false otherwise
+ *  (no IO handler association, IO handler stopped, or output queue overflow); the status
+ *  reports the specific outcome.
  *
  */
-  bool send(chops::mutable_shared_buffer&& buf) const { 
+  send_result send(chops::mutable_shared_buffer&& buf) const { 
     return send(chops::const_shared_buffer(std::move(buf)));
   }
 
@@ -177,11 +194,12 @@ public:
  *
  *  @param endp Destination @c asio::ip::udp::endpoint for the buffer.
  *
- *  @return @c true if buffer written or queued for output, @c false otherwise (no IO handler
- *  association, or IO handler stopped).
+ *  @return @c send_result, @c true if buffer written or queued for output, @c false otherwise
+ *  (no IO handler association, IO handler stopped, or output queue overflow); the status
+ *  reports the specific outcome.
  *
  */
-  bool send(const void* buf, std::size_t sz, const endpoint_type& endp) const {
+  send_result send(const void* buf, std::size_t sz, const endpoint_type& endp) const {
     return send(chops::const_shared_buffer(buf, sz), endp);
   }
 
@@ -195,13 +213,14 @@ public:
  *
  *  @param endp Destination @c asio::ip::udp::endpoint for the buffer.
  *
- *  @return @c true if buffer written or queued for output, @c false otherwise (no IO handler
- *  association, or IO handler stopped).
+ *  @return @c send_result, @c true if buffer written or queued for output, @c false otherwise
+ *  (no IO handler association, IO handler stopped, or output queue overflow); the status
+ *  reports the specific outcome.
  *
  */
-  bool send(const chops::const_shared_buffer& buf, const endpoint_type& endp) const {
+  send_result send(const chops::const_shared_buffer& buf, const endpoint_type& endp) const {
     auto sp = m_ioh_wptr.lock();
-    return sp ?  sp->send(buf, endp) : false;
+    return sp ?  sp->send(buf, endp) : send_result();
   }
 
 /**
@@ -215,14 +234,270 @@ public:
  *
  *  @param endp Destination @c asio::ip::udp::endpoint for the buffer.
  *
- *  @return @c true if buffer written or queued for output, @c false otherwise (no IO handler
- *  association, or IO handler stopped).
+ *  @return @c send_result, @c true if buffer written or queued for output, @c false otherwise
+ *  (no IO handler association, IO handler stopped, or output queue overflow); the status
+ *  reports the specific outcome.
  *
  */
-  bool send(chops::mutable_shared_buffer&& buf, const endpoint_type& endp) const {
+  send_result send(chops::mutable_shared_buffer&& buf, const endpoint_type& endp) const {
     return send(chops::const_shared_buffer(std::move(buf)), endp);
   }
 
+/**
+ *  @brief Send application owned memory through the associated network IO handler 
+ *  without copying it, with a function object called when the IO handler no longer 
+ *  references the memory.
+ *
+ *  No @c chops::const_shared_buffer is allocated and the data is not copied, which allows
+ *  sending from pooled, pre-registered or static memory. The memory must stay valid and 
+ *  unmodified until the release function object is called. 
+ *
+ *  The release function object must have the signature of @c buffer_release_hook:
+ *
+ *  @code
+ *    void (const void*, std::size_t);
+ *  @endcode
+ *
+ *  It is called exactly once, with @c buf and @c sz, whether the buffer is written or 
+ *  discarded (see @c buffer_release_hook for the threads it can be called from). If there 
+ *  is no associated IO handler, it is called before this method returns. 
+ *
+ *  The release function object is held in a small reference counted control block, which 
+ *  is the only allocation for the send. This is a non-blocking call.
+ *
+ *  @param buf Pointer to application owned memory.
+ *
+ *  @param sz Size of buffer.
+ *
+ *  @param release Function object called when the memory is no longer referenced.
+ *
+ *  @return @c send_result, as with @c send.
+ *
+ */
+  send_result send_no_copy(const void* buf, std::size_t sz, buffer_release_hook release) const {
+    auto sp = m_ioh_wptr.lock();
+    if (sp) {
+      return sp->send_no_copy(buf, sz, std::move(release));
+    }
+    if (release) {
+      release(buf, sz);
+    }
+    return send_result();
+  }
+
+/**
+ *  @brief Send application owned memory to a specific destination endpoint without 
+ *  copying it, implemented only for UDP IO handlers.
+ *
+ *  See documentation for @c send_no_copy without an endpoint.
+ *
+ *  @param buf Pointer to application owned memory.
+ *
+ *  @param sz Size of buffer.
+ *
+ *  @param endp Destination @c asio::ip::udp::endpoint for the buffer.
+ *
+ *  @param release Function object called when the memory is no longer referenced.
+ *
+ *  @return @c send_result, as with @c send.
+ *
+ */
+  send_result send_no_copy(const void* buf, std::size_t sz, const endpoint_type& endp,
+                           buffer_release_hook release) const {
+    auto sp = m_ioh_wptr.lock();
+    if (sp) {
+      return sp->send_no_copy(buf, sz, endp, std::move(release));
+    }
+    if (release) {
+      release(buf, sz);
+    }
+    return send_result();
+  }
+
+/**
+ *  @brief Send a segment of a file through the associated TCP IO handler, without
+ *  reading it into user space memory, implemented only for TCP IO handlers.
+ *
+ *  The segment is queued in order with all other sends. When it reaches the head of the
+ *  output queue it is written with @c sendfile(2) on Linux (other POSIX platforms read
+ *  and send it in chunks; Windows is not supported). In output queue statistics and
+ *  water marks the segment counts as a buffer of @c len bytes.
+ *
+ *  The file descriptor must stay open, and the segment must not be truncated, until the
+ *  release function object is called. It has the signature of @c file_release_hook:
+ *
+ *  @code
+ *    void (int);
+ *  @endcode
+ *
+ *  It is called exactly once with @c fd, whether the segment is written or discarded. If
+ *  there is no associated IO handler, it is called before this method returns. If the file
+ *  ends before @c len bytes are sent, the IO handler is closed with the
+ *  @c net_ip_errc::send_file_short error. This is a non-blocking call.
+ *
+ *  @param fd Open file descriptor, readable and mappable (e.g. a regular file).
+ *
+ *  @param offset Offset of the segment in the file.
+ *
+ *  @param len Number of bytes to send.
+ *
+ *  @param release Function object called when the descriptor is no longer referenced.
+ *
+ *  @return @c send_result, as with @c send.
+ *
+ */
+  send_result send_file(int fd, std::uint64_t offset, std::size_t len,
+                        file_release_hook release) const {
+    auto sp = m_ioh_wptr.lock();
+    if (sp) {
+      return sp->send_file(fd, offset, len, std::move(release));
+    }
+    if (release) {
+      release(fd);
+    }
+    return send_result();
+  }
+
+/**
+ *  @brief Send a region of a file by mapping it into memory (POSIX @c mmap) and sending
+ *  the mapped memory with @c send_no_copy.
+ *
+ *  The region is unmapped when the IO handler no longer references it. The file descriptor
+ *  can be closed as soon as this method returns, but the file must not be truncated while
+ *  the region is mapped. Compared to @c send_file this also works with zero copy sends
+ *  (see @c set_zero_copy) and with UDP IO handlers (to the default destination).
+ *
+ *  @param fd Open file descriptor, readable and mappable.
+ *
+ *  @param offset Offset of the region in the file, any alignment.
+ *
+ *  @param len Number of bytes to send.
+ *
+ *  @return @c nonstd::expected - @c send_result, as with @c send, on success; the @c mmap
+ *  error if the region could not be mapped.
+ *
+ */
+  auto send_mapped_file(int fd, std::uint64_t offset, std::size_t len) const ->
+        nonstd::expected<send_result, std::error_code> {
+    std::error_code ec;
+    auto region = detail::map_file_region(fd, offset, len, ec);
+    if (ec) {
+      return nonstd::make_unexpected(ec);
+    }
+    return send_no_copy(region.first, len, std::move(region.second));
+  }
+
+/**
+ *  @brief Send a reference counted buffer through the associated network IO handler, 
+ *  with a function object called once the write of the buffer has completed.
+ *
+ *  The buffer goes through the output queue in order with all other sends. When the
+ *  @c async_write (TCP) or @c async_send_to (UDP, or the whole batch for batched UDP 
+ *  sends) that contains the buffer completes, the function object is called from the IO
+ *  thread with the error code of the write and the number of bytes of the buffer 
+ *  written. A datagram of a UDP batch sent before a later datagram failed reports 
+ *  success. This allows an application to release upstream resources or pace an 
+ *  ack-driven pipeline when the data has been handed to the socket, instead of 
+ *  buffering in the output queue.
+ *
+ *  The function object must have the signature of @c send_completion_handler:
+ *
+ *  @code
+ *    void (const std::error_code&, std::size_t);
+ *  @endcode
+ *
+ *  The function object is only called if the returned @c send_result is @c true. It is not
+ *  called if the buffer is later discarded by the @c drop_oldest overflow policy, or if 
+ *  the IO handler is closed while the buffer is still in the output queue (it is destroyed 
+ *  without being called). 
+ *
+ *  Buffers sent through the plain @c send methods do not carry a completion and pay no
+ *  extra cost. This is a non-blocking call.
+ *
+ *  @param buf @c chops::const_shared_buffer containing data.
+ *
+ *  @param completion Function object called when the write completes.
+ *
+ *  @return @c send_result, as with @c send.
+ *
+ */
+  send_result send_with_completion(const chops::const_shared_buffer& buf, 
+                                   send_completion_handler completion) const {
+    auto sp = m_ioh_wptr.lock();
+    return sp ?  sp->send_with_completion(buf, std::move(completion)) : send_result();
+  }
+
+/**
+ *  @brief Send a reference counted buffer to a specific destination endpoint, with a 
+ *  function object called once the write of the buffer has completed, implemented 
+ *  only for UDP IO handlers.
+ *
+ *  See documentation for @c send_with_completion without an endpoint.
+ *
+ *  @param buf @c chops::const_shared_buffer containing data.
+ *
+ *  @param endp Destination @c asio::ip::udp::endpoint for the buffer.
+ *
+ *  @param completion Function object called when the write completes.
+ *
+ *  @return @c send_result, as with @c send.
+ *
+ */
+  send_result send_with_completion(const chops::const_shared_buffer& buf, 
+                                   const endpoint_type& endp,
+                                   send_completion_handler completion) const {
+    auto sp = m_ioh_wptr.lock();
+    return sp ?  sp->send_with_completion(buf, endp, std::move(completion)) : send_result();
+  }
+
+/**
+ *  @brief Send a reference counted buffer through the associated network IO handler, 
+ *  returning a @c std::future that becomes ready once the write of the buffer has 
+ *  completed.
+ *
+ *  The @c send_completion in the @c std::future contains the error code and number of
+ *  bytes written, as delivered to the function object of the other @c send_with_completion
+ *  overload. If the buffer is not written or queued (no IO handler association, IO handler
+ *  stopped, or output queue overflow), the @c std::future is ready immediately with a
+ *  @c net_ip_errc::send_not_queued error. If the buffer is discarded after being queued 
+ *  (see the other overload), the @c std::future holds a @c std::future_error (broken
+ *  promise).
+ *
+ *  @param buf @c chops::const_shared_buffer containing data.
+ *
+ *  @return @c std::future containing a @c send_completion.
+ *
+ */
+  std::future<send_completion> send_with_completion(const chops::const_shared_buffer& buf) const {
+    return completion_future([&buf, this] (send_completion_handler completion) {
+        return send_with_completion(buf, std::move(completion));
+      }
+    );
+  }
+
+/**
+ *  @brief Send a reference counted buffer to a specific destination endpoint, returning a 
+ *  @c std::future that becomes ready once the write of the buffer has completed, 
+ *  implemented only for UDP IO handlers.
+ *
+ *  See documentation for @c send_with_completion returning a @c std::future without an
+ *  endpoint.
+ *
+ *  @param buf @c chops::const_shared_buffer containing data.
+ *
+ *  @param endp Destination @c asio::ip::udp::endpoint for the buffer.
+ *
+ *  @return @c std::future containing a @c send_completion.
+ *
+ */
+  std::future<send_completion> send_with_completion(const chops::const_shared_buffer& buf,
+                                                    const endpoint_type& endp) const {
+    return completion_future([&buf, &endp, this] (send_completion_handler completion) {
+        return send_with_completion(buf, endp, std::move(completion));
+      }
+    );
+  }
+
 /**
  *  @brief Compare two @c basic_io_output objects for equality.
  *
@@ -251,6 +526,24 @@ public:
     return (m_ioh_wptr.lock() < rhs.m_ioh_wptr.lock());
   }
 
+private:
+
+  // std::promise is move-only and send_completion_handler is a std::function, so the
+  // promise is shared with the function object
+  template <typename F>
+  static std::future<send_completion> completion_future(F&& send_func) {
+    auto prom = std::make_shared<std::promise<send_completion>>();
+    auto fut = prom->get_future();
+    auto r = send_func([prom] (const std::error_code& err, std::size_t num_bytes) {
+        prom->set_value(send_completion { err, num_bytes });
+      }
+    );
+    if (!r) {
+      prom->set_value(send_completion { std::make_error_code(net_ip_errc::send_not_queued), 0u });
+    }
+    return fut;
+  }
+
 };
 
 } // end net namespace
@@ -0,0 +1,125 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Functions for sending file contents through a TCP socket without user space
+ *  copies, and for mapping a file region into memory.
+ *
+ *  On Linux @c send_file_segment uses @c sendfile(2), which moves the data from the page
+ *  cache to the socket inside the kernel. Other POSIX platforms read the file in chunks
+ *  with @c pread and send each chunk; this is correct but does copy the data. File
+ *  sending is not supported on Windows.
+ *
+ *  @c map_file_region maps a read-only, shared view of a file region (POSIX @c mmap),
+ *  returning a release hook that unmaps it, suitable for @c send_no_copy.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef FILE_SEND_HPP_INCLUDED
+#define FILE_SEND_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <system_error>
+#include <utility> // std::pair
+#include <algorithm> // std::min
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+#include "net_ip/queue_stats.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+#ifndef _WIN32
+
+// sends up to count bytes of the file starting at offset, the socket must be non-blocking;
+// returns the number of bytes sent, 0 with no error means the file ended before offset
+inline std::size_t send_file_segment(int sock, int fd, std::uint64_t offset, std::size_t count,
+                                     std::error_code& ec) noexcept {
+#ifdef __linux__
+  off_t off = static_cast<off_t>(offset);
+  auto n = ::sendfile(sock, fd, &off, count);
+  if (n < 0) {
+    ec = std::error_code(errno, std::system_category());
+    return 0u;
+  }
+  return static_cast<std::size_t>(n);
+#else
+  std::byte chunk[64u * 1024u];
+  auto r = ::pread(fd, chunk, std::min(count, sizeof(chunk)), static_cast<off_t>(offset));
+  if (r <= 0) {
+    if (r < 0) {
+      ec = std::error_code(errno, std::system_category());
+    }
+    return 0u;
+  }
+  // bytes of the chunk that are not sent are read again on the next call
+  auto n = ::send(sock, chunk, static_cast<std::size_t>(r), 0);
+  if (n < 0) {
+    ec = std::error_code(errno, std::system_category());
+    return 0u;
+  }
+  return static_cast<std::size_t>(n);
+#endif
+}
+
+// the mapping starts on a page boundary, so the returned pointer is offset into it
+inline std::pair<const void*, buffer_release_hook> map_file_region(int fd, std::uint64_t offset,
+                                                                   std::size_t len,
+                                                                   std::error_code& ec) {
+  auto page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+  auto delta = static_cast<std::size_t>(offset % page);
+  auto map_len = len + delta;
+  void* base = ::mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd,
+                      static_cast<off_t>(offset - delta));
+  if (base == MAP_FAILED) {
+    ec = std::error_code(errno, std::system_category());
+    return std::pair<const void*, buffer_release_hook>(nullptr, buffer_release_hook { });
+  }
+  return std::pair<const void*, buffer_release_hook>(static_cast<const std::byte*>(base) + delta,
+            [base, map_len] (const void*, std::size_t) { ::munmap(base, map_len); } );
+}
+
+#else
+
+template <typename S, typename F>
+std::size_t send_file_segment(S, F, std::uint64_t, std::size_t, std::error_code& ec) noexcept {
+  ec = std::make_error_code(std::errc::operation_not_supported);
+  return 0u;
+}
+
+template <typename F>
+std::pair<const void*, buffer_release_hook> map_file_region(F, std::uint64_t, std::size_t,
+                                                            std::error_code& ec) {
+  ec = std::make_error_code(std::errc::operation_not_supported);
+  return std::pair<const void*, buffer_release_hook>(nullptr, buffer_release_hook { });
+}
+
+#endif
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
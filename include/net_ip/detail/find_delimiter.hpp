@@ -0,0 +1,64 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Delimiter search used by delimiter based TCP reads.
+ *
+ *  The first delimiter byte is located with @c std::memchr, which standard libraries
+ *  implement with vector instructions (e.g. SSE2 or AVX2 in glibc), and the remaining
+ *  delimiter bytes are then compared. For single byte delimiters (e.g. a newline) the
+ *  search is a single @c std::memchr call.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef FIND_DELIMITER_HPP_INCLUDED
+#define FIND_DELIMITER_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstring> // std::memchr, std::memcmp
+#include <string_view>
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// returns the offset of the first delimiter in the buffer, or the buffer size if there
+// is no complete delimiter; an empty delimiter is never found
+inline std::size_t find_delimiter(const std::byte* buf, std::size_t sz,
+                                  std::string_view delim) noexcept {
+  if (delim.empty()) {
+    return sz;
+  }
+  const std::size_t rest = delim.size() - 1u;
+  std::size_t pos = 0u;
+  while (sz - pos > rest) {
+    auto p = static_cast<const std::byte*>(std::memchr(buf + pos,
+                                           static_cast<unsigned char>(delim.front()),
+                                           sz - pos - rest));
+    if (p == nullptr) {
+      return sz;
+    }
+    std::size_t off = static_cast<std::size_t>(p - buf);
+    if (rest == 0u || std::memcmp(p + 1, delim.data() + 1, rest) == 0) {
+      return off;
+    }
+    pos = off + 1u;
+  }
+  return sz;
+}
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
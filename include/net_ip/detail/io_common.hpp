@@ -9,6 +9,24 @@
  *  but other designs are possible, including @c asio @c post for writes, or 
  *  various combinations of a lock-free MPSC queue and @c std::atomic variables.
  *
+ *  The output queue container is a template policy, defaulting to the @c std::queue
+ *  based @c output_queue; the io handlers use @c ring_output_queue. An optional limit
+ *  on the number of queued elements, along with a @c queue_overflow_policy, bounds the
+ *  memory used by a slow or stuck peer.
+ *
+ *  Output queue water marks can be set, with a notify function object called (with
+ *  the lock held, so notifications stay in order) when the queue crosses a high water 
+ *  mark going up or a low water mark going down. The io handler then calls 
+ *  @c check_water_marks from the IO thread, which applies the hysteresis and reports 
+ *  each state change once. The check evaluates the queue level when it runs, not the
+ *  level at the time of the notify, so a spike above the high water mark that drains
+ *  before the check is not reported. The hysteresis state is reset when a check finds
+ *  IO stopped or notifications disabled, the same as in @c lock_free_io_common.
+ *
+ *  A lock-free MPSC queue design is available in @c lock_free_io_common, and is
+ *  selected for the io handlers (through the @c io_common_type alias) when
+ *  @c CHOPS_NET_IP_LOCK_FREE_IO_COMMON is defined.
+ *
  *  @note For internal use only.
  *
  *  @author Cliff Green
@@ -25,20 +43,41 @@
 
 #include <optional>
 #include <mutex>
+#include <functional> // std::function
+#include <utility> // std::move
+#include <vector>
+#include <cstddef> // std::size_t
+#include <limits>
 
 #include "net_ip/detail/output_queue.hpp"
+#include "net_ip/detail/ring_output_queue.hpp"
 #include "net_ip/queue_stats.hpp"
 
+#ifdef CHOPS_NET_IP_LOCK_FREE_IO_COMMON
+#include "net_ip/detail/lock_free_io_common.hpp"
+#endif
+
 namespace chops {
 namespace net {
 namespace detail {
 
-template <typename E>
+// template parameter Q is the output queue policy, either output_queue<E> or 
+// ring_output_queue<E>
+template <typename E, typename Q = output_queue<E>>
 class io_common {
 private:
   bool                m_io_started; // original implementation this was std::atomic_bool
+  bool                m_io_closing; // new writes refused, queued elements still written
   bool                m_write_in_progress;
-  output_queue<E>     m_outq;
+  std::size_t         m_max_batch_elems;
+  std::size_t         m_max_batch_bytes;
+  std::size_t         m_max_queue_elems; // 0 is unbounded
+  queue_overflow_policy m_overflow_policy;
+  std::size_t         m_num_overflows;
+  output_queue_water_marks m_water_marks;
+  std::function<void ()> m_water_mark_notify;
+  bool                m_above_high_water;
+  Q                   m_outq;
   mutable std::mutex  m_mutex;
 
 private:
@@ -50,18 +89,61 @@ private:
     m_write_in_progress = false;
   }
 
+  // apply a change to the queue (mutex should already be locked), calling the water mark 
+  // notify function object if the change crosses a water mark
+  template <typename F>
+  auto change_queue(F&& func) {
+    if (!m_water_mark_notify) {
+      return func();
+    }
+    auto before = m_outq.get_queue_stats();
+    auto ret = func();
+    auto after = m_outq.get_queue_stats();
+    if (water_mark_crossed(m_water_marks.high_bufs, m_water_marks.low_bufs, 
+                           before.output_queue_size, after.output_queue_size) ||
+        water_mark_crossed(m_water_marks.high_bytes, m_water_marks.low_bytes, 
+                           before.bytes_in_output_queue, after.bytes_in_output_queue)) {
+      m_water_mark_notify();
+    }
+    return ret;
+  }
+
+  // queue is full, apply the overflow policy
+  send_result::status overflow(const E& elem) {
+    ++m_num_overflows;
+    switch (m_overflow_policy) {
+    case queue_overflow_policy::drop_oldest:
+      m_outq.get_next_element();
+      m_outq.add_element(elem);
+      return send_result::queued_dropped_oldest;
+    case queue_overflow_policy::drop_newest:
+      return send_result::dropped_newest;
+    case queue_overflow_policy::close_io:
+      return send_result::overflow_closed;
+    case queue_overflow_policy::reject:
+      break;
+    }
+    return send_result::rejected;
+  }
+
 public:
-  enum write_status { io_stopped, queued, write_started };
+  using write_status = send_result::status;
 
 public:
 
   io_common() noexcept :
-    m_io_started(false), m_write_in_progress(false), m_outq(), m_mutex() { }
+    m_io_started(false), m_io_closing(false), m_write_in_progress(false), 
+    m_max_batch_elems(1u), m_max_batch_bytes(std::numeric_limits<std::size_t>::max()),
+    m_max_queue_elems(0u), m_overflow_policy(queue_overflow_policy::reject), 
+    m_num_overflows(0u), m_water_marks(), m_water_mark_notify(), m_above_high_water(false),
+    m_outq(), m_mutex() { }
 
-  // the following four methods can be called concurrently
-  auto get_output_queue_stats() const noexcept {
+  // the following seven methods can be called concurrently
+  output_queue_stats get_output_queue_stats() const noexcept {
     lk_guard lg(m_mutex);
-    return m_outq.get_queue_stats();
+    auto st = m_outq.get_queue_stats();
+    st.num_overflows = m_num_overflows;
+    return st;
   }
 
   bool is_io_started() const noexcept {
@@ -76,10 +158,73 @@ public:
 
   bool set_io_stopped() noexcept {
     lk_guard lg(m_mutex);
+    m_io_closing = false;
     return m_io_started ? (m_io_started = false, true) : false;
   }
 
+  // a close is pending, start_write returns io_stopped from now on, while the elements
+  // already queued are still written; set_io_stopped ends the closing state
+  void set_io_closing() noexcept {
+    lk_guard lg(m_mutex);
+    m_io_closing = m_io_started;
+  }
+
+  // a max elements value of 1 disables batching, a max bytes value of 0 means no byte
+  // limit; at least one element is always part of a batch, regardless of the max bytes value
+  void set_write_batch_limits(std::size_t max_elems, std::size_t max_bytes) noexcept {
+    lk_guard lg(m_mutex);
+    m_max_batch_elems = (max_elems == 0u ? 1u : max_elems);
+    m_max_batch_bytes = (max_bytes == 0u ? std::numeric_limits<std::size_t>::max() : max_bytes);
+  }
+
+  // a max elements value of 0 means an unbounded queue; the queue policy reserves 
+  // storage for the limit (a ring buffer then never allocates), and a lowered limit 
+  // applies to new sends only, already queued elements are not discarded (a ring 
+  // buffer gives back the storage above the lowered limit not needed by them)
+  void set_output_queue_limit(std::size_t max_elems, queue_overflow_policy policy) {
+    lk_guard lg(m_mutex);
+    m_max_queue_elems = max_elems;
+    m_overflow_policy = policy;
+    m_outq.reserve(max_elems);
+  }
+
+  // the notify function object is called whenever a water mark might have been crossed,
+  // including right away so that the current queue level is evaluated; an empty notify 
+  // function object disables water marks
+  void set_water_marks(const output_queue_water_marks& wm, std::function<void ()> notify) {
+    lk_guard lg(m_mutex);
+    m_water_marks = normalize_water_marks(wm);
+    m_water_mark_notify = std::move(notify);
+    m_above_high_water = false;
+    if (m_water_mark_notify) {
+      m_water_mark_notify();
+    }
+  }
+
   // rest of these method called only from within run thread
+
+  // returns true if the queue has reached a high water mark, false if the queue has 
+  // drained to the low water marks, and an empty optional if there is no state change
+  std::optional<bool> check_water_marks() {
+    lk_guard lg(m_mutex);
+    if (!m_io_started || !m_water_mark_notify) {
+      m_above_high_water = false; // a restart or new notify begins below the high water mark
+      return std::optional<bool> { };
+    }
+    auto st = m_outq.get_queue_stats();
+    if (!m_above_high_water && 
+        above_high_water(m_water_marks, st.output_queue_size, st.bytes_in_output_queue)) {
+      m_above_high_water = true;
+      return std::optional<bool> { true };
+    }
+    if (m_above_high_water && 
+        below_low_water(m_water_marks, st.output_queue_size, st.bytes_in_output_queue)) {
+      m_above_high_water = false;
+      return std::optional<bool> { false };
+    }
+    return std::optional<bool> { };
+  }
+
   bool is_write_in_progress() const noexcept {
     lk_guard lg(m_mutex);
     return m_write_in_progress;
@@ -97,15 +242,24 @@ public:
     lk_guard lg(m_mutex);
     if (!m_io_started) {
       do_clear();
-      return io_stopped; // shutdown happening or not io_started, don't start a write
+      return write_status::io_stopped; // shutdown happening or not io_started, don't start a write
+    }
+    if (m_io_closing) {
+      return write_status::io_stopped;
     }
     if (m_write_in_progress) { // queue buffer
-      m_outq.add_element(elem);
-      return queued;
+      return change_queue([this, &elem] {
+          if (m_max_queue_elems != 0u && m_outq.size() >= m_max_queue_elems) {
+            return overflow(elem);
+          }
+          m_outq.add_element(elem);
+          return write_status::queued;
+        }
+      );
     }
     m_write_in_progress = true;
     func(elem);
-    return write_started;
+    return write_status::write_started;
   }
 
   template <typename F>
@@ -115,7 +269,7 @@ public:
       do_clear();
       return;
     }
-    auto elem = m_outq.get_next_element();
+    auto elem = change_queue([this] { return m_outq.get_next_element(); } );
     if (!elem) {
       m_write_in_progress = false;
       return;
@@ -125,8 +279,37 @@ public:
     return;
   }
 
+  // gather write version of write_next_elem, the container is cleared and then filled 
+  // with up to the batch limits of elements; the container must stay unmodified until 
+  // the write completes, since it keeps the buffers alive for the duration of the write
+  template <typename F>
+  void write_next_elems(std::vector<E>& elems, F&& func) {
+    lk_guard lg(m_mutex);
+    elems.clear();
+    if (!m_io_started) { // shutting down
+      do_clear();
+      return;
+    }
+    if (change_queue([this, &elems] { 
+          return m_outq.get_next_elements(elems, m_max_batch_elems, m_max_batch_bytes); } ) == 0u) {
+      m_write_in_progress = false;
+      return;
+    }
+    m_write_in_progress = true;
+    func(elems);
+    return;
+  }
+
 };
 
+#ifdef CHOPS_NET_IP_LOCK_FREE_IO_COMMON
+template <typename E>
+using io_common_type = lock_free_io_common<E>;
+#else
+template <typename E>
+using io_common_type = io_common<E, ring_output_queue<E>>;
+#endif
+
 } // end detail namespace
 } // end net namespace
 } // end chops namespace
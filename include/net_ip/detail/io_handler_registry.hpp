@@ -0,0 +1,88 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Registry of the IO handlers of a TCP acceptor, with constant time insert and
+ *  remove.
+ *
+ *  The handlers are held in a dense vector, so iteration (e.g. for @c visit_io_output)
+ *  is a contiguous walk. Each handler stores its own position in the vector (an intrusive
+ *  slot index), so a remove does not search: the removed handler's slot is filled by the
+ *  last handler, which is then popped. Removing therefore changes the iteration order,
+ *  but the container must not be modified while it is being iterated in any case.
+ *
+ *  The IO handler type provides @c get_registry_slot and @c set_registry_slot methods.
+ *  The registry is not thread-safe, the TCP acceptor only uses it on its own strand.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef IO_HANDLER_REGISTRY_HPP_INCLUDED
+#define IO_HANDLER_REGISTRY_HPP_INCLUDED
+
+#include <vector>
+#include <memory> // std::shared_ptr
+#include <utility> // std::move
+#include <cstddef> // std::size_t
+
+namespace chops {
+namespace net {
+namespace detail {
+
+constexpr std::size_t no_registry_slot = static_cast<std::size_t>(-1);
+
+template <typename IOH>
+class io_handler_registry {
+public:
+  using io_handler_ptr = std::shared_ptr<IOH>;
+  using const_iterator = typename std::vector<io_handler_ptr>::const_iterator;
+
+private:
+  std::vector<io_handler_ptr>  m_handlers;
+
+public:
+
+  io_handler_registry() : m_handlers() { }
+
+  void add(io_handler_ptr ioh) {
+    ioh->set_registry_slot(m_handlers.size());
+    m_handlers.push_back(std::move(ioh));
+  }
+
+  // returns false if the handler is not in this registry (e.g. already removed)
+  bool remove(const io_handler_ptr& ioh) {
+    auto slot = ioh->get_registry_slot();
+    if (slot >= m_handlers.size() || m_handlers[slot] != ioh) {
+      return false;
+    }
+    if (slot != m_handlers.size() - 1u) {
+      m_handlers[slot] = std::move(m_handlers.back());
+      m_handlers[slot]->set_registry_slot(slot);
+    }
+    m_handlers.pop_back();
+    ioh->set_registry_slot(no_registry_slot);
+    return true;
+  }
+
+  std::size_t size() const noexcept { return m_handlers.size(); }
+  bool empty() const noexcept { return m_handlers.empty(); }
+
+  const_iterator begin() const noexcept { return m_handlers.cbegin(); }
+  const_iterator end() const noexcept { return m_handlers.cend(); }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
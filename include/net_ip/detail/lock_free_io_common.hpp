@@ -0,0 +1,445 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Lock-free alternative to @c io_common, for TCP and UDP io handlers.
+ *
+ *  The interface is the same as @c io_common, but instead of a @c std::mutex protecting
+ *  the output queue and flags, senders push elements onto a lock-free multiple producer,
+ *  single consumer (MPSC) queue. A @c std::atomic_bool "write in progress" flag is used
+ *  as a hand-off between threads, guaranteeing that only one write is ever in progress.
+ *  Whichever thread sets the flag (either a sender or the IO thread in a write completion)
+ *  is the single consumer of the queue until it clears the flag.
+ *
+ *  The MPSC queue is the node based design from Dmitry Vyukov. Pushes are wait-free
+ *  (one atomic exchange), pops are lock-free, with a short window where a pushed element
+ *  is counted but not yet linked into the queue (the consumer yields and tries again).
+ *
+ *  An output queue limit and overflow policy are supported, but the limit is checked
+ *  against the atomic size counter, so it is exact only for the reject, drop newest, and
+ *  close policies. With the drop oldest policy senders cannot remove elements (there is
+ *  a single consumer), so the excess elements are discarded by the consumer on its next
+ *  pop. Queue nodes are allocated per element, regardless of the limit.
+ *
+ *  Water marks are supported with the same notify and check design as @c io_common. The
+ *  notify function object may be called concurrently from multiple threads (it is only 
+ *  a request for a check), while @c check_water_marks is only called from the IO thread.
+ *  As with @c io_common, the check evaluates the queue level when it runs, so a spike
+ *  that drains before the check is not reported.
+ *
+ *  This design is selected in the TCP and UDP io handlers by defining
+ *  @c CHOPS_NET_IP_LOCK_FREE_IO_COMMON before including any Chops Net IP headers. Senders
+ *  never block each other or the IO thread, but each queued element costs a node
+ *  allocation, so whether it outperforms the mutex design depends on the number of cores
+ *  and sending threads. The (hidden) contention benchmark in the unit tests compares the
+ *  two designs; the mutex design remains the default.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef LOCK_FREE_IO_COMMON_HPP_INCLUDED
+#define LOCK_FREE_IO_COMMON_HPP_INCLUDED
+
+#include <atomic>
+#include <optional>
+#include <vector>
+#include <thread> // std::this_thread::yield
+#include <cstddef> // std::size_t
+#include <limits>
+#include <utility> // std::move
+#include <memory> // std::shared_ptr, std::atomic_load, std::atomic_store
+#include <functional> // std::function
+
+#include "net_ip/queue_stats.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// template parameter E has the same requirements as in output_queue
+template <typename E>
+class mpsc_queue {
+private:
+  struct node {
+    std::atomic<node*>  m_next;
+    std::optional<E>    m_elem; // empty for the stub node
+
+    node() noexcept : m_next(nullptr), m_elem() { }
+    explicit node(const E& elem) : m_next(nullptr), m_elem(elem) { }
+  };
+
+private:
+  std::atomic<node*>    m_head; // producers push here
+  node*                 m_tail; // consumer pops here, always points to a stub node
+
+public:
+
+  mpsc_queue() : m_head(new node()), m_tail(m_head.load()) { }
+
+  ~mpsc_queue() noexcept {
+    while (m_tail) {
+      node* nxt = m_tail->m_next.load(std::memory_order_relaxed);
+      delete m_tail;
+      m_tail = nxt;
+    }
+  }
+
+private:
+  mpsc_queue(const mpsc_queue&) = delete;
+  mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+public:
+
+  // can be called concurrently by any number of threads
+  void push(const E& elem) {
+    node* n = new node(elem);
+    node* prev = m_head.exchange(n, std::memory_order_acq_rel);
+    prev->m_next.store(n, std::memory_order_release);
+  }
+
+  // following methods are only called by the (single) consumer; a nullptr is returned
+  // if the queue is empty or the next element has not yet been linked in by a producer
+  const E* peek() const noexcept {
+    node* nxt = m_tail->m_next.load(std::memory_order_acquire);
+    return nxt ? &(*nxt->m_elem) : nullptr;
+  }
+
+  std::optional<E> pop() {
+    node* nxt = m_tail->m_next.load(std::memory_order_acquire);
+    if (!nxt) {
+      return std::optional<E> { };
+    }
+    std::optional<E> elem { std::move(nxt->m_elem) };
+    nxt->m_elem.reset(); // nxt is now the stub node
+    delete m_tail;
+    m_tail = nxt;
+    return elem;
+  }
+
+};
+
+template <typename E>
+class lock_free_io_common {
+private:
+  std::atomic_bool           m_io_started;
+  std::atomic_bool           m_io_closing;
+  std::atomic_bool           m_write_in_progress;
+  std::atomic_size_t         m_max_batch_elems;
+  std::atomic_size_t         m_max_batch_bytes;
+  std::atomic_size_t         m_max_queue_elems; // 0 is unbounded
+  std::atomic<queue_overflow_policy> m_overflow_policy;
+  std::atomic_size_t         m_num_overflows;
+  std::atomic_size_t         m_high_bufs; // water marks
+  std::atomic_size_t         m_low_bufs;
+  std::atomic_size_t         m_high_bytes;
+  std::atomic_size_t         m_low_bytes;
+  // accessed through std::atomic_load and std::atomic_store
+  std::shared_ptr<const std::function<void ()>> m_water_mark_notify;
+  bool                       m_above_high_water; // IO thread only
+  // counts are incremented before an element is pushed and decremented after it is
+  // popped, so a non-zero size means an element is in the queue or about to be
+  std::atomic_size_t         m_queue_size;
+  std::atomic_size_t         m_queue_bytes;
+  // following are only written by the consumer, atomic for concurrent stats access
+  std::atomic_size_t         m_num_write_batches;
+  std::atomic_size_t         m_bufs_in_write_batches;
+  std::atomic_size_t         m_max_write_batch_bufs;
+  mpsc_queue<E>              m_queue;
+
+public:
+  using write_status = send_result::status;
+
+public:
+
+  lock_free_io_common() :
+    m_io_started(false), m_io_closing(false), m_write_in_progress(false),
+    m_max_batch_elems(1u), m_max_batch_bytes(std::numeric_limits<std::size_t>::max()),
+    m_max_queue_elems(0u), m_overflow_policy(queue_overflow_policy::reject), 
+    m_num_overflows(0u), m_high_bufs(0u), m_low_bufs(0u), m_high_bytes(0u), m_low_bytes(0u),
+    m_water_mark_notify(), m_above_high_water(false), m_queue_size(0u), m_queue_bytes(0u),
+    m_num_write_batches(0u), m_bufs_in_write_batches(0u), m_max_write_batch_bufs(0u),
+    m_queue() { }
+
+  // the following seven methods can be called concurrently
+  output_queue_stats get_output_queue_stats() const noexcept {
+    return output_queue_stats { m_queue_size.load(std::memory_order_relaxed),
+                                m_queue_bytes.load(std::memory_order_relaxed),
+                                m_num_write_batches.load(std::memory_order_relaxed),
+                                m_bufs_in_write_batches.load(std::memory_order_relaxed),
+                                m_max_write_batch_bufs.load(std::memory_order_relaxed),
+                                m_num_overflows.load(std::memory_order_relaxed) };
+  }
+
+  bool is_io_started() const noexcept { return m_io_started; }
+
+  bool set_io_started() noexcept {
+    bool expected = false;
+    return m_io_started.compare_exchange_strong(expected, true);
+  }
+
+  bool set_io_stopped() noexcept {
+    m_io_closing = false;
+    bool expected = true;
+    return m_io_started.compare_exchange_strong(expected, false);
+  }
+
+  // same semantics as io_common set_io_closing; a send racing with this call may still 
+  // queue its element, which is then written along with the others
+  void set_io_closing() noexcept {
+    m_io_closing = m_io_started.load();
+  }
+
+  void set_write_batch_limits(std::size_t max_elems, std::size_t max_bytes) noexcept {
+    m_max_batch_elems.store(max_elems == 0u ? 1u : max_elems, std::memory_order_relaxed);
+    m_max_batch_bytes.store(max_bytes == 0u ? std::numeric_limits<std::size_t>::max() : max_bytes,
+                            std::memory_order_relaxed);
+  }
+
+  // a max elements value of 0 means an unbounded queue
+  void set_output_queue_limit(std::size_t max_elems, queue_overflow_policy policy) noexcept {
+    m_overflow_policy.store(policy, std::memory_order_relaxed);
+    m_max_queue_elems.store(max_elems, std::memory_order_relaxed);
+  }
+
+  // same semantics as io_common set_water_marks
+  void set_water_marks(const output_queue_water_marks& wm, std::function<void ()> notify) {
+    auto nwm = normalize_water_marks(wm);
+    m_high_bufs = nwm.high_bufs;
+    m_low_bufs = nwm.low_bufs;
+    m_high_bytes = nwm.high_bytes;
+    m_low_bytes = nwm.low_bytes;
+    std::shared_ptr<const std::function<void ()>> p;
+    if (notify) {
+      p = std::make_shared<const std::function<void ()>>(std::move(notify));
+    }
+    std::atomic_store(&m_water_mark_notify, p);
+    if (p) {
+      (*p)();
+    }
+  }
+
+  // rest of these method called only from within run thread
+
+  // same semantics as io_common check_water_marks
+  std::optional<bool> check_water_marks() {
+    if (!m_io_started || !std::atomic_load(&m_water_mark_notify)) {
+      m_above_high_water = false;
+      return std::optional<bool> { };
+    }
+    output_queue_water_marks wm { m_high_bufs, m_low_bufs, m_high_bytes, m_low_bytes };
+    auto bufs = m_queue_size.load();
+    auto bytes = m_queue_bytes.load();
+    if (!m_above_high_water && above_high_water(wm, bufs, bytes)) {
+      m_above_high_water = true;
+      return std::optional<bool> { true };
+    }
+    if (m_above_high_water && below_low_water(wm, bufs, bytes)) {
+      m_above_high_water = false;
+      return std::optional<bool> { false };
+    }
+    return std::optional<bool> { };
+  }
+
+  bool is_write_in_progress() const noexcept { return m_write_in_progress; }
+
+  // the queue can only be emptied by the consumer, so if a write is in progress the
+  // elements are released when the write completes (write_next_elem or write_next_elems
+  // must be called even on write errors)
+  void clear() noexcept {
+    if (m_write_in_progress.exchange(true)) {
+      return;
+    }
+    drain();
+    m_write_in_progress = false;
+  }
+
+  template <typename F>
+  write_status start_write(const E& elem, F&& func) {
+    if (!m_io_started || m_io_closing) {
+      return write_status::io_stopped; // shutdown happening or not io_started, don't start a write
+    }
+    write_status st = write_status::queued;
+    auto max_elems = m_max_queue_elems.load(std::memory_order_relaxed);
+    // elements are counted until popped for a write, so the count is the number of 
+    // elements waiting behind the write in progress
+    auto prev_size = m_queue_size.fetch_add(1u);
+    if (prev_size >= max_elems && max_elems != 0u) {
+      m_num_overflows.fetch_add(1u, std::memory_order_relaxed);
+      switch (m_overflow_policy.load(std::memory_order_relaxed)) {
+      case queue_overflow_policy::drop_oldest:
+        st = write_status::queued_dropped_oldest; // consumer discards the excess
+        break;
+      case queue_overflow_policy::drop_newest:
+        m_queue_size.fetch_sub(1u);
+        return write_status::dropped_newest;
+      case queue_overflow_policy::close_io:
+        m_queue_size.fetch_sub(1u);
+        return write_status::overflow_closed;
+      case queue_overflow_policy::reject:
+        m_queue_size.fetch_sub(1u);
+        return write_status::rejected;
+      }
+    }
+    auto prev_bytes = m_queue_bytes.fetch_add(elem.size(), std::memory_order_relaxed);
+    m_queue.push(elem);
+    water_mark_edge(prev_size, prev_size + 1u, prev_bytes, prev_bytes + elem.size());
+    if (m_write_in_progress.exchange(true)) {
+      return st; // the current consumer will pick up the element
+    }
+    // this thread is now the consumer, the next element may not be the one just pushed
+    drop_excess();
+    auto e = pop_wait();
+    func(*e);
+    return st == write_status::queued ? write_status::write_started : st;
+  }
+
+  template <typename F>
+  void write_next_elem(F&& func) {
+    while (true) {
+      if (!m_io_started) { // shutting down
+        drain();
+        m_write_in_progress = false;
+        return;
+      }
+      if (m_queue_size != 0u) {
+        drop_excess();
+        auto e = pop_wait();
+        func(*e);
+        return;
+      }
+      if (!release_write_in_progress()) {
+        return;
+      }
+    }
+  }
+
+  template <typename F>
+  void write_next_elems(std::vector<E>& elems, F&& func) {
+    elems.clear();
+    while (true) {
+      if (!m_io_started) { // shutting down
+        drain();
+        m_write_in_progress = false;
+        return;
+      }
+      if (m_queue_size != 0u) {
+        drop_excess();
+        pop_batch(elems);
+        func(elems);
+        return;
+      }
+      if (!release_write_in_progress()) {
+        return;
+      }
+    }
+  }
+
+private:
+
+  // clear the write in progress flag, then check if an element arrived in the meantime
+  // and try to set the flag again, returning true if this thread is still the consumer;
+  // sequentially consistent ordering on the flag and the size counter is required,
+  // otherwise a sender and the consumer could both miss the other's element
+  bool release_write_in_progress() noexcept {
+    m_write_in_progress = false;
+    if (m_queue_size == 0u) {
+      return false;
+    }
+    return !m_write_in_progress.exchange(true);
+  }
+
+  // check for a water mark crossing, only when water marks are set
+  void water_mark_edge(std::size_t prev_bufs, std::size_t bufs, 
+                       std::size_t prev_bytes, std::size_t bytes) {
+    auto high_bufs = m_high_bufs.load(std::memory_order_relaxed);
+    auto high_bytes = m_high_bytes.load(std::memory_order_relaxed);
+    if (high_bufs == 0u && high_bytes == 0u) { // no water marks, avoid the shared_ptr load
+      return;
+    }
+    if (water_mark_crossed(high_bufs, m_low_bufs.load(std::memory_order_relaxed), 
+                           prev_bufs, bufs) ||
+        water_mark_crossed(high_bytes, m_low_bytes.load(std::memory_order_relaxed), 
+                           prev_bytes, bytes)) {
+      auto p = std::atomic_load(&m_water_mark_notify);
+      if (p) {
+        (*p)();
+      }
+    }
+  }
+
+  void pop_count(const E& elem) {
+    auto prev_bufs = m_queue_size.fetch_sub(1u);
+    auto prev_bytes = m_queue_bytes.fetch_sub(elem.size(), std::memory_order_relaxed);
+    water_mark_edge(prev_bufs, prev_bufs - 1u, prev_bytes, prev_bytes - elem.size());
+  }
+
+  // only called when the size counter shows an element is available or about to be
+  std::optional<E> pop_wait() {
+    auto e = m_queue.pop();
+    while (!e) {
+      std::this_thread::yield();
+      e = m_queue.pop();
+    }
+    pop_count(*e);
+    return e;
+  }
+
+  // with the drop oldest policy, discard queued elements over the limit, always leaving 
+  // at least one element (the caller has seen a non-zero size)
+  void drop_excess() {
+    auto max_elems = m_max_queue_elems.load(std::memory_order_relaxed);
+    if (max_elems == 0u || 
+        m_overflow_policy.load(std::memory_order_relaxed) != queue_overflow_policy::drop_oldest) {
+      return;
+    }
+    while (m_queue_size > max_elems) {
+      pop_wait();
+    }
+  }
+
+  void pop_batch(std::vector<E>& elems) {
+    auto max_elems = m_max_batch_elems.load(std::memory_order_relaxed);
+    auto max_bytes = m_max_batch_bytes.load(std::memory_order_relaxed);
+    // first element always part of the batch, wait for it if needed
+    auto e = pop_wait();
+    std::size_t num_bytes = e->size();
+    elems.push_back(std::move(*e));
+    while (elems.size() < max_elems) {
+      const E* p = m_queue.peek();
+      if (!p || num_bytes + p->size() > max_bytes) {
+        break;
+      }
+      num_bytes += p->size();
+      elems.push_back(std::move(*m_queue.pop()));
+      pop_count(elems.back());
+    }
+    m_num_write_batches.fetch_add(1u, std::memory_order_relaxed);
+    m_bufs_in_write_batches.fetch_add(elems.size(), std::memory_order_relaxed);
+    if (elems.size() > m_max_write_batch_bufs.load(std::memory_order_relaxed)) {
+      m_max_write_batch_bufs.store(elems.size(), std::memory_order_relaxed);
+    }
+  }
+
+  void drain() noexcept {
+    while (auto e = m_queue.pop()) {
+      m_queue_size.fetch_sub(1u);
+      m_queue_bytes.fetch_sub(e->size(), std::memory_order_relaxed);
+    }
+  }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
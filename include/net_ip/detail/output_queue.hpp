@@ -10,6 +10,10 @@
  *  spin-lock or semaphore, etc), or by posting all write operations through the Asio 
  *  executor.
  *
+ *  The output queue is a template policy of @c io_common, with this class (unbounded,
+ *  based on @c std::queue) as the default. See @c ring_output_queue for a ring buffer
+ *  alternative.
+ *
  *  @note For internal use only.
  *
  *  @author Cliff Green
@@ -25,8 +29,10 @@
 #define OUTPUT_QUEUE_HPP_INCLUDED
 
 #include <queue>
+#include <vector>
 #include <cstddef> // std::size_t
 #include <optional>
+#include <algorithm> // std::max
 
 #include "net_ip/queue_stats.hpp"
 
@@ -42,6 +48,9 @@ private:
 
   std::queue<E>       m_output_queue;
   std::size_t         m_current_num_bytes;
+  std::size_t         m_num_write_batches;
+  std::size_t         m_bufs_in_write_batches;
+  std::size_t         m_max_write_batch_bufs;
 
   // std::size_t         m_queue_size;
   // std::size_t         m_total_bufs_sent;
@@ -49,7 +58,13 @@ private:
 
 public:
 
-  output_queue() noexcept : m_output_queue(), m_current_num_bytes(0u) { }
+  output_queue() noexcept : m_output_queue(), m_current_num_bytes(0u),
+    m_num_write_batches(0u), m_bufs_in_write_batches(0u), m_max_write_batch_bufs(0u) { }
+
+  // nothing to reserve with a std::queue, present for queue policy compatibility
+  void reserve(std::size_t) noexcept { }
+
+  std::size_t size() const noexcept { return m_output_queue.size(); }
 
   // io handlers call this method to get next buffer of data, can be empty
   std::optional<E> get_next_element() {
@@ -62,13 +77,41 @@ public:
     return std::optional<E> {elem};
   }
 
+  // io handlers call this method to get a batch of elements for a gather write; elements
+  // are appended to the supplied container until either limit is reached, but at least one
+  // element is always moved (if available), even if larger than the byte limit
+  std::size_t get_next_elements(std::vector<E>& elems, std::size_t max_elems, 
+                                std::size_t max_bytes) {
+    std::size_t num = 0u;
+    std::size_t num_bytes = 0u;
+    while (!m_output_queue.empty() && num < max_elems) {
+      auto sz = m_output_queue.front().size();
+      if (num != 0u && num_bytes + sz > max_bytes) {
+        break;
+      }
+      elems.push_back(m_output_queue.front());
+      m_output_queue.pop();
+      m_current_num_bytes -= sz;
+      num_bytes += sz;
+      ++num;
+    }
+    if (num != 0u) {
+      ++m_num_write_batches;
+      m_bufs_in_write_batches += num;
+      m_max_write_batch_bufs = std::max(m_max_write_batch_bufs, num);
+    }
+    return num;
+  }
+
   void add_element(const E& element) {
     m_output_queue.push(element);
     m_current_num_bytes += element.size(); // note - possible integer overflow
   }
 
   chops::net::output_queue_stats get_queue_stats() const noexcept {
-    return chops::net::output_queue_stats { m_output_queue.size(), m_current_num_bytes };
+    return chops::net::output_queue_stats { m_output_queue.size(), m_current_num_bytes,
+                                            m_num_write_batches, m_bufs_in_write_batches,
+                                            m_max_write_batch_bufs };
   }
 
   void clear() noexcept {
@@ -0,0 +1,146 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Size class pool of read buffers, shared by the IO handlers of a @c net_ip object.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef READ_BUFFER_POOL_HPP_INCLUDED
+#define READ_BUFFER_POOL_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <vector>
+#include <memory> // std::shared_ptr
+#include <mutex>
+#include <utility> // std::move
+#include <algorithm> // std::max
+
+#include "net_ip/queue_stats.hpp"
+
+#include "marshall/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// buffers are borrowed and returned rarely (start of IO, after a message larger than the
+// shrink threshold, owned buffer replacement, end of IO), so a single lock is sufficient
+class read_buffer_pool {
+public:
+  using byte_vec = chops::mutable_shared_buffer::byte_vec;
+
+private:
+  mutable std::mutex                 m_mutex;
+  read_buffer_pool_config            m_config;
+  // free buffers per size class, class i holds buffers with a capacity of at least
+  // min_class_size << i
+  std::vector<std::vector<byte_vec>> m_free;
+  read_buffer_pool_stats             m_stats;
+
+private:
+  using lg = std::lock_guard<std::mutex>;
+
+  std::size_t class_size(std::size_t idx) const noexcept {
+    return m_config.min_class_size << idx;
+  }
+
+public:
+
+  explicit read_buffer_pool(const read_buffer_pool_config& config = read_buffer_pool_config()) :
+      m_mutex(), m_config(config), m_free(), m_stats() {
+    m_config.min_class_size = std::max(m_config.min_class_size, std::size_t(1u));
+    std::size_t n = 1u;
+    while (class_size(n - 1u) < m_config.shrink_threshold) {
+      ++n;
+    }
+    m_free.resize(n);
+  }
+
+private:
+  read_buffer_pool(const read_buffer_pool&) = delete;
+  read_buffer_pool& operator=(const read_buffer_pool&) = delete;
+
+public:
+
+  std::size_t shrink_threshold() const noexcept { return m_config.shrink_threshold; }
+
+  // returns a buffer of size sz, with a capacity of its size class when sz is not above
+  // the largest class
+  byte_vec acquire(std::size_t sz) {
+    std::size_t idx = 0u;
+    while (idx < m_free.size() && class_size(idx) < sz) {
+      ++idx;
+    }
+    byte_vec buf;
+    {
+      lg g(m_mutex);
+      ++m_stats.num_acquires;
+      if (idx < m_free.size() && !m_free[idx].empty()) {
+        buf = std::move(m_free[idx].back());
+        m_free[idx].pop_back();
+        ++m_stats.num_pool_hits;
+        --m_stats.bufs_pooled;
+        m_stats.bytes_pooled -= buf.capacity();
+      }
+    }
+    if (buf.capacity() == 0u && idx < m_free.size()) {
+      buf.reserve(class_size(idx));
+    }
+    buf.resize(sz);
+    return buf;
+  }
+
+  // buffers are freed (outside of the lock) rather than pooled when smaller than the
+  // smallest class, larger than the largest class, or the class is full; a buffer that
+  // was never allocated is ignored
+  void release(byte_vec&& buf) {
+    std::size_t cap = buf.capacity();
+    if (cap == 0u) {
+      return;
+    }
+    byte_vec discard;
+    lg g(m_mutex);
+    ++m_stats.num_releases;
+    std::size_t idx = m_free.size();
+    if (cap >= class_size(0u) && cap <= class_size(m_free.size() - 1u)) {
+      idx = 0u;
+      while (idx + 1u < m_free.size() && class_size(idx + 1u) <= cap) {
+        ++idx;
+      }
+    }
+    if (idx == m_free.size() || m_free[idx].size() >= m_config.max_pooled_per_class) {
+      ++m_stats.num_discards;
+      discard = std::move(buf);
+      return;
+    }
+    buf.clear();
+    m_free[idx].push_back(std::move(buf));
+    ++m_stats.bufs_pooled;
+    m_stats.bytes_pooled += cap;
+  }
+
+  read_buffer_pool_stats get_stats() const {
+    lg g(m_mutex);
+    return m_stats;
+  }
+
+};
+
+using read_buffer_pool_ptr = std::shared_ptr<read_buffer_pool>;
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,188 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Ring buffer output queue, an alternative to the @c std::queue based
+ *  @c output_queue.
+ *
+ *  Elements are stored in a contiguous circular buffer. When a capacity is reserved
+ *  (which @c io_common does when an output queue limit is set), storage is allocated
+ *  once and no further allocations happen for queueing. Without a reserved capacity the
+ *  buffer doubles in size as needed, which amortizes to no allocations once the
+ *  queue reaches its typical high water mark.
+ *
+ *  Capacity grown past the reserved capacity is given back as the queue drains: when
+ *  fewer than a quarter of the slots are in use the buffer is halved, down to the
+ *  reserved capacity (or a small minimum), so that a burst to a slow peer does not pin
+ *  its high water mark of storage for the life of the connection. Reserving a smaller
+ *  capacity than before (e.g. a lowered output queue limit) releases the excess right
+ *  away, as far as the queued elements allow.
+ *
+ *  The interface is the same as @c output_queue, and as with @c output_queue concurrency
+ *  protection is needed at a higher level.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RING_OUTPUT_QUEUE_HPP_INCLUDED
+#define RING_OUTPUT_QUEUE_HPP_INCLUDED
+
+#include <vector>
+#include <cstddef> // std::size_t
+#include <optional>
+#include <algorithm> // std::max
+#include <utility> // std::move
+
+#include "net_ip/queue_stats.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// template parameter E has the same requirements as in output_queue; elements are
+// held in std::optional slots so E does not need to be default constructible, and
+// so that a popped slot releases its element (e.g. a reference counted buffer) right away
+template <typename E>
+class ring_output_queue {
+private:
+
+  std::vector<std::optional<E>> m_ring;
+  std::size_t         m_head; // index of next element to pop
+  std::size_t         m_size;
+  std::size_t         m_reserved;
+  std::size_t         m_current_num_bytes;
+  std::size_t         m_num_write_batches;
+  std::size_t         m_bufs_in_write_batches;
+  std::size_t         m_max_write_batch_bufs;
+
+  static constexpr std::size_t min_capacity = 16u;
+
+private:
+
+  E pop_front() {
+    E elem { std::move(*m_ring[m_head]) };
+    m_ring[m_head].reset();
+    m_head = (m_head + 1u) % m_ring.size();
+    --m_size;
+    m_current_num_bytes -= elem.size();
+    return elem;
+  }
+
+  // halving below a quarter full, rather than a half, keeps an add / pop pattern
+  // around a size boundary from resizing on every call; a batch pop can drain many
+  // elements at once, so the halving is repeated before the one resize
+  void shrink_if_sparse() {
+    auto floor = std::max(m_reserved, min_capacity);
+    auto cap = m_ring.size();
+    while (cap > floor && m_size < cap / 4u) {
+      cap = std::max(cap / 2u, floor);
+    }
+    if (cap != m_ring.size()) {
+      resize_ring(cap);
+    }
+  }
+
+  void resize_ring(std::size_t cap) {
+    std::vector<std::optional<E>> r(cap);
+    for (std::size_t i = 0u; i < m_size; ++i) {
+      r[i] = std::move(m_ring[(m_head + i) % m_ring.size()]);
+    }
+    m_ring.swap(r);
+    m_head = 0u;
+  }
+
+public:
+
+  ring_output_queue() noexcept : m_ring(), m_head(0u), m_size(0u), m_reserved(0u),
+    m_current_num_bytes(0u), m_num_write_batches(0u), m_bufs_in_write_batches(0u),
+    m_max_write_batch_bufs(0u) { }
+
+  // allocate storage for cap elements up front, the ring does not shrink below it; a
+  // smaller cap than the current capacity releases the storage not needed by the 
+  // queued elements, a cap of 0 lets the ring shrink back to its minimum
+  void reserve(std::size_t cap) {
+    m_reserved = cap;
+    auto new_cap = std::max(cap, m_size);
+    if (new_cap != m_ring.size()) {
+      resize_ring(new_cap);
+    }
+  }
+
+  std::size_t capacity() const noexcept { return m_ring.size(); }
+
+  std::size_t size() const noexcept { return m_size; }
+
+  // io handlers call this method to get next buffer of data, can be empty
+  std::optional<E> get_next_element() {
+    if (m_size == 0u) {
+      return std::optional<E> { };
+    }
+    std::optional<E> elem { pop_front() };
+    shrink_if_sparse();
+    return elem;
+  }
+
+  // same semantics as output_queue get_next_elements
+  std::size_t get_next_elements(std::vector<E>& elems, std::size_t max_elems,
+                                std::size_t max_bytes) {
+    std::size_t num = 0u;
+    std::size_t num_bytes = 0u;
+    while (m_size != 0u && num < max_elems) {
+      auto sz = m_ring[m_head]->size();
+      if (num != 0u && num_bytes + sz > max_bytes) {
+        break;
+      }
+      elems.push_back(pop_front());
+      num_bytes += sz;
+      ++num;
+    }
+    if (num != 0u) {
+      ++m_num_write_batches;
+      m_bufs_in_write_batches += num;
+      m_max_write_batch_bufs = std::max(m_max_write_batch_bufs, num);
+      shrink_if_sparse();
+    }
+    return num;
+  }
+
+  void add_element(const E& element) {
+    if (m_size == m_ring.size()) {
+      resize_ring(m_ring.empty() ? min_capacity : m_ring.size() * 2u);
+    }
+    m_ring[(m_head + m_size) % m_ring.size()] = element;
+    ++m_size;
+    m_current_num_bytes += element.size();
+  }
+
+  chops::net::output_queue_stats get_queue_stats() const noexcept {
+    return chops::net::output_queue_stats { m_size, m_current_num_bytes,
+                                            m_num_write_batches, m_bufs_in_write_batches,
+                                            m_max_write_batch_bufs };
+  }
+
+  // storage is kept, only the elements are released
+  void clear() noexcept {
+    for (auto& e : m_ring) {
+      e.reset();
+    }
+    m_head = 0u;
+    m_size = 0u;
+    m_current_num_bytes = 0u;
+  }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
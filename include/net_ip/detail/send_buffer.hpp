@@ -0,0 +1,100 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Buffer type carried through the output queue of the TCP and UDP io handlers,
+ *  holding either a reference counted @c const_shared_buffer, application owned
+ *  memory with a release hook, or a segment of a file (TCP only).
+ *
+ *  Application owned memory (e.g. pooled, pre-registered or static memory) is not copied.
+ *  The release hook is held by a @c std::shared_ptr with a custom deleter, so copies of
+ *  the buffer made by the output queue and the io handler share it, and the hook is
+ *  called exactly once when the last copy is destroyed. This is after the write of the
+ *  buffer completes, or when the buffer is discarded (send rejected, output queue overflow,
+ *  or io handler closed while the buffer is queued).
+ *
+ *  A file segment has no data pointer, it is written by the TCP io handler with
+ *  @c sendfile when it reaches the head of the output queue. Its size is the segment
+ *  length, so queue statistics and water marks count it like any other buffer.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef SEND_BUFFER_HPP_INCLUDED
+#define SEND_BUFFER_HPP_INCLUDED
+
+#include <memory> // std::shared_ptr
+#include <optional>
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <utility> // std::move
+
+#include "marshall/shared_buffer.hpp"
+
+#include "net_ip/queue_stats.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+class send_buffer {
+private:
+  std::optional<chops::const_shared_buffer> m_shared;
+  std::shared_ptr<const void>               m_release;
+  const std::byte*                          m_data;
+  std::size_t                               m_size;
+  int                                       m_fd; // -1 unless a file segment
+  std::uint64_t                             m_file_offset;
+
+public:
+
+  // the data pointer refers to the shared byte vector, which does not move when the
+  // send_buffer is copied
+  send_buffer(const chops::const_shared_buffer& buf) noexcept :
+    m_shared(buf), m_release(), m_data(m_shared->data()), m_size(m_shared->size()),
+    m_fd(-1), m_file_offset(0u) { }
+
+  // if allocating the shared_ptr control block throws, the release hook is called before
+  // the exception propagates
+  send_buffer(const void* buf, std::size_t sz, buffer_release_hook release) :
+    m_shared(),
+    m_release(buf, [release = std::move(release), sz] (const void* p) {
+        if (release) {
+          release(p, sz);
+        }
+      }),
+    m_data(static_cast<const std::byte*>(buf)), m_size(sz), m_fd(-1), m_file_offset(0u) { }
+
+  // the shared_ptr owns a null pointer, its deleter still runs once
+  send_buffer(int fd, std::uint64_t offset, std::size_t len, file_release_hook release) :
+    m_shared(),
+    m_release(nullptr, [release = std::move(release), fd] (const void*) {
+        if (release) {
+          release(fd);
+        }
+      }),
+    m_data(nullptr), m_size(len), m_fd(fd), m_file_offset(offset) { }
+
+  const std::byte* data() const noexcept { return m_data; }
+  std::size_t size() const noexcept { return m_size; }
+
+  bool is_file() const noexcept { return m_fd >= 0; }
+  int file_descriptor() const noexcept { return m_fd; }
+  std::uint64_t file_offset() const noexcept { return m_file_offset; }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
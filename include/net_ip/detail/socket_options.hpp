@@ -0,0 +1,92 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Platform specific socket options not provided by Asio.
+ *
+ *  @c SO_REUSEPORT (Linux 3.9 and later, BSD and macOS) lets every socket that sets it
+ *  bind the same address and port. For UDP multicast this allows many processes on a
+ *  host to receive the same group; on Linux incoming unicast datagrams and TCP connections
+ *  are load balanced across the sockets. It is not available on Windows.
+ *
+ *  On Linux a socket bound to the "any" address receives the datagrams of every multicast
+ *  group joined by any socket on the host for its port, unless @c IP_MULTICAST_ALL (or
+ *  @c IPV6_MULTICAST_ALL) is cleared, in which case it only receives the groups it joined
+ *  itself. Other platforms already behave this way.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef SOCKET_OPTIONS_HPP_INCLUDED
+#define SOCKET_OPTIONS_HPP_INCLUDED
+
+#include "asio/socket_base.hpp"
+
+#include <system_error>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+namespace chops {
+namespace net {
+namespace detail {
+
+#if !defined(_WIN32) && defined(SO_REUSEPORT)
+
+constexpr bool reuse_port_supported = true;
+
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+// the socket must be open and not yet bound
+template <typename S>
+std::error_code set_reuse_port(S& sock, bool value) {
+  std::error_code ec;
+  sock.set_option(reuse_port(value), ec);
+  return ec;
+}
+
+#else
+
+constexpr bool reuse_port_supported = false;
+
+template <typename S>
+std::error_code set_reuse_port(S&, bool value) {
+  return value ? std::make_error_code(std::errc::operation_not_supported) : std::error_code();
+}
+
+#endif
+
+// not being able to clear the option is not an error, the socket then also receives the
+// groups joined by other sockets
+template <typename S>
+void set_multicast_all(S& sock, bool v6, bool value) {
+#if defined(__linux__) && defined(IP_MULTICAST_ALL)
+  int v = value ? 1 : 0;
+  if (!v6) {
+    ::setsockopt(sock.native_handle(), IPPROTO_IP, IP_MULTICAST_ALL, &v, sizeof(v));
+  }
+#ifdef IPV6_MULTICAST_ALL
+  else {
+    ::setsockopt(sock.native_handle(), IPPROTO_IPV6, IPV6_MULTICAST_ALL, &v, sizeof(v));
+  }
+#endif
+#endif
+}
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
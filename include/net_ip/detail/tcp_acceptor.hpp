@@ -21,13 +21,14 @@
 #include "asio/ip/tcp.hpp"
 #include "asio/io_context.hpp"
 #include "asio/post.hpp"
+#include "asio/strand.hpp"
 
 #include <system_error>
 #include <memory>// std::shared_ptr, std::weak_ptr
 #include <vector>
 #include <utility> // std::move, std::forward
 #include <cstddef> // for std::size_t
-#include <functional> // std::bind
+#include <functional> // std::function, std::reference_wrapper
 #include <string>
 #include <string_view>
 #include <future>
@@ -36,15 +37,21 @@
 #include "net_ip/endpoints_resolver.hpp"
 #include "net_ip/detail/tcp_io.hpp"
 #include "net_ip/detail/net_entity_common.hpp"
+#include "net_ip/detail/read_buffer_pool.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
+#include "net_ip/detail/socket_options.hpp"
+#include "net_ip/detail/io_handler_registry.hpp"
 
 #include "net_ip/basic_io_output.hpp"
 
-#include "utility/erase_where.hpp"
-
 namespace chops {
 namespace net {
 namespace detail {
 
+using io_context_refs = std::vector<std::reference_wrapper<asio::io_context>>;
+
+enum class accept_placement { round_robin, least_loaded };
+
 class tcp_acceptor : public std::enable_shared_from_this<tcp_acceptor> {
 public:
   using endpoint_type = asio::ip::tcp::endpoint;
@@ -53,26 +60,46 @@ private:
   net_entity_common<tcp_io>         m_entity_common;
   asio::io_context&                 m_ioc;
   asio::ip::tcp::acceptor           m_acceptor;
-  std::vector<tcp_io_shared_ptr>    m_io_handlers;
+  // additional listening sockets (shards) on other io_contexts, bound to the same 
+  // endpoint with SO_REUSEPORT; the shard vector is not resized once started
+  io_context_refs                   m_shard_iocs;
+  std::vector<asio::ip::tcp::acceptor> m_shards;
+  // io_contexts the connections accepted by m_acceptor are placed on, with the number
+  // of live connections per context; only used on the acceptor strand
+  io_context_refs                   m_targets;
+  std::vector<std::size_t>          m_target_loads;
+  accept_placement                  m_placement;
+  std::size_t                       m_next_target;
+  io_handler_registry<tcp_io>       m_io_handlers;
   endpoint_type                     m_acceptor_endp;
   std::string                       m_local_port_or_service;
   std::string                       m_listen_intf;
   bool                              m_reuse_addr;
   bool                              m_shutting_down;
+  read_buffer_pool_ptr              m_read_buf_pool;
+  timer_wheel_ptr                   m_timer_wheel;
 
 public:
   tcp_acceptor(asio::io_context& ioc, const endpoint_type& endp,
-               bool reuse_addr) :
-    m_entity_common(), m_ioc(ioc), m_acceptor(ioc), m_io_handlers(), m_acceptor_endp(endp), 
+               bool reuse_addr, read_buffer_pool_ptr pool = read_buffer_pool_ptr(),
+               timer_wheel_ptr wheel = timer_wheel_ptr()) :
+    m_entity_common(), m_ioc(ioc), m_acceptor(asio::make_strand(ioc)), 
+    m_shard_iocs(), m_shards(), m_targets(), m_target_loads(),
+    m_placement(accept_placement::round_robin), m_next_target(0u), m_io_handlers(), m_acceptor_endp(endp), 
     m_local_port_or_service(), m_listen_intf(),
-    m_reuse_addr(reuse_addr), m_shutting_down(false) { }
+    m_reuse_addr(reuse_addr), m_shutting_down(false), m_read_buf_pool(std::move(pool)),
+    m_timer_wheel(std::move(wheel)) { }
 
   tcp_acceptor(asio::io_context& ioc, 
                std::string_view local_port_or_service, std::string_view listen_intf,
-               bool reuse_addr) :
-    m_entity_common(), m_ioc(ioc), m_acceptor(ioc), m_io_handlers(), m_acceptor_endp(), 
+               bool reuse_addr, read_buffer_pool_ptr pool = read_buffer_pool_ptr(),
+               timer_wheel_ptr wheel = timer_wheel_ptr()) :
+    m_entity_common(), m_ioc(ioc), m_acceptor(asio::make_strand(ioc)), 
+    m_shard_iocs(), m_shards(), m_targets(), m_target_loads(),
+    m_placement(accept_placement::round_robin), m_next_target(0u), m_io_handlers(), m_acceptor_endp(), 
     m_local_port_or_service(local_port_or_service), m_listen_intf(listen_intf),
-    m_reuse_addr(reuse_addr), m_shutting_down(false) { }
+    m_reuse_addr(reuse_addr), m_shutting_down(false), m_read_buf_pool(std::move(pool)),
+    m_timer_wheel(std::move(wheel)) { }
 
 private:
   // no copy or assignment semantics for this class
@@ -85,6 +112,27 @@ public:
 
   bool is_started() const noexcept { return m_entity_common.is_started(); }
 
+  // must be called before start; a context that is the acceptor's own context is 
+  // skipped, since it already has a listening socket
+  void set_shards(const io_context_refs& iocs) {
+    m_shard_iocs.clear();
+    for (auto ioc : iocs) {
+      if (&ioc.get() != &m_ioc) {
+        m_shard_iocs.push_back(ioc);
+      }
+    }
+  }
+
+  std::size_t num_shards() const noexcept { return m_shard_iocs.size() + 1u; }
+
+  // must be called before start, and not combined with shards; each connection is 
+  // placed on one of the contexts when its accept is started
+  void set_io_targets(const io_context_refs& iocs, accept_placement placement) {
+    m_targets = iocs;
+    m_target_loads.assign(iocs.size(), 0u);
+    m_placement = placement;
+  }
+
   template <typename F>
   void visit_socket(F&& f) {
     f(m_acceptor);
@@ -96,7 +144,7 @@ public:
     std::promise<std::size_t> prom;
     auto fut = prom.get_future();
     // send to executor for concurrency protection
-    asio::post(m_ioc, [this, self, &func, p = std::move(prom)] () mutable {
+    asio::post(m_acceptor.get_executor(), [this, self, &func, p = std::move(prom)] () mutable {
         std::size_t sum = 0u;
         if (m_shutting_down) {
           p.set_value(sum);
@@ -148,32 +196,53 @@ private:
       m_listen_intf.clear();
       m_listen_intf.shrink_to_fit();
     }
-    std::error_code ec;
-    m_acceptor.open(m_acceptor_endp.protocol(), ec);
+    auto ec = open_listener(m_acceptor);
     if (ec) {
       close(ec);
       return ec;
     }
-    if (m_reuse_addr) {
-      m_acceptor.set_option(asio::socket_base::reuse_address(true), ec);
+    // no accepts are started until every shard is listening, so the shard vector
+    // is stable for the references held by the accept handlers
+    m_shards.reserve(m_shard_iocs.size());
+    for (auto ioc : m_shard_iocs) {
+      m_shards.emplace_back(asio::make_strand(ioc.get()));
+      ec = open_listener(m_shards.back());
       if (ec) {
         close(ec);
         return ec;
       }
     }
-    m_acceptor.bind(m_acceptor_endp, ec);
+    start_accept(m_acceptor, next_target());
+    for (std::size_t i = 0u; i < m_shards.size(); ++i) {
+      start_accept(m_shards[i], m_shard_iocs[i].get());
+    }
+    return { };
+  }
+
+  std::error_code open_listener(asio::ip::tcp::acceptor& acc) {
+    std::error_code ec;
+    acc.open(m_acceptor_endp.protocol(), ec);
     if (ec) {
-      close(ec);
       return ec;
     }
-    m_acceptor.listen(asio::socket_base::max_listen_connections, ec);
+    if (m_reuse_addr) {
+      acc.set_option(asio::socket_base::reuse_address(true), ec);
+      if (ec) {
+        return ec;
+      }
+    }
+    if (!m_shard_iocs.empty()) {
+      ec = set_reuse_port(acc, true);
+      if (ec) {
+        return ec;
+      }
+    }
+    acc.bind(m_acceptor_endp, ec);
     if (ec) {
-      close(ec);
       return ec;
     }
-
-    start_accept();
-    return { };
+    acc.listen(asio::socket_base::max_listen_connections, ec);
+    return ec;
   }
 
   void close(const std::error_code& err) {
@@ -183,11 +252,10 @@ private:
     }
     m_shutting_down = true;
     m_entity_common.set_stopped(); // in case of internal call to close
-    // the following copy is important, since the notify_me modifies the 
-    // m_io_handlers container
-    auto iohs = m_io_handlers;
-    for (auto& i : iohs) {
-      i->stop_io();
+    // each IO handler is stopped on its own strand, notify_me is then posted back to
+    // this strand and removes it from m_io_handlers
+    for (auto& i : m_io_handlers) {
+      asio::post(i->get_executor(), [iop = i] () { iop->stop_io(); } );
     }
     // m_io_handlers.clear(); // the stop_io on each tcp_io handler should clear the container
     std::error_code ec;
@@ -195,43 +263,94 @@ private:
     if (ec) {
       m_entity_common.call_error_cb(tcp_io_shared_ptr(), ec);
     }
+    // shards are closed on their own strand, aborting their pending accepts
+    auto self = shared_from_this();
+    for (auto& s : m_shards) {
+      asio::post(s.get_executor(), [self, &s] () {
+          std::error_code e;
+          s.close(e);
+        }
+      );
+    }
     m_entity_common.call_error_cb(tcp_io_shared_ptr(), 
           std::make_error_code(net_ip_errc::tcp_acceptor_closed));
   }
 
 private:
 
-  void start_accept() {
-    using namespace std::placeholders;
+  // the accept handler runs on the strand of the listening socket, which for a shard
+  // is not the acceptor strand, so only the acceptor strand touches m_shutting_down
+  // and m_io_handlers; a closed listening socket completes the accept with an error
+  void start_accept(asio::ip::tcp::acceptor& acc, asio::io_context& ioc) {
 
-    if (m_shutting_down) {
-      return;
-    }
     auto self = shared_from_this();
-    m_acceptor.async_accept( [this, self] 
-            (const std::error_code& err, asio::ip::tcp::socket sock) {
-        if (err || m_shutting_down ) {
+    // each accepted socket gets its own strand, so the IO handlers of one acceptor can
+    // run concurrently when multiple threads run the io_context
+    acc.async_accept(asio::ip::tcp::socket::executor_type(asio::make_strand(ioc)),
+          [this, self, &acc, &ioc] (const std::error_code& err, asio::ip::tcp::socket sock) {
+        if (err) {
           return;
         }
+        bool main_acc = (&acc == &m_acceptor);
+        // the IO handler closes on its own strand, the notification is posted to this one
         tcp_io_shared_ptr iop = std::make_shared<tcp_io>(std::move(sock), 
-          tcp_io::entity_notifier_cb(std::bind(&tcp_acceptor::notify_me, shared_from_this(), _1, _2)));
-        m_io_handlers.push_back(iop);
+          [self] (std::error_code err, tcp_io_shared_ptr iop) {
+            asio::post(self->m_acceptor.get_executor(), [self, err, iop] () { 
+                self->notify_me(err, iop);
+              }
+            );
+          },
+          m_read_buf_pool, m_timer_wheel);
         // make sure app doesn't do any strangeness during callback
         // even if another accept completes, post order should invoke callback before next
         // accept handler is invoked
-        asio::post(m_ioc, [this, self, iop] () {
+        asio::post(m_acceptor.get_executor(), [this, self, iop, main_acc] () {
+            if (m_shutting_down) {
+              return; // not yet started, the socket is closed when iop is released
+            }
+            if (main_acc) { // counted only once registered, notify_me removes the count
+              change_target_load(iop->get_executor().context(), true);
+            }
+            m_io_handlers.add(iop);
             m_entity_common.call_io_state_chg_cb(iop, m_io_handlers.size(), true);
           }
         );
-        start_accept();
+        start_accept(acc, main_acc ? next_target() : ioc);
       }
     );
   }
 
+  // called on the acceptor strand
+  asio::io_context& next_target() {
+    if (m_targets.empty()) {
+      return m_ioc;
+    }
+    if (m_placement == accept_placement::round_robin) {
+      return m_targets[m_next_target++ % m_targets.size()].get();
+    }
+    std::size_t idx = 0u;
+    for (std::size_t i = 1u; i < m_target_loads.size(); ++i) {
+      if (m_target_loads[i] < m_target_loads[idx]) {
+        idx = i;
+      }
+    }
+    return m_targets[idx].get();
+  }
+
+  void change_target_load(asio::execution_context& ctx, bool incr) {
+    for (std::size_t i = 0u; i < m_targets.size(); ++i) {
+      if (&ctx == static_cast<asio::execution_context*>(&m_targets[i].get())) {
+        m_target_loads[i] = incr ? m_target_loads[i] + 1u : m_target_loads[i] - 1u;
+        return;
+      }
+    }
+  }
+
   // this code invoked via a posted function object, allowing the TCP IO handler
   // to completely shut down 
   void notify_me(std::error_code err, tcp_io_shared_ptr iop) {
-    chops::erase_where(m_io_handlers, iop);
+    m_io_handlers.remove(iop);
+    change_target_load(iop->get_executor().context(), false);
     m_entity_common.call_error_cb(iop, err);
     m_entity_common.call_io_state_chg_cb(iop, m_io_handlers.size(), false);
   }
@@ -24,6 +24,8 @@
 #include "asio/io_context.hpp"
 #include "asio/ip/basic_resolver.hpp"
 #include "asio/steady_timer.hpp"
+#include "asio/strand.hpp"
+#include "asio/bind_executor.hpp"
 
 #include <system_error>
 #include <vector>
@@ -35,6 +37,8 @@
 
 #include "net_ip/detail/tcp_io.hpp"
 #include "net_ip/detail/net_entity_common.hpp"
+#include "net_ip/detail/read_buffer_pool.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
 
 #include "net_ip/basic_io_output.hpp"
 
@@ -81,43 +85,53 @@ private:
   tcp_connector_timeout_func    m_timeout_func;
   std::size_t                   m_conn_attempts;
   conn_state                    m_state;
+  read_buffer_pool_ptr          m_read_buf_pool;
+  timer_wheel_ptr               m_timer_wheel;
 
 public:
   template <typename Iter>
   tcp_connector(asio::io_context& ioc, 
                 Iter beg, Iter end,
                 tcp_connector_timeout_func tout_func,
-                bool reconn_on_err) :
+                bool reconn_on_err,
+                read_buffer_pool_ptr pool = read_buffer_pool_ptr(),
+                timer_wheel_ptr wheel = timer_wheel_ptr()) :
       m_entity_common(),
-      m_socket(ioc),
+      m_socket(asio::make_strand(ioc)),
       m_io_handler(),
       m_resolver(ioc),
       m_endpoints(beg, end),
-      m_timer(ioc),
+      m_timer(m_socket.get_executor()),
       m_remote_host(),
       m_remote_port(),
       m_reconn_on_err(reconn_on_err),
       m_timeout_func(tout_func),
       m_conn_attempts(0u),
-      m_state(stopped)
+      m_state(stopped),
+      m_read_buf_pool(std::move(pool)),
+      m_timer_wheel(std::move(wheel))
     { }
 
   tcp_connector(asio::io_context& ioc,
                 std::string_view remote_port, std::string_view remote_host, 
                 tcp_connector_timeout_func tout_func,
-                bool reconn_on_err) :
+                bool reconn_on_err,
+                read_buffer_pool_ptr pool = read_buffer_pool_ptr(),
+                timer_wheel_ptr wheel = timer_wheel_ptr()) :
       m_entity_common(),
-      m_socket(ioc),
+      m_socket(asio::make_strand(ioc)),
       m_io_handler(),
       m_resolver(ioc),
       m_endpoints(),
-      m_timer(ioc),
+      m_timer(m_socket.get_executor()),
       m_remote_host(remote_host),
       m_remote_port(remote_port),
       m_reconn_on_err(reconn_on_err),
       m_timeout_func(tout_func),
       m_conn_attempts(0u),
-      m_state(stopped)
+      m_state(stopped),
+      m_read_buf_pool(std::move(pool)),
+      m_timer_wheel(std::move(wheel))
     { }
 
 private:
@@ -190,8 +204,9 @@ private:
       m_entity_common.call_error_cb(tcp_io_shared_ptr(),
                                     std::make_error_code(net_ip_errc::tcp_connector_resolving_addresses));
       auto self = shared_from_this();
+      // the resolver is not on the strand, so the completion is bound to it
       m_resolver.make_endpoints(false, m_remote_host, m_remote_port,
-        [this, self] 
+        asio::bind_executor(m_socket.get_executor(), [this, self] 
              (std::error_code err, resolver_results res) {
           if (err || m_state != resolving) {
             m_state = stopped;
@@ -203,7 +218,7 @@ private:
           }
           clear_strings();
           start_connect(m_timeout_func);
-        }
+        } )
       );
       return { };
     }
@@ -316,7 +331,8 @@ private:
       return;
     }
     m_io_handler = std::make_shared<tcp_io>(std::move(m_socket), 
-      tcp_io::entity_notifier_cb(std::bind(&tcp_connector::notify_me, shared_from_this(), _1, _2)));
+      tcp_io::entity_notifier_cb(std::bind(&tcp_connector::notify_me, shared_from_this(), _1, _2)),
+      m_read_buf_pool, m_timer_wheel);
     m_state = connected;
     // this is only called after an async connect so no danger of invoking app code during the
     // start method call
@@ -21,21 +21,38 @@
 #include "asio/io_context.hpp"
 #include "asio/executor.hpp"
 #include "asio/read.hpp"
-#include "asio/read_until.hpp"
 #include "asio/write.hpp"
+#include "asio/post.hpp"
+#include "asio/dispatch.hpp"
 #include "asio/ip/tcp.hpp"
 #include "asio/buffer.hpp"
+#include "asio/steady_timer.hpp"
 
 #include <memory> // std::shared_ptr, std::enable_shared_from_this
 #include <system_error>
 
 #include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
 #include <utility> // std::forward, std::move
 #include <string>
 #include <string_view>
 #include <functional> // std::function
+#include <vector>
+#include <algorithm> // std::min
+#include <atomic>
+#include <type_traits> // std::is_invocable_v
+#include <cstring> // std::memmove
+#include <chrono>
 
 #include "net_ip/detail/io_common.hpp"
+#include "net_ip/detail/traffic_counters.hpp"
+#include "net_ip/detail/send_buffer.hpp"
+#include "net_ip/detail/tcp_zero_copy.hpp"
+#include "net_ip/detail/file_send.hpp"
+#include "net_ip/detail/find_delimiter.hpp"
+#include "net_ip/detail/read_buffer_pool.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
+#include "net_ip/detail/io_handler_registry.hpp" // no_registry_slot
 #include "net_ip/queue_stats.hpp"
 #include "net_ip/net_ip_error.hpp"
 
@@ -48,6 +65,13 @@ namespace chops {
 namespace net {
 namespace detail {
 
+constexpr std::size_t default_delim_read_buf_size = 4096u;
+
+// how long a closing tcp_io waits for queued writes (after a message handler returned
+// false) or keeps its socket open for outstanding zero copy notifications (after which
+// the connection is reset, so that the kernel drops the pinned pages)
+constexpr std::chrono::seconds close_drain_timeout { 10 };
+
 inline std::size_t null_msg_frame (asio::mutable_buffer) noexcept { return 0u; }
 
 template <typename IOT>
@@ -55,10 +79,45 @@ bool null_msg_hdlr (asio::const_buffer, basic_io_output<IOT>, asio::ip::tcp::end
   return true;
 }
 
+// non-owning view of a contiguous sequence of buffers; passing the gather write container 
+// directly to async_write would copy (and allocate) the container for every write; also
+// used to pass a batch of messages to a batch message handler
+class const_buffer_span {
+private:
+  const asio::const_buffer* m_beg;
+  const asio::const_buffer* m_end;
+public:
+  const_buffer_span(const asio::const_buffer* beg, const asio::const_buffer* end) noexcept :
+    m_beg(beg), m_end(end) { }
+  const asio::const_buffer* begin() const noexcept { return m_beg; }
+  const asio::const_buffer* end() const noexcept { return m_end; }
+  std::size_t size() const noexcept { return static_cast<std::size_t>(m_end - m_beg); }
+  bool empty() const noexcept { return m_beg == m_end; }
+  const asio::const_buffer& operator[](std::size_t i) const noexcept { return m_beg[i]; }
+};
+
+// the completion handler is only allocated for send_with_completion, plain sends 
+// carry an empty pointer, which is copied without any reference count updates
+struct tcp_queue_element {
+  send_buffer             m_buf;
+  std::shared_ptr<const send_completion_handler> m_completion;
+
+  tcp_queue_element (const send_buffer& buf,
+                     std::shared_ptr<const send_completion_handler> completion = 
+                          std::shared_ptr<const send_completion_handler>()) noexcept : 
+        m_buf(buf), m_completion(std::move(completion)) { }
+
+  std::size_t size() const noexcept {
+    return m_buf.size();
+  }
+
+};
+
 class tcp_io : public std::enable_shared_from_this<tcp_io> {
 public:
   using endpoint_type = asio::ip::tcp::endpoint;
   using entity_notifier_cb = std::function<void (std::error_code, std::shared_ptr<tcp_io>)>;
+  using water_mark_cb = std::function<void (basic_io_output<tcp_io>, bool)>;
 
 private:
   using byte_vec = chops::mutable_shared_buffer::byte_vec;
@@ -66,21 +125,81 @@ private:
 private:
 
   asio::ip::tcp::socket               m_socket;
-  io_common<const_shared_buffer>      m_io_common;
+  io_common_type<tcp_queue_element>   m_io_common;
   entity_notifier_cb                  m_notifier_cb;
   endpoint_type                       m_remote_endp;
+  traffic_counters                    m_counters;
 
-  // the following member is only used for read processing; it could be 
-  // moved through handlers, but is a member for simplicity and to reduce 
-  // moving
+  // read and write timeouts, the entry only exists if there is a timer wheel; the
+  // entry is refreshed on every read and write without any locking
+  timer_wheel_ptr                     m_timer_wheel;
+  timeout_entry_ptr                   m_timeouts;
+
+  // the following members are only used for read processing; they could be 
+  // moved through handlers, but are members for simplicity and to reduce 
+  // moving; in buffered and delimiter read modes m_byte_vec is the read buffer, 
+  // with the current message starting at m_msg_beg, unframed (or not yet searched
+  // for a delimiter) data from m_msg_beg + m_msg_framed to m_rd_end; with a read buffer
+  // pool, m_byte_vec is borrowed from the pool
+  read_buffer_pool_ptr                m_read_buf_pool;
   byte_vec                            m_byte_vec;
+  std::vector<asio::const_buffer>     m_msg_batch;
+  std::atomic_size_t                  m_read_buf_bytes;
+  std::atomic_size_t                  m_read_buf_size;
+  std::size_t                         m_rd_end;
+  std::size_t                         m_msg_beg;
+  std::size_t                         m_msg_framed;
+
+  // the following members are only used for write processing; the buffers in
+  // the current write are kept alive here until the write completes, and the
+  // asio buffer container is reused between writes to avoid allocations; a write
+  // containing file segments is performed in parts, m_write_pos is the first
+  // element of the current part; the close timer only exists while a close requested
+  // by a message handler waits for the queued writes
+  std::vector<tcp_queue_element>      m_write_bufs;
+  std::vector<asio::const_buffer>     m_write_seq;
+  std::size_t                         m_write_pos;
+  std::size_t                         m_write_total;
+  std::unique_ptr<asio::steady_timer> m_close_timer;
+
+  // zero copy sends, the min size is set from application threads, the rest is only
+  // used in the IO thread; a min size of 0 means zero copy is disabled; the drain timer
+  // only exists while a closed tcp_io waits for the last zero copy notifications
+  std::atomic_size_t                  m_zero_copy_min_size;
+  zero_copy_tracker                   m_zc_tracker;
+  bool                                m_zc_notify_wait;
+  std::unique_ptr<asio::steady_timer> m_zc_drain_timer;
+
+  // position in the connection registry of an acceptor, only used on the acceptor strand
+  std::size_t                         m_registry_slot;
 
 public:
 
-  tcp_io(asio::ip::tcp::socket sock, entity_notifier_cb cb) noexcept : 
+  tcp_io(asio::ip::tcp::socket sock, entity_notifier_cb cb, 
+         read_buffer_pool_ptr pool = read_buffer_pool_ptr(),
+         timer_wheel_ptr wheel = timer_wheel_ptr()) : 
     m_socket(std::move(sock)), m_io_common(), 
-    m_notifier_cb(cb), m_remote_endp(),
-    m_byte_vec() { }
+    m_notifier_cb(cb), m_remote_endp(), m_counters(),
+    m_timer_wheel(std::move(wheel)), 
+    m_timeouts(m_timer_wheel ? std::make_shared<timeout_entry>() : timeout_entry_ptr()),
+    m_read_buf_pool(std::move(pool)), m_byte_vec(), m_msg_batch(), 
+    m_read_buf_bytes(0u), m_read_buf_size(0u),
+    m_rd_end(0u), m_msg_beg(0u), m_msg_framed(0u),
+    m_write_bufs(), m_write_seq(), m_write_pos(0u), m_write_total(0u), m_close_timer(),
+    m_zero_copy_min_size(0u), m_zc_tracker(), m_zc_notify_wait(false), m_zc_drain_timer(),
+    m_registry_slot(no_registry_slot) { }
+
+  // no handlers are outstanding, so the read buffer is no longer referenced; if the
+  // io_context went away during a zero copy drain, the connection is reset before the
+  // tracker releases the buffers
+  ~tcp_io() {
+    if (!m_zc_tracker.idle()) {
+      end_zero_copy_drain(true);
+    }
+    if (m_read_buf_pool) {
+      m_read_buf_pool->release(std::move(m_byte_vec));
+    }
+  }
 
 private:
   // no copy or assignment semantics for this class
@@ -98,20 +217,97 @@ public:
     f(m_socket);
   }
 
+  // not called through an interface, the acceptor uses the socket executor (a strand, 
+  // which every handler of this object runs on) to stop IO
+  auto get_executor() {
+    return m_socket.get_executor();
+  }
+
+  // not called through an interface, used by the acceptor connection registry
+  std::size_t get_registry_slot() const noexcept { return m_registry_slot; }
+  void set_registry_slot(std::size_t slot) noexcept { m_registry_slot = slot; }
+
   output_queue_stats get_output_queue_stats() const noexcept {
-    return m_io_common.get_output_queue_stats();
+    auto st = m_io_common.get_output_queue_stats();
+    m_counters.fill_stats(st);
+    st.read_buffer_bytes = m_read_buf_bytes.load(std::memory_order_relaxed);
+    return st;
   }
 
   bool is_io_started() const noexcept { return m_io_common.is_io_started(); }
 
+  void set_write_batch_limits(std::size_t max_bufs, std::size_t max_bytes) noexcept {
+    m_io_common.set_write_batch_limits(max_bufs, max_bytes);
+  }
+
+  void set_output_queue_limit(std::size_t max_bufs, queue_overflow_policy policy) {
+    m_io_common.set_output_queue_limit(max_bufs, policy);
+  }
+
+  // crossings are detected in io_common, possibly in a sending thread, so the check
+  // and callback are posted to the IO thread
+  template <typename F>
+  void set_output_queue_water_marks(const output_queue_water_marks& wm, F&& func) {
+    auto cb = std::make_shared<water_mark_cb>(std::forward<F>(func));
+    if (!*cb) {
+      m_io_common.set_water_marks(wm, std::function<void ()> { });
+      return;
+    }
+    auto wp = weak_from_this();
+    m_io_common.set_water_marks(wm, [wp, cb, ex = m_socket.get_executor()] () {
+        asio::post(ex, [wp, cb] () {
+            auto sp = wp.lock();
+            if (!sp) {
+              return;
+            }
+            auto st = sp->m_io_common.check_water_marks();
+            if (st) {
+              (*cb)(basic_io_output<tcp_io>(wp), *st);
+            }
+          }
+        );
+      }
+    );
+  }
+
+  // a read buffer size of 0 (the default) reads exactly the header and body sizes 
+  // returned by the message frame, otherwise reads fill a buffer of this size and all
+  // of the complete messages in it are handled per read; used by the next start_io,
+  // delimiter reads always use a read buffer
+  void set_read_buffer_size(std::size_t sz) noexcept {
+    m_read_buf_size.store(sz, std::memory_order_relaxed);
+  }
+
+  // start_io, stop_io and send can be called from any thread, while every handler runs
+  // on the socket strand; the IO started flag is set in the calling thread, everything 
+  // that uses the socket or the read and write state is dispatched to the strand (run 
+  // directly if already on it, e.g. from a handler)
   template <typename MH, typename MF>
   bool start_io(std::size_t header_size, MH&& msg_handler, MF&& msg_frame) {
-    if (!start_io_setup()) {
+    if (!m_io_common.set_io_started()) { // concurrency protected
       return false;
     }
-    m_byte_vec.resize(header_size);
-    start_read(asio::mutable_buffer(m_byte_vec.data(), m_byte_vec.size()), header_size,
-               std::forward<MH>(msg_handler), std::forward<MF>(msg_frame));
+    auto self { shared_from_this() };
+    asio::dispatch(m_socket.get_executor(), [this, self, header_size, 
+                     msg_hdlr = std::move(msg_handler), 
+                     msg_frame = std::move(msg_frame)] () mutable {
+        if (!start_io_setup()) {
+          return;
+        }
+        auto rd_buf_size = m_read_buf_size.load(std::memory_order_relaxed);
+        if (rd_buf_size != 0u) {
+          size_read_buf(std::max(rd_buf_size, header_size));
+          m_rd_end = 0u;
+          m_msg_beg = 0u;
+          m_msg_framed = 0u;
+          start_read_some(header_size, header_size, std::move(msg_hdlr), std::move(msg_frame));
+          return;
+        }
+        size_read_buf(header_size);
+        start_read(asio::mutable_buffer(m_byte_vec.data(), m_byte_vec.size()), header_size,
+                   std::move(msg_hdlr), std::move(msg_frame));
+      }
+    );
     return true;
   }
 
@@ -123,11 +319,24 @@ public:
 
   template <typename MH>
   bool start_io(std::string_view delimiter, MH&& msg_handler) {
-    if (!start_io_setup()) {
+    if (!m_io_common.set_io_started()) { // concurrency protected
       return false;
     }
+    auto self { shared_from_this() };
     // not sure of delimiter std::string_view lifetime, so create string
-    start_read_until(std::string(delimiter), std::forward<MH>(msg_handler));
+    asio::dispatch(m_socket.get_executor(), [this, self, delim = std::string(delimiter),
+                     msg_hdlr = std::move(msg_handler)] () mutable {
+        if (!start_io_setup()) {
+          return;
+        }
+        auto rd_buf_size = m_read_buf_size.load(std::memory_order_relaxed);
+        size_read_buf(rd_buf_size != 0u ? rd_buf_size : default_delim_read_buf_size);
+        m_rd_end = 0u;
+        m_msg_beg = 0u;
+        m_msg_framed = 0u;
+        start_read_until(std::move(delim), m_byte_vec.size(), std::move(msg_hdlr));
+      }
+    );
     return true;
   }
 
@@ -149,41 +358,196 @@ public:
       ret = false;
       m_io_common.set_io_started();
     }
-    close(std::make_error_code(net_ip_errc::tcp_io_handler_stopped));
+    auto self { shared_from_this() };
+    asio::dispatch(m_socket.get_executor(), [this, self] () {
+        close(std::make_error_code(net_ip_errc::tcp_io_handler_stopped));
+      }
+    );
     return ret;
   }
 
   // io_common has concurrency protection
-  bool send(const chops::const_shared_buffer& buf) {
-    auto ret = m_io_common.start_write(buf, 
-        [this] (const chops::const_shared_buffer& b) {
-          start_write(b);
+  send_result send(const chops::const_shared_buffer& buf) {
+    return send_elem(tcp_queue_element(buf));
+  }
+
+  send_result send(const chops::const_shared_buffer& buf, const endpoint_type&) {
+    return send(buf);
+  }
+
+  send_result send_with_completion(const chops::const_shared_buffer& buf, 
+                                   send_completion_handler completion) {
+    return send_elem(tcp_queue_element(buf, 
+          std::make_shared<const send_completion_handler>(std::move(completion))));
+  }
+
+  send_result send_with_completion(const chops::const_shared_buffer& buf, const endpoint_type&,
+                                   send_completion_handler completion) {
+    return send_with_completion(buf, std::move(completion));
+  }
+
+  // buffers of at least min_size bytes are sent with MSG_ZEROCOPY (Linux only), a value
+  // of 0 disables zero copy sends; zero copy only applies to buffers written on their own
+  std::error_code set_zero_copy(std::size_t min_size) {
+    if (min_size != 0u) {
+      auto ec = enable_zero_copy(m_socket.native_handle());
+      if (ec) {
+        return ec;
+      }
+    }
+    m_zero_copy_min_size.store(min_size, std::memory_order_relaxed);
+    return std::error_code();
+  }
+
+  // a timeout of zero disables it; on expiry the IO handler is closed through the 
+  // executor, as with other closes originating outside of a handler
+  std::error_code set_io_timeouts(std::chrono::milliseconds read_timeout, 
+                                  std::chrono::milliseconds write_timeout) {
+    if (!m_timer_wheel) {
+      return std::make_error_code(std::errc::operation_not_supported);
+    }
+    m_timer_wheel->set_timeouts(m_timeouts, read_timeout, write_timeout,
+        [wp = weak_from_this(), ex = m_socket.get_executor()] (std::error_code err) {
+          asio::post(ex, [wp, err] () {
+              auto sp = wp.lock();
+              if (sp) {
+                sp->close(err);
+              }
+            }
+          );
         }
       );
-    return ret != io_common<const_shared_buffer>::write_status::io_stopped;
+    return std::error_code();
   }
 
-  bool send(const chops::const_shared_buffer& buf, const endpoint_type&) {
-    return send(buf);
+  send_result send_no_copy(const void* buf, std::size_t sz, buffer_release_hook release) {
+    return send_elem(tcp_queue_element(send_buffer(buf, sz, std::move(release))));
+  }
+
+  send_result send_no_copy(const void* buf, std::size_t sz, const endpoint_type&, 
+                           buffer_release_hook release) {
+    return send_no_copy(buf, sz, std::move(release));
+  }
+
+  // the file segment is written with sendfile when it reaches the head of the output 
+  // queue, in order with other sends; the descriptor must stay open until the release
+  // hook is called
+  send_result send_file(int fd, std::uint64_t offset, std::size_t len, 
+                        file_release_hook release) {
+    return send_elem(tcp_queue_element(send_buffer(fd, offset, len, std::move(release))));
   }
 
 private:
+  send_result send_elem(const tcp_queue_element& elem) {
+    auto ret = m_io_common.start_write(elem, 
+        [this] (const tcp_queue_element& e) {
+          auto self { shared_from_this() };
+          asio::dispatch(m_socket.get_executor(), [this, self, e] () {
+              // no write in progress, so the write containers are not in use
+              m_write_bufs.clear();
+              m_write_bufs.push_back(e);
+              start_write();
+            }
+          );
+        }
+      );
+    if (ret == send_result::overflow_closed) {
+      // send can be called from any thread, so close through the executor
+      post_close(std::make_error_code(net_ip_errc::output_queue_overflow));
+    }
+    return send_result(ret);
+  }
+
+  // a close through the executor, rather than a direct call, from a message handler 
+  // returning false (giving a return message a possibility of getting through) or from
+  // outside of a handler
+  void post_close(const std::error_code& err) {
+    auto self { shared_from_this() };
+    asio::post(m_socket.get_executor(), [this, self, err] () { close(err); } );
+  }
+
+  // in the read modes handling many messages per read, a message handler returning false
+  // stops the reads, refuses further sends, and closes once the replies already queued 
+  // for earlier messages are written, or after the drain timeout
+  void close_after_writes() {
+    m_io_common.set_io_closing();
+    auto self { shared_from_this() };
+    asio::post(m_socket.get_executor(), [this, self] () {
+        if (!m_io_common.is_write_in_progress()) {
+          close(std::make_error_code(net_ip_errc::message_handler_terminated));
+          return;
+        }
+        m_close_timer = std::make_unique<asio::steady_timer>(m_socket.get_executor(),
+                                                             close_drain_timeout);
+        m_close_timer->async_wait([this, self] (const std::error_code& err) {
+            if (!err) {
+              close(std::make_error_code(net_ip_errc::message_handler_terminated));
+            }
+          }
+        );
+      }
+    );
+  }
+
   void close(const std::error_code& err) {
     if (!m_io_common.set_io_stopped()) {
       return; // already stopped, short circuit any late handler callbacks
     }
     m_io_common.clear();
+    if (m_timeouts) {
+      m_timer_wheel->cancel(m_timeouts);
+    }
     std::error_code ec;
+    if (m_close_timer) {
+      m_close_timer->cancel(ec);
+      m_close_timer.reset();
+    }
     m_socket.shutdown(asio::ip::tcp::socket::shutdown_receive, ec);
-    m_socket.close(ec); 
+    if (m_zc_tracker.idle()) {
+      m_socket.close(ec); 
+    }
+    else {
+      // the kernel still sends queued data from the pinned pages of zero copy buffers,
+      // so the socket stays open until their notifications have been read
+      start_zero_copy_drain();
+    }
     // notify the acceptor or connector that this tcp_io object is closed
     m_notifier_cb(err, shared_from_this());
   }
 
 private:
 
+  void size_read_buf(std::size_t sz) {
+    if (m_read_buf_pool && m_byte_vec.capacity() == 0u) {
+      m_byte_vec = m_read_buf_pool->acquire(sz);
+      return;
+    }
+    m_byte_vec.resize(sz);
+  }
+
+  // called only when the read buffer holds no partial message; a buffer grown above the
+  // pool shrink threshold is freed and a buffer of size sz borrowed in its place
+  void shrink_read_buf(std::size_t sz) {
+    if (m_read_buf_pool && 
+        m_byte_vec.capacity() > std::max(sz, m_read_buf_pool->shrink_threshold())) {
+      m_read_buf_pool->release(std::move(m_byte_vec));
+      m_byte_vec = m_read_buf_pool->acquire(sz);
+    }
+  }
+
+  void read_activity() noexcept {
+    if (m_timeouts) {
+      m_timeouts->read_activity(m_timer_wheel->now());
+    }
+  }
+
+  void store_read_buf_bytes() noexcept {
+    m_read_buf_bytes.store(m_byte_vec.capacity(), std::memory_order_relaxed);
+  }
+
+  // called on the socket strand, IO started has already been set
   bool start_io_setup() {
-    if (!m_io_common.set_io_started()) { // concurrency protected
+    if (!m_io_common.is_io_started()) { // stopped before the dispatch ran
       return false;
     }
     std::error_code ec;
@@ -197,6 +561,7 @@ private:
 
   template <typename MH, typename MF>
   void start_read(asio::mutable_buffer mbuf, std::size_t hdr_size, MH&& msg_hdlr, MF&& msg_frame) {
+    store_read_buf_bytes();
     auto self { shared_from_this() };
     asio::async_read(m_socket, mbuf,
       [this, self, hdr_size, mbuf, msg_hdlr = std::move(msg_hdlr), msg_frame = std::move(msg_frame)]
@@ -210,31 +575,160 @@ private:
   void handle_read(asio::mutable_buffer, std::size_t,
                    const std::error_code&, std::size_t, MH&&, MF&&);
 
+  template <typename MH, typename MF>
+  void start_read_some(std::size_t hdr_size, std::size_t next_size, MH&& msg_hdlr, MF&& msg_frame) {
+    store_read_buf_bytes();
+    auto self { shared_from_this() };
+    m_socket.async_read_some(asio::mutable_buffer(m_byte_vec.data() + m_rd_end, 
+                                                  m_byte_vec.size() - m_rd_end),
+      [this, self, hdr_size, next_size, msg_hdlr = std::move(msg_hdlr), msg_frame = std::move(msg_frame)]
+            (const std::error_code& err, std::size_t nb) mutable {
+        handle_read_some(hdr_size, next_size, err, nb, std::move(msg_hdlr), std::move(msg_frame));
+      }
+    );
+  }
+
+  template <typename MH, typename MF>
+  void handle_read_some(std::size_t, std::size_t, const std::error_code&, std::size_t, MH&&, MF&&);
+
+  template <typename MH>
+  bool invoke_msg_hdlr(MH&, std::size_t, std::size_t, bool);
+
   template <typename MH>
-  void start_read_until(std::string delim, MH&& msg_hdlr) {
+  bool collect_or_invoke_msg_hdlr(MH&, std::size_t, std::size_t, bool);
+
+  template <typename MH>
+  bool invoke_batch_msg_hdlr(MH&);
+
+  template <typename MH>
+  void start_read_until(std::string delim, std::size_t rd_buf_size, MH&& msg_hdlr) {
+    store_read_buf_bytes();
     auto self { shared_from_this() };
-    asio::async_read_until(m_socket, asio::dynamic_buffer(m_byte_vec), delim,
-      [this, self, delim, msg_hdlr = std::move(msg_hdlr)] 
+    m_socket.async_read_some(asio::mutable_buffer(m_byte_vec.data() + m_rd_end, 
+                                                  m_byte_vec.size() - m_rd_end),
+      [this, self, delim = std::move(delim), rd_buf_size, msg_hdlr = std::move(msg_hdlr)] 
             (const std::error_code& err, std::size_t nb) mutable {
-        handle_read_until(delim, err, nb, std::move(msg_hdlr));
+        handle_read_until(std::move(delim), rd_buf_size, err, nb, std::move(msg_hdlr));
       }
     );
   }
 
   template <typename MH>
-  void handle_read_until(std::string, const std::error_code&, std::size_t, MH&&);
+  void handle_read_until(std::string, std::size_t, const std::error_code&, std::size_t, MH&&);
 
-  void start_write(const chops::const_shared_buffer&);
+  void start_write();
+
+  void write_part();
+
+  void handle_write_part(const std::error_code&, std::size_t, std::size_t);
 
   void handle_write(const std::error_code&, std::size_t);
 
+  void invoke_completions(const std::error_code&, std::size_t);
+
+  bool use_zero_copy(std::size_t sz) const noexcept {
+    auto min_sz = m_zero_copy_min_size.load(std::memory_order_relaxed);
+    return min_sz != 0u && sz >= min_sz;
+  }
+
+  void start_zero_copy_write(std::size_t);
+  void handle_zero_copy_write(const std::error_code&, std::size_t);
+  void start_zero_copy_notify_wait();
+  void start_zero_copy_drain();
+  void end_zero_copy_drain(bool reset);
+
+  void start_file_write(std::size_t);
+  void handle_file_write(const std::error_code&, std::size_t);
+
 };
 
+// a message handler can take the message as an asio::const_buffer, referencing the 
+// read buffer for the duration of the call, or as a chops::const_shared_buffer that
+// it owns; a handler accepting either gets the asio::const_buffer
+template <typename MH>
+constexpr bool tcp_owned_msg_hdlr_v = 
+  std::is_invocable_v<MH&, chops::const_shared_buffer, basic_io_output<tcp_io>, 
+                      asio::ip::tcp::endpoint> &&
+  !std::is_invocable_v<MH&, asio::const_buffer, basic_io_output<tcp_io>, 
+                       asio::ip::tcp::endpoint>;
+
+// a batch message handler takes all of the complete messages from one read, as buffers
+// referencing the read buffer for the duration of the call
+template <typename MH>
+constexpr bool tcp_batch_msg_hdlr_v = 
+  std::is_invocable_v<MH&, const_buffer_span, basic_io_output<tcp_io>, 
+                      asio::ip::tcp::endpoint> &&
+  !std::is_invocable_v<MH&, asio::const_buffer, basic_io_output<tcp_io>, 
+                       asio::ip::tcp::endpoint>;
+
 // method implementations, just to make the class declaration a little more readable
 
+// when the message is all of the read buffer it is moved into the shared buffer and 
+// the read buffer is replaced, otherwise the message is copied
+template <typename MH>
+bool tcp_io::invoke_msg_hdlr(MH& msg_hdlr, std::size_t beg, std::size_t len, bool can_move) {
+  if constexpr (tcp_batch_msg_hdlr_v<MH>) {
+    asio::const_buffer buf(m_byte_vec.data() + beg, len);
+    return msg_hdlr(const_buffer_span(&buf, &buf + 1), 
+                    basic_io_output<tcp_io>(weak_from_this()), m_remote_endp);
+  }
+  else if constexpr (tcp_owned_msg_hdlr_v<MH>) {
+    if (can_move && beg == 0u && len == m_byte_vec.size()) {
+      chops::const_shared_buffer buf(std::move(m_byte_vec));
+      // the next message is likely a similar size
+      if (m_read_buf_pool) {
+        m_byte_vec = m_read_buf_pool->acquire(std::min(len, m_read_buf_pool->shrink_threshold()));
+        m_byte_vec.clear();
+      }
+      else {
+        m_byte_vec = byte_vec();
+        m_byte_vec.reserve(len);
+      }
+      return msg_hdlr(std::move(buf), basic_io_output<tcp_io>(weak_from_this()), m_remote_endp);
+    }
+    return msg_hdlr(chops::const_shared_buffer(m_byte_vec.data() + beg, len), 
+                    basic_io_output<tcp_io>(weak_from_this()), m_remote_endp);
+  }
+  else {
+    return msg_hdlr(asio::const_buffer(m_byte_vec.data() + beg, len), 
+                    basic_io_output<tcp_io>(weak_from_this()), m_remote_endp);
+  }
+}
+
+// for buffered and delimiter reads, a batch message handler gets the messages after all
+// of the messages in the read buffer have been found
+template <typename MH>
+bool tcp_io::collect_or_invoke_msg_hdlr(MH& msg_hdlr, std::size_t beg, std::size_t len, 
+                                        bool can_move) {
+  if constexpr (tcp_batch_msg_hdlr_v<MH>) {
+    m_msg_batch.emplace_back(m_byte_vec.data() + beg, len);
+    return true;
+  }
+  else {
+    return invoke_msg_hdlr(msg_hdlr, beg, len, can_move);
+  }
+}
+
+template <typename MH>
+bool tcp_io::invoke_batch_msg_hdlr(MH& msg_hdlr) {
+  if constexpr (tcp_batch_msg_hdlr_v<MH>) {
+    if (m_msg_batch.empty()) {
+      return true;
+    }
+    bool ret = msg_hdlr(const_buffer_span(m_msg_batch.data(), 
+                                          m_msg_batch.data() + m_msg_batch.size()),
+                        basic_io_output<tcp_io>(weak_from_this()), m_remote_endp);
+    m_msg_batch.clear();
+    return ret;
+  }
+  else {
+    return true;
+  }
+}
+
 template <typename MH, typename MF>
 void tcp_io::handle_read(asio::mutable_buffer mbuf, std::size_t hdr_size,
-                         const std::error_code& err, std::size_t /* num_bytes */,
+                         const std::error_code& err, std::size_t num_bytes,
                          MH&& msg_hdlr, MF&& msg_frame) {
 
   if (err) {
@@ -242,18 +736,20 @@ void tcp_io::handle_read(asio::mutable_buffer mbuf, std::size_t hdr_size,
     return;
   }
   // assert num_bytes == mbuf.size()
+  m_counters.count_read(num_bytes);
+  read_activity();
   std::size_t next_read_size = msg_frame(mbuf);
+  if (next_read_size == msg_frame_error) {
+    close(std::make_error_code(net_ip_errc::message_frame_error));
+    return;
+  }
   if (next_read_size == 0u) { // msg fully received, now invoke message handler
-    if (!msg_hdlr(asio::const_buffer(m_byte_vec.data(), m_byte_vec.size()), 
-                  basic_io_output<tcp_io>(weak_from_this()), m_remote_endp)) {
-      auto self { shared_from_this() };
-      // message handler not happy, tear everything down, post function object
-      // instead of directly calling close to give a return message a possibility
-      // of getting through
-      asio::post(m_socket.get_executor(), [this, self] () { 
-        close(std::make_error_code(net_ip_errc::message_handler_terminated)); } );
+    m_counters.count_msg();
+    if (!invoke_msg_hdlr(msg_hdlr, 0u, m_byte_vec.size(), true)) {
+      post_close(std::make_error_code(net_ip_errc::message_handler_terminated));
       return;
     }
+    shrink_read_buf(hdr_size);
     m_byte_vec.resize(hdr_size);
     mbuf = asio::mutable_buffer(m_byte_vec.data(), m_byte_vec.size());
   }
@@ -265,46 +761,350 @@ void tcp_io::handle_read(asio::mutable_buffer mbuf, std::size_t hdr_size,
   start_read(mbuf, hdr_size, std::forward<MH>(msg_hdlr), std::forward<MF>(msg_frame));
 }
 
+// the message frame is called with each header and body piece in turn, as with 
+// unbuffered reads, but for every piece already in the buffer; messages are passed
+// to the message handler directly from the read buffer
+template <typename MH, typename MF>
+void tcp_io::handle_read_some(std::size_t hdr_size, std::size_t next_size,
+                              const std::error_code& err, std::size_t num_bytes,
+                              MH&& msg_hdlr, MF&& msg_frame) {
+
+  if (err) {
+    close(err);
+    return;
+  }
+  m_counters.count_read(num_bytes);
+  read_activity();
+  m_rd_end += num_bytes;
+  while (m_rd_end - (m_msg_beg + m_msg_framed) >= next_size) {
+    asio::mutable_buffer mbuf(m_byte_vec.data() + m_msg_beg + m_msg_framed, next_size);
+    m_msg_framed += next_size;
+    next_size = msg_frame(mbuf);
+    if (next_size == msg_frame_error) {
+      invoke_batch_msg_hdlr(msg_hdlr); // messages before the error are still delivered
+      close(std::make_error_code(net_ip_errc::message_frame_error));
+      return;
+    }
+    if (next_size != 0u) {
+      continue;
+    }
+    m_counters.count_msg();
+    // the read buffer holds other messages, so it is never moved out
+    if (!collect_or_invoke_msg_hdlr(msg_hdlr, m_msg_beg, m_msg_framed, false)) {
+      close_after_writes();
+      return;
+    }
+    m_msg_beg += m_msg_framed;
+    m_msg_framed = 0u;
+    next_size = hdr_size;
+  }
+  if (!invoke_batch_msg_hdlr(msg_hdlr)) {
+    close_after_writes();
+    return;
+  }
+  // move the partial message to the front, and grow the buffer if the rest of the 
+  // message will not fit
+  if (m_msg_beg != 0u) {
+    std::memmove(m_byte_vec.data(), m_byte_vec.data() + m_msg_beg, m_rd_end - m_msg_beg);
+    m_rd_end -= m_msg_beg;
+    m_msg_beg = 0u;
+  }
+  if (m_rd_end == 0u) {
+    shrink_read_buf(std::max(hdr_size, m_read_buf_size.load(std::memory_order_relaxed)));
+  }
+  if (m_msg_framed + next_size > m_byte_vec.size()) {
+    m_byte_vec.resize(m_msg_framed + next_size);
+  }
+  start_read_some(hdr_size, next_size, std::forward<MH>(msg_hdlr), std::forward<MF>(msg_frame));
+}
+
+// every complete message in the buffer is handled before the next read; the searched
+// part of a partial message is not searched again, other than the bytes that could
+// be the start of a delimiter split across reads
 template <typename MH>
-void tcp_io::handle_read_until(std::string delim, const std::error_code& err, 
-                               std::size_t num_bytes, MH&& msg_hdlr) {
+void tcp_io::handle_read_until(std::string delim, std::size_t rd_buf_size,
+                               const std::error_code& err, std::size_t num_bytes, 
+                               MH&& msg_hdlr) {
 
   if (err) {
     close(err);
     return;
   }
-  // beginning of m_byte_vec to num_bytes is buf, includes delimiter bytes
-  if (!msg_hdlr(asio::const_buffer(m_byte_vec.data(), num_bytes),
-                basic_io_output<tcp_io>(weak_from_this()), m_remote_endp)) {
-      auto self { shared_from_this() };
-      asio::post(m_socket.get_executor(), [this, self] () { 
-        close(std::make_error_code(net_ip_errc::message_handler_terminated)); } );
+  m_counters.count_read(num_bytes);
+  read_activity();
+  m_rd_end += num_bytes;
+  for (;;) {
+    std::size_t scan_beg = m_msg_beg + m_msg_framed;
+    std::size_t scan_size = m_rd_end - scan_beg;
+    std::size_t off = find_delimiter(m_byte_vec.data() + scan_beg, scan_size, delim);
+    if (off == scan_size) {
+      std::size_t partial = m_rd_end - m_msg_beg;
+      m_msg_framed = partial - std::min(partial, delim.size() - 1u);
+      break;
+    }
+    // message includes the delimiter bytes
+    std::size_t len = m_msg_framed + off + delim.size();
+    bool whole = (m_msg_beg == 0u && len == m_rd_end);
+    if constexpr (tcp_owned_msg_hdlr_v<MH>) {
+      if (whole) { // trim so the read buffer can be moved out
+        m_byte_vec.resize(len);
+      }
+    }
+    m_counters.count_msg();
+    if (!collect_or_invoke_msg_hdlr(msg_hdlr, m_msg_beg, len, whole)) {
+      close_after_writes();
+      return;
+    }
+    m_msg_framed = 0u;
+    if (m_byte_vec.size() < m_rd_end) { // moved out, no other data was buffered
+      m_msg_beg = 0u;
+      m_rd_end = 0u;
+      break;
+    }
+    m_msg_beg += len;
+  }
+  if (!invoke_batch_msg_hdlr(msg_hdlr)) {
+    close_after_writes();
     return;
   }
-  m_byte_vec.erase(m_byte_vec.begin(), m_byte_vec.begin() + num_bytes);
-  start_read_until(delim, std::forward<MH>(msg_hdlr));
+  if (m_msg_beg != 0u) {
+    std::memmove(m_byte_vec.data(), m_byte_vec.data() + m_msg_beg, m_rd_end - m_msg_beg);
+    m_rd_end -= m_msg_beg;
+    m_msg_beg = 0u;
+  }
+  if (m_rd_end == 0u) {
+    shrink_read_buf(rd_buf_size);
+  }
+  if (m_byte_vec.size() < rd_buf_size) {
+    m_byte_vec.resize(rd_buf_size);
+  }
+  else if (m_rd_end == m_byte_vec.size()) { // message longer than the buffer
+    m_byte_vec.resize(2u * m_byte_vec.size());
+  }
+  start_read_until(std::move(delim), rd_buf_size, std::forward<MH>(msg_hdlr));
 }
 
 
-inline void tcp_io::start_write(const chops::const_shared_buffer& buf) {
+inline void tcp_io::start_write() {
+  if (m_timeouts) {
+    m_timeouts->write_started(m_timer_wheel->now());
+  }
+  m_write_pos = 0u;
+  m_write_total = 0u;
+  write_part();
+}
+
+// a part is a file segment, or the run of memory buffers up to the next file segment
+// (normally all of the buffers), written with one async_write or with zero copy sends
+inline void tcp_io::write_part() {
+  const auto& first = m_write_bufs[m_write_pos].m_buf;
+  if (first.is_file()) {
+    start_file_write(0u);
+    return;
+  }
+  std::size_t end = m_write_pos + 1u;
+  while (end < m_write_bufs.size() && !m_write_bufs[end].m_buf.is_file()) {
+    ++end;
+  }
+  if (end - m_write_pos == 1u && use_zero_copy(first.size())) {
+    m_zc_tracker.start_buffer();
+    start_zero_copy_write(0u);
+    return;
+  }
   auto self { shared_from_this() };
-  asio::async_write(m_socket, asio::const_buffer(buf.data(), buf.size()),
-            [this, self] (const std::error_code& err, std::size_t nb) {
-      handle_write(err, nb);
+  if (end - m_write_pos == 1u) { // common case, no gather write needed
+    asio::async_write(m_socket, asio::const_buffer(first.data(), first.size()),
+              [this, self, end] (const std::error_code& err, std::size_t nb) {
+        handle_write_part(err, nb, end);
+      }
+    );
+    return;
+  }
+  m_write_seq.clear();
+  for (std::size_t i = m_write_pos; i < end; ++i) {
+    m_write_seq.emplace_back(m_write_bufs[i].m_buf.data(), m_write_bufs[i].m_buf.size());
+  }
+  asio::async_write(m_socket, const_buffer_span(m_write_seq.data(), 
+                                                m_write_seq.data() + m_write_seq.size()),
+            [this, self, end] (const std::error_code& err, std::size_t nb) {
+      handle_write_part(err, nb, end);
     }
   );
 }
 
-inline void tcp_io::handle_write(const std::error_code& err, std::size_t /* num_bytes */) {
+inline void tcp_io::handle_write_part(const std::error_code& err, std::size_t num_bytes, 
+                                      std::size_t next_pos) {
+  m_write_total += num_bytes;
+  m_write_pos = next_pos;
+  if (err || m_write_pos == m_write_bufs.size()) {
+    handle_write(err, m_write_total);
+    return;
+  }
+  if (m_timeouts) { // progress, so the write stall time starts again
+    m_timeouts->write_started(m_timer_wheel->now());
+  }
+  write_part();
+}
+
+inline void tcp_io::handle_write(const std::error_code& err, std::size_t num_bytes) {
   if (err) {
-    // read pops first, so usually no error is needed in write handlers
+    // read pops first, so usually no error is needed in write handlers; io_common is
+    // still called after the close, ending the write cycle and releasing queued buffers
     close(err);
+  }
+  else {
+    m_counters.count_write(m_write_bufs.size(), num_bytes);
+  }
+  if (m_timeouts) {
+    m_timeouts->write_finished();
+  }
+  invoke_completions(err, num_bytes);
+  // release the written buffers here rather than in io_common, so that buffer release 
+  // hooks are not called with the io_common lock held
+  m_write_bufs.clear();
+  m_io_common.write_next_elems(m_write_bufs, 
+        [this] (const std::vector<tcp_queue_element>&) {
+      start_write();
+    }
+  );
+  if (m_close_timer && !m_io_common.is_write_in_progress()) {
+    close(std::make_error_code(net_ip_errc::message_handler_terminated));
+  }
+}
+
+// the bytes written by a gather write are apportioned to the buffers in order, so on 
+// an error each completion reports how much of its own buffer was written
+inline void tcp_io::invoke_completions(const std::error_code& err, std::size_t num_bytes) {
+  for (const auto& e : m_write_bufs) {
+    std::size_t nb = std::min(num_bytes, e.size());
+    num_bytes -= nb;
+    if (e.m_completion) {
+      (*e.m_completion)(err, nb);
+    }
+  }
+}
+
+// zero copy sends are performed directly on the native socket when asio reports it
+// writable, since asio has no way to pass MSG_ZEROCOPY through async_write
+inline void tcp_io::start_zero_copy_write(std::size_t offset) {
+  auto self { shared_from_this() };
+  m_socket.async_wait(asio::ip::tcp::socket::wait_write, 
+            [this, self, offset] (const std::error_code& err) {
+      handle_zero_copy_write(err, offset);
+    }
+  );
+}
+
+inline void tcp_io::handle_zero_copy_write(const std::error_code& err, std::size_t offset) {
+  const auto& buf = m_write_bufs[m_write_pos].m_buf;
+  std::error_code ec { err };
+  while (!ec && offset < buf.size()) {
+    bool zero_copy = false;
+    offset += zero_copy_send(m_socket.native_handle(), buf.data() + offset, 
+                             buf.size() - offset, zero_copy, ec);
+    if (!ec && zero_copy) {
+      m_zc_tracker.sent();
+    }
+  }
+  if (ec == std::errc::resource_unavailable_try_again || 
+      ec == std::errc::operation_would_block) { // socket buffer full, wait again
+    start_zero_copy_write(offset);
+    return;
+  }
+  // the kernel references the buffer until the notification arrives, also when the
+  // write was aborted by a close (the socket is then kept open by the zero copy drain)
+  m_zc_tracker.end_buffer(buf);
+  start_zero_copy_notify_wait();
+  handle_write_part(ec, offset, m_write_pos + 1u);
+}
+
+inline void tcp_io::start_zero_copy_notify_wait() {
+  if (!m_socket.is_open()) {
     return;
   }
-  m_io_common.write_next_elem([this] (const chops::const_shared_buffer& buf) {
-      start_write(buf);
+  if (!m_zc_notify_wait && !m_zc_tracker.idle()) {
+    m_zc_notify_wait = true;
+    auto self { shared_from_this() };
+    m_socket.async_wait(asio::ip::tcp::socket::wait_error, 
+              [this, self] (const std::error_code& err) {
+        m_zc_notify_wait = false;
+        // the cancel at the start of a drain also aborts this wait
+        if (!err || (err == asio::error::operation_aborted && m_zc_drain_timer)) {
+          start_zero_copy_notify_wait();
+        }
+      }
+    );
+  }
+  // pick up notifications that arrived before the wait was started
+  read_zero_copy_notifications(m_socket.native_handle(), m_zc_tracker);
+  if (m_zc_drain_timer && m_zc_tracker.idle()) {
+    end_zero_copy_drain(false);
+  }
+}
+
+// called from close, the outstanding reads and writes are cancelled but the socket is
+// only shut down for sending, which queues the FIN behind the data already in the kernel
+inline void tcp_io::start_zero_copy_drain() {
+  std::error_code ec;
+  m_socket.shutdown(asio::ip::tcp::socket::shutdown_send, ec);
+  m_socket.cancel(ec);
+  m_zc_drain_timer = std::make_unique<asio::steady_timer>(m_socket.get_executor(),
+                                                          close_drain_timeout);
+  auto self { shared_from_this() };
+  m_zc_drain_timer->async_wait([this, self] (const std::error_code& err) {
+      if (!err && m_zc_drain_timer) {
+        end_zero_copy_drain(true); // the peer is not reading, give up on it
+      }
     }
   );
+  start_zero_copy_notify_wait();
+}
+
+// with a reset (SO_LINGER of zero) the kernel drops the unsent data and the pinned pages
+// before the socket close returns, so the buffers can then be released
+inline void tcp_io::end_zero_copy_drain(bool reset) {
+  std::error_code ec;
+  if (m_zc_drain_timer) {
+    m_zc_drain_timer->cancel(ec);
+    m_zc_drain_timer.reset();
+  }
+  if (reset) {
+    m_socket.set_option(asio::socket_base::linger(true, 0), ec);
+  }
+  m_socket.close(ec);
+  m_zc_tracker.clear();
+}
+
+// file segments are sent directly on the native socket when asio reports it writable
+inline void tcp_io::start_file_write(std::size_t offset) {
+  auto self { shared_from_this() };
+  m_socket.async_wait(asio::ip::tcp::socket::wait_write, 
+            [this, self, offset] (const std::error_code& err) {
+      handle_file_write(err, offset);
+    }
+  );
+}
+
+inline void tcp_io::handle_file_write(const std::error_code& err, std::size_t offset) {
+  const auto& seg = m_write_bufs[m_write_pos].m_buf;
+  std::error_code ec { err };
+  if (!ec) { // sendfile has no per call non-blocking flag
+    m_socket.native_non_blocking(true, ec);
+  }
+  while (!ec && offset < seg.size()) {
+    auto n = send_file_segment(m_socket.native_handle(), seg.file_descriptor(), 
+                               seg.file_offset() + offset, seg.size() - offset, ec);
+    if (!ec && n == 0u) {
+      ec = std::make_error_code(net_ip_errc::send_file_short);
+    }
+    offset += n;
+  }
+  if (ec == std::errc::resource_unavailable_try_again || 
+      ec == std::errc::operation_would_block) { // socket buffer full, wait again
+    start_file_write(offset);
+    return;
+  }
+  handle_write_part(ec, offset, m_write_pos + 1u);
 }
 
 using tcp_io_shared_ptr = std::shared_ptr<tcp_io>;
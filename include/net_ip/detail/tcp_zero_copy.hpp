@@ -0,0 +1,221 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Support for Linux @c MSG_ZEROCOPY sends in the TCP io handler.
+ *
+ *  With @c SO_ZEROCOPY set on a socket, a @c send with the @c MSG_ZEROCOPY flag pins the
+ *  user pages instead of copying them into the kernel. The pages are referenced until
+ *  the kernel posts a completion notification to the socket error queue. Each successful
+ *  zero copy send call is assigned the next 32 bit notification id, and a notification
+ *  covers a range of ids.
+ *
+ *  @c zero_copy_tracker keeps the sent buffers alive (and so defers release hooks of
+ *  application owned memory) until the notification covering their last send call
+ *  arrives. Closing the socket does not stop the kernel from sending data that is 
+ *  already queued, straight from the pinned pages, so a closing @c tcp_io keeps the 
+ *  socket open until the tracker is idle (see @c tcp_io::close). The tracker is 
+ *  platform independent; the system calls are only compiled on
+ *  Linux, where @c CHOPS_NET_IP_HAS_MSG_ZEROCOPY is then defined. On other platforms
+ *  enabling zero copy returns @c std::errc::operation_not_supported.
+ *
+ *  Zero copy has a per send overhead (page pinning and the notification), so it only
+ *  pays off for large buffers. On the loopback interface the kernel always falls back
+ *  to copying (notifications are flagged with @c SO_EE_CODE_ZEROCOPY_COPIED).
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef TCP_ZERO_COPY_HPP_INCLUDED
+#define TCP_ZERO_COPY_HPP_INCLUDED
+
+#include <deque>
+#include <utility> // std::pair
+#include <cstdint> // std::uint32_t, std::int32_t
+#include <cstddef> // std::size_t, std::byte
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <cerrno>
+#include <cstring> // std::memcpy
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define CHOPS_NET_IP_HAS_MSG_ZEROCOPY
+#endif
+#endif
+
+#include "net_ip/detail/send_buffer.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+class zero_copy_tracker {
+private:
+  std::deque<std::pair<std::uint32_t, send_buffer>> m_pending; // last notification id, buffer
+  std::uint32_t       m_next_id;
+  std::uint32_t       m_buf_first_id;
+  std::uint32_t       m_done_id; // all ids before this one are complete
+  std::size_t         m_num_zero_copy_sends;
+  std::size_t         m_num_copied;
+
+public:
+
+  // the kernel starts the ids of a socket at 0, a different first id is only for testing
+  explicit zero_copy_tracker(std::uint32_t first_id = 0u) noexcept : m_pending(), 
+    m_next_id(first_id), m_buf_first_id(first_id), m_done_id(first_id),
+    m_num_zero_copy_sends(0u), m_num_copied(0u) { }
+
+  // called before the first send call for a buffer
+  void start_buffer() noexcept { m_buf_first_id = m_next_id; }
+
+  // called after each successful MSG_ZEROCOPY send call
+  void sent() noexcept {
+    ++m_next_id;
+    ++m_num_zero_copy_sends;
+  }
+
+  // called after the last send call for a buffer; the buffer is only held if at least
+  // one of its send calls used MSG_ZEROCOPY and those calls are not all complete yet
+  void end_buffer(const send_buffer& buf) {
+    if (m_next_id != m_buf_first_id && !is_done(static_cast<std::uint32_t>(m_next_id - 1u))) {
+      m_pending.emplace_back(static_cast<std::uint32_t>(m_next_id - 1u), buf);
+    }
+    m_buf_first_id = m_next_id;
+  }
+
+  // TCP notifications complete in order, so every buffer whose last id is at or before
+  // the end of the range is released; ids wrap, so compare with a signed difference
+  void complete(std::uint32_t /* lo */, std::uint32_t hi, bool copied) {
+    if (!is_done(hi)) {
+      m_done_id = hi + 1u;
+    }
+    while (!m_pending.empty() && is_done(m_pending.front().first)) {
+      m_pending.pop_front();
+    }
+    if (copied) {
+      ++m_num_copied;
+    }
+  }
+
+  bool empty() const noexcept { return m_pending.empty(); }
+  // no zero copy send call is waiting on a notification, including the calls of a 
+  // buffer that is still being sent
+  bool idle() const noexcept { return m_done_id == m_next_id; }
+  std::size_t size() const noexcept { return m_pending.size(); }
+
+  std::size_t num_zero_copy_sends() const noexcept { return m_num_zero_copy_sends; }
+  // number of notifications reporting that the kernel copied the data after all
+  std::size_t num_copied() const noexcept { return m_num_copied; }
+
+  // gives up on the outstanding notifications, only after the kernel has dropped the
+  // data (e.g. a connection reset)
+  void clear() noexcept {
+    m_pending.clear();
+    m_done_id = m_next_id;
+    m_buf_first_id = m_next_id;
+  }
+
+private:
+  bool is_done(std::uint32_t id) const noexcept {
+    return static_cast<std::int32_t>(id - m_done_id) < 0;
+  }
+
+};
+
+#ifdef CHOPS_NET_IP_HAS_MSG_ZEROCOPY
+
+inline std::error_code enable_zero_copy(int fd) noexcept {
+  int one = 1;
+  if (::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+    return std::error_code(errno, std::system_category());
+  }
+  return std::error_code();
+}
+
+// non-blocking send, zero_copy is set to false if the kernel could not take another
+// zero copy send (ENOBUFS, the notification memory limit) and the data was copied instead
+inline std::size_t zero_copy_send(int fd, const std::byte* data, std::size_t sz,
+                                  bool& zero_copy, std::error_code& ec) noexcept {
+  zero_copy = true;
+  auto n = ::send(fd, data, sz, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (n < 0 && errno == ENOBUFS) {
+    zero_copy = false;
+    n = ::send(fd, data, sz, MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
+  if (n < 0) {
+    ec = std::error_code(errno, std::system_category());
+    return 0u;
+  }
+  return static_cast<std::size_t>(n);
+}
+
+// drains the socket error queue, returns the number of zero copy notifications
+inline std::size_t read_zero_copy_notifications(int fd, zero_copy_tracker& tracker) {
+  std::size_t num = 0u;
+  for (;;) {
+    alignas(cmsghdr) char control[128];
+    msghdr msg { };
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      break; // EAGAIN when the queue is empty
+    }
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+        continue;
+      }
+      sock_extended_err serr;
+      std::memcpy(&serr, CMSG_DATA(cm), sizeof(serr));
+      if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      tracker.complete(serr.ee_info, serr.ee_data,
+                       (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0);
+      ++num;
+    }
+  }
+  return num;
+}
+
+#else
+
+template <typename FD>
+std::error_code enable_zero_copy(FD) noexcept {
+  return std::make_error_code(std::errc::operation_not_supported);
+}
+
+template <typename FD>
+std::size_t zero_copy_send(FD, const std::byte*, std::size_t,
+                           bool& zero_copy, std::error_code& ec) noexcept {
+  zero_copy = false;
+  ec = std::make_error_code(std::errc::operation_not_supported);
+  return 0u;
+}
+
+template <typename FD>
+std::size_t read_zero_copy_notifications(FD, zero_copy_tracker&) {
+  return 0u;
+}
+
+#endif
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,370 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Hierarchical timer wheel for IO handler read and write timeouts, shared by the
+ *  IO handlers of a @c net_ip object.
+ *
+ *  Each IO handler with timeouts has a @c timeout_entry, refreshed with a single atomic
+ *  store on every read completion and write start or completion. The wheel only looks
+ *  at an entry when its earliest possible deadline is reached; if it has been refreshed
+ *  in the meantime it is rescheduled for its new deadline, otherwise the expiry callback
+ *  is invoked. One @c asio::steady_timer drives the whole wheel, ticking at a fixed
+ *  resolution while there are entries, so per message costs are independent of the
+ *  number of connections and no timer is armed or cancelled per read.
+ *
+ *  Ticks are processed in a Linux kernel style hierarchy of four levels of 64 slots,
+ *  entries in higher levels are cascaded to lower levels as the wheel turns, for a range
+ *  of 2^24 ticks (about 19 days at the default 100 ms resolution); longer timeouts are
+ *  rescheduled each time they reach the end of the range.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef TIMER_WHEEL_HPP_INCLUDED
+#define TIMER_WHEEL_HPP_INCLUDED
+
+#include "asio/io_context.hpp"
+#include "asio/steady_timer.hpp"
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <chrono>
+#include <memory> // std::shared_ptr, std::enable_shared_from_this
+#include <functional> // std::function
+#include <system_error>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <algorithm> // std::min
+#include <limits>
+#include <utility> // std::move, std::swap
+
+#include "net_ip/net_ip_error.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+constexpr std::chrono::milliseconds default_timer_wheel_resolution { 100 };
+
+// timeout values and times are in ticks; activity times are stored as the tick plus one,
+// so that zero can mean no write in progress
+class timeout_entry {
+public:
+  using tick_type = std::uint64_t;
+  using expire_cb = std::function<void (std::error_code)>;
+
+private:
+  friend class timer_wheel;
+
+  std::atomic<tick_type>   m_read_timeout;
+  std::atomic<tick_type>   m_write_timeout;
+  std::atomic<tick_type>   m_last_read;
+  std::atomic<tick_type>   m_write_start;
+  // only accessed by the wheel, under its lock
+  bool                     m_cancelled;
+  expire_cb                m_expire_cb;
+  tick_type                m_deadline;
+  bool                     m_scheduled;
+
+public:
+  timeout_entry() noexcept :
+    m_read_timeout(0u), m_write_timeout(0u), m_last_read(0u), m_write_start(0u),
+    m_cancelled(false), m_expire_cb(), m_deadline(0u), m_scheduled(false) { }
+
+  void read_activity(tick_type now) noexcept {
+    m_last_read.store(now + 1u, std::memory_order_relaxed);
+  }
+
+  void write_started(tick_type now) noexcept {
+    m_write_start.store(now + 1u, std::memory_order_relaxed);
+  }
+
+  void write_finished() noexcept {
+    m_write_start.store(0u, std::memory_order_relaxed);
+  }
+};
+
+using timeout_entry_ptr = std::shared_ptr<timeout_entry>;
+
+class timer_wheel : public std::enable_shared_from_this<timer_wheel> {
+public:
+  using tick_type = timeout_entry::tick_type;
+  using clock = std::chrono::steady_clock;
+
+private:
+  static constexpr unsigned    slot_bits = 6u;
+  static constexpr std::size_t num_slots = 1u << slot_bits;
+  static constexpr std::size_t num_levels = 4u;
+  static constexpr tick_type   max_range = (tick_type(1u) << (slot_bits * num_levels)) - 1u;
+  static constexpr tick_type   no_deadline = std::numeric_limits<tick_type>::max();
+
+  // an entry can be in the wheel more than once after it is rescheduled to an earlier
+  // deadline, the copy with a deadline different from the entry's is stale and dropped
+  struct slot_entry {
+    timeout_entry_ptr  m_entry;
+    tick_type          m_deadline;
+  };
+  using slot = std::vector<slot_entry>;
+
+  mutable std::mutex                                    m_mutex;
+  asio::steady_timer                                    m_timer;
+  clock::duration                                       m_resolution;
+  clock::time_point                                     m_start;
+  // next tick to be processed, only changed under the lock; m_now is the last processed
+  // tick, read without the lock when refreshing entries
+  tick_type                                             m_current;
+  std::atomic<tick_type>                                m_now;
+  std::array<std::array<slot, num_slots>, num_levels>  m_slots;
+  std::size_t                                           m_num_entries;
+  bool                                                  m_running;
+  std::uint64_t                                         m_timer_gen;
+
+private:
+  using lg = std::lock_guard<std::mutex>;
+
+public:
+  timer_wheel(asio::io_context& ioc, std::chrono::milliseconds resolution =
+                                       default_timer_wheel_resolution) :
+    m_mutex(), m_timer(ioc),
+    m_resolution(std::max(clock::duration(resolution), clock::duration(1))),
+    m_start(clock::now()), m_current(1u), m_now(0u), m_slots(), m_num_entries(0u),
+    m_running(false), m_timer_gen(0u) { }
+
+private:
+  timer_wheel(const timer_wheel&) = delete;
+  timer_wheel& operator=(const timer_wheel&) = delete;
+
+public:
+
+  tick_type now() const noexcept { return m_now.load(std::memory_order_relaxed); }
+
+  // rounded up, plus one for the part of the current tick already elapsed, so a timeout
+  // never expires early
+  tick_type to_ticks(std::chrono::milliseconds tout) const noexcept {
+    if (tout.count() <= 0) {
+      return 0u;
+    }
+    clock::duration d(tout);
+    return static_cast<tick_type>((d + m_resolution - clock::duration(1)) / m_resolution) + 1u;
+  }
+
+  // a timeout of zero disables it; the entry is (re)scheduled if needed, activity is
+  // counted from now; the expiry callback is only accessed under the lock
+  void set_timeouts(const timeout_entry_ptr& e, std::chrono::milliseconds read_tout,
+                    std::chrono::milliseconds write_tout, timeout_entry::expire_cb cb) {
+    lg g(m_mutex);
+    if (e->m_cancelled) {
+      return;
+    }
+    e->m_expire_cb = std::move(cb);
+    if (!m_running) { // the wheel has not been turning, so catch up to the clock
+      m_current = std::max(m_current, elapsed_ticks() + 1u);
+      m_now.store(m_current - 1u, std::memory_order_relaxed);
+    }
+    e->read_activity(m_current - 1u);
+    e->m_read_timeout.store(to_ticks(read_tout), std::memory_order_relaxed);
+    e->m_write_timeout.store(to_ticks(write_tout), std::memory_order_relaxed);
+    auto deadline = next_deadline(*e, m_current - 1u);
+    if (deadline == no_deadline) {
+      unschedule(*e);
+      return;
+    }
+    if (e->m_scheduled && e->m_deadline <= deadline) {
+      return; // visited before the new deadline, and rescheduled then
+    }
+    if (!e->m_scheduled) {
+      e->m_scheduled = true;
+      ++m_num_entries;
+    }
+    // rescheduled to an earlier deadline, the copy at the later deadline is now stale
+    e->m_deadline = deadline;
+    insert(e, deadline);
+    start_timer();
+  }
+
+  // called when the IO handler closes, the entry is never expired after this
+  void cancel(const timeout_entry_ptr& e) {
+    lg g(m_mutex);
+    e->m_cancelled = true;
+    unschedule(*e);
+  }
+
+  std::size_t num_entries() const {
+    lg g(m_mutex);
+    return m_num_entries;
+  }
+
+private:
+
+  tick_type elapsed_ticks() const {
+    return static_cast<tick_type>((clock::now() - m_start) / m_resolution);
+  }
+
+  static tick_type next_deadline(const timeout_entry& e, tick_type cur) noexcept {
+    tick_type deadline = no_deadline;
+    auto rd_tout = e.m_read_timeout.load(std::memory_order_relaxed);
+    if (rd_tout != 0u) {
+      deadline = e.m_last_read.load(std::memory_order_relaxed) - 1u + rd_tout;
+    }
+    auto wr_tout = e.m_write_timeout.load(std::memory_order_relaxed);
+    if (wr_tout != 0u) {
+      auto ws = e.m_write_start.load(std::memory_order_relaxed);
+      // with no write in progress, a write started now is the earliest that can stall
+      deadline = std::min(deadline, (ws != 0u ? ws - 1u : cur) + wr_tout);
+    }
+    return deadline;
+  }
+
+  void insert(const timeout_entry_ptr& e, tick_type deadline) {
+    tick_type delta = deadline > m_current ? std::min(deadline - m_current, max_range) : 0u;
+    tick_type pos = m_current + delta; // differs from the deadline when beyond the range
+    std::size_t level = 0u;
+    while (level + 1u < num_levels && delta >= (tick_type(1u) << (slot_bits * (level + 1u)))) {
+      ++level;
+    }
+    m_slots[level][(pos >> (slot_bits * level)) & (num_slots - 1u)].push_back(
+          slot_entry { e, deadline });
+  }
+
+  // move the entries of a higher level slot down, returns the slot index
+  std::size_t cascade(std::size_t level) {
+    std::size_t idx = (m_current >> (slot_bits * level)) & (num_slots - 1u);
+    slot entries;
+    std::swap(entries, m_slots[level][idx]);
+    for (auto& se : entries) {
+      insert(se.m_entry, se.m_deadline);
+    }
+    return idx;
+  }
+
+  // called under the lock, expiry callbacks only post to the IO handler executor
+  void process_tick() {
+    std::size_t idx = m_current & (num_slots - 1u);
+    if (idx == 0u) {
+      for (std::size_t level = 1u; level < num_levels && cascade(level) == 0u; ++level) { }
+    }
+    slot entries;
+    std::swap(entries, m_slots[0][idx]);
+    tick_type cur = m_current;
+    ++m_current;
+    for (auto& se : entries) {
+      visit(se, cur);
+    }
+  }
+
+  void visit(const slot_entry& se, tick_type cur) {
+    const auto& e = se.m_entry;
+    if (!e->m_scheduled || e->m_deadline != se.m_deadline) {
+      return; // stale copy
+    }
+    if (se.m_deadline > cur) { // deadline was beyond the wheel range
+      insert(e, se.m_deadline);
+      return;
+    }
+    std::error_code err;
+    tick_type deadline = no_deadline;
+    if (!e->m_cancelled) {
+      auto rd_tout = e->m_read_timeout.load(std::memory_order_relaxed);
+      auto wr_tout = e->m_write_timeout.load(std::memory_order_relaxed);
+      auto ws = e->m_write_start.load(std::memory_order_relaxed);
+      if (rd_tout != 0u && e->m_last_read.load(std::memory_order_relaxed) - 1u + rd_tout <= cur) {
+        err = std::make_error_code(net_ip_errc::io_read_timeout);
+      }
+      else if (wr_tout != 0u && ws != 0u && ws - 1u + wr_tout <= cur) {
+        err = std::make_error_code(net_ip_errc::io_write_timeout);
+      }
+      else {
+        deadline = next_deadline(*e, cur);
+      }
+    }
+    if (deadline == no_deadline) {
+      unschedule(*e);
+      if (err) {
+        e->m_expire_cb(err);
+      }
+      return;
+    }
+    e->m_deadline = deadline;
+    insert(e, deadline);
+  }
+
+  // copies of an unscheduled entry left in the wheel are stale; when nothing is scheduled
+  // the wheel is emptied and the timer stopped, so an idle wheel does not keep the IO 
+  // context busy
+  void unschedule(timeout_entry& e) {
+    if (!e.m_scheduled) {
+      return;
+    }
+    e.m_scheduled = false;
+    if (--m_num_entries != 0u) {
+      return;
+    }
+    for (auto& level : m_slots) {
+      for (auto& sl : level) {
+        sl.clear();
+      }
+    }
+    if (m_running) {
+      m_running = false;
+      m_timer.cancel();
+    }
+  }
+
+  void start_timer() {
+    if (m_running || m_num_entries == 0u) {
+      return;
+    }
+    m_running = true;
+    ++m_timer_gen;
+    m_timer.expires_at(m_start + m_resolution * m_current);
+    std::weak_ptr<timer_wheel> wp = weak_from_this();
+    m_timer.async_wait([wp, gen = m_timer_gen] (const std::error_code& err) {
+        auto sp = wp.lock();
+        if (err || !sp) {
+          return;
+        }
+        sp->handle_timer(gen);
+      }
+    );
+  }
+
+  // a wait that completed just before the timer was stopped (and possibly restarted)
+  // is ignored
+  void handle_timer(std::uint64_t gen) {
+    lg g(m_mutex);
+    if (gen != m_timer_gen || !m_running) {
+      return;
+    }
+    m_running = false;
+    auto elapsed = elapsed_ticks();
+    while (m_current <= elapsed && m_num_entries != 0u) {
+      process_tick();
+    }
+    if (m_num_entries == 0u) { // nothing scheduled, jump ahead when restarted
+      m_current = std::max(m_current, elapsed + 1u);
+    }
+    m_now.store(m_current - 1u, std::memory_order_relaxed);
+    start_timer();
+  }
+
+};
+
+using timer_wheel_ptr = std::shared_ptr<timer_wheel>;
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,114 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Cumulative traffic counters for TCP and UDP io handlers.
+ *
+ *  The counters are only updated from the IO thread (in read and write completion
+ *  handlers), so each update is a relaxed load and store of a @c std::atomic (no
+ *  read-modify-write instruction is needed with a single writer). Any thread can
+ *  take a snapshot of the counters, although the snapshot is not guaranteed to be
+ *  consistent across counters.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef TRAFFIC_COUNTERS_HPP_INCLUDED
+#define TRAFFIC_COUNTERS_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef> // std::size_t
+
+#include "net_ip/queue_stats.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+class traffic_counters {
+private:
+  std::atomic_size_t  m_bufs_sent;
+  std::atomic_size_t  m_bytes_sent;
+  std::atomic_size_t  m_writes;
+  std::atomic_size_t  m_msgs_received;
+  std::atomic_size_t  m_bytes_received;
+  std::atomic_size_t  m_reads;
+  std::atomic_size_t  m_read_batches;
+  std::atomic_size_t  m_msgs_in_read_batches;
+  std::atomic_size_t  m_max_read_batch_msgs;
+  std::atomic_size_t  m_truncated_msgs;
+  std::atomic_size_t  m_dropped_msgs;
+
+private:
+  static void add(std::atomic_size_t& cnt, std::size_t val) noexcept {
+    cnt.store(cnt.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+  }
+
+public:
+
+  traffic_counters() noexcept : m_bufs_sent(0u), m_bytes_sent(0u), m_writes(0u),
+    m_msgs_received(0u), m_bytes_received(0u), m_reads(0u), m_read_batches(0u),
+    m_msgs_in_read_batches(0u), m_max_read_batch_msgs(0u), m_truncated_msgs(0u),
+    m_dropped_msgs(0u) { }
+
+  // following methods only called from the IO thread
+  void count_write(std::size_t num_bufs, std::size_t num_bytes) noexcept {
+    add(m_writes, 1u);
+    add(m_bufs_sent, num_bufs);
+    add(m_bytes_sent, num_bytes);
+  }
+
+  void count_read(std::size_t num_bytes) noexcept {
+    add(m_reads, 1u);
+    add(m_bytes_received, num_bytes);
+  }
+
+  void count_msg() noexcept {
+    add(m_msgs_received, 1u);
+  }
+
+  void count_read_batch(std::size_t num_msgs, std::size_t num_truncated) noexcept {
+    add(m_read_batches, 1u);
+    add(m_msgs_in_read_batches, num_msgs);
+    if (num_msgs > m_max_read_batch_msgs.load(std::memory_order_relaxed)) {
+      m_max_read_batch_msgs.store(num_msgs, std::memory_order_relaxed);
+    }
+    add(m_truncated_msgs, num_truncated);
+  }
+
+  // the drop count is cumulative, as reported by the platform
+  void set_dropped_msgs(std::size_t num_dropped) noexcept {
+    m_dropped_msgs.store(num_dropped, std::memory_order_relaxed);
+  }
+
+  // can be called from any thread
+  void fill_stats(output_queue_stats& st) const noexcept {
+    st.total_bufs_sent = m_bufs_sent.load(std::memory_order_relaxed);
+    st.total_bytes_sent = m_bytes_sent.load(std::memory_order_relaxed);
+    st.total_writes = m_writes.load(std::memory_order_relaxed);
+    st.total_msgs_received = m_msgs_received.load(std::memory_order_relaxed);
+    st.total_bytes_received = m_bytes_received.load(std::memory_order_relaxed);
+    st.total_reads = m_reads.load(std::memory_order_relaxed);
+    st.num_read_batches = m_read_batches.load(std::memory_order_relaxed);
+    st.msgs_in_read_batches = m_msgs_in_read_batches.load(std::memory_order_relaxed);
+    st.max_read_batch_msgs = m_max_read_batch_msgs.load(std::memory_order_relaxed);
+    st.num_truncated_msgs = m_truncated_msgs.load(std::memory_order_relaxed);
+    st.num_dropped_msgs = m_dropped_msgs.load(std::memory_order_relaxed);
+  }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,241 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Batched, non-blocking UDP receive of multiple datagrams per system call.
+ *
+ *  On Linux @c udp_receive_batch uses @c recvmmsg(2) to read up to a batch of datagrams
+ *  with one system call, each into its own slot of a caller supplied buffer. Other POSIX
+ *  platforms call @c recvmsg once per datagram in a loop until no more are available,
+ *  which saves the per datagram completion handler dispatch but not the system calls.
+ *  Batched receives are not supported on Windows.
+ *
+ *  On Linux the @c SO_RXQ_OVFL socket option reports the number of datagrams dropped by
+ *  the kernel for the socket (e.g. receive buffer full) with each received datagram.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef UDP_BATCH_RECEIVE_HPP_INCLUDED
+#define UDP_BATCH_RECEIVE_HPP_INCLUDED
+
+#include "asio/ip/udp.hpp"
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint32_t
+#include <cstring> // std::memcpy
+#include <system_error>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cerrno>
+#endif
+
+namespace chops {
+namespace net {
+namespace detail {
+
+#ifndef _WIN32
+
+constexpr bool udp_batch_receive_supported = true;
+
+// asks the kernel to report the socket drop count with each datagram, where supported;
+// not being able to is not an error, the drop count is then never reported
+inline void enable_udp_drop_count(int sock) noexcept {
+#ifdef SO_RXQ_OVFL
+  int one = 1;
+  ::setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+#endif
+}
+
+// the message headers, sender endpoints and control buffers are set up once for a given
+// buffer, so a receive only resets the lengths the kernel writes back
+class udp_receive_batch {
+public:
+  using endpoint_type = asio::ip::udp::endpoint;
+
+private:
+  std::byte*                  m_bufs;
+  std::size_t                 m_max_size;
+  std::vector<endpoint_type>  m_senders;
+  std::vector<std::size_t>    m_sizes;
+  std::vector<::iovec>        m_iovs;
+#ifdef __linux__
+  std::vector<::mmsghdr>      m_hdrs;
+#else
+  std::vector<::msghdr>       m_hdrs;
+#endif
+  std::vector<std::byte>      m_ctrl;
+  std::size_t                 m_ctrl_size;
+  std::size_t                 m_num_truncated;
+  std::size_t                 m_kernel_drops;
+  bool                        m_drops_reported;
+
+private:
+  ::msghdr& hdr(std::size_t i) noexcept {
+#ifdef __linux__
+    return m_hdrs[i].msg_hdr;
+#else
+    return m_hdrs[i];
+#endif
+  }
+
+  // the kernel overwrites the address, control and flag fields on each receive
+  void reset_hdr(std::size_t i) noexcept {
+    auto& h = hdr(i);
+    h.msg_namelen = static_cast<::socklen_t>(m_senders[i].capacity());
+    h.msg_controllen = static_cast<decltype(h.msg_controllen)>(m_ctrl_size);
+    h.msg_flags = 0;
+  }
+
+  void finish_msg(std::size_t i, std::size_t len) {
+    auto& h = hdr(i);
+    m_senders[i].resize(h.msg_namelen);
+    m_sizes[i] = len;
+    if (h.msg_flags & MSG_TRUNC) {
+      ++m_num_truncated;
+    }
+#ifdef SO_RXQ_OVFL
+    for (auto* c = CMSG_FIRSTHDR(&h); c != nullptr; c = CMSG_NXTHDR(&h, c)) {
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+        std::uint32_t drops;
+        std::memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+        m_kernel_drops = drops;
+        m_drops_reported = true;
+      }
+    }
+#endif
+  }
+
+public:
+
+  udp_receive_batch() noexcept : m_bufs(nullptr), m_max_size(0u), m_senders(), m_sizes(),
+    m_iovs(), m_hdrs(), m_ctrl(), m_ctrl_size(0u), m_num_truncated(0u), m_kernel_drops(0u),
+    m_drops_reported(false) { }
+
+  // bufs must hold max_msgs slots of max_size bytes each, and stay valid while receiving
+  void setup(std::byte* bufs, std::size_t max_size, std::size_t max_msgs) {
+    m_bufs = bufs;
+    m_max_size = max_size;
+    m_senders.assign(max_msgs, endpoint_type());
+    m_sizes.assign(max_msgs, 0u);
+    m_iovs.assign(max_msgs, ::iovec());
+    m_hdrs.assign(max_msgs, typename decltype(m_hdrs)::value_type());
+#ifdef SO_RXQ_OVFL
+    m_ctrl_size = CMSG_SPACE(sizeof(std::uint32_t));
+#endif
+    m_ctrl.assign(max_msgs * m_ctrl_size, std::byte(0));
+    for (std::size_t i = 0u; i < max_msgs; ++i) {
+      m_iovs[i].iov_base = m_bufs + i * m_max_size;
+      m_iovs[i].iov_len = m_max_size;
+      auto& h = hdr(i);
+      h.msg_name = m_senders[i].data();
+      h.msg_iov = &m_iovs[i];
+      h.msg_iovlen = 1;
+      h.msg_control = m_ctrl_size == 0u ? nullptr : m_ctrl.data() + i * m_ctrl_size;
+    }
+  }
+
+  // receives up to a batch of datagrams without blocking, returning the number received;
+  // 0 with no error means no datagram was available
+  std::size_t receive(int sock, std::error_code& ec) {
+    m_num_truncated = 0u;
+    std::size_t n = 0u;
+#ifdef __linux__
+    for (std::size_t i = 0u; i < m_hdrs.size(); ++i) {
+      reset_hdr(i);
+    }
+    int r = ::recvmmsg(sock, m_hdrs.data(), static_cast<unsigned int>(m_hdrs.size()),
+                       MSG_DONTWAIT, nullptr);
+    if (r < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        ec = std::error_code(errno, std::system_category());
+      }
+      return 0u;
+    }
+    n = static_cast<std::size_t>(r);
+    for (std::size_t i = 0u; i < n; ++i) {
+      finish_msg(i, m_hdrs[i].msg_len);
+    }
+#else
+    for (; n < m_hdrs.size(); ++n) {
+      reset_hdr(n);
+      auto r = ::recvmsg(sock, &m_hdrs[n], MSG_DONTWAIT);
+      if (r < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && n == 0u) {
+          ec = std::error_code(errno, std::system_category());
+        }
+        break;
+      }
+      finish_msg(n, static_cast<std::size_t>(r));
+    }
+#endif
+    return n;
+  }
+
+  std::size_t max_msgs() const noexcept { return m_sizes.size(); }
+
+  // following are valid for the datagrams of the last receive
+  const std::byte* data(std::size_t i) const noexcept { return m_bufs + i * m_max_size; }
+  std::size_t size(std::size_t i) const noexcept { return m_sizes[i]; }
+  const endpoint_type& sender(std::size_t i) const noexcept { return m_senders[i]; }
+  std::size_t num_truncated() const noexcept { return m_num_truncated; }
+
+  // cumulative count of datagrams dropped by the kernel, false if never reported
+  bool kernel_drops(std::size_t& drops) const noexcept {
+    drops = m_kernel_drops;
+    return m_drops_reported;
+  }
+
+};
+
+#else
+
+constexpr bool udp_batch_receive_supported = false;
+
+template <typename S>
+void enable_udp_drop_count(S) noexcept { }
+
+class udp_receive_batch {
+public:
+  using endpoint_type = asio::ip::udp::endpoint;
+
+private:
+  endpoint_type m_endp;
+
+public:
+  void setup(std::byte*, std::size_t, std::size_t) { }
+
+  template <typename S>
+  std::size_t receive(S, std::error_code& ec) {
+    ec = std::make_error_code(std::errc::operation_not_supported);
+    return 0u;
+  }
+
+  std::size_t max_msgs() const noexcept { return 0u; }
+  const std::byte* data(std::size_t) const noexcept { return nullptr; }
+  std::size_t size(std::size_t) const noexcept { return 0u; }
+  const endpoint_type& sender(std::size_t) const noexcept { return m_endp; }
+  std::size_t num_truncated() const noexcept { return 0u; }
+  bool kernel_drops(std::size_t&) const noexcept { return false; }
+};
+
+#endif
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,278 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Batched, non-blocking UDP send of multiple datagrams per system call, with
+ *  optional UDP generic segmentation offload.
+ *
+ *  On Linux @c udp_send_batch uses @c sendmmsg(2) to send a batch of datagrams (possibly
+ *  to different destinations) with one system call. Runs of datagrams to the same
+ *  destination with the same size (the last one can be shorter) can also be sent as one
+ *  message with the @c UDP_SEGMENT control message (UDP GSO, Linux 4.18 and later), so
+ *  that the kernel (or the network card) splits it into datagrams, saving the per
+ *  datagram traversal of the network stack. Other POSIX platforms call @c sendmsg once
+ *  per datagram in a loop. Batched sends are not supported on Windows.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef UDP_BATCH_SEND_HPP_INCLUDED
+#define UDP_BATCH_SEND_HPP_INCLUDED
+
+#include "asio/ip/udp.hpp"
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint16_t
+#include <cstring> // std::memcpy
+#include <system_error>
+#include <vector>
+#include <utility> // std::pair
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <cerrno>
+#endif
+
+namespace chops {
+namespace net {
+namespace detail {
+
+#ifndef _WIN32
+
+constexpr bool udp_batch_send_supported = true;
+
+#if defined(__linux__) && defined(UDP_SEGMENT)
+constexpr bool udp_gso_supported = true;
+#else
+constexpr bool udp_gso_supported = false;
+#endif
+
+// a segmented message is limited by the kernel to 64 segments and by the IPv4 maximum
+// datagram payload
+constexpr std::size_t udp_gso_max_segments = 64u;
+constexpr std::size_t udp_gso_max_bytes = 65507u;
+
+// the datagrams reference the caller's buffers and endpoints, which must stay valid and
+// unmodified until the whole batch has been sent
+class udp_send_batch {
+public:
+  using endpoint_type = asio::ip::udp::endpoint;
+
+private:
+  struct dgram {
+    const std::byte*     m_data;
+    std::size_t          m_size;
+    const endpoint_type* m_endp;
+  };
+
+  std::vector<dgram>          m_dgrams;
+  std::vector<::iovec>        m_iovs;
+#ifdef __linux__
+  std::vector<::mmsghdr>      m_hdrs;
+#else
+  std::vector<::msghdr>       m_hdrs;
+#endif
+  // index of the first datagram of each message, plus the end index
+  std::vector<std::size_t>    m_first;
+  std::vector<std::byte>      m_ctrl;
+  std::size_t                 m_next_msg;
+  std::size_t                 m_num_segmented;
+
+private:
+  ::msghdr& hdr(std::size_t i) noexcept {
+#ifdef __linux__
+    return m_hdrs[i].msg_hdr;
+#else
+    return m_hdrs[i];
+#endif
+  }
+
+  bool is_segmented(std::size_t msg) const noexcept {
+    return m_first[msg + 1u] - m_first[msg] > 1u;
+  }
+
+  // a run continues while the datagrams go to the same destination with the size of the
+  // first, and includes one final shorter datagram
+  std::size_t segment_run(std::size_t beg, std::size_t max_segment_size) const noexcept {
+    auto seg = m_dgrams[beg].m_size;
+    if (max_segment_size == 0u || seg == 0u || seg > max_segment_size) {
+      return 1u;
+    }
+    std::size_t end = beg + 1u;
+    std::size_t total = seg;
+    while (end < m_dgrams.size() && end - beg < udp_gso_max_segments) {
+      const auto& d = m_dgrams[end];
+      if (d.m_size == 0u || d.m_size > seg || total + d.m_size > udp_gso_max_bytes ||
+          !(*d.m_endp == *m_dgrams[beg].m_endp)) {
+        break;
+      }
+      total += d.m_size;
+      ++end;
+      if (d.m_size < seg) {
+        break;
+      }
+    }
+    return end - beg;
+  }
+
+  // groups the datagrams from beg into messages, all of the storage is sized before any
+  // pointers into it are taken
+  void prepare_from(std::size_t beg, std::size_t max_segment_size) {
+    m_first.clear();
+    for (std::size_t i = beg; i < m_dgrams.size(); i += segment_run(i, max_segment_size)) {
+      m_first.push_back(i);
+    }
+    m_first.push_back(m_dgrams.size());
+    std::size_t num_msgs = m_first.size() - 1u;
+    m_iovs.resize(m_dgrams.size());
+    m_hdrs.assign(num_msgs, typename decltype(m_hdrs)::value_type());
+    std::size_t ctrl_size = 0u;
+#if defined(__linux__) && defined(UDP_SEGMENT)
+    ctrl_size = CMSG_SPACE(sizeof(std::uint16_t));
+#endif
+    m_ctrl.assign(num_msgs * ctrl_size, std::byte(0));
+    m_num_segmented = 0u;
+    for (std::size_t m = 0u; m < num_msgs; ++m) {
+      auto& h = hdr(m);
+      const auto& first = m_dgrams[m_first[m]];
+      h.msg_name = const_cast<void*>(static_cast<const void*>(first.m_endp->data()));
+      h.msg_namelen = static_cast<::socklen_t>(first.m_endp->size());
+      for (std::size_t i = m_first[m]; i < m_first[m + 1u]; ++i) {
+        m_iovs[i].iov_base = const_cast<std::byte*>(m_dgrams[i].m_data);
+        m_iovs[i].iov_len = m_dgrams[i].m_size;
+      }
+      h.msg_iov = &m_iovs[m_first[m]];
+      h.msg_iovlen = static_cast<decltype(h.msg_iovlen)>(m_first[m + 1u] - m_first[m]);
+#if defined(__linux__) && defined(UDP_SEGMENT)
+      if (is_segmented(m)) {
+        h.msg_control = m_ctrl.data() + m * ctrl_size;
+        h.msg_controllen = static_cast<decltype(h.msg_controllen)>(ctrl_size);
+        auto* c = CMSG_FIRSTHDR(&h);
+        c->cmsg_level = SOL_UDP;
+        c->cmsg_type = UDP_SEGMENT;
+        c->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+        auto seg = static_cast<std::uint16_t>(first.m_size);
+        std::memcpy(CMSG_DATA(c), &seg, sizeof(seg));
+        ++m_num_segmented;
+      }
+#endif
+    }
+    m_next_msg = 0u;
+  }
+
+public:
+
+  udp_send_batch() noexcept : m_dgrams(), m_iovs(), m_hdrs(), m_first(), m_ctrl(),
+    m_next_msg(0u), m_num_segmented(0u) { }
+
+  void clear() noexcept {
+    m_dgrams.clear();
+    m_first.clear();
+    m_next_msg = 0u;
+  }
+
+  void add(const void* data, std::size_t sz, const endpoint_type& endp) {
+    m_dgrams.push_back(dgram { static_cast<const std::byte*>(data), sz, &endp });
+  }
+
+  // a max segment size of 0 sends every datagram as its own message, otherwise runs of
+  // datagrams no larger than the max segment size are sent as segmented messages
+  void prepare(std::size_t max_segment_size) {
+    prepare_from(0u, udp_gso_supported ? max_segment_size : 0u);
+  }
+
+  bool done() const noexcept { return m_next_msg + 1u >= m_first.size(); }
+
+  // number of datagrams sent so far, these are the first datagrams added to the batch; 
+  // after a send error the datagrams from here on were not sent
+  std::size_t num_sent() const noexcept { return m_first.empty() ? 0u : m_first[m_next_msg]; }
+
+  // number of segmented messages in the batch, for statistics
+  std::size_t num_segmented() const noexcept { return m_num_segmented; }
+
+  // sends as many of the remaining messages as the socket takes without blocking,
+  // returning the number of datagrams and bytes sent; 0 datagrams with no error means
+  // the send is to be retried once the socket is writable
+  std::pair<std::size_t, std::size_t> send(int sock, std::error_code& ec) {
+    std::size_t beg = m_first[m_next_msg];
+#ifdef __linux__
+    int r = ::sendmmsg(sock, &m_hdrs[m_next_msg],
+                       static_cast<unsigned int>(m_hdrs.size() - m_next_msg), MSG_DONTWAIT);
+    if (r < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return { 0u, 0u };
+      }
+      // segmentation is refused for a segment size above the path MTU, or by a kernel
+      // without UDP GSO, so the rest of the batch is sent without it
+      if (is_segmented(m_next_msg) && (errno == EINVAL || errno == EIO || errno == ENOPROTOOPT)) {
+        prepare_from(beg, 0u);
+        return { 0u, 0u };
+      }
+      ec = std::error_code(errno, std::system_category());
+      return { 0u, 0u };
+    }
+    m_next_msg += static_cast<std::size_t>(r);
+#else
+    for (; m_next_msg + 1u < m_first.size(); ++m_next_msg) {
+      if (::sendmsg(sock, &m_hdrs[m_next_msg], MSG_DONTWAIT) < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+            m_first[m_next_msg] == beg) {
+          ec = std::error_code(errno, std::system_category());
+        }
+        break;
+      }
+    }
+#endif
+    std::size_t end = m_first[m_next_msg];
+    std::size_t num_bytes = 0u;
+    for (std::size_t i = beg; i < end; ++i) {
+      num_bytes += m_dgrams[i].m_size;
+    }
+    return { end - beg, num_bytes };
+  }
+
+};
+
+#else
+
+constexpr bool udp_batch_send_supported = false;
+constexpr bool udp_gso_supported = false;
+
+class udp_send_batch {
+public:
+  using endpoint_type = asio::ip::udp::endpoint;
+
+  void clear() noexcept { }
+  void add(const void*, std::size_t, const endpoint_type&) { }
+  void prepare(std::size_t) { }
+  bool done() const noexcept { return true; }
+  std::size_t num_sent() const noexcept { return 0u; }
+  std::size_t num_segmented() const noexcept { return 0u; }
+
+  template <typename S>
+  std::pair<std::size_t, std::size_t> send(S, std::error_code& ec) {
+    ec = std::make_error_code(std::errc::operation_not_supported);
+    return { 0u, 0u };
+  }
+};
+
+#endif
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -20,7 +20,10 @@
 
 #include "asio/io_context.hpp"
 #include "asio/post.hpp"
+#include "asio/dispatch.hpp"
+#include "asio/strand.hpp"
 #include "asio/ip/udp.hpp"
+#include "asio/ip/multicast.hpp"
 #include "asio/buffer.hpp"
 
 #include <memory> // std::shared_ptr, std::enable_shared_from_this
@@ -30,12 +33,22 @@
 #include <utility> // std::forward, std::move
 #include <functional> // std::function
 #include <future>
+#include <vector>
+#include <optional>
+#include <atomic>
 
 #include "net_ip/detail/io_common.hpp"
 #include "net_ip/detail/net_entity_common.hpp"
+#include "net_ip/detail/traffic_counters.hpp"
+#include "net_ip/detail/send_buffer.hpp"
+#include "net_ip/detail/read_buffer_pool.hpp"
+#include "net_ip/detail/udp_batch_receive.hpp"
+#include "net_ip/detail/udp_batch_send.hpp"
+#include "net_ip/detail/socket_options.hpp"
 
 #include "net_ip/queue_stats.hpp"
 #include "net_ip/net_ip_error.hpp"
+#include "net_ip/udp_multicast_config.hpp"
 
 #include "net_ip/basic_io_output.hpp"
 #include "net_ip/endpoints_resolver.hpp"
@@ -49,13 +62,18 @@ namespace chops {
 namespace net {
 namespace detail {
 
+// as with tcp_queue_element, the completion handler is only allocated for 
+// send_with_completion
 struct udp_queue_element {
-  const_shared_buffer     m_buf;
+  send_buffer             m_buf;
   asio::ip::udp::endpoint m_endp;
+  std::shared_ptr<const send_completion_handler> m_completion;
 
-  udp_queue_element (const const_shared_buffer& buf,
-                     const asio::ip::udp::endpoint& endp) noexcept : 
-        m_buf(buf), m_endp(endp) { }
+  udp_queue_element (const send_buffer& buf,
+                     const asio::ip::udp::endpoint& endp,
+                     std::shared_ptr<const send_completion_handler> completion = 
+                          std::shared_ptr<const send_completion_handler>()) noexcept : 
+        m_buf(buf), m_endp(endp), m_completion(std::move(completion)) { }
 
   std::size_t size() const noexcept {
     return m_buf.size();
@@ -66,13 +84,15 @@ struct udp_queue_element {
 class udp_entity_io : public std::enable_shared_from_this<udp_entity_io> {
 public:
   using endpoint_type = asio::ip::udp::endpoint;
+  using water_mark_cb = std::function<void (basic_io_output<udp_entity_io>, bool)>;
 
 private:
   using byte_vec = chops::mutable_shared_buffer::byte_vec;
 
 private:
 
-  io_common<udp_queue_element>      m_io_common;
+  io_common_type<udp_queue_element> m_io_common;
+  traffic_counters                  m_counters;
   net_entity_common<udp_entity_io>  m_entity_common;
   asio::io_context&                 m_ioc;
   asio::ip::udp::socket             m_socket;
@@ -82,31 +102,58 @@ private:
   std::string                       m_local_intf;
   bool                              m_shutting_down;
 
-  // TODO: multicast stuff
+  // present for multicast receivers and senders, applied when the entity is started
+  std::optional<udp_multicast_config> m_mcast_config;
 
   // following members could be passed through handler, but are members for 
-  // simplicity and less copying
+  // simplicity and less copying; with a read buffer pool, m_byte_vec is borrowed from
+  // the pool while IO is started
+  read_buffer_pool_ptr              m_read_buf_pool;
   byte_vec                          m_byte_vec;
+  std::atomic_size_t                m_read_buf_bytes;
   endpoint_type                     m_sender_endp;
+  // with batched receives, m_byte_vec holds a slot of the maximum datagram size for
+  // each datagram of a batch
+  std::atomic_size_t                m_rcv_batch_size;
+  udp_receive_batch                 m_rcv_batch;
+
+  // the elements being written are kept here until the write completes, which keeps the
+  // buffers alive and holds the completion handlers, if any; more than one element is 
+  // written when write batching is enabled
+  std::vector<udp_queue_element>    m_write_elems;
+  udp_send_batch                    m_send_batch;
+  std::atomic_size_t                m_max_segment_size;
+  struct write_completion {
+    std::shared_ptr<const send_completion_handler> m_completion;
+    std::size_t                                    m_num_bytes;
+    bool                                           m_sent;
+  };
+  std::vector<write_completion>     m_write_completions;
 
 public:
 
   udp_entity_io(asio::io_context& ioc, 
-                const endpoint_type& local_endp) noexcept : 
-    m_io_common(), m_entity_common(), m_ioc(ioc),
-    m_socket(ioc), m_local_endp(local_endp), m_default_dest_endp(), 
+                const endpoint_type& local_endp,
+                read_buffer_pool_ptr pool = read_buffer_pool_ptr()) noexcept : 
+    m_io_common(), m_counters(), m_entity_common(), m_ioc(ioc),
+    m_socket(asio::make_strand(ioc)), m_local_endp(local_endp), m_default_dest_endp(), 
     m_local_port_or_service(), m_local_intf(),
-    m_shutting_down(false),
-    m_byte_vec(), m_sender_endp() 
+    m_shutting_down(false), m_mcast_config(),
+    m_read_buf_pool(std::move(pool)), m_byte_vec(), m_read_buf_bytes(0u),
+    m_sender_endp(), m_rcv_batch_size(0u), m_rcv_batch(), 
+    m_write_elems(), m_send_batch(), m_max_segment_size(0u), m_write_completions()
     { }
 
   udp_entity_io(asio::io_context& ioc, 
-                std::string_view local_port_or_service, std::string_view local_intf) noexcept :
-    m_io_common(), m_entity_common(), m_ioc(ioc),
-    m_socket(ioc), m_local_endp(), m_default_dest_endp(), 
+                std::string_view local_port_or_service, std::string_view local_intf,
+                read_buffer_pool_ptr pool = read_buffer_pool_ptr()) noexcept :
+    m_io_common(), m_counters(), m_entity_common(), m_ioc(ioc),
+    m_socket(asio::make_strand(ioc)), m_local_endp(), m_default_dest_endp(), 
     m_local_port_or_service(local_port_or_service), m_local_intf(local_intf),
-    m_shutting_down(false),
-    m_byte_vec(), m_sender_endp() 
+    m_shutting_down(false), m_mcast_config(),
+    m_read_buf_pool(std::move(pool)), m_byte_vec(), m_read_buf_bytes(0u),
+    m_sender_endp(), m_rcv_batch_size(0u), m_rcv_batch(), 
+    m_write_elems(), m_send_batch(), m_max_segment_size(0u), m_write_completions()
     { }
 
 private:
@@ -150,7 +197,57 @@ public:
   }
 
   output_queue_stats get_output_queue_stats() const noexcept {
-    return m_io_common.get_output_queue_stats();
+    auto st = m_io_common.get_output_queue_stats();
+    m_counters.fill_stats(st);
+    st.read_buffer_bytes = m_read_buf_bytes.load(std::memory_order_relaxed);
+    return st;
+  }
+
+  // batches of queued datagrams are sent with one system call where supported, otherwise
+  // every datagram is sent on its own
+  void set_write_batch_limits(std::size_t max_bufs, std::size_t max_bytes) noexcept {
+    m_io_common.set_write_batch_limits(udp_batch_send_supported ? max_bufs : 1u, max_bytes);
+  }
+
+  // a max segment size of 0 (the default) disables segmentation offload, otherwise runs
+  // of datagrams in a write batch that go to the same destination with the same size (up
+  // to the max segment size) are sent as one segmented message
+  std::error_code set_segmentation_offload(std::size_t max_segment_size) noexcept {
+    if (max_segment_size != 0u && !udp_gso_supported) {
+      return std::make_error_code(std::errc::operation_not_supported);
+    }
+    m_max_segment_size.store(max_segment_size, std::memory_order_relaxed);
+    return { };
+  }
+
+  void set_output_queue_limit(std::size_t max_bufs, queue_overflow_policy policy) {
+    m_io_common.set_output_queue_limit(max_bufs, policy);
+  }
+
+  // crossings are detected in io_common, possibly in a sending thread, so the check
+  // and callback are posted to the IO thread
+  template <typename F>
+  void set_output_queue_water_marks(const output_queue_water_marks& wm, F&& func) {
+    auto cb = std::make_shared<water_mark_cb>(std::forward<F>(func));
+    if (!*cb) {
+      m_io_common.set_water_marks(wm, std::function<void ()> { });
+      return;
+    }
+    auto wp = weak_from_this();
+    m_io_common.set_water_marks(wm, [wp, cb, ex = m_socket.get_executor()] () {
+        asio::post(ex, [wp, cb] () {
+            auto sp = wp.lock();
+            if (!sp) {
+              return;
+            }
+            auto st = sp->m_io_common.check_water_marks();
+            if (st) {
+              (*cb)(basic_io_output<udp_entity_io>(wp), *st);
+            }
+          }
+        );
+      }
+    );
   }
 
   template <typename F1, typename F2>
@@ -161,6 +258,38 @@ public:
              [this, self] () { return do_start(); } );
   }
 
+  // a batch size of 0 or 1 (the default) receives one datagram per read completion,
+  // otherwise up to this many datagrams are received per socket readiness; used by the
+  // next start_io
+  std::error_code set_receive_batch_size(std::size_t max_msgs) noexcept {
+    if (max_msgs > 1u && !udp_batch_receive_supported) {
+      return std::make_error_code(std::errc::operation_not_supported);
+    }
+    m_rcv_batch_size.store(max_msgs, std::memory_order_relaxed);
+    return { };
+  }
+
+  // called by net_ip before the entity is returned to the application
+  void set_multicast_config(const udp_multicast_config& cfg) {
+    m_mcast_config = cfg;
+    if (udp_batch_receive_supported) {
+      m_rcv_batch_size.store(cfg.receive_batch_size, std::memory_order_relaxed);
+    }
+  }
+
+  // as with visit_socket, the socket option is set directly; groups joined here are not
+  // rejoined if the entity is stopped and started again, groups in the config are
+  std::error_code join_multicast_group(const multicast_group& grp) {
+    return change_membership(grp, true);
+  }
+
+  std::error_code leave_multicast_group(const multicast_group& grp) {
+    return change_membership(grp, false);
+  }
+
+  // start_io, stop_io and send can be called from any thread, while every handler runs
+  // on the socket strand, so the reads, writes and close are dispatched to the strand
+  // (run directly if already on it)
   template <typename MH>
   bool start_io(std::size_t max_size, MH&& msg_handler) {
     if (!m_io_common.set_io_started()) { // concurrency protected
@@ -169,10 +298,9 @@ public:
     if (m_local_endp == endpoint_type()) { // mismatch between start_io and initialized UDP entity
       return false;
     }
-    m_byte_vec.resize(max_size);
 // std::cerr << "Inside start_io AAA, ready to start read, buf resized to: " << max_size << 
 // ", local endp: " << m_local_endp << ", default dest endp: " << m_default_dest_endp << std::endl;
-    start_read(std::forward<MH>(msg_handler));
+    dispatch_start_reads(max_size, std::forward<MH>(msg_handler));
     return true;
   }
 
@@ -185,10 +313,9 @@ public:
       return false;
     }
     m_default_dest_endp = endp;
-    m_byte_vec.resize(max_size);
 // std::cerr << "Inside start_io BBB, ready to start read, buf resized to: " << max_size << 
 // ", local endp: " << m_local_endp << ", default dest endp: " << m_default_dest_endp << std::endl;
-    start_read(std::forward<MH>(msg_handler));
+    dispatch_start_reads(max_size, std::forward<MH>(msg_handler));
     return true;
   }
 
@@ -214,7 +341,11 @@ public:
   bool stop_io() {
     // handle start_io never called - close the open socket, etc
     bool ret = !m_io_common.is_io_started();
-    close(std::make_error_code(net_ip_errc::udp_io_handler_stopped));
+    auto self { shared_from_this() };
+    asio::dispatch(m_socket.get_executor(), [this, self] () {
+        close(std::make_error_code(net_ip_errc::udp_io_handler_stopped));
+      }
+    );
     return ret;
   }
 
@@ -229,24 +360,103 @@ public:
   }
 
   // io_common has concurrency protection
-  bool send(const chops::const_shared_buffer& buf) {
+  send_result send(const chops::const_shared_buffer& buf) {
     return send(buf, m_default_dest_endp);
   }
 
-  bool send(const chops::const_shared_buffer& buf, const endpoint_type& endp) {
-    if (endp == endpoint_type()) { // mismatch between start_io and send
-      return false;
+  send_result send(const chops::const_shared_buffer& buf, const endpoint_type& endp) {
+    return send_elem(udp_queue_element(buf, endp));
+  }
+
+  send_result send_with_completion(const chops::const_shared_buffer& buf, 
+                                   send_completion_handler completion) {
+    return send_with_completion(buf, m_default_dest_endp, std::move(completion));
+  }
+
+  send_result send_with_completion(const chops::const_shared_buffer& buf, const endpoint_type& endp,
+                                   send_completion_handler completion) {
+    return send_elem(udp_queue_element(buf, endp,
+          std::make_shared<const send_completion_handler>(std::move(completion))));
+  }
+
+  send_result send_no_copy(const void* buf, std::size_t sz, buffer_release_hook release) {
+    return send_no_copy(buf, sz, m_default_dest_endp, std::move(release));
+  }
+
+  send_result send_no_copy(const void* buf, std::size_t sz, const endpoint_type& endp,
+                           buffer_release_hook release) {
+    return send_elem(udp_queue_element(send_buffer(buf, sz, std::move(release)), endp));
+  }
+
+private:
+
+  send_result send_elem(const udp_queue_element& elem) {
+    if (elem.m_endp == endpoint_type()) { // mismatch between start_io and send
+      return send_result();
     }
-    auto ret = m_io_common.start_write(udp_queue_element(buf, endp), 
+    auto ret = m_io_common.start_write(elem, 
         [this] (const udp_queue_element& e) {
-          start_write(e);
+          auto self { shared_from_this() };
+          asio::dispatch(m_socket.get_executor(), [this, self, e] () { start_write(e); } );
         }
       );
-    return ret != io_common<udp_queue_element>::write_status::io_stopped;
+    if (ret == send_result::overflow_closed) {
+      // send can be called from any thread, so close through the executor
+      auto self { shared_from_this() };
+      asio::post(m_socket.get_executor(), [this, self] () { 
+        close(std::make_error_code(net_ip_errc::output_queue_overflow)); } );
+    }
+    return send_result(ret);
   }
 
 private:
 
+  void size_read_buf(std::size_t sz) {
+    if (m_read_buf_pool && m_byte_vec.capacity() == 0u) {
+      m_byte_vec = m_read_buf_pool->acquire(sz);
+    }
+    else {
+      m_byte_vec.resize(sz);
+    }
+    m_read_buf_bytes.store(m_byte_vec.capacity(), std::memory_order_relaxed);
+  }
+
+  // a read is always outstanding while IO is started, so the read buffer is returned
+  // when the read handler is done with it
+  void release_read_buf() {
+    if (m_read_buf_pool) {
+      m_read_buf_pool->release(std::move(m_byte_vec));
+      m_byte_vec = byte_vec();
+      m_read_buf_bytes.store(0u, std::memory_order_relaxed);
+    }
+  }
+
+  template <typename MH>
+  void dispatch_start_reads(std::size_t max_size, MH&& msg_handler) {
+    auto self { shared_from_this() };
+    asio::dispatch(m_socket.get_executor(), [this, self, max_size, 
+                     msg_hdlr = std::move(msg_handler)] () mutable {
+        if (m_io_common.is_io_started()) { // not stopped before the dispatch ran
+          start_reads(max_size, std::move(msg_hdlr));
+        }
+      }
+    );
+  }
+
+  template <typename MH>
+  void start_reads(std::size_t max_size, MH&& msg_hdlr) {
+    auto batch_size = m_rcv_batch_size.load(std::memory_order_relaxed);
+    if (batch_size > 1u) {
+      size_read_buf(batch_size * max_size);
+      m_rcv_batch.setup(m_byte_vec.data(), max_size, batch_size);
+      enable_udp_drop_count(m_socket.native_handle());
+      start_batch_read(std::forward<MH>(msg_hdlr));
+      return;
+    }
+    size_read_buf(max_size);
+    start_read(std::forward<MH>(msg_hdlr));
+  }
+
   template <typename MH>
   void start_read(MH&& msg_hdlr) {
     auto self { shared_from_this() };
@@ -263,10 +473,34 @@ private:
   template <typename MH>
   void handle_read(const std::error_code&, std::size_t, MH&&);
 
+  // waits for the socket to be readable, then receives the whole batch without blocking
+  template <typename MH>
+  void start_batch_read(MH&& msg_hdlr) {
+    auto self { shared_from_this() };
+    m_socket.async_wait(asio::ip::udp::socket::wait_read,
+                [this, self, msg_hdlr = std::move(msg_hdlr)] 
+                  (const std::error_code& err) mutable {
+        handle_batch_read(err, std::move(msg_hdlr));
+      }
+    );
+  }
+
+  template <typename MH>
+  void handle_batch_read(const std::error_code&, MH&&);
+
   void start_write(const udp_queue_element&);
 
+  void start_writes();
+
   void handle_write(const std::error_code&, std::size_t);
 
+  // waits for the socket to be writable, then sends as much of the batch as it takes
+  void start_batch_write();
+
+  void handle_batch_write(const std::error_code&);
+
+  void finish_write(const std::error_code&, std::size_t);
+
 private:
 
   std::error_code do_start() {
@@ -278,6 +512,17 @@ private:
         return ret.error();
       }
       m_local_endp = ret->cbegin()->endpoint();
+      // a passive resolve can return both IPv4 and IPv6 endpoints, a multicast receiver
+      // binds one of the same IP version as its groups
+      if (m_mcast_config && !m_mcast_config->groups.empty()) {
+        bool v6 = m_mcast_config->groups.front().group.is_v6();
+        for (const auto& e : *ret) {
+          if (e.endpoint().address().is_v6() == v6) {
+            m_local_endp = e.endpoint();
+            break;
+          }
+        }
+      }
       m_local_port_or_service.clear();
       m_local_port_or_service.shrink_to_fit();
       m_local_intf.clear();
@@ -289,6 +534,13 @@ private:
       close(ec);
       return ec;
     }
+    if (m_mcast_config) {
+      ec = set_multicast_reuse();
+      if (ec) {
+        close(ec);
+        return ec;
+      }
+    }
     if (m_local_endp != endpoint_type()) { // local bind needed
       m_socket.bind(m_local_endp, ec);
       if (ec) {
@@ -296,10 +548,87 @@ private:
         return ec;
       }
     }
+    if (m_mcast_config) {
+      ec = set_multicast_options();
+      if (ec) {
+        close(ec);
+        return ec;
+      }
+    }
     m_entity_common.call_io_state_chg_cb(shared_from_this(), 1, true);
     return { };
   }
 
+  // must be set before the bind; SO_REUSEPORT is skipped where not supported
+  std::error_code set_multicast_reuse() {
+    std::error_code ec;
+    m_socket.set_option(asio::socket_base::reuse_address(m_mcast_config->reuse_addr), ec);
+    if (!ec && reuse_port_supported) {
+      ec = set_reuse_port(m_socket, m_mcast_config->reuse_port);
+    }
+    return ec;
+  }
+
+  // asio selects the IPv4 or IPv6 option level from the socket protocol
+  std::error_code set_multicast_options() {
+    const auto& cfg = *m_mcast_config;
+    std::error_code ec;
+    if (cfg.hops >= 0) {
+      m_socket.set_option(asio::ip::multicast::hops(cfg.hops), ec);
+      if (ec) {
+        return ec;
+      }
+    }
+    m_socket.set_option(asio::ip::multicast::enable_loopback(cfg.loopback), ec);
+    if (ec) {
+      return ec;
+    }
+    if (cfg.outbound_intf.is_v4() && !cfg.outbound_intf.is_unspecified()) {
+      m_socket.set_option(asio::ip::multicast::outbound_interface(cfg.outbound_intf.to_v4()), ec);
+    }
+    else if (cfg.outbound_intf_index != 0u) {
+      m_socket.set_option(asio::ip::multicast::outbound_interface(cfg.outbound_intf_index), ec);
+    }
+    if (ec) {
+      return ec;
+    }
+    if (!cfg.groups.empty()) {
+      set_multicast_all(m_socket, m_local_endp.address().is_v6(), false);
+    }
+    for (const auto& grp : cfg.groups) {
+      ec = change_membership(grp, true);
+      if (ec) {
+        return ec;
+      }
+    }
+    return ec;
+  }
+
+  std::error_code change_membership(const multicast_group& grp, bool join) {
+    if (!m_socket.is_open()) {
+      return std::make_error_code(net_ip_errc::udp_entity_stopped);
+    }
+    std::error_code ec;
+    if (grp.group.is_v4()) {
+      auto intf = grp.intf.is_v4() ? grp.intf.to_v4() : asio::ip::address_v4::any();
+      if (join) {
+        m_socket.set_option(asio::ip::multicast::join_group(grp.group.to_v4(), intf), ec);
+      }
+      else {
+        m_socket.set_option(asio::ip::multicast::leave_group(grp.group.to_v4(), intf), ec);
+      }
+    }
+    else {
+      if (join) {
+        m_socket.set_option(asio::ip::multicast::join_group(grp.group.to_v6(), grp.intf_index), ec);
+      }
+      else {
+        m_socket.set_option(asio::ip::multicast::leave_group(grp.group.to_v6(), grp.intf_index), ec);
+      }
+    }
+    return ec;
+  }
+
   void close(const std::error_code& err) {
     auto self { shared_from_this() };
     m_entity_common.call_error_cb(self, err);
@@ -325,37 +654,146 @@ void udp_entity_io::handle_read(const std::error_code& err,
                                 std::size_t num_bytes, MH&& msg_hdlr) {
 
   if (err) {
+    release_read_buf();
     close(err);
     return;
   }
+  m_counters.count_read(num_bytes);
+  m_counters.count_msg();
   if (!msg_hdlr(asio::const_buffer(m_byte_vec.data(), num_bytes), 
                 basic_io_output<udp_entity_io>(weak_from_this()), m_sender_endp)) {
     // message handler not happy, tear everything down
+    release_read_buf();
     close(std::make_error_code(net_ip_errc::message_handler_terminated));
     return;
   }
   start_read(std::forward<MH>(msg_hdlr));
 }
 
+template <typename MH>
+void udp_entity_io::handle_batch_read(const std::error_code& err, MH&& msg_hdlr) {
+
+  std::error_code ec(err);
+  std::size_t num_msgs = 0u;
+  if (!ec) {
+    num_msgs = m_rcv_batch.receive(m_socket.native_handle(), ec);
+  }
+  if (ec) {
+    release_read_buf();
+    close(ec);
+    return;
+  }
+  if (num_msgs != 0u) { // readiness without a datagram is possible, the wait is restarted
+    std::size_t num_bytes = 0u;
+    for (std::size_t i = 0u; i < num_msgs; ++i) {
+      num_bytes += m_rcv_batch.size(i);
+    }
+    m_counters.count_read(num_bytes);
+    m_counters.count_read_batch(num_msgs, m_rcv_batch.num_truncated());
+    std::size_t drops;
+    if (m_rcv_batch.kernel_drops(drops)) {
+      m_counters.set_dropped_msgs(drops);
+    }
+  }
+  for (std::size_t i = 0u; i < num_msgs; ++i) {
+    m_counters.count_msg();
+    if (!msg_hdlr(asio::const_buffer(m_rcv_batch.data(i), m_rcv_batch.size(i)), 
+                  basic_io_output<udp_entity_io>(weak_from_this()), m_rcv_batch.sender(i))) {
+      // remaining datagrams of the batch are discarded
+      release_read_buf();
+      close(std::make_error_code(net_ip_errc::message_handler_terminated));
+      return;
+    }
+  }
+  start_batch_read(std::forward<MH>(msg_hdlr));
+}
+
 inline void udp_entity_io::start_write(const udp_queue_element& e) {
-  auto self { shared_from_this() };
 // if (e.m_endp == asio::ip::udp::endpoint()) {
 // std::cerr << "Ack! Empty endpoint in UDP write" << std::endl;
 // }
-  m_socket.async_send_to(asio::const_buffer(e.m_buf.data(), e.m_buf.size()), e.m_endp,
-            [this, self] (const std::error_code& err, std::size_t nb) {
-      handle_write(err, nb);
+  m_write_elems.clear();
+  m_write_elems.push_back(e);
+  start_writes();
+}
+
+inline void udp_entity_io::start_writes() {
+  auto self { shared_from_this() };
+  if (m_write_elems.size() == 1u) {
+    const auto& e = m_write_elems.front();
+    m_socket.async_send_to(asio::const_buffer(e.m_buf.data(), e.m_buf.size()), e.m_endp,
+              [this, self] (const std::error_code& err, std::size_t nb) {
+        handle_write(err, nb);
+      }
+    );
+    return;
+  }
+  m_send_batch.clear();
+  for (const auto& e : m_write_elems) {
+    m_send_batch.add(e.m_buf.data(), e.m_buf.size(), e.m_endp);
+  }
+  m_send_batch.prepare(m_max_segment_size.load(std::memory_order_relaxed));
+  start_batch_write();
+}
+
+inline void udp_entity_io::handle_write(const std::error_code& err, std::size_t num_bytes) {
+  if (!err) {
+    m_counters.count_write(1u, num_bytes);
+  }
+  finish_write(err, err ? 0u : 1u);
+}
+
+inline void udp_entity_io::start_batch_write() {
+  auto self { shared_from_this() };
+  m_socket.async_wait(asio::ip::udp::socket::wait_write,
+            [this, self] (const std::error_code& err) {
+      handle_batch_write(err);
     }
   );
 }
 
-inline void udp_entity_io::handle_write(const std::error_code& err, std::size_t /* num_bytes */) {
+inline void udp_entity_io::handle_batch_write(const std::error_code& err) {
+  std::error_code ec(err);
+  if (!ec) {
+    auto sent = m_send_batch.send(m_socket.native_handle(), ec);
+    if (sent.first != 0u) {
+      m_counters.count_write(sent.first, sent.second);
+    }
+    if (!ec && !m_send_batch.done()) { // socket send buffer full
+      start_batch_write();
+      return;
+    }
+  }
+  finish_write(ec, m_send_batch.num_sent());
+}
+
+// completion handlers are called after the buffers have been released; the first 
+// num_sent elements were sent, even if a later datagram of a batch failed
+inline void udp_entity_io::finish_write(const std::error_code& err, std::size_t num_sent) {
   if (err) {
+    // io_common is still called after the close, ending the write cycle
     close(err);
-    return;
   }
-  m_io_common.write_next_elem([this] (const udp_queue_element& e) {
-      start_write(e);
+  for (std::size_t i = 0u; i < m_write_elems.size(); ++i) {
+    auto& e = m_write_elems[i];
+    if (e.m_completion) {
+      m_write_completions.push_back(write_completion { std::move(e.m_completion), e.size(), 
+                                                       i < num_sent });
+    }
+  }
+  m_write_elems.clear();
+  for (const auto& c : m_write_completions) {
+    if (c.m_sent) {
+      (*c.m_completion)(std::error_code(), c.m_num_bytes);
+    }
+    else {
+      (*c.m_completion)(err, 0u);
+    }
+  }
+  m_write_completions.clear();
+  m_io_common.write_next_elems(m_write_elems, 
+        [this] (std::vector<udp_queue_element>&) {
+      start_writes();
     }
   );
 }
@@ -0,0 +1,147 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Function object class template for TCP message framing where the header has
+ *  a fixed size and contains an integer length field at a fixed offset.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef FIXED_LEN_PREFIX_FRAME_HPP_INCLUDED
+#define FIXED_LEN_PREFIX_FRAME_HPP_INCLUDED
+
+#include "asio/buffer.hpp"
+
+#include <cstddef> // std::size_t, std::ptrdiff_t
+#include <cstdint> // std::uint64_t
+#include <limits>
+#include <algorithm> // std::min
+
+#include "net_ip/net_ip_error.hpp" // msg_frame_error
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Byte order of the length field decoded by @c fixed_len_prefix_frame.
+ */
+enum class length_endian { big, little };
+
+/**
+ *  @brief Function object class template used in the @c basic_io_interface @c start_io
+ *  method taking a message frame, for headers with a length field at a fixed offset.
+ *
+ *  All of the header layout is specified at compile time, so the decoding is inlined
+ *  into the TCP IO handler read processing, with no function pointer call per message
+ *  (as there is with @c simple_variable_len_msg_frame and a header decoder function).
+ *
+ *  The length field is decoded as an unsigned integer, then @c Adjust is added to get
+ *  the body size. For example, a length field that includes the header itself uses an
+ *  @c Adjust of the negative header size. A message with an empty body is complete after
+ *  the header.
+ *
+ *  If the body size is negative, or the full message (header plus body) is larger than
+ *  the maximum message size given at construction, @c msg_frame_error is returned and
+ *  the TCP IO handler closes the connection with @c net_ip_errc::message_frame_error.
+ *
+ *  For example, a 2 byte big endian body length at the start of a 2 byte header, with
+ *  messages limited to 64K bytes:
+ *
+ *  @code
+ *    using frame = chops::net::fixed_len_prefix_frame<2u>;
+ *    io.start_io(frame::header_size, msg_hdlr, frame(65536u));
+ *  @endcode
+ *
+ *  @tparam LenBytes Size of the length field in bytes, 1 to 8.
+ *
+ *  @tparam Endian Byte order of the length field.
+ *
+ *  @tparam Offset Offset of the length field in the header.
+ *
+ *  @tparam Adjust Value added to the decoded length to get the body size.
+ *
+ *  @tparam HeaderSize Size of the header, by default the end of the length field.
+ */
+template <std::size_t LenBytes, length_endian Endian = length_endian::big,
+          std::size_t Offset = 0u, std::ptrdiff_t Adjust = 0,
+          std::size_t HeaderSize = Offset + LenBytes>
+class fixed_len_prefix_frame {
+public:
+  static_assert(LenBytes >= 1u && LenBytes <= 8u, "length field must be 1 to 8 bytes");
+  static_assert(Offset + LenBytes <= HeaderSize, "length field must be within the header");
+
+  static constexpr std::size_t header_size = HeaderSize;
+
+private:
+  std::size_t      m_max_msg_size;
+  bool             m_hdr_processed;
+
+public:
+
+/**
+ *  @brief Construct with a maximum message size, including the header.
+ *
+ *  @param max_msg_size Maximum size of a full message, the default is no limit.
+ */
+  explicit fixed_len_prefix_frame(std::size_t max_msg_size =
+                                  std::numeric_limits<std::size_t>::max()) noexcept :
+      m_max_msg_size(max_msg_size), m_hdr_processed(false) { }
+
+/**
+ *  @brief Decode the length field of a header, without any size checks.
+ *
+ *  @param hdr Pointer to the start of the header.
+ *
+ *  @return Value of the length field.
+ */
+  static constexpr std::uint64_t decode_length(const unsigned char* hdr) noexcept {
+    std::uint64_t len = 0u;
+    for (std::size_t i = 0u; i < LenBytes; ++i) {
+      if constexpr (Endian == length_endian::big) {
+        len = (len << 8u) | hdr[Offset + i];
+      }
+      else {
+        len |= static_cast<std::uint64_t>(hdr[Offset + i]) << (8u * i);
+      }
+    }
+    return len;
+  }
+
+  std::size_t operator() (asio::mutable_buffer buf) noexcept {
+    if (m_hdr_processed) {
+      m_hdr_processed = false;
+      return 0u;
+    }
+    std::uint64_t len = decode_length(static_cast<const unsigned char*>(buf.data()));
+    std::uint64_t max_body = m_max_msg_size - std::min(m_max_msg_size, HeaderSize);
+    if constexpr (Adjust < 0) {
+      constexpr auto sub = static_cast<std::uint64_t>(-Adjust);
+      if (len < sub || len - sub > max_body) {
+        return msg_frame_error;
+      }
+      len -= sub;
+    }
+    else {
+      constexpr auto add = static_cast<std::uint64_t>(Adjust);
+      if (len > max_body || max_body - len < add) {
+        return msg_frame_error;
+      }
+      len += add;
+    }
+    m_hdr_processed = (len != 0u);
+    return static_cast<std::size_t>(len);
+  }
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
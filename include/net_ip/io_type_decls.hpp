@@ -72,6 +72,18 @@ using tcp_io_output = basic_io_output<tcp_io>;
  */
 using udp_io_output = basic_io_output<udp_io>;
 
+/**
+ *  @brief Using declaration for the sequence of messages passed to a TCP batch message
+ *  handler, a non-owning range of @c asio::const_buffer objects.
+ *
+ *  The range provides @c begin, @c end, @c size, @c empty and @c operator[]. The 
+ *  buffers reference internal storage and are only valid for the duration of the 
+ *  message handler call.
+ *
+ *  @relates basic_io_interface
+ */
+using tcp_msg_batch = detail::const_buffer_span;
+
 } // end net namespace
 } // end chops namespace
 
@@ -28,6 +28,7 @@
 #include "nonstd/expected.hpp"
 
 #include "net_ip/net_ip_error.hpp"
+#include "net_ip/udp_multicast_config.hpp"
 
 #include "net_ip/detail/tcp_acceptor.hpp"
 #include "net_ip/detail/tcp_connector.hpp"
@@ -54,7 +55,7 @@ namespace net {
  *  The @c net_entity class provides methods to start and stop processing 
  *  on an underlying network entity, such as a TCP acceptor or TCP connector or
  *  UDP entity (which may be a UDP unicast sender or receiver, or a UDP
- *  multicast receiver).
+ *  multicast receiver or sender).
  *
  *  Calling the @c stop method on a @c net_entity object will shutdown the 
  *  associated network resource. At this point, other @c net_entity objects 
@@ -250,6 +251,44 @@ public:
       },  m_wptr);
   }
 
+/**
+ *  @brief Join a multicast group on a started UDP entity.
+ *
+ *  The groups of the @c udp_multicast_config passed to a @c net_ip multicast @c make
+ *  method are joined when the entity is started (and again each time it is restarted).
+ *  This method adds groups (or interfaces for a group) while the entity is running, e.g.
+ *  as market data channels are subscribed. A group joined through this method is not
+ *  rejoined when the entity is stopped and started again.
+ *
+ *  As with the @c visit_socket method, the socket option is set directly on the socket.
+ *
+ *  @param grp Multicast group address and local interface.
+ *
+ *  @return @c nonstd::expected - group is joined on success; on error (no associated
+ *  entity, entity not started, not a UDP entity, or the join failed), a @c std::error_code
+ *  is returned.
+ */
+  auto join_multicast_group(const multicast_group& grp) const ->
+          nonstd::expected<void, std::error_code> {
+    return change_multicast_membership(grp, true);
+  }
+
+/**
+ *  @brief Leave a multicast group on a started UDP entity.
+ *
+ *  All groups are left when the entity is stopped, so this method is only needed to
+ *  leave a group while the entity continues running.
+ *
+ *  @param grp Multicast group address and local interface, as joined.
+ *
+ *  @return @c nonstd::expected - group is left on success; on error, a @c std::error_code
+ *  is returned.
+ */
+  auto leave_multicast_group(const multicast_group& grp) const ->
+          nonstd::expected<void, std::error_code> {
+    return change_multicast_membership(grp, false);
+  }
+
 /**
  *  @brief Start network processing on the associated net entity with the application
  *  providing IO state change and error function objects.
@@ -424,6 +463,25 @@ public:
   friend bool operator==(const net_entity&, const net_entity&) noexcept;
   friend bool operator<(const net_entity&, const net_entity&) noexcept;
 
+private:
+
+  auto change_multicast_membership(const multicast_group& grp, bool join) const ->
+          nonstd::expected<void, std::error_code> {
+    return std::visit(chops::overloaded {
+        [&grp, join] (const udp_wp& wp)->nonstd::expected<void, std::error_code> {
+          return detail::wp_access_void(wp, 
+              [&grp, join] (detail::udp_entity_io_shared_ptr sp) { 
+                return join ? sp->join_multicast_group(grp) : sp->leave_multicast_group(grp); } );
+        },
+        [] (const acc_wp&)->nonstd::expected<void, std::error_code> {
+          return nonstd::make_unexpected(std::make_error_code(net_ip_errc::not_udp_entity));
+        },
+        [] (const conn_wp&)->nonstd::expected<void, std::error_code> {
+          return nonstd::make_unexpected(std::make_error_code(net_ip_errc::not_udp_entity));
+        },
+      },  m_wptr);
+  }
+
 };
 
 /**
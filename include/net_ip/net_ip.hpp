@@ -34,10 +34,14 @@
 
 #include "net_ip/net_ip_error.hpp"
 #include "net_ip/net_entity.hpp"
+#include "net_ip/queue_stats.hpp"
+#include "net_ip/udp_multicast_config.hpp"
 
 #include "net_ip/detail/tcp_connector.hpp"
 #include "net_ip/detail/tcp_acceptor.hpp"
 #include "net_ip/detail/udp_entity_io.hpp"
+#include "net_ip/detail/read_buffer_pool.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
 
 #include "net_ip/tcp_connector_timeout.hpp"
 
@@ -47,6 +51,20 @@
 namespace chops {
 namespace net {
 
+/**
+ *  @brief A set of @c io_context objects, such as the contexts of a @c worker_pool, used
+ *  by the @c net_ip sharded TCP acceptor and by a TCP acceptor placing its connections on
+ *  multiple contexts.
+ */
+using io_context_refs = detail::io_context_refs;
+
+/**
+ *  @brief Placement of the connections accepted by a TCP acceptor onto a set of 
+ *  @c io_context objects: @c round_robin, or @c least_loaded (fewest live connections
+ *  accepted by that acceptor).
+ */
+using accept_placement = detail::accept_placement;
+
 /**
  *  @brief Primary class for the Chops Net IP library and the initial API 
  *  point for providing TCP acceptor, TCP connector, UDP unicast, and UDP 
@@ -70,8 +88,8 @@ namespace net {
  *
  *  2. Create a @c net_entity object, through one of the @c net_ip @c make 
  *  methods. A @c net_entity interacts with one of a TCP acceptor, TCP 
- *  connector, UDP unicast receiver or sender, or UDP multicast receiver (a
- *  UDP multicast sender is the same as a UDP unicast sender).
+ *  connector, UDP unicast receiver or sender, or UDP multicast receiver or
+ *  sender.
  *
  *  3. Call the @c start method on the @c net_entity object. This performs
  *  name resolution (if needed), a local bind (if needed) and (for TCP) a 
@@ -124,6 +142,8 @@ private:
 
   asio::io_context&                             m_ioc;
   mutable std::mutex                            m_mutex;
+  detail::read_buffer_pool_ptr                  m_read_buf_pool;
+  detail::timer_wheel_ptr                       m_timer_wheel;
 
   std::vector<detail::tcp_acceptor_shared_ptr>  m_acceptors;
   std::vector<detail::tcp_connector_shared_ptr> m_connectors;
@@ -140,7 +160,30 @@ public:
  *  @param ioc IO context for asynchronous operations.
  */
   explicit net_ip(asio::io_context& ioc) :
-    m_ioc(ioc), m_acceptors(), m_connectors(), m_udp_entities() { }
+    net_ip(ioc, read_buffer_pool_config()) { }
+
+/**
+ *  @brief Construct a @c net_ip object with a specific read buffer pool configuration
+ *  and timeout resolution, without starting any network processing.
+ *
+ *  The read buffers of all of the IO handlers created through this @c net_ip object are
+ *  borrowed from a pool, which limits the read buffer memory held by each connection 
+ *  between messages; see @c read_buffer_pool_config.
+ *
+ *  @param ioc IO context for asynchronous operations.
+ *
+ *  @param pool_config Read buffer pool size classes and shrink threshold.
+ *
+ *  @param timeout_resolution Resolution of the TCP IO handler read and write timeouts 
+ *  (see @c basic_io_interface @c set_io_timeouts).
+ */
+  net_ip(asio::io_context& ioc, const read_buffer_pool_config& pool_config,
+         std::chrono::milliseconds timeout_resolution = 
+             detail::default_timer_wheel_resolution) :
+    m_ioc(ioc), m_mutex(), 
+    m_read_buf_pool(std::make_shared<detail::read_buffer_pool>(pool_config)),
+    m_timer_wheel(std::make_shared<detail::timer_wheel>(ioc, timeout_resolution)),
+    m_acceptors(), m_connectors(), m_udp_entities() { }
 
 private:
 
@@ -176,7 +219,8 @@ public:
                                 std::string_view listen_intf = "",
                                 bool reuse_addr = true) {
     auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, local_port_or_service, 
-                                                    listen_intf, reuse_addr);
+                                                    listen_intf, reuse_addr, m_read_buf_pool,
+                                                    m_timer_wheel);
     lg g(m_mutex);
     m_acceptors.push_back(p);
     return net_entity(p);
@@ -200,7 +244,145 @@ public:
  */
   net_entity make_tcp_acceptor (const asio::ip::tcp::endpoint& endp,
                                 bool reuse_addr = true) {
-    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, endp, reuse_addr);
+    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, endp, reuse_addr, m_read_buf_pool,
+                                                    m_timer_wheel);
+    lg g(m_mutex);
+    m_acceptors.push_back(p);
+    return net_entity(p);
+  }
+
+/**
+ *  @brief Create a TCP acceptor @c net_entity with one listening socket, which places each
+ *  accepted TCP connection on one of a set of @c io_context objects.
+ *
+ *  The accepts run on the @c io_context of this @c net_ip object, while the IO handler of 
+ *  each connection runs on its target context, e.g. one per @c worker_pool context. This
+ *  spreads the connections across threads without relying on @c SO_REUSEPORT (see 
+ *  @c make_tcp_sharded_acceptor). The target of a connection is chosen when its accept 
+ *  is started, either round robin or the context with the fewest live connections of 
+ *  this acceptor. The connection count passed to the IO state change function object 
+ *  covers all of the contexts.
+ *
+ *  @param local_port_or_service Port number or service name to bind to for incoming TCP 
+ *  connects.
+ *
+ *  @param listen_intf Specific interface for the bind, or empty for "any" IP interface.
+ *
+ *  @param target_iocs IO contexts the accepted connections are placed on.
+ *
+ *  @param placement Round robin (default) or least loaded placement.
+ *
+ *  @param reuse_addr If @c true (default), the @c reuse_address socket option is set upon 
+ *  socket open.
+ *
+ *  @return @c net_entity object instantiated for a TCP acceptor.
+ *
+ */
+  net_entity make_tcp_acceptor (std::string_view local_port_or_service, 
+                                std::string_view listen_intf,
+                                const io_context_refs& target_iocs,
+                                accept_placement placement = accept_placement::round_robin,
+                                bool reuse_addr = true) {
+    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, local_port_or_service, 
+                                                    listen_intf, reuse_addr, m_read_buf_pool,
+                                                    m_timer_wheel);
+    p->set_io_targets(target_iocs, placement);
+    lg g(m_mutex);
+    m_acceptors.push_back(p);
+    return net_entity(p);
+  }
+
+/**
+ *  @brief Create a TCP acceptor @c net_entity using an already created endpoint, which 
+ *  places each accepted TCP connection on one of a set of @c io_context objects.
+ *
+ *  See the other @c make_tcp_acceptor method taking target contexts for details.
+ *
+ *  @param endp A @c asio::ip::tcp::endpoint that the acceptor uses for the local bind.
+ *
+ *  @param target_iocs IO contexts the accepted connections are placed on.
+ *
+ *  @param placement Round robin (default) or least loaded placement.
+ *
+ *  @param reuse_addr If @c true (default), the @c reuse_address socket option is set upon 
+ *  socket open.
+ *
+ *  @return @c net_entity object instantiated for a TCP acceptor.
+ *
+ */
+  net_entity make_tcp_acceptor (const asio::ip::tcp::endpoint& endp,
+                                const io_context_refs& target_iocs,
+                                accept_placement placement = accept_placement::round_robin,
+                                bool reuse_addr = true) {
+    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, endp, reuse_addr, m_read_buf_pool,
+                                                    m_timer_wheel);
+    p->set_io_targets(target_iocs, placement);
+    lg g(m_mutex);
+    m_acceptors.push_back(p);
+    return net_entity(p);
+  }
+
+/**
+ *  @brief Create a sharded TCP acceptor @c net_entity, with one listening socket per 
+ *  @c io_context, all bound to the same port with the @c SO_REUSEPORT socket option.
+ *
+ *  The kernel spreads incoming connections across the listening sockets, so accepts and
+ *  the TCP connections of each shard run on the @c io_context (and threads) of that shard,
+ *  e.g. one per @c worker_pool context. The @c io_context of this @c net_ip object always 
+ *  has a listening socket (it is skipped if also in @c shard_iocs) and runs the IO state 
+ *  change and error function objects. To the application the shards are a single 
+ *  @c net_entity: the connection count passed to the IO state change function object and 
+ *  @c visit_io_output cover the connections of all shards.
+ *
+ *  On platforms without @c SO_REUSEPORT (e.g. Windows) @c start returns an error.
+ *
+ *  @param local_port_or_service Port number or service name to bind to for incoming TCP 
+ *  connects.
+ *
+ *  @param listen_intf Specific interface for the bind, or empty for "any" IP interface.
+ *
+ *  @param shard_iocs IO contexts that each get an additional listening socket.
+ *
+ *  @param reuse_addr If @c true (default), the @c reuse_address socket option is set upon 
+ *  socket open.
+ *
+ *  @return @c net_entity object instantiated for a TCP acceptor.
+ *
+ */
+  net_entity make_tcp_sharded_acceptor (std::string_view local_port_or_service, 
+                                        std::string_view listen_intf,
+                                        const io_context_refs& shard_iocs,
+                                        bool reuse_addr = true) {
+    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, local_port_or_service, 
+                                                    listen_intf, reuse_addr, m_read_buf_pool,
+                                                    m_timer_wheel);
+    p->set_shards(shard_iocs);
+    lg g(m_mutex);
+    m_acceptors.push_back(p);
+    return net_entity(p);
+  }
+
+/**
+ *  @brief Create a sharded TCP acceptor @c net_entity, using an already created endpoint.
+ *
+ *  See the other @c make_tcp_sharded_acceptor method for details.
+ *
+ *  @param endp A @c asio::ip::tcp::endpoint that every listening socket binds to.
+ *
+ *  @param shard_iocs IO contexts that each get an additional listening socket.
+ *
+ *  @param reuse_addr If @c true (default), the @c reuse_address socket option is set upon 
+ *  socket open.
+ *
+ *  @return @c net_entity object instantiated for a TCP acceptor.
+ *
+ */
+  net_entity make_tcp_sharded_acceptor (const asio::ip::tcp::endpoint& endp,
+                                        const io_context_refs& shard_iocs,
+                                        bool reuse_addr = true) {
+    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, endp, reuse_addr, m_read_buf_pool,
+                                                    m_timer_wheel);
+    p->set_shards(shard_iocs);
     lg g(m_mutex);
     m_acceptors.push_back(p);
     return net_entity(p);
@@ -241,7 +423,8 @@ public:
 
     auto p = std::make_shared<detail::tcp_connector>(m_ioc, remote_port_or_service, remote_host, 
                                                      tcp_connector_timeout_func(timeout_func),
-                                                     reconn_on_err);
+                                                     reconn_on_err, m_read_buf_pool,
+                                                     m_timer_wheel);
     lg g(m_mutex);
     m_connectors.push_back(p);
     return net_entity(p);
@@ -281,7 +464,8 @@ public:
         std::enable_if_t<std::is_same_v<std::decay<decltype(*beg)>, asio::ip::tcp::endpoint>, net_entity> {
     auto p = std::make_shared<detail::tcp_connector>(m_ioc, beg, end, 
                                                      tcp_connector_timeout_func(timeout_func),
-                                                     reconn_on_err);
+                                                     reconn_on_err, m_read_buf_pool,
+                                                     m_timer_wheel);
     lg g(m_mutex);
     m_connectors.push_back(p);
     return net_entity(p);
@@ -340,7 +524,8 @@ public:
  */
   net_entity make_udp_unicast (std::string_view local_port_or_service, 
                                std::string_view local_intf = "") {
-    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, local_port_or_service, local_intf);
+    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, local_port_or_service, local_intf,
+                                                     m_read_buf_pool);
     lg g(m_mutex);
     m_udp_entities.push_back(p);
     return net_entity(p);
@@ -360,7 +545,7 @@ public:
  *
  */
   net_entity make_udp_unicast (const asio::ip::udp::endpoint& endp) {
-    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, endp);
+    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, endp, m_read_buf_pool);
     lg g(m_mutex);
     m_udp_entities.push_back(p);
     return net_entity(p);
@@ -378,7 +563,100 @@ public:
     return make_udp_unicast(asio::ip::udp::endpoint());
   }
 
-// TODO: multicast make methods 
+/**
+ *  @brief Create a UDP multicast receiver @c net_entity, which joins one or more multicast
+ *  groups and can also send.
+ *
+ *  When the @c net_entity @c start method is called, names are resolved, the socket 
+ *  reuse options of the config are set, the local port is bound, and each group of the
+ *  config is joined on its interface. By default the address and port can be shared, 
+ *  so many receivers (in one or many processes) on a host can receive the same groups. 
+ *  More groups can be joined or left while running through the @c net_entity 
+ *  @c join_multicast_group and @c leave_multicast_group methods.
+ *
+ *  The receive batch size of the config is applied, so a high rate receiver only needs
+ *  @c start_io to be called to read datagrams in batches.
+ *
+ *  @param local_port_or_service Port number or service name for local binding, i.e. the
+ *  destination port of the multicast datagrams.
+ *
+ *  @param config Groups to join and multicast socket options; the groups must be of the
+ *  same IP version, which selects the IP version of the bind when a name or an empty
+ *  local interface is resolved.
+ *
+ *  @param local_intf Local bind address, otherwise the default is "any address"; on Linux
+ *  binding to a group address filters out datagrams of other groups sent to the same port.
+ *
+ *  @return @c net_entity object instantiated for UDP.
+ *
+ */
+  net_entity make_udp_multicast_receiver (std::string_view local_port_or_service, 
+                                          const udp_multicast_config& config,
+                                          std::string_view local_intf = "") {
+    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, local_port_or_service, local_intf,
+                                                     m_read_buf_pool);
+    p->set_multicast_config(config);
+    lg g(m_mutex);
+    m_udp_entities.push_back(p);
+    return net_entity(p);
+  }
+
+/**
+ *  @brief Create a UDP multicast receiver @c net_entity, using an already created 
+ *  endpoint for the local bind.
+ *
+ *  @param endp A @c asio::ip::udp::endpoint used for the local bind (when @c start is 
+ *  called).
+ *
+ *  @param config Groups to join and multicast socket options.
+ *
+ *  @return @c net_entity object instantiated for UDP.
+ *
+ */
+  net_entity make_udp_multicast_receiver (const asio::ip::udp::endpoint& endp,
+                                          const udp_multicast_config& config) {
+    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, endp, m_read_buf_pool);
+    p->set_multicast_config(config);
+    lg g(m_mutex);
+    m_udp_entities.push_back(p);
+    return net_entity(p);
+  }
+
+/**
+ *  @brief Create a UDP multicast sender @c net_entity.
+ *
+ *  The hops (time to live), loopback and outbound interface settings of the config are
+ *  applied when the @c net_entity @c start method is called; the groups are normally
+ *  left empty. Datagrams are sent to a group endpoint, either as the default destination 
+ *  passed to @c start_io or with each @c send. Write batching and segmentation offload 
+ *  (see @c basic_io_interface) apply as for any UDP entity.
+ *
+ *  @param config Multicast socket options.
+ *
+ *  @param local_endp Local bind endpoint; the default does not bind and sends IPv4, an 
+ *  IPv6 sender passes @c asio::ip::udp::endpoint(asio::ip::udp::v6(), 0).
+ *
+ *  @return @c net_entity object instantiated for UDP.
+ *
+ */
+  net_entity make_udp_multicast_sender (const udp_multicast_config& config = 
+                                                 udp_multicast_config(),
+                                        const asio::ip::udp::endpoint& local_endp = 
+                                                 asio::ip::udp::endpoint()) {
+    return make_udp_multicast_receiver(local_endp, config);
+  }
+
+
+/**
+ *  @brief Return the read buffer pool statistics for the IO handlers created through this 
+ *  @c net_ip object.
+ *
+ *  @return @c read_buffer_pool_stats, which includes the memory held by the pool; the
+ *  memory held by each IO handler is in its @c output_queue_stats.
+ */
+  read_buffer_pool_stats get_read_buffer_pool_stats() const {
+    return m_read_buf_pool->get_stats();
+  }
 
 /**
  *  @brief Remove a @c net_entity from the internal list of @c net_entity objects.
@@ -23,6 +23,7 @@
 #include <stdexcept>
 #include <system_error>
 #include <string>
+#include <cstddef> // std::size_t
 
 namespace chops {
 namespace net {
@@ -30,6 +31,7 @@ namespace net {
 enum class net_ip_errc {
   weak_ptr_expired = 1,
   message_handler_terminated = 2,
+  output_queue_overflow = 3,
 
   io_already_started = 4,
   io_already_stopped = 5,
@@ -53,6 +55,13 @@ enum class net_ip_errc {
   tcp_connector_no_reconnect_attempted = 20,
 
   functor_variant_mismatch = 30,
+
+  send_not_queued = 31,
+  send_file_short = 32,
+  message_frame_error = 33,
+  io_read_timeout = 34,
+  io_write_timeout = 35,
+  not_udp_entity = 36,
 };
 
 namespace detail {
@@ -67,6 +76,8 @@ struct net_ip_err_category : public std::error_category {
       return "weak pointer expired";
     case net_ip_errc::message_handler_terminated:
       return "message handler terminated via false return value";
+    case net_ip_errc::output_queue_overflow:
+      return "output queue overflow, io handler closed";
 
     case net_ip_errc::io_already_started:
       return "io already started";
@@ -108,6 +119,19 @@ struct net_ip_err_category : public std::error_category {
 
     case net_ip_errc::functor_variant_mismatch:
       return "function object does not match internal variant";
+
+    case net_ip_errc::send_not_queued:
+      return "send not written or queued, io handler stopped or output queue full";
+    case net_ip_errc::send_file_short:
+      return "file ended before the length given to send file";
+    case net_ip_errc::message_frame_error:
+      return "message frame reported an invalid message, io handler closed";
+    case net_ip_errc::io_read_timeout:
+      return "no data received within the read timeout, io handler closed";
+    case net_ip_errc::io_write_timeout:
+      return "write not completed within the write timeout, io handler closed";
+    case net_ip_errc::not_udp_entity:
+      return "operation only supported on a UDP network entity";
     }
     return "(unknown error)";
   }
@@ -137,7 +161,12 @@ inline error_code make_error_code(chops::net::net_ip_errc e) noexcept {
 namespace chops {
 namespace net {
 
-
+/**
+ *  @brief Value returned by a TCP message frame function object for an invalid message
+ *  (e.g. a length field over the maximum message size), closing the connection with the
+ *  @c net_ip_errc::message_frame_error error.
+ */
+constexpr std::size_t msg_frame_error = static_cast<std::size_t>(-1);
 
 /**
  *  @brief General @c net_ip exception class.
@@ -2,7 +2,8 @@
  *
  *  @ingroup net_ip_module
  *
- *  @brief Structures containing statistics gathered on internal queues.
+ *  @brief Structures containing statistics gathered on internal queues, along with
+ *  output queue overflow policy, send result, send completion and buffer and file release types.
  *
  *  @author Cliff Green
  *
@@ -17,21 +18,260 @@
 #define QUEUE_STATS_HPP_INCLUDED
 
 #include <cstddef> // std::size_t 
+#include <system_error>
+#include <functional> // std::function
 
 namespace chops {
 namespace net {
 
 /**
  *  @brief @c output_queue_stats provides information on the internal output 
- *  queue.
+ *  queue, along with cumulative traffic counts for the IO handler.
  */
 
 struct output_queue_stats {
 
   std::size_t output_queue_size = 0u;
   std::size_t bytes_in_output_queue = 0u;
-  // std::size_t total_bufs_sent;
-  // std::size_t total_bytes_sent;
+  // following are updated by IO handlers that drain the queue in gather write batches
+  // (currently TCP); the average batch size is bufs_in_write_batches / num_write_batches
+  std::size_t num_write_batches = 0u;
+  std::size_t bufs_in_write_batches = 0u;
+  std::size_t max_write_batch_bufs = 0u;
+  // number of sends that found the output queue at its limit, whatever the overflow 
+  // policy did with the data
+  std::size_t num_overflows = 0u;
+  // following are cumulative traffic counts for the life of the IO handler; a write is
+  // one completed write call (possibly a gather write of multiple buffers), a read is one
+  // completed read call (a message may take more than one read, e.g. header then body)
+  std::size_t total_bufs_sent = 0u;
+  std::size_t total_bytes_sent = 0u;
+  std::size_t total_writes = 0u;
+  std::size_t total_msgs_received = 0u;
+  std::size_t total_bytes_received = 0u;
+  std::size_t total_reads = 0u;
+  // capacity of the read buffer when the last read was started (TCP and UDP)
+  std::size_t read_buffer_bytes = 0u;
+  // following are updated by UDP IO handlers with batched receives (see the
+  // basic_io_interface set_receive_batch_size method); the average batch size is 
+  // msgs_in_read_batches / num_read_batches
+  std::size_t num_read_batches = 0u;
+  std::size_t msgs_in_read_batches = 0u;
+  std::size_t max_read_batch_msgs = 0u;
+  // datagrams larger than the maximum size, delivered truncated
+  std::size_t num_truncated_msgs = 0u;
+  // datagrams dropped by the kernel for the socket, e.g. when the socket receive buffer
+  // is full; only reported on platforms that support it (Linux SO_RXQ_OVFL)
+  std::size_t num_dropped_msgs = 0u;
+};
+
+/**
+ *  @brief @c read_buffer_pool_config specifies the read buffer pool shared by the IO
+ *  handlers of a @c net_ip object.
+ *
+ *  Read buffers are kept in size classes, doubling from @c min_class_size up to the 
+ *  first class at or above @c shrink_threshold. A connection read buffer that grows 
+ *  above the shrink threshold (for an unusually large message) is freed once the message
+ *  has been handled, and a buffer of the normal size is borrowed from the pool instead, 
+ *  so each connection holds at most the larger of the threshold and its configured read 
+ *  buffer size between messages. Buffers are returned to the pool when IO handlers are 
+ *  destroyed (TCP) or stopped (UDP), and at most @c max_pooled_per_class buffers of 
+ *  each class are kept.
+ *
+ *  The default threshold of one page bounds the read buffer of an idle connection to 
+ *  4 KB. Messages above the threshold cost an allocation each, so applications that 
+ *  regularly receive larger messages can raise it, trading idle memory for fewer 
+ *  allocations.
+ */
+struct read_buffer_pool_config {
+  std::size_t min_class_size = 256u;
+  std::size_t shrink_threshold = 4u * 1024u;
+  std::size_t max_pooled_per_class = 64u;
+};
+
+/**
+ *  @brief @c read_buffer_pool_stats reports the memory held by a read buffer pool, along
+ *  with cumulative counts of buffers borrowed from and returned to it.
+ *
+ *  The read buffer memory footprint of a @c net_ip object is @c bytes_pooled plus the
+ *  @c read_buffer_bytes of each IO handler.
+ */
+struct read_buffer_pool_stats {
+  std::size_t bufs_pooled = 0u;
+  std::size_t bytes_pooled = 0u;
+  std::size_t num_acquires = 0u;
+  // acquires satisfied from the pool, the rest allocated a new buffer
+  std::size_t num_pool_hits = 0u;
+  std::size_t num_releases = 0u;
+  // released buffers freed instead of pooled (too small, too large, or class full)
+  std::size_t num_discards = 0u;
+};
+
+/**
+ *  @brief @c output_queue_water_marks specifies output queue levels for back-pressure
+ *  notifications, in number of queued buffers, number of queued bytes, or both.
+ *
+ *  The queue is above the high water mark when either the buffer count or byte count 
+ *  reaches its high value. It is back below the low water mark when all of the monitored 
+ *  counts are at or below their low values. A high value of 0 means the count is not 
+ *  monitored. A low value must be less than the corresponding high value (it is lowered
+ *  if not).
+ */
+struct output_queue_water_marks {
+  std::size_t high_bufs = 0u;
+  std::size_t low_bufs = 0u;
+  std::size_t high_bytes = 0u;
+  std::size_t low_bytes = 0u;
+};
+
+namespace detail {
+
+inline output_queue_water_marks normalize_water_marks(output_queue_water_marks wm) noexcept {
+  if (wm.high_bufs != 0u && wm.low_bufs >= wm.high_bufs) {
+    wm.low_bufs = wm.high_bufs - 1u;
+  }
+  if (wm.high_bytes != 0u && wm.low_bytes >= wm.high_bytes) {
+    wm.low_bytes = wm.high_bytes - 1u;
+  }
+  return wm;
+}
+
+// true if a count changing from prev to cur crosses the high mark going up, or the low mark 
+// going down; io common classes use this to decide when a water mark check is needed
+inline bool water_mark_crossed(std::size_t high, std::size_t low, 
+                               std::size_t prev, std::size_t cur) noexcept {
+  return high != 0u && ((prev < high && cur >= high) || (prev > low && cur <= low));
+}
+
+inline bool above_high_water(const output_queue_water_marks& wm, 
+                             std::size_t bufs, std::size_t bytes) noexcept {
+  return (wm.high_bufs != 0u && bufs >= wm.high_bufs) || 
+         (wm.high_bytes != 0u && bytes >= wm.high_bytes);
+}
+
+inline bool below_low_water(const output_queue_water_marks& wm, 
+                            std::size_t bufs, std::size_t bytes) noexcept {
+  return (wm.high_bufs == 0u || bufs <= wm.low_bufs) && 
+         (wm.high_bytes == 0u || bytes <= wm.low_bytes);
+}
+
+} // end detail namespace
+
+/**
+ *  @brief @c queue_overflow_policy specifies what happens when data is sent and the
+ *  output queue is at its limit.
+ *
+ *  The output queue of an IO handler is unbounded unless a limit is set (through the
+ *  @c basic_io_interface @c set_output_queue_limit method).
+ *
+ *  - @c reject: the data is not queued and the @c send fails, allowing the application
+ *  to retry or otherwise apply back-pressure.
+ *  - @c drop_oldest: the oldest data in the queue is discarded and the new data is queued.
+ *  - @c drop_newest: the new data is discarded, as acceptable (and counted) data loss.
+ *  - @c close_io: the IO handler is closed, for peers that are not keeping up.
+ */
+enum class queue_overflow_policy { reject, drop_oldest, drop_newest, close_io };
+
+/**
+ *  @brief @c send_result is returned from the @c send methods, reporting whether the data
+ *  was written or queued, and if not what happened to it.
+ *
+ *  A @c send_result is @c true in a boolean context if the data was written or queued for
+ *  output (even if older queued data was dropped to make room), @c false otherwise.
+ *
+ *  For example:
+ *  @code
+ *    auto r = io_out.send(buf);
+ *    if (!r && r.get_status() == chops::net::send_result::rejected) {
+ *      // output queue full, try again later
+ *    }
+ *  @endcode
+ */
+class send_result {
+public:
+  enum status { 
+    io_stopped, // no associated IO handler, or IO handler not started or stopped
+    queued, // queued for output behind a write in progress
+    write_started, // write started immediately
+    queued_dropped_oldest, // queued, oldest data in full queue discarded
+    rejected, // queue full, data not queued
+    dropped_newest, // queue full, data discarded
+    overflow_closed // queue full, data discarded and IO handler closing
+  };
+
+private:
+  status m_status;
+
+public:
+  constexpr send_result(status s = io_stopped) noexcept : m_status(s) { }
+
+  constexpr status get_status() const noexcept { return m_status; }
+
+  // implicit, so that code written for the bool returning send methods (e.g. 
+  // bool r = io_out.send(buf);) is unchanged
+  constexpr operator bool() const noexcept {
+    return m_status == queued || m_status == write_started || 
+           m_status == queued_dropped_oldest;
+  }
+
+  constexpr bool operator==(const send_result& rhs) const noexcept {
+    return m_status == rhs.m_status;
+  }
+  constexpr bool operator!=(const send_result& rhs) const noexcept {
+    return m_status != rhs.m_status;
+  }
+  // exact matches for a status, otherwise the comparison is ambiguous with the bool
+  // conversion
+  constexpr bool operator==(status s) const noexcept { return m_status == s; }
+  constexpr bool operator!=(status s) const noexcept { return m_status != s; }
+  friend constexpr bool operator==(status s, const send_result& rhs) noexcept { 
+    return s == rhs.m_status;
+  }
+  friend constexpr bool operator!=(status s, const send_result& rhs) noexcept {
+    return s != rhs.m_status;
+  }
+};
+
+/**
+ *  @brief Function object type called when the write of a buffer sent through
+ *  @c send_with_completion has finished.
+ *
+ *  The function object is invoked from the IO thread with the error code of the write
+ *  (no error on success) and the number of bytes of the buffer that were written. 
+ *  It should not block, since no reads or writes are processed while it is running.
+ */
+using send_completion_handler = std::function<void (const std::error_code&, std::size_t)>;
+
+/**
+ *  @brief Function object type called when application owned memory sent through 
+ *  @c send_no_copy is no longer referenced by the IO handler.
+ *
+ *  The function object is called exactly once, with the buffer pointer and size passed
+ *  to @c send_no_copy. This is normally from the IO thread after the write of the buffer
+ *  completes, but it can also be from the sending thread (if the send is rejected) or 
+ *  from whichever thread discards a queued buffer (output queue overflow or IO handler 
+ *  close). Internal locks may be held while it is called, so it must not call back into 
+ *  the IO handler (e.g. @c send), and it should only return the memory to its owner.
+ */
+using buffer_release_hook = std::function<void (const void*, std::size_t)>;
+
+/**
+ *  @brief Function object type called when a file descriptor sent through @c send_file
+ *  is no longer referenced by the IO handler.
+ *
+ *  The function object is called exactly once with the file descriptor, under the same
+ *  conditions and constraints as a @c buffer_release_hook. A typical hook closes the file
+ *  or decrements a count of outstanding sends of it.
+ */
+using file_release_hook = std::function<void (int)>;
+
+/**
+ *  @brief @c send_completion holds the outcome of the write of a buffer, as delivered
+ *  through the @c std::future returning @c send_with_completion.
+ */
+struct send_completion {
+  std::error_code err;
+  std::size_t num_bytes = 0u;
 };
 
 } // end net namespace
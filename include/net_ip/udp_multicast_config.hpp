@@ -0,0 +1,80 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Structures specifying UDP multicast group membership and multicast socket
+ *  options, used by the @c net_ip multicast @c make methods.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef UDP_MULTICAST_CONFIG_HPP_INCLUDED
+#define UDP_MULTICAST_CONFIG_HPP_INCLUDED
+
+#include "asio/ip/address.hpp"
+
+#include <cstddef> // std::size_t
+#include <vector>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c multicast_group specifies a multicast group and the local interface the
+ *  group is joined on.
+ *
+ *  For an IPv4 group the interface is given by a local interface address, for an IPv6
+ *  group by an interface index (e.g. from @c if_nametoindex). An unspecified interface
+ *  address or an index of 0 lets the operating system choose the interface (typically
+ *  the one of the default route). Joining the same group on more than one interface
+ *  takes one entry per interface.
+ */
+struct multicast_group {
+  asio::ip::address  group;
+  asio::ip::address  intf = asio::ip::address();
+  unsigned int       intf_index = 0u;
+};
+
+/**
+ *  @brief @c udp_multicast_config specifies the groups joined by a UDP multicast receiver
+ *  along with the multicast socket options of receivers and senders.
+ *
+ *  - @c groups: joined when the @c net_entity is started, all must be of the same IP
+ *  version as the local bind endpoint; groups are left when the socket is closed. A
+ *  receiver only receives the groups it joined, even if other sockets on the host join
+ *  other groups on the same port.
+ *  - @c reuse_addr, @c reuse_port: set before the local bind, so that many sockets (in
+ *  one or many processes) on a host can bind the same port and receive the same groups;
+ *  @c reuse_port (@c SO_REUSEPORT) is ignored where not supported.
+ *  - @c hops: multicast time to live (IPv4) or hop limit (IPv6) of sent datagrams, 1
+ *  keeps them on the local network; a negative value keeps the system default.
+ *  - @c loopback: whether sent datagrams are also delivered to receivers on the sending
+ *  host.
+ *  - @c outbound_intf, @c outbound_intf_index: interface for sent datagrams, as an IPv4
+ *  interface address or an IPv6 interface index, unspecified or 0 for the system default.
+ *  - @c receive_batch_size: datagrams received per socket readiness, see the
+ *  @c basic_io_interface @c set_receive_batch_size method; batching is recommended for
+ *  high rate feeds and is ignored where not supported.
+ */
+struct udp_multicast_config {
+  std::vector<multicast_group>  groups;
+  bool                          reuse_addr = true;
+  bool                          reuse_port = true;
+  int                           hops = 1;
+  bool                          loopback = true;
+  asio::ip::address             outbound_intf = asio::ip::address();
+  unsigned int                  outbound_intf_index = 0u;
+  std::size_t                   receive_batch_size = 0u;
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,131 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Function object class for TCP message framing with a varint (base 128, as
+ *  used by Protocol Buffers) length prefix, along with a varint encoding function.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef VARINT_LEN_PREFIX_FRAME_HPP_INCLUDED
+#define VARINT_LEN_PREFIX_FRAME_HPP_INCLUDED
+
+#include "asio/buffer.hpp"
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <limits>
+
+#include "net_ip/net_ip_error.hpp" // msg_frame_error
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Maximum size of an encoded 64 bit varint.
+ */
+constexpr std::size_t max_varint_size = 10u;
+
+/**
+ *  @brief Encode a value as a varint, 7 bits per byte with the least significant group
+ *  first, and the high bit set on all but the last byte.
+ *
+ *  @param val Value to encode.
+ *
+ *  @param out Output buffer, at least @c max_varint_size bytes.
+ *
+ *  @return Number of bytes written.
+ */
+inline std::size_t encode_varint(std::uint64_t val, std::byte* out) noexcept {
+  std::size_t i = 0u;
+  while (val >= 0x80u) {
+    out[i++] = static_cast<std::byte>((val & 0x7Fu) | 0x80u);
+    val >>= 7u;
+  }
+  out[i++] = static_cast<std::byte>(val);
+  return i;
+}
+
+/**
+ *  @brief Function object class used in the @c basic_io_interface @c start_io method
+ *  taking a message frame, for streams of messages each preceded by a varint body length
+ *  (e.g. length delimited Protocol Buffers messages).
+ *
+ *  The prefix has a variable size, so it is read one byte at a time (@c header_size is
+ *  1), until a byte without the continuation bit. Each byte is a separate read unless a
+ *  read buffer is set (see @c basic_io_interface @c set_read_buffer_size), in which case
+ *  the prefix bytes are framed from the buffer without any additional read calls, so
+ *  buffered reads are recommended.
+ *
+ *  The message passed to the message handler includes the prefix bytes. A prefix longer
+ *  than 10 bytes or larger than 64 bits, or a message (prefix plus body) larger than the
+ *  maximum message size given at construction, results in @c msg_frame_error being
+ *  returned and the TCP IO handler closing the connection with
+ *  @c net_ip_errc::message_frame_error.
+ *
+ *  @code
+ *    using frame = chops::net::varint_len_prefix_frame;
+ *    io.set_read_buffer_size(65536u);
+ *    io.start_io(frame::header_size, msg_hdlr, frame(1024u * 1024u));
+ *  @endcode
+ */
+class varint_len_prefix_frame {
+public:
+  static constexpr std::size_t header_size = 1u;
+
+private:
+  std::size_t      m_max_msg_size;
+  std::uint64_t    m_len;
+  unsigned int     m_shift;
+  bool             m_in_body;
+
+public:
+
+/**
+ *  @brief Construct with a maximum message size, including the prefix.
+ *
+ *  @param max_msg_size Maximum size of a full message, the default is no limit.
+ */
+  explicit varint_len_prefix_frame(std::size_t max_msg_size =
+                                   std::numeric_limits<std::size_t>::max()) noexcept :
+      m_max_msg_size(max_msg_size), m_len(0u), m_shift(0u), m_in_body(false) { }
+
+  std::size_t operator() (asio::mutable_buffer buf) noexcept {
+    if (m_in_body) {
+      m_in_body = false;
+      return 0u;
+    }
+    auto b = *static_cast<const unsigned char*>(buf.data());
+    // the tenth byte can only hold the top bit of a 64 bit value
+    if (m_shift == 63u && (b & 0xFEu) != 0u) {
+      return msg_frame_error;
+    }
+    m_len |= static_cast<std::uint64_t>(b & 0x7Fu) << m_shift;
+    if ((b & 0x80u) != 0u) {
+      m_shift += 7u;
+      return 1u;
+    }
+    std::size_t prefix_size = m_shift / 7u + 1u;
+    std::uint64_t body = m_len;
+    m_len = 0u;
+    m_shift = 0u;
+    if (prefix_size > m_max_msg_size || body > m_max_msg_size - prefix_size) {
+      return msg_frame_error;
+    }
+    m_in_body = (body != 0u);
+    return static_cast<std::size_t>(body);
+  }
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -19,6 +19,7 @@
 
 #include <cstddef> // std::size_t
 #include <numeric> // std::accumulate
+#include <algorithm> // std::max
 
 #include "net_ip/queue_stats.hpp"
 #include "net_ip/basic_io_output.hpp"
@@ -26,6 +27,38 @@
 namespace chops {
 namespace net {
 
+/**
+ *  @brief Combine two @c output_queue_stats objects, summing the counts and taking
+ *  the larger of the maximum values.
+ *
+ *  @param lhs First @c output_queue_stats object.
+ *
+ *  @param rhs Second @c output_queue_stats object.
+ *
+ *  @return @c output_queue_stats containing the combined statistics.
+ */
+inline output_queue_stats combine_output_queue_stats(const output_queue_stats& lhs,
+                                                     const output_queue_stats& rhs) noexcept {
+  return output_queue_stats { lhs.output_queue_size + rhs.output_queue_size,
+                              lhs.bytes_in_output_queue + rhs.bytes_in_output_queue,
+                              lhs.num_write_batches + rhs.num_write_batches,
+                              lhs.bufs_in_write_batches + rhs.bufs_in_write_batches,
+                              std::max(lhs.max_write_batch_bufs, rhs.max_write_batch_bufs),
+                              lhs.num_overflows + rhs.num_overflows,
+                              lhs.total_bufs_sent + rhs.total_bufs_sent,
+                              lhs.total_bytes_sent + rhs.total_bytes_sent,
+                              lhs.total_writes + rhs.total_writes,
+                              lhs.total_msgs_received + rhs.total_msgs_received,
+                              lhs.total_bytes_received + rhs.total_bytes_received,
+                              lhs.total_reads + rhs.total_reads,
+                              lhs.read_buffer_bytes + rhs.read_buffer_bytes,
+                              lhs.num_read_batches + rhs.num_read_batches,
+                              lhs.msgs_in_read_batches + rhs.msgs_in_read_batches,
+                              std::max(lhs.max_read_batch_msgs, rhs.max_read_batch_msgs),
+                              lhs.num_truncated_msgs + rhs.num_truncated_msgs,
+                              lhs.num_dropped_msgs + rhs.num_dropped_msgs };
+}
+
 /**
  *  @brief Accumulate @c output_queue_stats given a sequence of
  *  @c basic_io_output objects.
@@ -49,9 +82,7 @@ output_queue_stats accumulate_output_queue_stats(Iter beg, Iter end) {
   return std::accumulate(beg, end, output_queue_stats(),
 			  [] (const output_queue_stats& sum, const auto& io) {
           auto rhs = io.get_output_queue_stats();
-          return rhs ? output_queue_stats { sum.output_queue_size + rhs->output_queue_size,
-                                            sum.bytes_in_output_queue + rhs->bytes_in_output_queue } :
-                       sum;
+          return rhs ? combine_output_queue_stats(sum, *rhs) : sum;
     }
   );
 }
@@ -103,6 +134,35 @@ void accumulate_output_queue_stats_until(Iter beg, Iter end, Cond&& cond) {
   }
 }
 
+/**
+ *  @brief Aggregate @c output_queue_stats over all of the IO handlers of a 
+ *  @c net_entity, using the @c visit_io_output method.
+ *
+ *  For a TCP acceptor this combines the statistics (including the cumulative traffic
+ *  counts) of every current connection. IO handlers that have already been closed are 
+ *  not included.
+ *
+ *  @tparam IOT Either @c chops::net::tcp_io or @c chops::net::udp_io.
+ *
+ *  @param ne @c net_entity object.
+ *
+ *  @return @c output_queue_stats containing aggregated statistics; if the 
+ *  @c net_entity is not valid or not started, all counts are zero.
+ *
+ */
+template <typename IOT, typename NE>
+output_queue_stats net_entity_output_queue_stats(const NE& ne) {
+  output_queue_stats st{};
+  ne.visit_io_output([&st] (basic_io_output<IOT> io) {
+      auto r = io.get_output_queue_stats();
+      if (r) {
+        st = combine_output_queue_stats(st, *r);
+      }
+    }
+  );
+  return st;
+}
+
 /**
  *  @brief Accumulate @c output_queue_stats given a sequence of
  *  @c net_entity objects, using the @c visit_io_output method on each
@@ -122,17 +182,7 @@ template <typename IOT, typename Iter>
 output_queue_stats accumulate_net_entity_output_queue_stats(Iter beg, Iter end) {
   return std::accumulate(beg, end, output_queue_stats(),
 			  [] (const output_queue_stats& sum, const auto& ne) {
-          output_queue_stats st{};
-          ne.visit_io_output([&st] (basic_io_output<IOT> io) {
-              auto r = io.get_output_queue_stats();
-              if (r) {
-                st.output_queue_size += r->output_queue_size;
-                st.bytes_in_output_queue += r->bytes_in_output_queue;
-              }
-            }
-          );
-          return output_queue_stats {sum.output_queue_size + st.output_queue_size,
-                                     sum.bytes_in_output_queue + st.bytes_in_output_queue};
+          return combine_output_queue_stats(sum, net_entity_output_queue_stats<IOT>(ne));
     }
   );
 }
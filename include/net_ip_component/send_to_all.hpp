@@ -25,6 +25,8 @@
 
 #include <mutex>
 #include <vector>
+#include <memory> // std::shared_ptr, std::atomic_load, std::atomic_store
+#include <atomic>
 
 #include "net_ip/basic_io_interface.hpp"
 #include "net_ip/basic_io_output.hpp"
@@ -58,7 +60,20 @@ namespace net {
  *  A function object operator overload is provided so that a @c std::ref to a @c send_to_all
  *  object can be used in composing function objects for @c io_state_change calls.
  *
- *  This class is thread-safe for concurrent access.
+ *  This class is thread-safe for concurrent access. The collection is copy-on-write: 
+ *  adding or removing an object copies the collection (serialized by a mutex) and then
+ *  publishes the copy, while the @c send methods and the statistics take a snapshot of the
+ *  published collection without locking the mutex. A large fan-out therefore does not
+ *  block adds, removes, or other sends, and a send that is in progress uses the 
+ *  collection as it was when the send started.
+ *
+ *  The published collection is a @c std::atomic<std::shared_ptr> when the standard 
+ *  library provides it (@c __cpp_lib_atomic_shared_ptr, C++20). Otherwise the 
+ *  @c std::atomic_load and @c std::atomic_store free functions are used, and with 
+ *  most standard libraries (e.g. libstdc++ and libc++) these are not lock-free: taking 
+ *  a snapshot then holds a short internal lock (from a small pool of mutexes shared 
+ *  by all @c shared_ptr atomic operations) for the duration of a reference count 
+ *  increment.
  *
  */
 template <typename IOT>
@@ -67,13 +82,28 @@ private:
   using lock_guard  = std::lock_guard<std::mutex>;
   using io_out      = chops::net::basic_io_output<IOT>;
   using io_outs     = std::vector<io_out>;
+  using io_outs_ptr = std::shared_ptr<const io_outs>;
   using io_interface = chops::net::basic_io_interface<IOT>;
 
 private:
-  mutable std::mutex    m_mutex;
-  io_outs               m_io_outs;
+  // the mutex only serializes writers, the published collection is never modified
+  std::mutex            m_mutex;
+#if defined(__cpp_lib_atomic_shared_ptr)
+  std::atomic<io_outs_ptr> m_io_outs;
+
+  io_outs_ptr snapshot() const noexcept { return m_io_outs.load(); }
+  void publish(io_outs_ptr outs) noexcept { m_io_outs.store(std::move(outs)); }
+#else
+  io_outs_ptr           m_io_outs;
+
+  io_outs_ptr snapshot() const noexcept { return std::atomic_load(&m_io_outs); }
+  void publish(io_outs_ptr outs) noexcept { std::atomic_store(&m_io_outs, std::move(outs)); }
+#endif
 
 public:
+
+  send_to_all() : m_mutex(), m_io_outs(std::make_shared<const io_outs>()) { }
+
 /**
  *  @brief Add a @c basic_io_output object to the collection.
  *
@@ -81,7 +111,9 @@ public:
  */
   void add_io_output(io_out io) {
     lock_guard gd { m_mutex };
-    m_io_outs.push_back(io);
+    auto outs = std::make_shared<io_outs>(*snapshot());
+    outs->push_back(io);
+    publish(io_outs_ptr(std::move(outs)));
   }
 
 /**
@@ -91,7 +123,9 @@ public:
  */
   void remove_io_output(io_out io) {
     lock_guard gd { m_mutex };
-    chops::erase_where(m_io_outs, io);
+    auto outs = std::make_shared<io_outs>(*snapshot());
+    chops::erase_where(*outs, io);
+    publish(io_outs_ptr(std::move(outs)));
   }
 
 /**
@@ -122,8 +156,8 @@ public:
  *  @param buf Reference counted buffer to send.
  */
   void send(chops::const_shared_buffer buf) const {
-    lock_guard gd { m_mutex };
-    for (const auto& io : m_io_outs) {
+    auto outs = snapshot();
+    for (const auto& io : *outs) {
       io.send(buf);
     }
   }
@@ -137,8 +171,8 @@ public:
  *  @param cur_io @c basic_io_output object to skip.
  */
   void send(chops::const_shared_buffer buf, io_out cur_io) const { // TG
-    lock_guard gd { m_mutex };
-    for (const auto& io : m_io_outs) {
+    auto outs = snapshot();
+    for (const auto& io : *outs) {
       if ( !(cur_io == io) ) {
         io.send(buf);
       }
@@ -198,8 +232,7 @@ public:
  *  @brief Return the number of @c basic_io_output objects in the collection.
  */
   std::size_t size() const noexcept {
-    lock_guard gd { m_mutex };
-    return m_io_outs.size();
+    return snapshot()->size();
   }
 
 /**
@@ -208,8 +241,8 @@ public:
  *  @return @c output_queue_stats object containing total counts.
  */
   auto get_total_output_queue_stats() const noexcept {
-    lock_guard gd { m_mutex };
-    return accumulate_output_queue_stats(m_io_outs.cbegin(), m_io_outs.cend());
+    auto outs = snapshot();
+    return accumulate_output_queue_stats(outs->cbegin(), outs->cend());
   }
 };
 
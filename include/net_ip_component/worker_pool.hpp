@@ -0,0 +1,227 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief Pool of threads running one or more @c io_context objects, with optional CPU
+ *  affinity per thread.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef WORKER_POOL_HPP_INCLUDED
+#define WORKER_POOL_HPP_INCLUDED
+
+#include <thread>
+#include <vector>
+#include <memory> // std::unique_ptr
+#include <utility> // std::move
+#include <cstddef> // std::size_t
+#include <functional> // std::reference_wrapper
+#include <system_error>
+
+#include <exception>
+#include <iostream>
+
+#include "asio/io_context.hpp"
+#include "asio/executor_work_guard.hpp"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Convenience class that runs a number of threads over one or more
+ *  @c io_context objects, the multi-threaded counterpart of the @c worker class.
+ *
+ *  Threads are assigned to the @c io_context objects round robin, so with 8 threads and
+ *  2 contexts each context is run by 4 threads. One context run by all of the threads
+ *  spreads the handlers of one @c net_ip object across the threads; a context per thread
+ *  (each with its own @c net_ip object) avoids any sharing between threads. The internal
+ *  network entities and IO handlers run their handlers on a per entity (and per TCP
+ *  connection) strand, so they are safe with any number of threads running the context.
+ *  Application callbacks for different connections can then be called concurrently.
+ *
+ *  Each thread can be pinned to a CPU (Linux only), given as a list of CPU numbers
+ *  indexed by thread number (wrapping around if shorter than the number of threads).
+ *
+ *  @note This class is not a necessary dependency of the @c net_ip library, but
+ *  is provided for convenience in many use cases.
+ */
+class worker_pool {
+private:
+  using work_guard = asio::executor_work_guard<asio::io_context::executor_type>;
+
+  std::vector<std::unique_ptr<asio::io_context>> m_iocs;
+  std::vector<work_guard>                        m_wgs;
+  std::vector<std::thread>                       m_run_thrs;
+  std::size_t                                    m_num_threads;
+  std::vector<int>                               m_cpus;
+
+public:
+
+/**
+ *  @brief Construct the @c io_context objects, without starting any threads.
+ *
+ *  @param num_threads Number of threads, at least 1.
+ *
+ *  @param num_contexts Number of @c io_context objects, at least 1 and no more than
+ *  the number of threads.
+ *
+ *  @param cpus CPU numbers the threads are pinned to, empty (the default) for no
+ *  pinning.
+ */
+  explicit worker_pool(std::size_t num_threads, std::size_t num_contexts = 1u,
+                       std::vector<int> cpus = std::vector<int>()) :
+      m_iocs(), m_wgs(), m_run_thrs(),
+      m_num_threads(num_threads == 0u ? 1u : num_threads), m_cpus(std::move(cpus)) {
+    num_contexts = (num_contexts == 0u ? 1u :
+                   (num_contexts > m_num_threads ? m_num_threads : num_contexts));
+    for (std::size_t i = 0u; i < num_contexts; ++i) {
+      // the concurrency hint is the number of threads running the context, a hint of 1
+      // enables single thread optimizations in the Asio scheduler
+      m_iocs.push_back(std::make_unique<asio::io_context>(
+            static_cast<int>((m_num_threads + num_contexts - 1u - i) / num_contexts)));
+      m_wgs.push_back(asio::make_work_guard(*m_iocs.back()));
+    }
+  }
+
+/**
+ *  @brief Stop a still running pool, abandoning any outstanding operations or handlers,
+ *  so that the threads are joined instead of the program being terminated.
+ */
+  ~worker_pool() {
+    stop();
+  }
+
+  worker_pool(const worker_pool&) = delete;
+  worker_pool& operator=(const worker_pool&) = delete;
+
+/**
+ *  @brief Provide access to an @c io_context.
+ *
+ *  @param idx Index of the context, less than @c num_io_contexts.
+ *
+ *  @return Reference to a @c asio::io_context.
+ */
+  asio::io_context& get_io_context(std::size_t idx = 0u) { return *m_iocs[idx]; }
+
+/**
+ *  @brief Provide access to an @c io_context for a round robin distribution of work,
+ *  e.g. a @c net_ip object per context.
+ *
+ *  @param n Any number, such as a count of objects created so far.
+ *
+ *  @return Reference to context @c n modulo the number of contexts.
+ */
+  asio::io_context& next_io_context(std::size_t n) { return *m_iocs[n % m_iocs.size()]; }
+
+/**
+ *  @brief Provide access to all of the @c io_context objects, e.g. for the @c net_ip 
+ *  sharded TCP acceptor.
+ *
+ *  @return Container of references to each @c asio::io_context.
+ */
+  std::vector<std::reference_wrapper<asio::io_context>> get_io_contexts() {
+    std::vector<std::reference_wrapper<asio::io_context>> iocs;
+    for (auto& ioc : m_iocs) {
+      iocs.push_back(*ioc);
+    }
+    return iocs;
+  }
+
+  std::size_t num_io_contexts() const noexcept { return m_iocs.size(); }
+
+  std::size_t num_threads() const noexcept { return m_num_threads; }
+
+/**
+ *  @brief Start the threads that invoke the underlying asynchronous operations.
+ *
+ *  @return Default constructed @c std::error_code, or the error of the first thread that
+ *  could not be pinned to its CPU (the thread runs unpinned).
+ */
+  std::error_code start() {
+    std::error_code ret;
+    for (std::size_t i = 0u; i < m_num_threads; ++i) {
+      auto& ioc = *m_iocs[i % m_iocs.size()];
+      m_run_thrs.emplace_back([&ioc] () {
+          try {
+            ioc.run();
+          }
+          catch (const std::exception& e) {
+            std::cerr << "std::exception caught in worker_pool::start: " << e.what() << std::endl;
+          }
+          catch (...) {
+            std::cerr << "Unknown exception caught in worker_pool::start" << std::endl;
+          }
+        }
+      );
+      if (!m_cpus.empty()) {
+        auto ec = pin_thread(m_run_thrs.back(), m_cpus[i % m_cpus.size()]);
+        if (ec && !ret) {
+          ret = ec;
+        }
+      }
+    }
+    return ret;
+  }
+
+/**
+ *  @brief Shutdown the executors and join the threads, abandoning any outstanding
+ *  operations or handlers.
+ */
+  void stop() {
+    for (auto& ioc : m_iocs) {
+      ioc->stop();
+    }
+    join();
+  }
+
+/**
+ *  @brief Reset the internal work guards and join the threads, waiting for outstanding
+ *  operations or handlers to complete.
+ */
+  void reset() {
+    for (auto& wg : m_wgs) {
+      wg.reset();
+    }
+    join();
+  }
+
+private:
+
+  void join() {
+    for (auto& thr : m_run_thrs) {
+      thr.join();
+    }
+    m_run_thrs.clear();
+  }
+
+  static std::error_code pin_thread(std::thread& thr, int cpu) {
+#if defined(__linux__)
+    ::cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    int r = ::pthread_setaffinity_np(thr.native_handle(), sizeof(cpu_set), &cpu_set);
+    return r == 0 ? std::error_code() : std::error_code(r, std::system_category());
+#else
+    return std::make_error_code(std::errc::operation_not_supported);
+#endif
+  }
+
+};
+
+}  // end net namespace
+}  // end chops namespace
+
+#endif
+
@@ -42,6 +42,26 @@ void basic_io_interface_test_default_constructed() {
 
   REQUIRE_FALSE (io_intf.visit_socket([] (double&) { } ));
 
+  REQUIRE_FALSE (io_intf.get_output_queue_stats());
+
+  REQUIRE_FALSE (io_intf.set_write_batch_limits(10u, 0u));
+
+  REQUIRE_FALSE (io_intf.set_read_buffer_size(65536u));
+
+  REQUIRE_FALSE (io_intf.set_receive_batch_size(32u));
+
+  REQUIRE_FALSE (io_intf.set_segmentation_offload(1472u));
+
+  REQUIRE_FALSE (io_intf.set_zero_copy(65536u));
+
+  REQUIRE_FALSE (io_intf.set_io_timeouts(std::chrono::milliseconds(100), 
+                                         std::chrono::milliseconds(0)));
+
+  REQUIRE_FALSE (io_intf.set_output_queue_limit(10u, chops::net::queue_overflow_policy::reject));
+
+  REQUIRE_FALSE (io_intf.set_output_queue_water_marks(chops::net::output_queue_water_marks { },
+                                                      [] (int, bool) { } ));
+
   REQUIRE_FALSE (io_intf.start_io(0, [] { }, [] { }));
   REQUIRE_FALSE (io_intf.start_io(0, [] { }, do_nothing_hdr_decoder));
   REQUIRE_FALSE (io_intf.start_io("testing, hah!", [] { }));
@@ -61,6 +81,9 @@ void basic_io_interface_test_start_io(F&& func) {
   chops::net::basic_io_interface<IOT> io_intf(ioh);
   REQUIRE (io_intf.is_valid());
   REQUIRE_FALSE (*io_intf.is_io_started());
+  auto qs = io_intf.get_output_queue_stats();
+  REQUIRE (qs);
+  REQUIRE ((*qs).output_queue_size == chops::test::io_handler_mock::qs_base);
 
   auto r = func(io_intf);
   REQUIRE (r);
@@ -117,6 +140,44 @@ void basic_io_interface_test_other_methods() {
   REQUIRE (r);
   REQUIRE (ioh->mock_sock == 43.0);
 
+  auto b = io_intf.set_write_batch_limits(10u, 0u);
+  REQUIRE (b);
+  REQUIRE (ioh->max_batch_bufs == 10u);
+
+  auto rb = io_intf.set_read_buffer_size(32768u);
+  REQUIRE (rb);
+  REQUIRE (ioh->read_buffer_size == 32768u);
+
+  auto rcv = io_intf.set_receive_batch_size(32u);
+  REQUIRE (rcv);
+  REQUIRE (ioh->receive_batch_size == 32u);
+
+  auto seg = io_intf.set_segmentation_offload(1472u);
+  REQUIRE (seg);
+  REQUIRE (ioh->max_segment_size == 1472u);
+
+  auto z = io_intf.set_zero_copy(65536u);
+  REQUIRE (z);
+  REQUIRE (ioh->zero_copy_min_size == 65536u);
+
+  auto t = io_intf.set_io_timeouts(std::chrono::milliseconds(5000), 
+                                   std::chrono::milliseconds(1000));
+  REQUIRE (t);
+  REQUIRE (ioh->read_timeout == std::chrono::milliseconds(5000));
+  REQUIRE (ioh->write_timeout == std::chrono::milliseconds(1000));
+
+  auto q = io_intf.set_output_queue_limit(100u, chops::net::queue_overflow_policy::drop_oldest);
+  REQUIRE (q);
+  REQUIRE (ioh->max_queue_bufs == 100u);
+  REQUIRE (ioh->overflow_policy == chops::net::queue_overflow_policy::drop_oldest);
+
+  auto w = io_intf.set_output_queue_water_marks(chops::net::output_queue_water_marks { 10u, 2u },
+                                                [] (int, bool) { } );
+  REQUIRE (w);
+  REQUIRE (ioh->water_mark_func_set);
+  REQUIRE (ioh->water_marks.high_bufs == 10u);
+  REQUIRE (ioh->water_marks.low_bufs == 2u);
+
 }
 
 template <typename IOT>
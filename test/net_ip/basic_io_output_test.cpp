@@ -18,8 +18,10 @@
 #include <memory> // std::shared_ptr
 #include <set>
 #include <cstddef> // std::size_t
+#include <system_error>
 
 #include "net_ip/queue_stats.hpp"
+#include "net_ip/net_ip_error.hpp"
 #include "net_ip/basic_io_interface.hpp"
 #include "net_ip/basic_io_output.hpp"
 
@@ -63,14 +65,75 @@ void basic_io_output_test_sends() {
 
   REQUIRE (io_out.is_valid());
 
-  io_out.send(nullptr, 0);
-  io_out.send(buf);
+  REQUIRE (io_out.send(nullptr, 0));
+  auto r = io_out.send(buf);
+  REQUIRE (r);
+  REQUIRE (r == chops::net::send_result::write_started);
+  REQUIRE (chops::net::send_result::write_started == r);
+  bool b = io_out.send(buf); // converts, as with the bool returning send
+  REQUIRE (b);
   io_out.send(chops::mutable_shared_buffer());
   io_out.send(nullptr, 0, endp_t());
   io_out.send(buf, endp_t());
   io_out.send(chops::mutable_shared_buffer(), endp_t());
   REQUIRE(ioh->send_called);
 
+  chops::net::basic_io_output<IOT> io_out_empty;
+  r = io_out_empty.send(buf);
+  REQUIRE_FALSE (r);
+  REQUIRE (r.get_status() == chops::net::send_result::io_stopped);
+
+  chops::const_shared_buffer buf2("abc", 3u);
+  std::size_t completed = 0u;
+  r = io_out.send_with_completion(buf2, [&completed] (const std::error_code& err, std::size_t nb) {
+      REQUIRE_FALSE (err);
+      completed += nb;
+    }
+  );
+  REQUIRE (r);
+  REQUIRE (completed == 3u);
+  r = io_out.send_with_completion(buf2, endp_t(), [&completed] (const std::error_code&, std::size_t nb) {
+      completed += nb;
+    }
+  );
+  REQUIRE (r);
+  REQUIRE (completed == 6u);
+  r = io_out_empty.send_with_completion(buf2, [&completed] (const std::error_code&, std::size_t nb) {
+      completed += nb;
+    }
+  );
+  REQUIRE_FALSE (r);
+  REQUIRE (completed == 6u);
+
+  std::size_t released = 0u;
+  auto release = [&released] (const void*, std::size_t sz) { released += sz; };
+  REQUIRE (io_out.send_no_copy("abcd", 4u, release));
+  REQUIRE (released == 4u);
+  REQUIRE (io_out.send_no_copy("abcd", 4u, endp_t(), release));
+  REQUIRE (released == 8u);
+  // no IO handler, memory released right away
+  REQUIRE_FALSE (io_out_empty.send_no_copy("abcd", 4u, release));
+  REQUIRE (released == 12u);
+  REQUIRE_FALSE (io_out_empty.send_no_copy("abcd", 4u, endp_t(), release));
+  REQUIRE (released == 16u);
+
+  int file_released = 0;
+  auto file_release = [&file_released] (int fd) { file_released += fd; };
+  REQUIRE (io_out.send_file(3, 0u, 100u, file_release));
+  REQUIRE (file_released == 3);
+  REQUIRE_FALSE (io_out_empty.send_file(4, 0u, 100u, file_release));
+  REQUIRE (file_released == 7);
+
+  auto fut = io_out.send_with_completion(buf2);
+  auto sc = fut.get();
+  REQUIRE_FALSE (sc.err);
+  REQUIRE (sc.num_bytes == 3u);
+  sc = io_out.send_with_completion(buf2, endp_t()).get();
+  REQUIRE (sc.num_bytes == 3u);
+  sc = io_out_empty.send_with_completion(buf2).get();
+  REQUIRE (sc.err == std::make_error_code(chops::net::net_ip_errc::send_not_queued));
+  REQUIRE (sc.num_bytes == 0u);
+
 }
 
 template <typename IOT>
@@ -0,0 +1,232 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for file segment sends and mapped file regions, and for
+ *  @c send_file in @c tcp_io.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#ifndef _WIN32
+
+#include "asio/ip/tcp.hpp"
+#include "asio/read.hpp"
+#include "asio/io_context.hpp"
+
+#include <system_error> // std::error_code
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <memory> // std::make_shared
+#include <vector>
+#include <string>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstring> // std::memcmp
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdlib> // mkstemp
+
+#include "net_ip/detail/file_send.hpp"
+#include "net_ip/detail/tcp_io.hpp"
+#include "net_ip/basic_io_output.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "net_ip_component/worker.hpp"
+
+#include "marshall/shared_buffer.hpp"
+
+constexpr unsigned short test_port = 30478;
+
+namespace {
+
+// temporary file filled with a byte pattern, removed on destruction
+struct temp_file {
+  int                     m_fd;
+  std::vector<std::byte>  m_data;
+
+  explicit temp_file(std::size_t sz) : m_fd(-1), m_data(sz) {
+    char name[] = "/tmp/chops_file_send_XXXXXX";
+    m_fd = ::mkstemp(name);
+    ::unlink(name);
+    for (std::size_t i = 0u; i < sz; ++i) {
+      m_data[i] = static_cast<std::byte>((i * 7u) % 256u);
+    }
+    std::size_t pos = 0u;
+    while (pos < sz) {
+      auto n = ::write(m_fd, m_data.data() + pos, sz - pos);
+      if (n <= 0) {
+        break;
+      }
+      pos += static_cast<std::size_t>(n);
+    }
+  }
+  ~temp_file() { ::close(m_fd); }
+};
+
+template <typename F>
+bool wait_for(F&& cond, std::chrono::milliseconds max_wait) {
+  auto end = std::chrono::steady_clock::now() + max_wait;
+  while (!cond()) {
+    if (std::chrono::steady_clock::now() > end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+}
+
+TEST_CASE ( "File segment send and mapped file region",
+           "[file_send]" ) {
+
+  using namespace chops::net::detail;
+
+  temp_file tf(20000u);
+  REQUIRE (tf.m_fd >= 0);
+
+  SECTION ("Mapped region at an unaligned offset matches the file contents") {
+    std::error_code ec;
+    auto region = map_file_region(tf.m_fd, 5001u, 10000u, ec);
+    REQUIRE_FALSE (ec);
+    REQUIRE (std::memcmp(region.first, tf.m_data.data() + 5001u, 10000u) == 0);
+    region.second(region.first, 10000u);
+  }
+
+  SECTION ("Mapping an invalid descriptor fails") {
+    std::error_code ec;
+    auto region = map_file_region(-1, 0u, 100u, ec);
+    REQUIRE (ec);
+    REQUIRE (region.first == nullptr);
+  }
+
+  SECTION ("Segment is sent through a socket pair") {
+    int sv[2];
+    REQUIRE (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    ::fcntl(sv[0], F_SETFL, ::fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+
+    std::vector<std::byte> rbuf(20000u);
+    std::size_t sent = 0u;
+    std::size_t recvd = 0u;
+    std::error_code ec;
+    while (!ec && sent < 12000u) {
+      sent += send_file_segment(sv[0], tf.m_fd, 3000u + sent, 12000u - sent, ec);
+      if (ec == std::errc::resource_unavailable_try_again ||
+          ec == std::errc::operation_would_block) {
+        ec.clear();
+      }
+      auto n = ::recv(sv[1], rbuf.data() + recvd, rbuf.size() - recvd, MSG_DONTWAIT);
+      if (n > 0) {
+        recvd += static_cast<std::size_t>(n);
+      }
+    }
+    REQUIRE_FALSE (ec);
+    while (recvd < 12000u) {
+      auto n = ::recv(sv[1], rbuf.data() + recvd, rbuf.size() - recvd, 0);
+      REQUIRE (n > 0);
+      recvd += static_cast<std::size_t>(n);
+    }
+    REQUIRE (recvd == 12000u);
+    REQUIRE (std::memcmp(rbuf.data(), tf.m_data.data() + 3000u, 12000u) == 0);
+
+    // the file ends, nothing more is sent and no error is reported
+    auto n = send_file_segment(sv[0], tf.m_fd, 20000u, 100u, ec);
+    REQUIRE_FALSE (ec);
+    REQUIRE (n == 0u);
+
+    ::close(sv[0]);
+    ::close(sv[1]);
+  }
+}
+
+TEST_CASE ( "Tcp io send file, in order with buffers, loopback",
+           "[tcp_io] [file_send]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  constexpr std::size_t file_size = 3u * 1024u * 1024u + 17u;
+  temp_file tf(file_size);
+  REQUIRE (tf.m_fd >= 0);
+
+  asio::ip::tcp::endpoint endp(asio::ip::make_address("127.0.0.1"), test_port);
+  asio::ip::tcp::acceptor acc(ioc, endp);
+  asio::ip::tcp::socket send_sock(ioc);
+  send_sock.connect(endp);
+  auto recv_sock = acc.accept();
+
+  auto prom = std::make_shared<std::promise<std::error_code>>();
+  auto notify_fut = prom->get_future();
+  auto iohp = std::make_shared<chops::net::detail::tcp_io>(std::move(send_sock),
+        [prom] (std::error_code e, chops::net::detail::tcp_io_shared_ptr) { prom->set_value(e); } );
+  REQUIRE (iohp->start_io());
+
+  chops::net::basic_io_output<chops::net::detail::tcp_io> io_out(iohp);
+
+  // expected byte stream: memory buffers, file segments and a mapped region interleaved
+  std::vector<std::byte> expected;
+  auto add_buf = [&] (std::size_t sz, std::byte val) {
+    std::vector<std::byte> b(sz, val);
+    expected.insert(expected.end(), b.begin(), b.end());
+    return chops::const_shared_buffer(b.data(), b.size());
+  };
+  auto add_file = [&] (std::uint64_t off, std::size_t len) {
+    expected.insert(expected.end(), tf.m_data.begin() + off, tf.m_data.begin() + off + len);
+  };
+
+  std::atomic_int num_released { 0 };
+  auto release = [&num_released] (int) { ++num_released; };
+
+  std::size_t total = 0u;
+  for (int i = 0; i < 5; ++i) {
+    REQUIRE (io_out.send(add_buf(1000u, std::byte{0x11})));
+    REQUIRE (io_out.send(add_buf(50u, std::byte{0x22})));
+    add_file(i * 1000u, file_size - i * 1000u);
+    REQUIRE (io_out.send_file(tf.m_fd, i * 1000u, file_size - i * 1000u, release));
+    REQUIRE (io_out.send(add_buf(10u, std::byte{0x33})));
+  }
+  add_file(123u, 500000u);
+  auto r = io_out.send_mapped_file(tf.m_fd, 123u, 500000u);
+  REQUIRE (r);
+  REQUIRE (*r);
+  // traffic counters are updated before completions are invoked
+  auto last_fut = io_out.send_with_completion(add_buf(7u, std::byte{0x44}));
+  total = expected.size();
+
+  std::vector<std::byte> recvd(total);
+  asio::read(recv_sock, asio::buffer(recvd));
+  REQUIRE (recvd == expected);
+  REQUIRE (last_fut.get().num_bytes == 7u);
+  // written buffers are released just after the completions are invoked
+  REQUIRE (wait_for([&num_released] { return num_released == 5; },
+                    std::chrono::milliseconds(5000)));
+
+  auto qs = iohp->get_output_queue_stats();
+  REQUIRE (qs.total_bytes_sent == total);
+
+  // a segment past the end of the file closes the io handler
+  REQUIRE (io_out.send_file(tf.m_fd, file_size - 10u, 100u, release));
+  REQUIRE (notify_fut.get() == std::make_error_code(chops::net::net_ip_errc::send_file_short));
+  REQUIRE (wait_for([&num_released] { return num_released == 6; },
+                    std::chrono::milliseconds(5000)));
+
+  wk.reset();
+}
+
+#endif
+
@@ -0,0 +1,56 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for the @c find_delimiter function.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include <cstddef> // std::size_t, std::byte
+#include <string_view>
+
+#include "net_ip/detail/find_delimiter.hpp"
+
+namespace {
+
+std::size_t find(std::string_view buf, std::string_view delim) {
+  return chops::net::detail::find_delimiter(reinterpret_cast<const std::byte*>(buf.data()),
+                                            buf.size(), delim);
+}
+
+}
+
+TEST_CASE ( "Find delimiter, single byte",
+           "[find_delimiter]" ) {
+
+  REQUIRE (find("", "\n") == 0u);
+  REQUIRE (find("abc", "\n") == 3u);
+  REQUIRE (find("\n", "\n") == 0u);
+  REQUIRE (find("abc\ndef\n", "\n") == 3u);
+  REQUIRE (find("abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz\n", "\n") == 62u);
+}
+
+TEST_CASE ( "Find delimiter, multiple bytes",
+           "[find_delimiter]" ) {
+
+  REQUIRE (find("abc\r\n", "\r\n") == 3u);
+  // first byte without the rest is skipped
+  REQUIRE (find("a\rb\r\r\nc", "\r\n") == 4u);
+  // partial delimiter at the end is not found
+  REQUIRE (find("abc\r", "\r\n") == 4u);
+  REQUIRE (find("ab", "\r\n\r\n") == 2u);
+  REQUIRE (find("x\r\n\r\r\n\r\ny", "\r\n\r\n") == 4u);
+  REQUIRE (find("END", "END") == 0u);
+  // empty delimiter is never found
+  REQUIRE (find("abc", "") == 3u);
+}
+
@@ -87,6 +87,19 @@ void io_common_api_test(const E& elem) {
   check_queue_stats(iocommon, 0u, 0u);
   REQUIRE_FALSE (iocommon.is_write_in_progress());
 
+  // closing, the queued element is still written but new writes are refused
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.set_io_closing();
+  s = iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (s == chops::net::detail::io_common<E>::write_status::io_stopped);
+  check_queue_stats(iocommon, 1u, 1u*elem.size());
+  iocommon.write_next_elem(empty_write_func<E>);
+  check_queue_stats(iocommon, 0u, 0u);
+  REQUIRE (iocommon.is_write_in_progress());
+  iocommon.write_next_elem(empty_write_func<E>);
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+
   REQUIRE_FALSE (iocommon.set_io_started());
   REQUIRE (iocommon.set_io_stopped());
 
@@ -101,6 +114,206 @@ void io_common_api_test(const E& elem) {
 
 }
 
+template <typename E>
+void io_common_batch_test(const E& elem) {
+
+  chops::net::detail::io_common<E> iocommon { };
+  REQUIRE (iocommon.set_io_started());
+  iocommon.set_write_batch_limits(3u, 0u);
+
+  std::vector<E> elems;
+  std::size_t batch_size = 0u;
+  auto batch_func = [&batch_size] (const std::vector<E>& v) { batch_size = v.size(); };
+
+  auto s = iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (s == chops::net::detail::io_common<E>::write_status::write_started);
+  chops::repeat(5, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  check_queue_stats(iocommon, 5u, 5u*elem.size());
+
+  iocommon.write_next_elems(elems, batch_func);
+  REQUIRE (batch_size == 3u);
+  REQUIRE (elems.size() == 3u);
+  check_queue_stats(iocommon, 2u, 2u*elem.size());
+  iocommon.write_next_elems(elems, batch_func);
+  REQUIRE (batch_size == 2u);
+  check_queue_stats(iocommon, 0u, 0u);
+  REQUIRE (iocommon.is_write_in_progress());
+  iocommon.write_next_elems(elems, batch_func);
+  REQUIRE (elems.empty());
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+
+  auto qs = iocommon.get_output_queue_stats();
+  REQUIRE (qs.num_write_batches == 2u);
+  REQUIRE (qs.bufs_in_write_batches == 5u);
+  REQUIRE (qs.max_write_batch_bufs == 3u);
+
+  // byte limit, only one element per batch
+  iocommon.set_write_batch_limits(3u, elem.size());
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.write_next_elems(elems, batch_func);
+  REQUIRE (batch_size == 1u);
+  check_queue_stats(iocommon, 1u, 1u*elem.size());
+
+  REQUIRE (iocommon.set_io_stopped());
+  iocommon.write_next_elems(elems, batch_func);
+  REQUIRE (elems.empty());
+  check_queue_stats(iocommon, 0u, 0u);
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+}
+
+template <typename E, typename Q>
+void io_common_overflow_test(const E& elem) {
+
+  using iocommon_type = chops::net::detail::io_common<E, Q>;
+  using sr = chops::net::send_result;
+
+  for (auto pol : { chops::net::queue_overflow_policy::reject, 
+                    chops::net::queue_overflow_policy::drop_oldest,
+                    chops::net::queue_overflow_policy::drop_newest,
+                    chops::net::queue_overflow_policy::close_io } ) {
+    iocommon_type iocommon { };
+    REQUIRE (iocommon.set_io_started());
+    iocommon.set_output_queue_limit(3u, pol);
+
+    // write in progress is not counted against the limit
+    REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == sr::write_started);
+    chops::repeat(3, [&iocommon, &elem] { 
+        REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == sr::queued);
+      }
+    );
+    auto s = iocommon.start_write(elem, empty_write_func<E>);
+    auto qs = iocommon.get_output_queue_stats();
+    REQUIRE (qs.output_queue_size == 3u);
+    REQUIRE (qs.bytes_in_output_queue == 3u*elem.size());
+    REQUIRE (qs.num_overflows == 1u);
+    switch (pol) {
+    case chops::net::queue_overflow_policy::reject:
+      REQUIRE (s == sr::rejected);
+      break;
+    case chops::net::queue_overflow_policy::drop_oldest:
+      REQUIRE (s == sr::queued_dropped_oldest);
+      break;
+    case chops::net::queue_overflow_policy::drop_newest:
+      REQUIRE (s == sr::dropped_newest);
+      break;
+    case chops::net::queue_overflow_policy::close_io:
+      REQUIRE (s == sr::overflow_closed);
+      break;
+    }
+
+    // queue drains below the limit, sends are queued again
+    iocommon.write_next_elem(empty_write_func<E>);
+    REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == sr::queued);
+    REQUIRE (iocommon.get_output_queue_stats().output_queue_size == 3u);
+
+    // lowering the limit does not discard queued elements
+    iocommon.set_output_queue_limit(1u, pol);
+    REQUIRE_FALSE (iocommon.start_write(elem, empty_write_func<E>) == sr::queued);
+    REQUIRE (iocommon.get_output_queue_stats().output_queue_size == 3u);
+    REQUIRE (iocommon.get_output_queue_stats().num_overflows == 2u);
+
+    // unbounded
+    iocommon.set_output_queue_limit(0u, pol);
+    chops::repeat(10, [&iocommon, &elem] { 
+        REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == sr::queued);
+      }
+    );
+    REQUIRE (iocommon.get_output_queue_stats().output_queue_size == 13u);
+    REQUIRE (iocommon.set_io_stopped());
+  }
+}
+
+template <typename E>
+void io_common_water_mark_test(const E& elem) {
+
+  chops::net::detail::io_common<E> iocommon { };
+  REQUIRE (iocommon.set_io_started());
+
+  int notifies = 0;
+  iocommon.set_water_marks(chops::net::output_queue_water_marks { 4u, 1u, 0u, 0u },
+                           [&notifies] { ++notifies; } );
+  REQUIRE (notifies == 1); // initial evaluation request
+  REQUIRE_FALSE (iocommon.check_water_marks());
+
+  REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == 
+           chops::net::send_result::write_started);
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  REQUIRE (notifies == 1);
+  iocommon.start_write(elem, empty_write_func<E>); // reaches 4 queued
+  REQUIRE (notifies == 2);
+  auto c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE (*c);
+  REQUIRE_FALSE (iocommon.check_water_marks()); // reported once
+  iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (notifies == 2);
+
+  // drain to the low water mark
+  chops::repeat(3, [&iocommon] { iocommon.write_next_elem(empty_write_func<E>); } );
+  REQUIRE (notifies == 2);
+  REQUIRE_FALSE (iocommon.check_water_marks()); // still above low water mark
+  iocommon.write_next_elem(empty_write_func<E>); // 1 left
+  REQUIRE (notifies == 3);
+  c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE_FALSE (*c);
+  REQUIRE_FALSE (iocommon.check_water_marks());
+
+  // spike that drains before the check is not reported
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  REQUIRE (notifies == 4);
+  std::vector<E> elems;
+  iocommon.set_write_batch_limits(10u, 0u);
+  iocommon.write_next_elems(elems, [] (const std::vector<E>&) { } );
+  REQUIRE (notifies == 5);
+  REQUIRE_FALSE (iocommon.check_water_marks());
+
+  // byte water marks, low value adjusted below high value
+  iocommon.set_water_marks(chops::net::output_queue_water_marks { 0u, 0u, 2u*elem.size(), 
+                                                                  5u*elem.size() },
+                           [&notifies] { ++notifies; } );
+  REQUIRE (notifies == 6);
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (notifies == 7);
+  c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE (*c);
+  iocommon.write_next_elem(empty_write_func<E>);
+  REQUIRE (notifies == 8);
+  c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE_FALSE (*c);
+
+  // disabled
+  iocommon.set_water_marks(chops::net::output_queue_water_marks { 1u, 0u, 0u, 0u }, 
+                           std::function<void ()> { } );
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  REQUIRE (notifies == 8);
+  REQUIRE_FALSE (iocommon.check_water_marks());
+
+  // above the high water mark when IO stops, a restart reports the next crossing again
+  int cnt = 0;
+  iocommon.set_water_marks(chops::net::output_queue_water_marks { 2u, 0u, 0u, 0u },
+                           [&cnt] { ++cnt; } );
+  iocommon.clear();
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE (*c);
+  REQUIRE (iocommon.set_io_stopped());
+  REQUIRE_FALSE (iocommon.check_water_marks());
+  iocommon.clear();
+  REQUIRE (iocommon.set_io_started());
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE (*c);
+  REQUIRE (iocommon.set_io_stopped());
+}
+
 constexpr int Wait = 5;
 
 template <typename E>
@@ -181,6 +394,20 @@ TEST_CASE ( "Io common API test, double element",
 
 }
 
+TEST_CASE ( "Io common batch test, single element", 
+           "[io_common] [single_element] [batch]" ) {
+
+  io_common_batch_test(chops::test::make_io_buf1());
+
+}
+
+TEST_CASE ( "Io common batch test, double element", 
+           "[io_common] [double_element] [batch]" ) {
+
+  io_common_batch_test(chops::test::io_buf_and_int(chops::test::make_io_buf2()));
+
+}
+
 TEST_CASE ( "Io common stress test, single element, multiplier 1, 1 thread", 
            "[io_common] [single_element] [multiplier_1] [threads_1]" ) {
 
@@ -251,3 +478,34 @@ TEST_CASE ( "Io common stress test, double element, multiplier 40, 60 threads",
 
 }
 
+
+TEST_CASE ( "Io common overflow test, single element, std::queue", 
+           "[io_common] [single_element] [overflow]" ) {
+
+  using E = chops::const_shared_buffer;
+  io_common_overflow_test<E, chops::net::detail::output_queue<E>>(chops::test::make_io_buf1());
+
+}
+
+TEST_CASE ( "Io common overflow test, double element, ring buffer", 
+           "[io_common] [double_element] [overflow]" ) {
+
+  using E = chops::test::io_buf_and_int;
+  io_common_overflow_test<E, chops::net::detail::ring_output_queue<E>>(
+            chops::test::io_buf_and_int(chops::test::make_io_buf2()));
+
+}
+
+TEST_CASE ( "Io common water mark test, single element", 
+           "[io_common] [single_element] [water_mark]" ) {
+
+  io_common_water_mark_test(chops::test::make_io_buf1());
+
+}
+
+TEST_CASE ( "Io common water mark test, double element", 
+           "[io_common] [double_element] [water_mark]" ) {
+
+  io_common_water_mark_test(chops::test::io_buf_and_int(chops::test::make_io_buf2()));
+
+}
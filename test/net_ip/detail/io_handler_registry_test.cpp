@@ -0,0 +1,102 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c io_handler_registry detail class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include <memory> // std::make_shared
+#include <vector>
+#include <set>
+#include <cstddef> // std::size_t
+
+#include "net_ip/detail/io_handler_registry.hpp"
+
+#include "utility/repeat.hpp"
+
+struct ioh_mock {
+  int          id;
+  std::size_t  slot = chops::net::detail::no_registry_slot;
+
+  explicit ioh_mock(int i) : id(i) { }
+
+  std::size_t get_registry_slot() const noexcept { return slot; }
+  void set_registry_slot(std::size_t s) noexcept { slot = s; }
+};
+
+using registry = chops::net::detail::io_handler_registry<ioh_mock>;
+
+std::set<int> ids(const registry& reg) {
+  std::set<int> s;
+  for (const auto& p : reg) {
+    s.insert(p->id);
+  }
+  return s;
+}
+
+// every handler knows its own position
+bool slots_consistent(const registry& reg) {
+  std::size_t i = 0u;
+  for (const auto& p : reg) {
+    if (p->get_registry_slot() != i) {
+      return false;
+    }
+    ++i;
+  }
+  return true;
+}
+
+TEST_CASE ( "Io handler registry test", "[io_handler_registry]" ) {
+
+  registry reg;
+  REQUIRE (reg.empty());
+
+  std::vector<std::shared_ptr<ioh_mock>> hdlrs;
+  int i = 0;
+  chops::repeat(6, [&] {
+      hdlrs.push_back(std::make_shared<ioh_mock>(i++));
+      reg.add(hdlrs.back());
+    }
+  );
+  REQUIRE (reg.size() == 6u);
+  REQUIRE (slots_consistent(reg));
+  REQUIRE (ids(reg) == std::set<int> { 0, 1, 2, 3, 4, 5 });
+
+  // middle, first, and last positions
+  REQUIRE (reg.remove(hdlrs[2]));
+  REQUIRE (hdlrs[2]->get_registry_slot() == chops::net::detail::no_registry_slot);
+  REQUIRE (slots_consistent(reg));
+  REQUIRE (reg.remove(hdlrs[0]));
+  REQUIRE (slots_consistent(reg));
+  auto last = *(reg.end() - 1);
+  REQUIRE (reg.remove(last));
+  REQUIRE (slots_consistent(reg));
+  REQUIRE (reg.size() == 3u);
+  REQUIRE (ids(reg).count(2) == 0u);
+  REQUIRE (ids(reg).count(0) == 0u);
+
+  // removing twice, or a handler never added, is ignored
+  REQUIRE_FALSE (reg.remove(hdlrs[2]));
+  REQUIRE_FALSE (reg.remove(std::make_shared<ioh_mock>(42)));
+  REQUIRE (reg.size() == 3u);
+
+  reg.add(hdlrs[2]);
+  REQUIRE (reg.size() == 4u);
+  REQUIRE (slots_consistent(reg));
+
+  for (auto& h : hdlrs) {
+    reg.remove(h);
+  }
+  REQUIRE (reg.empty());
+}
+
@@ -0,0 +1,415 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c lock_free_io_common detail class, including a contention
+ *  benchmark comparing it against the mutex based @c io_common.
+ *
+ *  The benchmark test case is hidden by default, run it by specifying the
+ *  @c [benchmark] tag on the command line.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include "asio/io_context.hpp"
+#include "asio/post.hpp"
+
+#include <vector>
+#include <cassert>
+
+#include <future>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+#include <iomanip> // std::setw
+#include <cstddef> // std::size_t
+#include <functional> // std::function
+
+#include "net_ip/detail/lock_free_io_common.hpp"
+#include "net_ip/detail/io_common.hpp"
+
+#include "net_ip_component/worker.hpp"
+
+#include "marshall/shared_buffer.hpp"
+
+#include "utility/repeat.hpp"
+
+#include "shared_test/io_buf.hpp"
+
+template <typename E>
+void empty_write_func (const E&) { }
+
+template <typename E>
+void check_queue_stats(const chops::net::detail::lock_free_io_common<E>& ioc,
+                       std::size_t exp_qs, std::size_t exp_bs) {
+
+  auto qs = ioc.get_output_queue_stats();
+  REQUIRE (qs.output_queue_size == exp_qs);
+  REQUIRE (qs.bytes_in_output_queue == exp_bs);
+
+}
+
+template <typename E>
+void lock_free_io_common_api_test(const E& elem) {
+
+  using lf_io_common = chops::net::detail::lock_free_io_common<E>;
+
+  lf_io_common iocommon { };
+
+  check_queue_stats(iocommon, 0u, 0u);
+
+  REQUIRE_FALSE (iocommon.is_io_started());
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+
+  auto s = iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (s == lf_io_common::write_status::io_stopped);
+  REQUIRE_FALSE (iocommon.set_io_stopped());
+
+  REQUIRE (iocommon.set_io_started());
+  REQUIRE (iocommon.is_io_started());
+  s = iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (s == lf_io_common::write_status::write_started);
+  check_queue_stats(iocommon, 0u, 0u);
+  REQUIRE (iocommon.is_write_in_progress());
+  s = iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (s == lf_io_common::write_status::queued);
+  check_queue_stats(iocommon, 1u, 1u*elem.size());
+  s = iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (s == lf_io_common::write_status::queued);
+  check_queue_stats(iocommon, 2u, 2u*elem.size());
+
+  iocommon.write_next_elem(empty_write_func<E>);
+  check_queue_stats(iocommon, 1u, 1u*elem.size());
+  REQUIRE (iocommon.is_write_in_progress());
+  iocommon.write_next_elem(empty_write_func<E>);
+  check_queue_stats(iocommon, 0u, 0u);
+  REQUIRE (iocommon.is_write_in_progress());
+  iocommon.write_next_elem(empty_write_func<E>);
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+
+  // batches
+  iocommon.set_write_batch_limits(3u, 0u);
+  std::vector<E> elems;
+  iocommon.start_write(elem, empty_write_func<E>);
+  chops::repeat(4, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  check_queue_stats(iocommon, 4u, 4u*elem.size());
+  iocommon.write_next_elems(elems, [] (const std::vector<E>&) { } );
+  REQUIRE (elems.size() == 3u);
+  iocommon.write_next_elems(elems, [] (const std::vector<E>&) { } );
+  REQUIRE (elems.size() == 1u);
+  iocommon.write_next_elems(elems, [] (const std::vector<E>&) { } );
+  REQUIRE (elems.empty());
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+  auto qs = iocommon.get_output_queue_stats();
+  REQUIRE (qs.num_write_batches == 2u);
+  REQUIRE (qs.bufs_in_write_batches == 4u);
+  REQUIRE (qs.max_write_batch_bufs == 3u);
+
+  // closing, the queued element is still written but new writes are refused
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.set_io_closing();
+  s = iocommon.start_write(elem, empty_write_func<E>);
+  REQUIRE (s == lf_io_common::write_status::io_stopped);
+  check_queue_stats(iocommon, 1u, 1u*elem.size());
+  iocommon.write_next_elem(empty_write_func<E>);
+  check_queue_stats(iocommon, 0u, 0u);
+  REQUIRE (iocommon.is_write_in_progress());
+  iocommon.write_next_elem(empty_write_func<E>);
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+
+  REQUIRE_FALSE (iocommon.set_io_started());
+  REQUIRE (iocommon.set_io_stopped());
+
+  iocommon.set_io_started();
+  iocommon.start_write(elem, empty_write_func<E>);
+  iocommon.start_write(elem, empty_write_func<E>);
+  check_queue_stats(iocommon, 1u, 1u*elem.size());
+  // write in progress, clear is deferred until the write completes
+  iocommon.clear();
+  check_queue_stats(iocommon, 1u, 1u*elem.size());
+  iocommon.set_io_stopped();
+  iocommon.write_next_elem(empty_write_func<E>);
+  check_queue_stats(iocommon, 0u, 0u);
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+
+}
+
+TEST_CASE ( "Lock free io common API test, single element",
+           "[lock_free_io_common] [single_element] [api]" ) {
+
+  lock_free_io_common_api_test(chops::test::make_io_buf1());
+
+}
+
+TEST_CASE ( "Lock free io common API test, double element",
+           "[lock_free_io_common] [double_element] [api]" ) {
+
+  lock_free_io_common_api_test(chops::test::io_buf_and_int(chops::test::make_io_buf2()));
+
+}
+
+TEST_CASE ( "Lock free io common overflow test",
+           "[lock_free_io_common] [overflow]" ) {
+
+  using E = chops::const_shared_buffer;
+  using sr = chops::net::send_result;
+  auto elem = chops::test::make_io_buf1();
+
+  for (auto pol : { chops::net::queue_overflow_policy::reject,
+                    chops::net::queue_overflow_policy::drop_oldest,
+                    chops::net::queue_overflow_policy::drop_newest,
+                    chops::net::queue_overflow_policy::close_io } ) {
+    chops::net::detail::lock_free_io_common<E> iocommon { };
+    REQUIRE (iocommon.set_io_started());
+    iocommon.set_output_queue_limit(3u, pol);
+
+    REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == sr::write_started);
+    chops::repeat(3, [&iocommon, &elem] {
+        REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == sr::queued);
+      }
+    );
+    auto s = iocommon.start_write(elem, empty_write_func<E>);
+    REQUIRE (iocommon.get_output_queue_stats().num_overflows == 1u);
+    switch (pol) {
+    case chops::net::queue_overflow_policy::reject:
+      REQUIRE (s == sr::rejected);
+      check_queue_stats(iocommon, 3u, 3u*elem.size());
+      break;
+    case chops::net::queue_overflow_policy::drop_oldest:
+      REQUIRE (s == sr::queued_dropped_oldest);
+      // excess is discarded by the consumer
+      check_queue_stats(iocommon, 4u, 4u*elem.size());
+      break;
+    case chops::net::queue_overflow_policy::drop_newest:
+      REQUIRE (s == sr::dropped_newest);
+      check_queue_stats(iocommon, 3u, 3u*elem.size());
+      break;
+    case chops::net::queue_overflow_policy::close_io:
+      REQUIRE (s == sr::overflow_closed);
+      check_queue_stats(iocommon, 3u, 3u*elem.size());
+      break;
+    }
+    // next write takes one element, leaving two
+    iocommon.write_next_elem(empty_write_func<E>);
+    check_queue_stats(iocommon, 2u, 2u*elem.size());
+    REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == sr::queued);
+
+    // unbounded
+    iocommon.set_output_queue_limit(0u, pol);
+    chops::repeat(10, [&iocommon, &elem] {
+        REQUIRE (iocommon.start_write(elem, empty_write_func<E>) == sr::queued);
+      }
+    );
+    check_queue_stats(iocommon, 13u, 13u*elem.size());
+    REQUIRE (iocommon.set_io_stopped());
+    iocommon.write_next_elem(empty_write_func<E>);
+    check_queue_stats(iocommon, 0u, 0u);
+  }
+
+}
+
+TEST_CASE ( "Lock free io common water mark test",
+           "[lock_free_io_common] [water_mark]" ) {
+
+  using E = chops::const_shared_buffer;
+  auto elem = chops::test::make_io_buf1();
+
+  chops::net::detail::lock_free_io_common<E> iocommon { };
+  REQUIRE (iocommon.set_io_started());
+
+  int notifies = 0;
+  iocommon.set_water_marks(chops::net::output_queue_water_marks { 4u, 1u, 0u, 0u },
+                           [&notifies] { ++notifies; } );
+  REQUIRE (notifies == 1);
+  REQUIRE_FALSE (iocommon.check_water_marks());
+
+  iocommon.start_write(elem, empty_write_func<E>);
+  chops::repeat(4, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  REQUIRE (notifies == 2);
+  auto c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE (*c);
+  REQUIRE_FALSE (iocommon.check_water_marks());
+
+  chops::repeat(2, [&iocommon] { iocommon.write_next_elem(empty_write_func<E>); } );
+  REQUIRE (notifies == 2);
+  REQUIRE_FALSE (iocommon.check_water_marks());
+  iocommon.write_next_elem(empty_write_func<E>);
+  REQUIRE (notifies == 3);
+  c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE_FALSE (*c);
+
+  // spike that drains before the check is not reported
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  REQUIRE (notifies == 4);
+  std::vector<E> elems;
+  iocommon.set_write_batch_limits(10u, 0u);
+  iocommon.write_next_elems(elems, [] (const std::vector<E>&) { } );
+  REQUIRE (notifies == 5);
+  REQUIRE_FALSE (iocommon.check_water_marks());
+
+  iocommon.set_water_marks(chops::net::output_queue_water_marks { 1u, 0u, 0u, 0u },
+                           std::function<void ()> { } );
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  REQUIRE (notifies == 5);
+  REQUIRE_FALSE (iocommon.check_water_marks());
+
+  // above the high water mark when IO stops, a restart reports the next crossing again
+  int cnt = 0;
+  iocommon.set_water_marks(chops::net::output_queue_water_marks { 2u, 0u, 0u, 0u },
+                           [&cnt] { ++cnt; } );
+  iocommon.clear();
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE (*c);
+  REQUIRE (iocommon.set_io_stopped());
+  REQUIRE_FALSE (iocommon.check_water_marks());
+  iocommon.clear();
+  REQUIRE (iocommon.set_io_started());
+  chops::repeat(3, [&iocommon, &elem] { iocommon.start_write(elem, empty_write_func<E>); } );
+  c = iocommon.check_water_marks();
+  REQUIRE (c);
+  REQUIRE (*c);
+  REQUIRE (iocommon.set_io_stopped());
+}
+
+// The following simulates a network IO handler - the write function posts a write
+// completion to the IO context, and the completion calls into the io common object for
+// the next write (batch); all of the sends happen from multiple sender threads
+template <typename IOC>
+struct write_sim {
+  using buf_vec = std::vector<chops::const_shared_buffer>;
+
+  asio::io_context&             m_ioc;
+  IOC&                          m_io_common;
+  buf_vec                       m_bufs;
+  std::atomic_size_t            m_num_written;
+  std::atomic_size_t            m_bytes_written;
+  std::size_t                   m_concurrent_writes;
+
+  write_sim(asio::io_context& ioc, IOC& io_common) : m_ioc(ioc), m_io_common(io_common),
+      m_bufs(), m_num_written(0u), m_bytes_written(0u), m_concurrent_writes(0u) { }
+
+  void start_write() {
+    ++m_concurrent_writes;
+    assert (m_concurrent_writes == 1u);
+    asio::post(m_ioc, [this] { handle_write(); } );
+  }
+
+  void handle_write() {
+    --m_concurrent_writes;
+    std::size_t nb = 0u;
+    for (const auto& b : m_bufs) {
+      nb += b.size();
+    }
+    m_bytes_written += nb;
+    m_num_written += m_bufs.size();
+    m_io_common.write_next_elems(m_bufs, [this] (const buf_vec&) { start_write(); } );
+  }
+
+  bool send(const chops::const_shared_buffer& buf) {
+    auto r = m_io_common.start_write(buf, [this] (const chops::const_shared_buffer& b) {
+        m_bufs.clear();
+        m_bufs.push_back(b);
+        start_write();
+      }
+    );
+    return r != IOC::write_status::io_stopped;
+  }
+};
+
+template <typename IOC>
+std::chrono::microseconds contention_run(int num_thrs, int num_sends, std::size_t max_batch) {
+
+  chops::net::worker wk;
+  wk.start();
+
+  IOC iocommon { };
+  iocommon.set_io_started();
+  iocommon.set_write_batch_limits(max_batch, 0u);
+
+  write_sim<IOC> sim(wk.get_io_context(), iocommon);
+  auto buf = chops::test::make_io_buf1();
+
+  std::promise<void> go_prom;
+  std::shared_future<void> go_fut(go_prom.get_future());
+  std::vector<std::future<void>> futs;
+  chops::repeat(num_thrs, [&futs, &sim, &buf, go_fut, num_sends] {
+      futs.push_back(std::async(std::launch::async, [&sim, &buf, go_fut, num_sends] {
+          go_fut.wait();
+          chops::repeat(num_sends, [&sim, &buf] { sim.send(buf); } );
+        }
+      ));
+    }
+  );
+  auto start = std::chrono::steady_clock::now();
+  go_prom.set_value();
+  for (auto& f : futs) {
+    f.get();
+  }
+  std::size_t tot = static_cast<std::size_t>(num_thrs) * num_sends;
+  while (sim.m_num_written < tot) {
+    std::this_thread::yield();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  wk.reset();
+
+  REQUIRE (sim.m_num_written == tot);
+  REQUIRE (sim.m_bytes_written == tot * buf.size());
+  auto qs = iocommon.get_output_queue_stats();
+  REQUIRE (qs.output_queue_size == 0u);
+  REQUIRE (qs.bytes_in_output_queue == 0u);
+  REQUIRE (qs.max_write_batch_bufs <= max_batch);
+  REQUIRE_FALSE (iocommon.is_write_in_progress());
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+}
+
+TEST_CASE ( "Lock free io common stress test, simulated writes, multiple sender threads",
+            "[lock_free_io_common] [stress]" ) {
+
+  for (int thrs : { 1, 4, 16 }) {
+    for (std::size_t batch : { 1u, 16u }) {
+      INFO ("Threads: " << thrs << ", max batch: " << batch);
+      contention_run<chops::net::detail::lock_free_io_common<chops::const_shared_buffer>>(thrs,
+                                                                          2000, batch);
+      contention_run<chops::net::detail::io_common<chops::const_shared_buffer>>(thrs,
+                                                                          2000, batch);
+    }
+  }
+
+}
+
+TEST_CASE ( "Contention benchmark, mutex io common versus lock free io common",
+            "[lock_free_io_common] [io_common] [benchmark] [.]" ) {
+
+  constexpr int num_sends = 100000;
+
+  std::cout << "Contention benchmark, " << num_sends << " sends per thread, times in ms\n" <<
+               "threads  batch     mutex  lock-free\n";
+  for (int thrs : { 1, 2, 4, 8, 16, 32 }) {
+    for (std::size_t batch : { 1u, 32u }) {
+      auto mtx = contention_run<chops::net::detail::io_common<chops::const_shared_buffer>>(thrs,
+                                                                          num_sends, batch);
+      auto lf = contention_run<chops::net::detail::lock_free_io_common<chops::const_shared_buffer>>(thrs,
+                                                                          num_sends, batch);
+      std::cout << std::setw(7) << thrs << std::setw(7) << batch <<
+                   std::setw(10) << mtx.count() / 1000 << std::setw(11) << lf.count() / 1000 << "\n";
+    }
+  }
+  std::cout << std::flush;
+
+}
+
@@ -72,6 +72,55 @@ void output_queue_test(const std::vector<E>& data_vec, int multiplier) {
   REQUIRE (qs.bytes_in_output_queue == 0u);
 }
 
+template <typename E>
+void output_queue_batch_test(const std::vector<E>& data_vec, int multiplier) {
+
+  chops::net::detail::output_queue<E> outq { };
+
+  auto tot = add_to_q(data_vec, outq, multiplier);
+  auto tot_bytes = chops::test::accum_io_buf_size(data_vec) * multiplier;
+
+  std::vector<E> elems;
+  // byte limit smaller than any element, one element still returned
+  REQUIRE (outq.get_next_elements(elems, 10u, 1u) == 1u);
+  REQUIRE (elems.size() == 1u);
+  // element limit
+  elems.clear();
+  REQUIRE (outq.get_next_elements(elems, 2u, 10000u) == 2u);
+  REQUIRE (elems.size() == 2u);
+  auto qs = outq.get_queue_stats();
+  REQUIRE (qs.output_queue_size == tot - 3u);
+  REQUIRE (qs.num_write_batches == 2u);
+  REQUIRE (qs.bufs_in_write_batches == 3u);
+  REQUIRE (qs.max_write_batch_bufs == 2u);
+  // drain the rest in one batch
+  elems.clear();
+  REQUIRE (outq.get_next_elements(elems, tot, tot_bytes) == tot - 3u);
+  qs = outq.get_queue_stats();
+  REQUIRE (qs.output_queue_size == 0u);
+  REQUIRE (qs.bytes_in_output_queue == 0u);
+  REQUIRE (qs.num_write_batches == 3u);
+  REQUIRE (qs.bufs_in_write_batches == tot);
+  elems.clear();
+  REQUIRE (outq.get_next_elements(elems, 10u, 10000u) == 0u);
+  REQUIRE (elems.empty());
+  REQUIRE (outq.get_queue_stats().num_write_batches == 3u);
+}
+
+TEST_CASE ( "Output_queue batch test, single element, multiplier 10", 
+           "[output_queue] [single_element] [multiplier_10] [batch]" ) {
+
+  output_queue_batch_test(chops::test::make_io_buf_vec(), 10);
+
+}
+
+TEST_CASE ( "Output_queue batch test, double element, multiplier 20",
+           "[output_queue] [double_element] [multiplier_20] [batch]" ) {
+
+  output_queue_batch_test(chops::test::make_io_buf_and_int_vec(), 20);
+
+}
+
 TEST_CASE ( "Output_queue test, single element, multiplier 1", 
            "[output_queue] [single_element] [multiplier_1]" ) {
 
@@ -0,0 +1,98 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c read_buffer_pool detail class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include <cstddef> // std::size_t
+#include <utility> // std::move
+
+#include "net_ip/detail/read_buffer_pool.hpp"
+#include "net_ip/queue_stats.hpp"
+
+SCENARIO ( "Read buffer pool acquire and release",
+           "[read_buffer_pool]" ) {
+  using chops::net::detail::read_buffer_pool;
+  using chops::net::read_buffer_pool_config;
+
+  read_buffer_pool_config cfg;
+  cfg.min_class_size = 256u;
+  cfg.shrink_threshold = 4096u;
+  cfg.max_pooled_per_class = 2u;
+
+  GIVEN ("An empty pool") {
+    read_buffer_pool pool(cfg);
+    REQUIRE (pool.shrink_threshold() == 4096u);
+    WHEN ("buffers are acquired") {
+      auto b1 = pool.acquire(10u);
+      auto b2 = pool.acquire(300u);
+      auto b3 = pool.acquire(10000u);
+      THEN ("sizes are as requested, with the capacity of the size class") {
+        REQUIRE (b1.size() == 10u);
+        REQUIRE (b1.capacity() >= 256u);
+        REQUIRE (b2.size() == 300u);
+        REQUIRE (b2.capacity() >= 512u);
+        REQUIRE (b3.size() == 10000u);
+        auto st = pool.get_stats();
+        REQUIRE (st.num_acquires == 3u);
+        REQUIRE (st.num_pool_hits == 0u);
+        REQUIRE (st.bufs_pooled == 0u);
+      }
+    }
+    AND_WHEN ("buffers are released and acquired again") {
+      auto b1 = pool.acquire(300u);
+      auto cap = b1.capacity();
+      pool.release(std::move(b1));
+      auto st = pool.get_stats();
+      REQUIRE (st.bufs_pooled == 1u);
+      REQUIRE (st.bytes_pooled == cap);
+      auto b2 = pool.acquire(400u);
+      THEN ("the pooled buffer is reused") {
+        REQUIRE (b2.size() == 400u);
+        REQUIRE (b2.capacity() == cap);
+        st = pool.get_stats();
+        REQUIRE (st.num_pool_hits == 1u);
+        REQUIRE (st.bufs_pooled == 0u);
+        REQUIRE (st.bytes_pooled == 0u);
+      }
+    }
+    AND_WHEN ("buffers above the threshold, or over the class limit, are released") {
+      pool.release(pool.acquire(10000u));
+      pool.release(pool.acquire(100u));
+      pool.release(pool.acquire(100u));
+      pool.release(pool.acquire(100u));
+      pool.release(read_buffer_pool::byte_vec());
+      THEN ("they are discarded") {
+        auto st = pool.get_stats();
+        REQUIRE (st.num_releases == 4u);
+        REQUIRE (st.bufs_pooled == 1u);
+        REQUIRE (st.num_discards == 1u);
+      }
+    }
+    AND_WHEN ("more buffers than the class limit are released") {
+      auto b1 = pool.acquire(100u);
+      auto b2 = pool.acquire(100u);
+      auto b3 = pool.acquire(100u);
+      pool.release(std::move(b1));
+      pool.release(std::move(b2));
+      pool.release(std::move(b3));
+      THEN ("the extra buffers are discarded") {
+        auto st = pool.get_stats();
+        REQUIRE (st.bufs_pooled == 2u);
+        REQUIRE (st.num_discards == 1u);
+      }
+    }
+  } // end given
+}
+
@@ -0,0 +1,270 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c ring_output_queue detail class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include <vector>
+#include <cstddef> // std::size_t
+
+#include "net_ip/detail/ring_output_queue.hpp"
+
+#include "marshall/shared_buffer.hpp"
+
+#include "utility/repeat.hpp"
+
+#include "shared_test/io_buf.hpp"
+
+template <typename E>
+std::size_t add_to_q(const std::vector<E>& data_vec,
+                     chops::net::detail::ring_output_queue<E>& outq,
+                     int multiplier) {
+  chops::repeat(multiplier, [&data_vec, &outq] {
+      for (const auto& i : data_vec) {
+        outq.add_element(i);
+      }
+  } );
+  return data_vec.size() * multiplier;
+}
+
+template <typename E>
+void ring_output_queue_test(const std::vector<E>& data_vec, int multiplier) {
+
+  chops::net::detail::ring_output_queue<E> outq { };
+  REQUIRE (outq.capacity() == 0u);
+
+  auto tot = add_to_q(data_vec, outq, multiplier);
+
+  REQUIRE (outq.size() == tot);
+  REQUIRE (outq.capacity() >= tot);
+  auto qs = outq.get_queue_stats();
+  REQUIRE (qs.output_queue_size == tot);
+  REQUIRE (qs.bytes_in_output_queue == chops::test::accum_io_buf_size(data_vec) * multiplier);
+
+  // elements come out in the order they went in
+  for (int i = 0; i < multiplier; ++i) {
+    for (const auto& d : data_vec) {
+      auto e = outq.get_next_element();
+      REQUIRE (e);
+      REQUIRE (e->size() == d.size());
+    }
+  }
+  auto e = outq.get_next_element(); // should be empty optional
+  REQUIRE_FALSE (e); // no element val available
+  qs = outq.get_queue_stats();
+  REQUIRE (qs.output_queue_size == 0u);
+  REQUIRE (qs.bytes_in_output_queue == 0u);
+
+  add_to_q(data_vec, outq, 1);
+  REQUIRE_FALSE (outq.size() == 0u);
+
+  auto cap = outq.capacity();
+  outq.clear();
+  qs = outq.get_queue_stats();
+  REQUIRE (qs.output_queue_size == 0u);
+  REQUIRE (qs.bytes_in_output_queue == 0u);
+  REQUIRE (outq.capacity() == cap);
+}
+
+template <typename E>
+void ring_output_queue_wrap_test(const std::vector<E>& data_vec) {
+
+  chops::net::detail::ring_output_queue<E> outq { };
+  auto cap = data_vec.size() + 1u;
+  outq.reserve(cap);
+  REQUIRE (outq.capacity() == cap);
+
+  // keep the queue partly full while adding and removing, so the head and tail
+  // wrap around the end of the ring many times without the ring growing
+  add_to_q(data_vec, outq, 1);
+  chops::repeat(20, [&outq, &data_vec] {
+      for (const auto& d : data_vec) {
+        auto e = outq.get_next_element();
+        REQUIRE (e);
+        REQUIRE (e->size() == d.size());
+        outq.add_element(d);
+      }
+    }
+  );
+  REQUIRE (outq.capacity() == cap);
+  REQUIRE (outq.size() == data_vec.size());
+  REQUIRE (outq.get_queue_stats().bytes_in_output_queue ==
+           chops::test::accum_io_buf_size(data_vec));
+
+  // growing past the reserved capacity keeps the order
+  outq.add_element(data_vec.front());
+  outq.add_element(data_vec.back());
+  REQUIRE (outq.capacity() > cap);
+  for (const auto& d : data_vec) {
+    auto e = outq.get_next_element();
+    REQUIRE (e);
+    REQUIRE (e->size() == d.size());
+  }
+  REQUIRE (outq.get_next_element()->size() == data_vec.front().size());
+  REQUIRE (outq.get_next_element()->size() == data_vec.back().size());
+  REQUIRE (outq.size() == 0u);
+
+  // smaller reserve releases the excess storage
+  REQUIRE (outq.capacity() > 2u);
+  outq.reserve(2u);
+  REQUIRE (outq.capacity() == 2u);
+}
+
+template <typename E>
+void ring_output_queue_shrink_test(const std::vector<E>& data_vec) {
+
+  chops::net::detail::ring_output_queue<E> outq { };
+
+  // storage grown for a burst is given back as the queue drains
+  auto tot = add_to_q(data_vec, outq, 100);
+  auto burst_cap = outq.capacity();
+  REQUIRE (burst_cap >= tot);
+  while (outq.get_next_element()) { }
+  REQUIRE (outq.capacity() < burst_cap);
+  REQUIRE (outq.capacity() <= 16u);
+
+  // not below a reserved capacity, also when drained in one batch
+  outq.reserve(tot / 4u);
+  REQUIRE (outq.capacity() == tot / 4u);
+  add_to_q(data_vec, outq, 100);
+  REQUIRE (outq.capacity() >= tot);
+  std::vector<E> elems;
+  REQUIRE (outq.get_next_elements(elems, tot, tot * 10000u) == tot);
+  REQUIRE (outq.capacity() == tot / 4u);
+
+  // a smaller reserve with elements queued keeps room for them, in order
+  add_to_q(data_vec, outq, 10);
+  outq.reserve(1u);
+  REQUIRE (outq.capacity() == data_vec.size() * 10u);
+  for (int i = 0; i < 10; ++i) {
+    for (const auto& d : data_vec) {
+      auto e = outq.get_next_element();
+      REQUIRE (e);
+      REQUIRE (e->size() == d.size());
+    }
+  }
+  REQUIRE (outq.size() == 0u);
+
+  // with no reserve the ring shrinks down to its minimum
+  outq.reserve(0u);
+  REQUIRE (outq.capacity() == 0u);
+  add_to_q(data_vec, outq, 1);
+  REQUIRE (outq.get_next_element());
+  REQUIRE (outq.size() == data_vec.size() - 1u);
+}
+
+template <typename E>
+void ring_output_queue_batch_test(const std::vector<E>& data_vec, int multiplier) {
+
+  chops::net::detail::ring_output_queue<E> outq { };
+
+  auto tot = add_to_q(data_vec, outq, multiplier);
+  auto tot_bytes = chops::test::accum_io_buf_size(data_vec) * multiplier;
+
+  std::vector<E> elems;
+  // byte limit smaller than any element, one element still returned
+  REQUIRE (outq.get_next_elements(elems, 10u, 1u) == 1u);
+  REQUIRE (elems.size() == 1u);
+  // element limit
+  elems.clear();
+  REQUIRE (outq.get_next_elements(elems, 2u, 10000u) == 2u);
+  REQUIRE (elems.size() == 2u);
+  auto qs = outq.get_queue_stats();
+  REQUIRE (qs.output_queue_size == tot - 3u);
+  REQUIRE (qs.num_write_batches == 2u);
+  REQUIRE (qs.bufs_in_write_batches == 3u);
+  REQUIRE (qs.max_write_batch_bufs == 2u);
+  // drain the rest in one batch
+  elems.clear();
+  REQUIRE (outq.get_next_elements(elems, tot, tot_bytes) == tot - 3u);
+  qs = outq.get_queue_stats();
+  REQUIRE (qs.output_queue_size == 0u);
+  REQUIRE (qs.bytes_in_output_queue == 0u);
+  REQUIRE (qs.num_write_batches == 3u);
+  REQUIRE (qs.bufs_in_write_batches == tot);
+  elems.clear();
+  REQUIRE (outq.get_next_elements(elems, 10u, 10000u) == 0u);
+  REQUIRE (elems.empty());
+}
+
+TEST_CASE ( "Ring output queue test, single element, multiplier 1",
+           "[ring_output_queue] [single_element] [multiplier_1]" ) {
+
+  ring_output_queue_test(chops::test::make_io_buf_vec(), 1);
+
+}
+
+TEST_CASE ( "Ring output queue test, single element, multiplier 50",
+           "[ring_output_queue] [single_element] [multiplier_50]" ) {
+
+  ring_output_queue_test(chops::test::make_io_buf_vec(), 50);
+
+}
+
+TEST_CASE ( "Ring output queue test, double element, multiplier 1",
+           "[ring_output_queue] [double_element] [multiplier_1]" ) {
+
+  ring_output_queue_test(chops::test::make_io_buf_and_int_vec(), 1);
+
+}
+
+TEST_CASE ( "Ring output queue test, double element, multiplier 50",
+           "[ring_output_queue] [double_element] [multiplier_50]" ) {
+
+  ring_output_queue_test(chops::test::make_io_buf_and_int_vec(), 50);
+
+}
+
+TEST_CASE ( "Ring output queue wrap around test, single element",
+           "[ring_output_queue] [single_element] [wrap]" ) {
+
+  ring_output_queue_wrap_test(chops::test::make_io_buf_vec());
+
+}
+
+TEST_CASE ( "Ring output queue wrap around test, double element",
+           "[ring_output_queue] [double_element] [wrap]" ) {
+
+  ring_output_queue_wrap_test(chops::test::make_io_buf_and_int_vec());
+
+}
+
+TEST_CASE ( "Ring output queue shrink test, single element",
+           "[ring_output_queue] [single_element] [shrink]" ) {
+
+  ring_output_queue_shrink_test(chops::test::make_io_buf_vec());
+
+}
+
+TEST_CASE ( "Ring output queue shrink test, double element",
+           "[ring_output_queue] [double_element] [shrink]" ) {
+
+  ring_output_queue_shrink_test(chops::test::make_io_buf_and_int_vec());
+
+}
+
+TEST_CASE ( "Ring output queue batch test, single element, multiplier 10",
+           "[ring_output_queue] [single_element] [multiplier_10] [batch]" ) {
+
+  ring_output_queue_batch_test(chops::test::make_io_buf_vec(), 10);
+
+}
+
+TEST_CASE ( "Ring output queue batch test, double element, multiplier 20",
+           "[ring_output_queue] [double_element] [multiplier_20] [batch]" ) {
+
+  ring_output_queue_batch_test(chops::test::make_io_buf_and_int_vec(), 20);
+
+}
+
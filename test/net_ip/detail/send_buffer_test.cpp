@@ -0,0 +1,88 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c send_buffer detail class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include <vector>
+#include <cstddef> // std::size_t, std::byte
+#include <optional>
+
+#include "net_ip/detail/send_buffer.hpp"
+#include "net_ip/detail/ring_output_queue.hpp"
+
+#include "marshall/shared_buffer.hpp"
+
+#include "utility/make_byte_array.hpp"
+
+TEST_CASE ( "Send buffer test, shared buffer",
+           "[send_buffer] [shared]" ) {
+
+  auto ba = chops::make_byte_array(0x20, 0x21, 0x22, 0x23);
+  chops::const_shared_buffer csb(ba.data(), ba.size());
+
+  chops::net::detail::send_buffer sb(csb);
+  REQUIRE (sb.size() == 4u);
+  REQUIRE (sb.data() == csb.data());
+  {
+    auto sb2 = sb;
+    REQUIRE (sb2.data() == csb.data());
+  }
+  REQUIRE (sb.data()[3] == std::byte{0x23});
+}
+
+TEST_CASE ( "Send buffer test, application owned memory with release hook",
+           "[send_buffer] [no_copy]" ) {
+
+  auto ba = chops::make_byte_array(0x20, 0x21, 0x22, 0x23, 0x24);
+  int num_released = 0;
+  const void* released_ptr = nullptr;
+  std::size_t released_sz = 0u;
+
+  {
+    std::optional<chops::net::detail::send_buffer> sb;
+    sb.emplace(ba.data(), ba.size(), 
+        [&num_released, &released_ptr, &released_sz] (const void* p, std::size_t sz) {
+          ++num_released;
+          released_ptr = p;
+          released_sz = sz;
+        }
+    );
+    REQUIRE (sb->size() == ba.size());
+    REQUIRE (sb->data() == ba.data()); // no copy
+
+    // copies through a queue share the hook, released once when the last copy goes away
+    chops::net::detail::ring_output_queue<chops::net::detail::send_buffer> outq;
+    outq.add_element(*sb);
+    outq.add_element(*sb);
+    sb.reset();
+    REQUIRE (num_released == 0);
+    auto e = outq.get_next_element();
+    REQUIRE (e);
+    REQUIRE (e->data() == ba.data());
+    e.reset();
+    REQUIRE (num_released == 0);
+    outq.clear();
+  }
+  REQUIRE (num_released == 1);
+  REQUIRE (released_ptr == ba.data());
+  REQUIRE (released_sz == ba.size());
+
+  // an empty hook is allowed
+  {
+    chops::net::detail::send_buffer sb(ba.data(), ba.size(), chops::net::buffer_release_hook { });
+    REQUIRE (sb.size() == ba.size());
+  }
+}
+
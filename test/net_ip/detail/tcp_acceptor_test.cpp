@@ -37,12 +37,15 @@
 #include <functional> // std::ref, std::cref
 #include <string_view>
 #include <vector>
+#include <set>
+#include <mutex>
 
 #include <cassert>
 
 #include "net_ip/detail/tcp_acceptor.hpp"
 
 #include "net_ip_component/worker.hpp"
+#include "net_ip_component/worker_pool.hpp"
 #include "net_ip_component/error_delivery.hpp"
 
 #include "net_ip/io_type_decls.hpp"
@@ -459,3 +462,110 @@ TEST_CASE ( "Tcp acceptor test,  LF msgs, two-way, interval 0, 25 connectors, ma
                   std::string_view("\n"), make_empty_lf_text_msg() );
 
 }
+
+// each context of the pool is run by one thread, so the thread that handles a message 
+// identifies the context of the connection; returns the number of contexts used
+template <typename F>
+std::size_t multi_context_test (chops::net::worker_pool& wp, F&& setup, int num_conns) {
+
+  chops::net::err_wait_q err_wq;
+  auto err_fut = std::async(std::launch::async,
+        chops::net::ostream_error_sink_with_wait_queue,
+        std::ref(err_wq), std::ref(std::cerr));
+
+  auto var_msg_vec = make_msg_vec (make_variable_len_msg, "Contexts!", 'C', num_msgs);
+  std::set<std::thread::id> thr_ids;
+
+  {
+    auto acc_ptr = std::make_shared<chops::net::detail::tcp_acceptor>(wp.get_io_context(0u), 
+                                  std::string_view(test_port), std::string_view(), true);
+    setup(*acc_ptr);
+
+    std::mutex mut;
+    test_counter recv_cnt = 0;
+    std::promise<std::size_t> prom;
+    auto max_fut = prom.get_future();
+    auto r = acc_ptr->start( [&mut, &thr_ids, &recv_cnt, &prom, num_conns]
+                      (chops::net::tcp_io_interface io, std::size_t num, bool starting ) {
+        if (starting) {
+          auto r = io.start_io(2, [&mut, &thr_ids, hdlr = tcp_msg_hdlr(true, recv_cnt)] 
+                  (asio::const_buffer buf, chops::net::tcp_io_output io_out, 
+                   asio::ip::tcp::endpoint endp) mutable {
+                {
+                  std::lock_guard<std::mutex> lk(mut);
+                  thr_ids.insert(std::this_thread::get_id());
+                }
+                return hdlr(buf, io_out, endp);
+              },
+              decode_variable_len_msg_hdr);
+          assert (r);
+          if (num == static_cast<std::size_t>(num_conns)) {
+            prom.set_value(num);
+          }
+        }
+      },
+      chops::net::make_error_func_with_wait_queue<chops::net::tcp_io>(err_wq)
+    );
+    REQUIRE_FALSE (r);
+    REQUIRE(acc_ptr->is_started());
+
+    asio::io_context ioc; // only used for blocking connects and name resolving
+    auto conn_fut = std::async(std::launch::async, start_var_data_funcs, 
+                               std::cref(var_msg_vec), std::ref(ioc), true, 0, num_conns,
+                               std::string_view(), make_empty_variable_len_msg());
+    // the connection count is combined across the contexts
+    REQUIRE (max_fut.get() == static_cast<std::size_t>(num_conns));
+    auto conn_cnt = conn_fut.get();
+
+    acc_ptr->stop();
+    REQUIRE_FALSE(acc_ptr->is_started());
+
+    std::size_t total_msgs = num_conns * var_msg_vec.size();
+    REQUIRE (total_msgs == recv_cnt);
+    REQUIRE (total_msgs == conn_cnt);
+  }
+
+  while (!err_wq.empty()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  err_wq.close();
+  auto cnt = err_fut.get();
+  INFO ("Number of messages passed thru error queue: " << cnt);
+  return thr_ids.size();
+}
+
+TEST_CASE ( "Tcp acceptor test, sharded listening sockets, var len msgs, two-way, 20 connectors",
+           "[tcp_acc] [var_len_msg] [two_way] [interval_0] [connectors_20] [sharded]" ) {
+
+  chops::net::worker_pool wp(3u, 3u);
+  wp.start();
+
+  if constexpr (chops::net::detail::reuse_port_supported) {
+    auto n = multi_context_test(wp, [&wp] (chops::net::detail::tcp_acceptor& acc) {
+          acc.set_shards(wp.get_io_contexts());
+          assert (acc.num_shards() == 3u);
+        }, 20);
+    // the kernel spreads the connections, almost certainly over more than one shard
+    REQUIRE (n > 1u);
+  }
+  wp.reset();
+}
+
+TEST_CASE ( "Tcp acceptor test, connections placed on target contexts, var len msgs, two-way, 20 connectors",
+           "[tcp_acc] [var_len_msg] [two_way] [interval_0] [connectors_20] [io_targets]" ) {
+
+  chops::net::worker_pool wp(3u, 3u);
+  wp.start();
+
+  auto n = multi_context_test(wp, [&wp] (chops::net::detail::tcp_acceptor& acc) {
+        acc.set_io_targets(wp.get_io_contexts(), chops::net::detail::accept_placement::round_robin);
+      }, 20);
+  REQUIRE (n == 3u);
+
+  n = multi_context_test(wp, [&wp] (chops::net::detail::tcp_acceptor& acc) {
+        acc.set_io_targets(wp.get_io_contexts(), chops::net::detail::accept_placement::least_loaded);
+      }, 20);
+  REQUIRE (n == 3u);
+
+  wp.reset();
+}
@@ -17,6 +17,7 @@
 
 #include "asio/ip/tcp.hpp"
 #include "asio/connect.hpp"
+#include "asio/write.hpp"
 #include "asio/io_context.hpp"
 
 #include <system_error> // std::error_code
@@ -28,10 +29,18 @@
 #include <chrono>
 #include <functional> // std::ref, std::cref
 #include <string_view>
+#include <vector>
+#include <atomic>
+#include <array>
+#include <algorithm> // std::max
 
 #include <cassert>
 
 #include "net_ip/detail/tcp_io.hpp"
+#include "net_ip/detail/read_buffer_pool.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
+#include "net_ip/fixed_len_prefix_frame.hpp"
+#include "net_ip/varint_len_prefix_frame.hpp"
 
 #include "net_ip_component/worker.hpp"
 
@@ -86,24 +95,62 @@ conn_info perform_connect (asio::io_context& ioc) {
 
 std::size_t var_conn_func (const vec_buf& var_msg_vec, asio::io_context& ioc, 
                            int interval, std::string_view delim, 
-                           const chops::const_shared_buffer& empty_msg) {
+                           const chops::const_shared_buffer& empty_msg,
+                           std::size_t max_batch_bufs, std::size_t read_buf_size) {
 
   auto info = perform_connect(ioc);
   const auto& iohp = info.first;
   auto& fut = info.second;
 
+  iohp->set_write_batch_limits(max_batch_bufs, 0u);
+  iohp->set_read_buffer_size(read_buf_size);
+  // water mark callbacks are invoked in the IO thread, and the vector is only read after 
+  // the connection is closed
+  std::vector<bool> wm_calls;
+  iohp->set_output_queue_water_marks(chops::net::output_queue_water_marks { 8u, 2u, 0u, 0u },
+            [&wm_calls] (chops::net::tcp_io_output, bool high) { wm_calls.push_back(high); } );
+
   test_counter cnt = 0;
   auto r = tcp_start_io(chops::net::tcp_io_interface(iohp), false, delim, cnt);
   assert (r);
 
+  // every other message is sent without a copy, the vector owns the memory
+  std::atomic_size_t num_released { 0u };
+  std::size_t num_no_copy = 0u;
+  bool no_copy = false;
   for (const auto& buf : var_msg_vec) {
-    iohp->send(buf);
+    if (no_copy) {
+      iohp->send_no_copy(buf.data(), buf.size(), 
+              [&num_released] (const void*, std::size_t) { ++num_released; } );
+      ++num_no_copy;
+    }
+    else {
+      iohp->send(buf);
+    }
+    no_copy = !no_copy;
     std::this_thread::sleep_for(std::chrono::milliseconds(interval));
   }
-  iohp->send(empty_msg);
+  // the empty message is the last one written, so its completion is delivered before
+  // the other side closes the connection
+  auto completion_fut = chops::net::tcp_io_output(iohp).send_with_completion(empty_msg);
 
   auto err = fut.get();
-  std::cerr << "TCP IO handler, variable msg conn, err: " << err << ", " << err.message() << std::endl;
+  auto sc = completion_fut.get();
+  assert (!sc.err);
+  assert (sc.num_bytes == empty_msg.size());
+  // writes complete in order, so all of the earlier buffers have been released
+  assert (num_released == num_no_copy);
+  auto qs = iohp->get_output_queue_stats();
+  assert (qs.max_write_batch_bufs <= max_batch_bufs);
+  assert (qs.total_bufs_sent == var_msg_vec.size() + 1u);
+  for (std::size_t i = 0u; i < wm_calls.size(); ++i) {
+    assert (wm_calls[i] == (i % 2u == 0u)); // alternates, starting with high
+  }
+  std::cerr << "TCP IO handler, variable msg conn, err: " << err << ", " << err.message() << 
+               ", write batches: " << qs.num_write_batches << ", bufs in batches: " << 
+               qs.bufs_in_write_batches << ", max batch: " << qs.max_write_batch_bufs << 
+               ", water mark crossings: " << wm_calls.size() << ", bytes sent: " <<
+               qs.total_bytes_sent << ", writes: " << qs.total_writes << std::endl;
 
   return cnt.load();
 }
@@ -131,20 +178,48 @@ std::size_t fixed_conn_func (const vec_buf& fixed_msg_vec, asio::io_context& ioc
   return fixed_msg_vec.size();
 }
 
-conn_info perform_accept (asio::ip::tcp::acceptor& acc) {
+conn_info perform_accept (asio::ip::tcp::acceptor& acc, 
+                          chops::net::detail::read_buffer_pool_ptr pool = 
+                              chops::net::detail::read_buffer_pool_ptr(),
+                          chops::net::detail::timer_wheel_ptr wheel = 
+                              chops::net::detail::timer_wheel_ptr()) {
 
   notify_prom_type notify_prom;
   auto notify_fut = notify_prom.get_future();
 
   auto iohp = std::make_shared<chops::net::detail::tcp_io>(std::move(acc.accept()), 
-                                                           notify_me(std::move(notify_prom)));
+                                                           notify_me(std::move(notify_prom)),
+                                                           pool, wheel);
   return conn_info(iohp, std::move(notify_fut));
 
 }
 
+// a plain client socket connected to an accepted tcp_io, for tests that write the 
+// incoming byte stream (or read the output) directly
+using connected_pair = std::pair<asio::ip::tcp::socket, conn_info>;
+
+connected_pair make_connected_pair (asio::io_context& ioc,
+                                    chops::net::detail::read_buffer_pool_ptr pool = 
+                                        chops::net::detail::read_buffer_pool_ptr(),
+                                    chops::net::detail::timer_wheel_ptr wheel = 
+                                        chops::net::detail::timer_wheel_ptr()) {
+
+  auto res = 
+      chops::net::endpoints_resolver<asio::ip::tcp>(ioc).make_endpoints(true, test_addr, test_port);
+  REQUIRE(res);
+
+  asio::ip::tcp::acceptor acc(ioc, *(res->cbegin()));
+  asio::ip::tcp::socket sock(ioc);
+  sock.connect(acc.local_endpoint());
+  auto info = perform_accept(acc, pool, wheel);
+  return connected_pair(std::move(sock), std::move(info));
+
+}
+
 void perform_test (const vec_buf& var_msg_vec, const vec_buf& fixed_msg_vec,
                    bool reply, int interval, std::string_view delim,
-                   const chops::const_shared_buffer& empty_msg) {
+                   const chops::const_shared_buffer& empty_msg,
+                   std::size_t max_batch_bufs = 1u, std::size_t read_buf_size = 0u) {
 
   chops::net::worker wk;
   wk.start();
@@ -160,12 +235,15 @@ void perform_test (const vec_buf& var_msg_vec, const vec_buf& fixed_msg_vec,
     INFO ("Creating var connector asynchronously, msg interval: " << interval);
 
     auto conn_fut = std::async(std::launch::async, var_conn_func, std::cref(var_msg_vec), 
-                                     std::ref(ioc), interval, delim, empty_msg);
+                                     std::ref(ioc), interval, delim, empty_msg, max_batch_bufs,
+                                     read_buf_size);
 
     auto info = perform_accept(acc);
     const auto& iohp = info.first;
     auto& fut = info.second;
 
+    iohp->set_write_batch_limits(max_batch_bufs, 0u);
+    iohp->set_read_buffer_size(read_buf_size);
     test_counter cnt = 0;
     auto r = tcp_start_io(chops::net::tcp_io_interface(iohp), reply, delim, cnt);
     assert (r);
@@ -195,6 +273,7 @@ void perform_test (const vec_buf& var_msg_vec, const vec_buf& fixed_msg_vec,
     test_counter cnt = 0;
     test_prom prom;
     auto mh_fut = prom.get_future();
+    iohp->set_read_buffer_size(read_buf_size);
     REQUIRE (iohp->start_io(fixed_size_buf_size, 
                        tcp_fixed_size_msg_hdlr(std::move(prom), fixed_msg_vec.size(), cnt)));
 
@@ -336,3 +415,478 @@ TEST_CASE ( "Tcp IO handler test, LF msgs, two-way, interval 0, many msgs",
 
 }
 
+TEST_CASE ( "Tcp IO handler test, variable len header msgs, two-way, interval 0, write batching",
+            "[tcp_io] [var_len_msg] [two_way] [interval_0] [many] [batch]" ) {
+
+  perform_test ( make_msg_vec (make_variable_len_msg, "Batch me!", 'B', 50*num_msgs),
+                 make_fixed_size_msg_vec(50*num_msgs),
+                 true, 0, 
+                 std::string_view(), make_empty_variable_len_msg(), 32u );
+
+}
+
+TEST_CASE ( "Tcp IO handler test, LF msgs, two-way, interval 0, write batching",
+            "[tcp_io] [lf_msg] [two_way] [interval_0] [many] [batch]" ) {
+
+  perform_test ( make_msg_vec (make_lf_text_msg, "Batch, fast!", 'b', 100*num_msgs),
+                 make_fixed_size_msg_vec(100*num_msgs),
+                 true, 0, 
+                 std::string_view("\n"), make_empty_lf_text_msg(), 16u );
+
+}
+
+TEST_CASE ( "Tcp IO handler test, variable len header msgs, one-way, interval 0, buffered reads",
+            "[tcp_io] [var_len_msg] [one_way] [interval_0] [many] [buffered_read]" ) {
+
+  // one-way, since replies to the messages read with the final empty message can still 
+  // be queued when the connection is closed
+  perform_test ( make_msg_vec (make_variable_len_msg, "Buffer me!", 'R', 50*num_msgs),
+                 make_fixed_size_msg_vec(50*num_msgs),
+                 false, 0, 
+                 std::string_view(), make_empty_variable_len_msg(), 32u, 65536u );
+
+}
+
+TEST_CASE ( "Tcp IO handler test, variable len header msgs, two-way, interval 0, small read buffer",
+            "[tcp_io] [var_len_msg] [two_way] [interval_0] [buffered_read]" ) {
+
+  // messages span reads and are larger than the buffer, so the buffer grows
+  perform_test ( make_msg_vec (make_variable_len_msg, "Small buffer, big message!", 'S', 5*num_msgs),
+                 make_fixed_size_msg_vec(5*num_msgs),
+                 true, 0, 
+                 std::string_view(), make_empty_variable_len_msg(), 1u, 7u );
+
+}
+
+// the message handler takes ownership of each message, all of them are held until the
+// connection closes and then compared with the messages sent
+void perform_owned_buf_test (const vec_buf& msg_vec, std::string_view delim,
+                             const chops::const_shared_buffer& empty_msg,
+                             std::size_t read_buf_size) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  auto conn = make_connected_pair(ioc);
+  auto& sock = conn.first;
+  const auto& iohp = conn.second.first;
+  auto& fut = conn.second.second;
+
+  iohp->set_read_buffer_size(read_buf_size);
+  // only used in the IO thread until the connection is closed
+  vec_buf recvd;
+  auto hdlr = [&recvd] (chops::const_shared_buffer buf, chops::net::tcp_io_output, 
+                        asio::ip::tcp::endpoint) {
+    bool more = buf.size() > 2u;
+    recvd.push_back(std::move(buf));
+    return more;
+  };
+  auto r = delim.empty() ? 
+    chops::net::tcp_io_interface(iohp).start_io(2, hdlr, decode_variable_len_msg_hdr) :
+    chops::net::tcp_io_interface(iohp).start_io(delim, hdlr);
+  REQUIRE (r);
+
+  for (const auto& buf : msg_vec) {
+    asio::write(sock, asio::const_buffer(buf.data(), buf.size()));
+  }
+  asio::write(sock, asio::const_buffer(empty_msg.data(), empty_msg.size()));
+
+  auto err = fut.get();
+  REQUIRE (err == std::make_error_code(chops::net::net_ip_errc::message_handler_terminated));
+  REQUIRE (recvd.size() == msg_vec.size() + 1u);
+  for (std::size_t i = 0u; i < msg_vec.size(); ++i) {
+    REQUIRE (recvd[i] == msg_vec[i]);
+  }
+
+  wk.reset();
+}
+
+TEST_CASE ( "Tcp IO handler test, owned message buffers",
+            "[tcp_io] [owned_buf]" ) {
+
+  SECTION ("Variable len header msgs, moved from the read buffer") {
+    perform_owned_buf_test ( make_msg_vec (make_variable_len_msg, "Keep me!", 'K', 10*num_msgs),
+                             std::string_view(), make_empty_variable_len_msg(), 0u );
+  }
+  SECTION ("Variable len header msgs, buffered reads") {
+    perform_owned_buf_test ( make_msg_vec (make_variable_len_msg, "Keep me!", 'K', 10*num_msgs),
+                             std::string_view(), make_empty_variable_len_msg(), 4096u );
+  }
+  SECTION ("LF msgs") {
+    perform_owned_buf_test ( make_msg_vec (make_lf_text_msg, "Keep me too!", 'L', 10*num_msgs),
+                             std::string_view("\n"), make_empty_lf_text_msg(), 0u );
+  }
+  SECTION ("CR / LF msgs, small read buffer") {
+    // messages and delimiters are split across reads, and the buffer grows
+    perform_owned_buf_test ( make_msg_vec (make_cr_lf_text_msg, "Split me!", 'C', 10*num_msgs),
+                             std::string_view("\r\n"), make_empty_cr_lf_text_msg(), 5u );
+  }
+}
+
+// all of the messages are written before IO is started, so the first reads find many
+// complete messages; batch sizes are only checked against one when reads are unbuffered
+void perform_batch_test (const vec_buf& msg_vec, std::string_view delim,
+                         const chops::const_shared_buffer& empty_msg,
+                         std::size_t read_buf_size, bool expect_multi) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  auto conn = make_connected_pair(ioc);
+  auto& sock = conn.first;
+  const auto& iohp = conn.second.first;
+  auto& fut = conn.second.second;
+
+  chops::mutable_shared_buffer stream;
+  for (const auto& buf : msg_vec) {
+    stream.append(buf.data(), buf.size());
+  }
+  stream.append(empty_msg.data(), empty_msg.size());
+  asio::write(sock, asio::const_buffer(stream.data(), stream.size()));
+
+  iohp->set_read_buffer_size(read_buf_size);
+  // only used in the IO thread until the connection is closed
+  vec_buf recvd;
+  std::size_t num_batches = 0u;
+  std::size_t max_batch = 0u;
+  auto hdlr = [&] (chops::net::tcp_msg_batch batch, chops::net::tcp_io_output, 
+                   asio::ip::tcp::endpoint) {
+    ++num_batches;
+    max_batch = std::max(max_batch, batch.size());
+    bool more = true;
+    for (const auto& buf : batch) {
+      more = more && buf.size() > 2u;
+      recvd.push_back(chops::const_shared_buffer(buf.data(), buf.size()));
+    }
+    return more;
+  };
+  auto r = delim.empty() ? 
+    chops::net::tcp_io_interface(iohp).start_io(2, hdlr, decode_variable_len_msg_hdr) :
+    chops::net::tcp_io_interface(iohp).start_io(delim, hdlr);
+  REQUIRE (r);
+
+  auto err = fut.get();
+  REQUIRE (err == std::make_error_code(chops::net::net_ip_errc::message_handler_terminated));
+  REQUIRE (recvd.size() == msg_vec.size() + 1u);
+  for (std::size_t i = 0u; i < msg_vec.size(); ++i) {
+    REQUIRE (recvd[i] == msg_vec[i]);
+  }
+  if (expect_multi) {
+    REQUIRE (max_batch > 1u);
+    REQUIRE (num_batches < recvd.size());
+  }
+  else {
+    REQUIRE (max_batch == 1u);
+    REQUIRE (num_batches == recvd.size());
+  }
+
+  wk.reset();
+}
+
+TEST_CASE ( "Tcp IO handler test, batch message handler",
+            "[tcp_io] [msg_batch]" ) {
+
+  SECTION ("Variable len header msgs, unbuffered reads") {
+    perform_batch_test ( make_msg_vec (make_variable_len_msg, "Batch me!", 'B', 10*num_msgs),
+                         std::string_view(), make_empty_variable_len_msg(), 0u, false );
+  }
+  SECTION ("Variable len header msgs, buffered reads") {
+    perform_batch_test ( make_msg_vec (make_variable_len_msg, "Batch me!", 'B', 10*num_msgs),
+                         std::string_view(), make_empty_variable_len_msg(), 4096u, true );
+  }
+  SECTION ("LF msgs") {
+    perform_batch_test ( make_msg_vec (make_lf_text_msg, "Batch me too!", 'L', 10*num_msgs),
+                         std::string_view("\n"), make_empty_lf_text_msg(), 0u, true );
+  }
+  SECTION ("CR / LF msgs, small read buffer") {
+    perform_batch_test ( make_msg_vec (make_cr_lf_text_msg, "Split me!", 'C', 10*num_msgs),
+                         std::string_view("\r\n"), make_empty_cr_lf_text_msg(), 64u, true );
+  }
+}
+
+TEST_CASE ( "Tcp IO handler test, fixed len prefix frame and frame error",
+            "[tcp_io] [fixed_len_prefix_frame]" ) {
+
+  using frame = chops::net::fixed_len_prefix_frame<2u>;
+  constexpr std::size_t max_msg_size = 100u;
+
+  auto msg_vec = make_msg_vec (make_variable_len_msg, "Prefix!", 'P', 10);
+  // body of 120 bytes is over the maximum message size
+  auto big_msg = make_variable_len_msg(chops::mutable_shared_buffer(120u));
+
+  for (std::size_t read_buf_size : { 0u, 1024u }) {
+    chops::net::worker wk;
+    wk.start();
+    auto& ioc = wk.get_io_context();
+
+    auto conn = make_connected_pair(ioc);
+    auto& sock = conn.first;
+    const auto& iohp = conn.second.first;
+    auto& fut = conn.second.second;
+
+    iohp->set_read_buffer_size(read_buf_size);
+    test_counter cnt = 0;
+    REQUIRE (iohp->start_io(frame::header_size, tcp_msg_hdlr(false, cnt), frame(max_msg_size)));
+
+    for (const auto& buf : msg_vec) {
+      asio::write(sock, asio::const_buffer(buf.data(), buf.size()));
+    }
+    asio::write(sock, asio::const_buffer(big_msg.data(), big_msg.size()));
+
+    REQUIRE (fut.get() == std::make_error_code(chops::net::net_ip_errc::message_frame_error));
+    REQUIRE (cnt == msg_vec.size());
+
+    wk.reset();
+  }
+}
+
+TEST_CASE ( "Tcp IO handler test, varint len prefix frame and frame error",
+            "[tcp_io] [varint_len_prefix_frame]" ) {
+
+  using frame = chops::net::varint_len_prefix_frame;
+  constexpr std::size_t max_msg_size = 1000u;
+
+  // bodies from 2 to 600 bytes, so prefixes are both 1 and 2 bytes, all in one stream
+  std::size_t num_varint_msgs = 0u;
+  chops::mutable_shared_buffer stream;
+  auto append_msg = [&stream] (std::size_t body_size) {
+    std::array<std::byte, chops::net::max_varint_size> prefix;
+    auto sz = chops::net::encode_varint(body_size, prefix.data());
+    stream.append(prefix.data(), sz);
+    std::vector<std::byte> body(body_size, std::byte(0x5A));
+    stream.append(body.data(), body.size());
+  };
+  for (std::size_t body_size = 2u; body_size <= 600u; body_size += 7u) {
+    append_msg(body_size);
+    ++num_varint_msgs;
+  }
+  // prefix plus body is over the maximum message size
+  append_msg(max_msg_size);
+
+  for (std::size_t read_buf_size : { 0u, 64u, 65536u }) {
+    chops::net::worker wk;
+    wk.start();
+    auto& ioc = wk.get_io_context();
+
+    auto conn = make_connected_pair(ioc);
+    auto& sock = conn.first;
+    const auto& iohp = conn.second.first;
+    auto& fut = conn.second.second;
+
+    iohp->set_read_buffer_size(read_buf_size);
+    test_counter cnt = 0;
+    REQUIRE (iohp->start_io(frame::header_size, tcp_msg_hdlr(false, cnt), frame(max_msg_size)));
+
+    asio::write(sock, asio::const_buffer(stream.data(), stream.size()));
+
+    REQUIRE (fut.get() == std::make_error_code(chops::net::net_ip_errc::message_frame_error));
+    REQUIRE (cnt == num_varint_msgs);
+
+    wk.reset();
+  }
+}
+
+TEST_CASE ( "Tcp IO handler test, read buffer pool shrinks large read buffers",
+            "[tcp_io] [read_buffer_pool]" ) {
+
+  chops::net::read_buffer_pool_config cfg;
+  cfg.shrink_threshold = 1024u;
+
+  auto small_msg = make_variable_len_msg(make_body_buf("Small msg", 'S', 1));
+  auto big_msg = make_variable_len_msg(chops::mutable_shared_buffer(20000u));
+  auto empty_msg = make_empty_variable_len_msg();
+
+  auto send_and_wait = [] (asio::ip::tcp::socket& sock, const chops::const_shared_buffer& msg, 
+                           const test_counter& cnt, std::size_t expected) {
+    asio::write(sock, asio::const_buffer(msg.data(), msg.size()));
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (cnt != expected && std::chrono::steady_clock::now() < end) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return cnt == expected;
+  };
+
+  for (std::size_t read_buf_size : { 0u, 256u }) {
+    auto pool = std::make_shared<chops::net::detail::read_buffer_pool>(cfg);
+    chops::net::worker wk;
+    wk.start();
+    auto& ioc = wk.get_io_context();
+
+    auto conn = make_connected_pair(ioc, pool);
+    auto& sock = conn.first;
+    auto iohp = std::move(conn.second.first);
+    auto& fut = conn.second.second;
+
+    iohp->set_read_buffer_size(read_buf_size);
+    test_counter cnt = 0;
+    REQUIRE (iohp->start_io(2u, tcp_msg_hdlr(false, cnt), decode_variable_len_msg_hdr));
+
+    REQUIRE (send_and_wait(sock, small_msg, cnt, 1u));
+    REQUIRE (send_and_wait(sock, big_msg, cnt, 2u));
+    REQUIRE (send_and_wait(sock, small_msg, cnt, 3u));
+    // the read buffer size is stored when the next read is started
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (iohp->get_output_queue_stats().read_buffer_bytes > cfg.shrink_threshold && 
+           std::chrono::steady_clock::now() < end) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto st = iohp->get_output_queue_stats();
+    REQUIRE (st.read_buffer_bytes != 0u);
+    REQUIRE (st.read_buffer_bytes <= cfg.shrink_threshold);
+
+    asio::write(sock, asio::const_buffer(empty_msg.data(), empty_msg.size()));
+    REQUIRE (fut.get() == std::make_error_code(chops::net::net_ip_errc::message_handler_terminated));
+    wk.reset();
+    iohp.reset();
+
+    auto pst = pool->get_stats();
+    REQUIRE (pst.num_discards == 1u); // the grown buffer
+    REQUIRE (pst.bufs_pooled == 1u); // returned when the IO handler is destroyed
+  }
+}
+
+TEST_CASE ( "Tcp IO handler test, idle connection read buffer footprint with the default pool",
+            "[tcp_io] [read_buffer_pool] [idle]" ) {
+
+  chops::net::read_buffer_pool_config cfg;
+  auto msg = make_variable_len_msg(chops::mutable_shared_buffer(16u * 1024u));
+  auto empty_msg = make_empty_variable_len_msg();
+
+  for (std::size_t read_buf_size : { 0u, 256u }) {
+    auto pool = std::make_shared<chops::net::detail::read_buffer_pool>(cfg);
+    chops::net::worker wk;
+    wk.start();
+    auto& ioc = wk.get_io_context();
+
+    auto conn = make_connected_pair(ioc, pool);
+    auto& sock = conn.first;
+    auto iohp = std::move(conn.second.first);
+    auto& fut = conn.second.second;
+
+    iohp->set_read_buffer_size(read_buf_size);
+    test_counter cnt = 0;
+    REQUIRE (iohp->start_io(2u, tcp_msg_hdlr(false, cnt), decode_variable_len_msg_hdr));
+
+    // a few messages larger than the threshold, then the connection goes idle
+    for (int i = 0; i < 3; ++i) {
+      asio::write(sock, asio::const_buffer(msg.data(), msg.size()));
+    }
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((cnt != 3 || iohp->get_output_queue_stats().read_buffer_bytes > cfg.shrink_threshold) &&
+           std::chrono::steady_clock::now() < end) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE (cnt == 3);
+    auto st = iohp->get_output_queue_stats();
+    REQUIRE (st.read_buffer_bytes != 0u);
+    REQUIRE (st.read_buffer_bytes <= 4096u);
+    // the idle footprint, pool and connection together, stays within a page or two
+    REQUIRE (pool->get_stats().bytes_pooled + st.read_buffer_bytes <= 2u * 4096u);
+
+    asio::write(sock, asio::const_buffer(empty_msg.data(), empty_msg.size()));
+    REQUIRE (fut.get() == std::make_error_code(chops::net::net_ip_errc::message_handler_terminated));
+    wk.reset();
+  }
+}
+
+TEST_CASE ( "Tcp IO handler test, read and write timeouts",
+            "[tcp_io] [timer_wheel]" ) {
+
+  using namespace std::chrono_literals;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+  auto wheel = std::make_shared<chops::net::detail::timer_wheel>(ioc, 10ms);
+
+  {
+    INFO ("Read timeout, messages received for a while, then nothing");
+    auto conn = make_connected_pair(ioc, chops::net::detail::read_buffer_pool_ptr(), wheel);
+    auto& sock = conn.first;
+    const auto& iohp = conn.second.first;
+    auto& fut = conn.second.second;
+    test_counter cnt = 0;
+    REQUIRE (iohp->start_io(2u, tcp_msg_hdlr(false, cnt), decode_variable_len_msg_hdr));
+    REQUIRE_FALSE (iohp->set_io_timeouts(100ms, 0ms));
+    auto msg = make_variable_len_msg(make_body_buf("Keep alive", 'K', 1));
+    for (int i = 0; i < 20; ++i) {
+      asio::write(sock, asio::const_buffer(msg.data(), msg.size()));
+      std::this_thread::sleep_for(20ms);
+    }
+    REQUIRE (fut.wait_for(0ms) == std::future_status::timeout);
+    REQUIRE (fut.get() == std::make_error_code(chops::net::net_ip_errc::io_read_timeout));
+    REQUIRE (cnt == 20u);
+  }
+  {
+    INFO ("Write timeout, peer not reading");
+    auto conn = make_connected_pair(ioc, chops::net::detail::read_buffer_pool_ptr(), wheel);
+    const auto& iohp = conn.second.first;
+    auto& fut = conn.second.second;
+    REQUIRE (iohp->start_io());
+    REQUIRE_FALSE (iohp->set_io_timeouts(0ms, 100ms));
+    // larger than the socket buffers, so the write cannot complete
+    REQUIRE (iohp->send(chops::const_shared_buffer(chops::mutable_shared_buffer(64u * 1024u * 1024u))));
+    REQUIRE (fut.get() == std::make_error_code(chops::net::net_ip_errc::io_write_timeout));
+  }
+  REQUIRE (wheel->num_entries() == 0u);
+
+  wheel.reset();
+  wk.reset();
+}
+
+TEST_CASE ( "Tcp IO handler test, false return with replies queued to a peer not reading",
+            "[tcp_io] [close_after_writes]" ) {
+
+  using namespace std::chrono_literals;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  auto conn = make_connected_pair(ioc);
+  auto& sock = conn.first;
+  const auto& iohp = conn.second.first;
+  auto& fut = conn.second.second;
+
+  // every line is answered with a reply larger than the socket buffers, the empty
+  // line ends the connection; all of the lines arrive in one read
+  auto reply = chops::const_shared_buffer(chops::mutable_shared_buffer(4u * 1024u * 1024u));
+  std::atomic_bool terminated { false };
+  auto hdlr = [&reply, &terminated] (asio::const_buffer buf, chops::net::tcp_io_output io_out,
+                                     asio::ip::tcp::endpoint) {
+    io_out.send(reply);
+    if (buf.size() > 1u) {
+      return true;
+    }
+    terminated = true;
+    return false;
+  };
+  REQUIRE (iohp->start_io(std::string_view("\n"), hdlr));
+
+  chops::mutable_shared_buffer stream;
+  for (const auto& buf : make_msg_vec (make_lf_text_msg, "Reply to me!", 'R', 4)) {
+    stream.append(buf.data(), buf.size());
+  }
+  auto empty_msg = make_empty_lf_text_msg();
+  stream.append(empty_msg.data(), empty_msg.size());
+  asio::write(sock, asio::const_buffer(stream.data(), stream.size()));
+
+  auto end = std::chrono::steady_clock::now() + 5s;
+  while (!terminated && std::chrono::steady_clock::now() < end) {
+    std::this_thread::sleep_for(1ms);
+  }
+  REQUIRE (terminated);
+  std::this_thread::sleep_for(50ms);
+  // the replies are still being written, and later sends are refused
+  REQUIRE (fut.wait_for(0ms) == std::future_status::timeout);
+  REQUIRE (iohp->send(reply) == chops::net::send_result::io_stopped);
+  // the peer never reads, the close still happens once the drain timeout expires
+  REQUIRE (fut.wait_for(chops::net::detail::close_drain_timeout + 5s) == 
+           std::future_status::ready);
+  REQUIRE (fut.get() == std::make_error_code(chops::net::net_ip_errc::message_handler_terminated));
+
+  wk.reset();
+}
+
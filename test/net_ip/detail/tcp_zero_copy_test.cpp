@@ -0,0 +1,372 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c zero_copy_tracker and @c MSG_ZEROCOPY sends in
+ *  @c tcp_io, along with a loopback benchmark comparing zero copy and normal sends.
+ *
+ *  The benchmark is hidden, run it with the "[benchmark]" tag. Note that on the loopback
+ *  interface the kernel falls back to copying zero copy sends, so the benchmark shows
+ *  the fixed overhead of zero copy (and the size where it becomes negligible) rather
+ *  than the gain seen on a real NIC.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include "asio/ip/tcp.hpp"
+#include "asio/read.hpp"
+#include "asio/io_context.hpp"
+
+#include <system_error> // std::error_code
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint32_t
+#include <memory> // std::make_shared
+#include <vector>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <functional> // std::ref
+#include <algorithm> // std::min, std::max
+#include <cstring> // std::memset
+
+#include "net_ip/detail/tcp_zero_copy.hpp"
+#include "net_ip/detail/tcp_io.hpp"
+#include "net_ip/detail/send_buffer.hpp"
+
+#include "net_ip_component/worker.hpp"
+
+#include "marshall/shared_buffer.hpp"
+
+constexpr unsigned short test_port = 30477;
+
+TEST_CASE ( "Zero copy tracker test",
+           "[zero_copy_tracker]" ) {
+
+  using namespace chops::net::detail;
+
+  std::vector<std::byte> mem(100u);
+  int num_released = 0;
+  auto make_buf = [&mem, &num_released] {
+    return send_buffer(mem.data(), mem.size(),
+                       [&num_released] (const void*, std::size_t) { ++num_released; } );
+  };
+
+  zero_copy_tracker trk;
+  REQUIRE (trk.empty());
+  REQUIRE (trk.idle());
+
+  // buffer sent with three zero copy send calls, ids 0 to 2
+  trk.start_buffer();
+  trk.sent();
+  trk.sent();
+  trk.sent();
+  trk.end_buffer(make_buf());
+  // buffer sent without any zero copy send calls is not held
+  trk.start_buffer();
+  trk.end_buffer(make_buf());
+  REQUIRE (num_released == 1);
+  // buffer with ids 3 and 4
+  trk.start_buffer();
+  trk.sent();
+  trk.sent();
+  trk.end_buffer(make_buf());
+  REQUIRE (trk.size() == 2u);
+  REQUIRE (trk.num_zero_copy_sends() == 5u);
+
+  trk.complete(0u, 1u, false); // first buffer still referenced by id 2
+  REQUIRE (trk.size() == 2u);
+  trk.complete(2u, 3u, true);
+  REQUIRE (trk.size() == 1u);
+  REQUIRE (num_released == 2);
+  REQUIRE_FALSE (trk.idle());
+  trk.complete(4u, 4u, true);
+  REQUIRE (trk.empty());
+  REQUIRE (trk.idle());
+  REQUIRE (num_released == 3);
+  REQUIRE (trk.num_copied() == 2u);
+
+  // a buffer that is still being sent is outstanding, but is not held once its ids 
+  // completed before the last send call returned
+  trk.start_buffer();
+  trk.sent(); // id 5
+  REQUIRE_FALSE (trk.idle());
+  trk.complete(5u, 5u, false);
+  REQUIRE (trk.idle());
+  trk.end_buffer(make_buf());
+  REQUIRE (trk.empty());
+  REQUIRE (num_released == 4);
+
+  // held buffers are released on clear
+  trk.start_buffer();
+  trk.sent();
+  trk.end_buffer(make_buf());
+  REQUIRE (num_released == 4);
+  trk.clear();
+  REQUIRE (num_released == 5);
+  REQUIRE (trk.idle());
+}
+
+TEST_CASE ( "Zero copy tracker id wrap around test",
+           "[zero_copy_tracker] [wrap]" ) {
+
+  using namespace chops::net::detail;
+
+  std::vector<std::byte> mem(10u);
+  zero_copy_tracker trk(0xFFFFFFFEu);
+
+  trk.start_buffer();
+  trk.sent(); // id 0xFFFFFFFE
+  trk.sent(); // id 0xFFFFFFFF
+  trk.sent(); // id 0, wrapped
+  trk.end_buffer(send_buffer(mem.data(), mem.size(), chops::net::buffer_release_hook { }));
+  trk.complete(0xFFFFFFFEu, 0xFFFFFFFFu, false);
+  REQUIRE (trk.size() == 1u);
+  trk.complete(0u, 0u, false);
+  REQUIRE (trk.empty());
+}
+
+namespace {
+
+struct loopback_conn {
+  chops::net::detail::tcp_io_shared_ptr     m_iohp;
+  asio::ip::tcp::socket                     m_recv_sock;
+  std::future<std::error_code>              m_notify_fut;
+};
+
+loopback_conn make_loopback_conn(asio::io_context& ioc) {
+  asio::ip::tcp::endpoint endp(asio::ip::make_address("127.0.0.1"), test_port);
+  asio::ip::tcp::acceptor acc(ioc, endp);
+  asio::ip::tcp::socket send_sock(ioc);
+  send_sock.connect(endp);
+  auto recv_sock = acc.accept();
+
+  auto prom = std::make_shared<std::promise<std::error_code>>();
+  auto fut = prom->get_future();
+  auto iohp = std::make_shared<chops::net::detail::tcp_io>(std::move(send_sock),
+        [prom] (std::error_code e, chops::net::detail::tcp_io_shared_ptr) { prom->set_value(e); } );
+  return loopback_conn { iohp, std::move(recv_sock), std::move(fut) };
+}
+
+// reads the given number of bytes, returning the number of bytes that did not match
+// the fill pattern of each buffer (buffer index modulo 251)
+std::size_t recv_and_check(asio::ip::tcp::socket& sock, std::size_t buf_size,
+                           std::size_t num_bufs, bool check) {
+  std::vector<std::byte> rbuf(1024u * 1024u);
+  std::size_t total = buf_size * num_bufs;
+  std::size_t pos = 0u;
+  std::size_t mismatches = 0u;
+  while (pos < total) {
+    std::error_code ec;
+    auto n = sock.read_some(asio::buffer(rbuf.data(), std::min(rbuf.size(), total - pos)), ec);
+    if (ec) {
+      return total;
+    }
+    if (check) {
+      for (std::size_t i = 0u; i < n; ++i) {
+        if (rbuf[i] != static_cast<std::byte>(((pos + i) / buf_size) % 251u)) {
+          ++mismatches;
+        }
+      }
+    }
+    pos += n;
+  }
+  return mismatches;
+}
+
+template <typename F>
+bool wait_for(F&& cond, std::chrono::milliseconds max_wait) {
+  auto end = std::chrono::steady_clock::now() + max_wait;
+  while (!cond()) {
+    if (std::chrono::steady_clock::now() > end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+}
+
+TEST_CASE ( "Tcp io zero copy send test, loopback",
+           "[tcp_io] [zero_copy]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  auto conn = make_loopback_conn(ioc);
+  auto ec = conn.m_iohp->set_zero_copy(4096u);
+  if (ec) {
+    WARN ("Zero copy not supported, only the normal send path is tested: " << ec.message());
+  }
+  REQUIRE (conn.m_iohp->start_io());
+
+  constexpr std::size_t buf_size = 100000u;
+  constexpr std::size_t num_bufs = 50u;
+  std::vector<std::vector<std::byte>> bufs;
+  for (std::size_t i = 0u; i < num_bufs; ++i) {
+    bufs.emplace_back(buf_size, static_cast<std::byte>(i % 251u));
+  }
+
+  auto recv_fut = std::async(std::launch::async, recv_and_check, std::ref(conn.m_recv_sock),
+                             buf_size, num_bufs, true);
+
+  std::atomic_size_t num_released { 0u };
+  for (std::size_t i = 0u; i < num_bufs; ++i) {
+    if (i % 2u == 0u) {
+      REQUIRE (conn.m_iohp->send_no_copy(bufs[i].data(), bufs[i].size(),
+                [&num_released] (const void*, std::size_t) { ++num_released; } ));
+    }
+    else {
+      REQUIRE (conn.m_iohp->send(chops::const_shared_buffer(bufs[i].data(), bufs[i].size())));
+    }
+  }
+  REQUIRE (recv_fut.get() == 0u);
+  // all memory released once the zero copy notifications have arrived
+  REQUIRE (wait_for([&num_released] { return num_released == num_bufs / 2u; },
+                    std::chrono::milliseconds(5000)));
+
+  auto qs = conn.m_iohp->get_output_queue_stats();
+  REQUIRE (qs.total_bytes_sent == buf_size * num_bufs);
+
+  conn.m_iohp->stop_io();
+  conn.m_notify_fut.get();
+  wk.reset();
+}
+
+TEST_CASE ( "Tcp io zero copy close with sends pending, loopback",
+           "[tcp_io] [zero_copy] [close]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  auto conn = make_loopback_conn(ioc);
+  if (conn.m_iohp->set_zero_copy(4096u)) {
+    WARN ("Zero copy not supported, close with pending zero copy sends not tested");
+    conn.m_iohp->stop_io();
+    conn.m_notify_fut.get();
+    wk.reset();
+    return;
+  }
+  REQUIRE (conn.m_iohp->start_io());
+
+  // the receiver does not read yet, so most of the data stays in the kernel, sent from 
+  // the pinned pages; the release hook overwrites the memory, so a release before the 
+  // notification shows up as corrupted bytes at the receiver
+  constexpr std::size_t buf_size = 1024u * 1024u;
+  constexpr std::size_t num_bufs = 16u;
+  std::vector<std::vector<std::byte>> bufs;
+  for (std::size_t i = 0u; i < num_bufs; ++i) {
+    bufs.emplace_back(buf_size, static_cast<std::byte>(i % 251u));
+  }
+  std::atomic_size_t num_released { 0u };
+  for (std::size_t i = 0u; i < num_bufs; ++i) {
+    REQUIRE (conn.m_iohp->send_no_copy(bufs[i].data(), bufs[i].size(),
+              [&num_released] (const void* p, std::size_t sz) { 
+                  std::memset(const_cast<void*>(p), 0xff, sz);
+                  ++num_released; 
+                } ));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200)); // socket buffers fill up
+  auto qs = conn.m_iohp->get_output_queue_stats();
+  REQUIRE (qs.total_bytes_sent > 0u);
+  REQUIRE (qs.total_bytes_sent < buf_size * num_bufs);
+
+  conn.m_iohp->stop_io();
+  conn.m_notify_fut.get();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // the buffers never handed to the kernel are released, the sent ones are still held
+  std::size_t num_sent_bufs = (qs.total_bytes_sent + buf_size - 1u) / buf_size;
+  REQUIRE (num_released <= num_bufs - num_sent_bufs);
+
+  // the data in the kernel still arrives intact, followed by the FIN
+  std::vector<std::byte> rbuf(64u * 1024u);
+  std::size_t pos = 0u;
+  std::size_t mismatches = 0u;
+  for (;;) {
+    std::error_code ec;
+    auto n = conn.m_recv_sock.read_some(asio::buffer(rbuf), ec);
+    if (ec) {
+      break;
+    }
+    for (std::size_t i = 0u; i < n; ++i) {
+      if (rbuf[i] != static_cast<std::byte>(((pos + i) / buf_size) % 251u)) {
+        ++mismatches;
+      }
+    }
+    pos += n;
+  }
+  REQUIRE (pos >= qs.total_bytes_sent);
+  REQUIRE (mismatches == 0u);
+  // every buffer is released once the notifications have been read
+  REQUIRE (wait_for([&num_released] { return num_released == num_bufs; },
+                    std::chrono::milliseconds(5000)));
+  wk.reset();
+}
+
+TEST_CASE ( "Tcp io zero copy benchmark, loopback",
+           "[tcp_io] [zero_copy] [benchmark] [.]" ) {
+
+  constexpr std::size_t total_bytes = 256u * 1024u * 1024u;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  std::vector<std::byte> mem(16u * 1024u * 1024u, std::byte{0x5a});
+
+  std::cout << "Loopback send throughput, MB/s (zero copy on loopback is copied by the kernel)\n";
+  std::cout << std::setw(10) << "buf size" << std::setw(12) << "normal" <<
+               std::setw(12) << "zero copy" << '\n';
+
+  for (std::size_t buf_size = 4096u; buf_size <= mem.size(); buf_size *= 4u) {
+    std::size_t num_bufs = std::max(total_bytes / buf_size, std::size_t(16u));
+    double mbps[2] = { 0.0, 0.0 };
+    for (int zc = 0; zc < 2; ++zc) {
+      auto conn = make_loopback_conn(ioc);
+      if (zc == 1 && conn.m_iohp->set_zero_copy(1u)) {
+        WARN ("Zero copy not supported on this platform");
+        conn.m_iohp->stop_io();
+        conn.m_notify_fut.get();
+        wk.reset();
+        return;
+      }
+      conn.m_iohp->start_io();
+
+      std::atomic_size_t num_released { 0u };
+      auto start = std::chrono::steady_clock::now();
+      auto recv_fut = std::async(std::launch::async, recv_and_check, std::ref(conn.m_recv_sock),
+                                 buf_size, num_bufs, false);
+      for (std::size_t i = 0u; i < num_bufs; ++i) {
+        // the same memory is sent repeatedly, it is never modified
+        conn.m_iohp->send_no_copy(mem.data(), buf_size,
+                [&num_released] (const void*, std::size_t) { ++num_released; } );
+      }
+      recv_fut.get();
+      wait_for([&num_released, num_bufs] { return num_released == num_bufs; },
+               std::chrono::milliseconds(10000));
+      std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+      mbps[zc] = (static_cast<double>(buf_size * num_bufs) / (1024.0 * 1024.0)) / secs.count();
+
+      conn.m_iohp->stop_io();
+      conn.m_notify_fut.get();
+    }
+    std::cout << std::setw(10) << buf_size << std::fixed << std::setprecision(1) <<
+                 std::setw(12) << mbps[0] << std::setw(12) << mbps[1] << '\n';
+  }
+  std::cout << std::flush;
+  wk.reset();
+}
+
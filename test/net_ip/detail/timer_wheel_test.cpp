@@ -0,0 +1,159 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c timer_wheel detail class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include <system_error> // std::error_code
+#include <memory> // std::make_shared
+#include <chrono>
+#include <thread>
+#include <future>
+#include <atomic>
+
+#include "net_ip/detail/timer_wheel.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "net_ip_component/worker.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+using chops::net::detail::timer_wheel;
+using chops::net::detail::timeout_entry;
+
+struct expiry {
+  std::promise<std::error_code> m_prom;
+  std::future<std::error_code>  m_fut;
+  std::atomic_int               m_cnt;
+
+  expiry() : m_prom(), m_fut(m_prom.get_future()), m_cnt(0) { }
+
+  timeout_entry::expire_cb cb() {
+    return [this] (std::error_code err) {
+      if (++m_cnt == 1) {
+        m_prom.set_value(err);
+      }
+    };
+  }
+};
+
+}
+
+SCENARIO ( "Timer wheel read timeouts",
+           "[timer_wheel]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto wheel = std::make_shared<timer_wheel>(wk.get_io_context(), 5ms);
+
+  GIVEN ("An entry with a read timeout and no reads") {
+    auto e = std::make_shared<timeout_entry>();
+    expiry ex;
+    auto start = std::chrono::steady_clock::now();
+    wheel->set_timeouts(e, 50ms, 0ms, ex.cb());
+    REQUIRE (wheel->num_entries() == 1u);
+    THEN ("the entry expires, no earlier than the timeout") {
+      REQUIRE (ex.m_fut.wait_for(2s) == std::future_status::ready);
+      REQUIRE (std::chrono::steady_clock::now() - start >= 50ms);
+      REQUIRE (ex.m_fut.get() == std::make_error_code(chops::net::net_ip_errc::io_read_timeout));
+      REQUIRE (wheel->num_entries() == 0u);
+    }
+  }
+
+  GIVEN ("An entry with a read timeout longer than the first wheel level") {
+    auto e = std::make_shared<timeout_entry>();
+    expiry ex;
+    auto start = std::chrono::steady_clock::now();
+    wheel->set_timeouts(e, 400ms, 0ms, ex.cb());
+    THEN ("the entry is cascaded and expires, no earlier than the timeout") {
+      REQUIRE (ex.m_fut.wait_for(3s) == std::future_status::ready);
+      REQUIRE (std::chrono::steady_clock::now() - start >= 400ms);
+    }
+  }
+
+  GIVEN ("An entry with reads more often than the read timeout") {
+    auto e = std::make_shared<timeout_entry>();
+    expiry ex;
+    wheel->set_timeouts(e, 50ms, 0ms, ex.cb());
+    for (int i = 0; i < 40; ++i) {
+      std::this_thread::sleep_for(5ms);
+      e->read_activity(wheel->now());
+    }
+    THEN ("the entry does not expire until the reads stop") {
+      REQUIRE (ex.m_cnt == 0);
+      REQUIRE (ex.m_fut.wait_for(2s) == std::future_status::ready);
+      REQUIRE (ex.m_cnt == 1);
+    }
+  }
+
+  GIVEN ("A cancelled entry") {
+    auto e = std::make_shared<timeout_entry>();
+    expiry ex;
+    wheel->set_timeouts(e, 20ms, 0ms, ex.cb());
+    wheel->cancel(e);
+    THEN ("it is dropped without expiring") {
+      REQUIRE (ex.m_fut.wait_for(200ms) == std::future_status::timeout);
+      REQUIRE (wheel->num_entries() == 0u);
+    }
+  }
+
+  wk.reset();
+}
+
+SCENARIO ( "Timer wheel write timeouts",
+           "[timer_wheel]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto wheel = std::make_shared<timer_wheel>(wk.get_io_context(), 5ms);
+
+  GIVEN ("An entry with a write timeout") {
+    auto e = std::make_shared<timeout_entry>();
+    expiry ex;
+    wheel->set_timeouts(e, 0ms, 30ms, ex.cb());
+    WHEN ("writes finish within the timeout") {
+      for (int i = 0; i < 20; ++i) {
+        e->write_started(wheel->now());
+        std::this_thread::sleep_for(5ms);
+        e->write_finished();
+        std::this_thread::sleep_for(5ms);
+      }
+      THEN ("the entry does not expire, even with no write in progress") {
+        REQUIRE (ex.m_fut.wait_for(100ms) == std::future_status::timeout);
+        REQUIRE (wheel->num_entries() == 1u);
+        wheel->cancel(e);
+      }
+    }
+    AND_WHEN ("a write stalls") {
+      e->write_started(wheel->now());
+      THEN ("the entry expires with a write timeout") {
+        REQUIRE (ex.m_fut.wait_for(2s) == std::future_status::ready);
+        REQUIRE (ex.m_fut.get() == std::make_error_code(chops::net::net_ip_errc::io_write_timeout));
+      }
+    }
+    AND_WHEN ("the timeouts are disabled") {
+      wheel->set_timeouts(e, 0ms, 0ms, ex.cb());
+      e->write_started(wheel->now());
+      THEN ("the entry is dropped without expiring") {
+        REQUIRE (ex.m_fut.wait_for(200ms) == std::future_status::timeout);
+        REQUIRE (wheel->num_entries() == 0u);
+      }
+    }
+  }
+
+  wk.reset();
+}
+
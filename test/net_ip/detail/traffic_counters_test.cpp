@@ -0,0 +1,70 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c traffic_counters detail class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include "net_ip/detail/traffic_counters.hpp"
+#include "net_ip/queue_stats.hpp"
+
+#include "utility/repeat.hpp"
+
+TEST_CASE ( "Traffic counters test",
+           "[traffic_counters]" ) {
+
+  chops::net::detail::traffic_counters cnts { };
+
+  chops::net::output_queue_stats st { 3u, 30u };
+  cnts.fill_stats(st);
+  // queue fields untouched, counters start at zero
+  REQUIRE (st.output_queue_size == 3u);
+  REQUIRE (st.bytes_in_output_queue == 30u);
+  REQUIRE (st.total_bufs_sent == 0u);
+  REQUIRE (st.total_bytes_sent == 0u);
+  REQUIRE (st.total_writes == 0u);
+  REQUIRE (st.total_msgs_received == 0u);
+  REQUIRE (st.total_bytes_received == 0u);
+  REQUIRE (st.total_reads == 0u);
+
+  chops::repeat(10, [&cnts] {
+      cnts.count_write(4u, 100u);
+      cnts.count_read(2u); // e.g. header read
+      cnts.count_read(20u); // body read
+      cnts.count_msg();
+    }
+  );
+  cnts.count_write(1u, 5u);
+
+  cnts.fill_stats(st);
+  REQUIRE (st.output_queue_size == 3u);
+  REQUIRE (st.total_bufs_sent == 41u);
+  REQUIRE (st.total_bytes_sent == 1005u);
+  REQUIRE (st.total_writes == 11u);
+  REQUIRE (st.total_msgs_received == 10u);
+  REQUIRE (st.total_bytes_received == 220u);
+  REQUIRE (st.total_reads == 20u);
+  REQUIRE (st.num_read_batches == 0u);
+
+  cnts.count_read_batch(16u, 0u);
+  cnts.count_read_batch(3u, 1u);
+  cnts.set_dropped_msgs(5u);
+  cnts.fill_stats(st);
+  REQUIRE (st.num_read_batches == 2u);
+  REQUIRE (st.msgs_in_read_batches == 19u);
+  REQUIRE (st.max_read_batch_msgs == 16u);
+  REQUIRE (st.num_truncated_msgs == 1u);
+  REQUIRE (st.num_dropped_msgs == 5u);
+
+}
+
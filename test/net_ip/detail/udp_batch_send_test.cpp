@@ -0,0 +1,188 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c udp_send_batch, sending datagram batches with and
+ *  without segmentation offload.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#ifndef _WIN32
+
+#include "asio/ip/udp.hpp"
+#include "asio/io_context.hpp"
+
+#include <system_error> // std::error_code
+#include <cstddef> // std::size_t, std::byte
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "net_ip/detail/udp_batch_send.hpp"
+
+namespace {
+
+const char*   test_addr = "127.0.0.1";
+constexpr unsigned short test_port_base = 30680;
+
+struct dgram_spec {
+  std::size_t m_size;
+  bool        m_to_a;
+};
+
+// datagram i is filled with the value i, so order and content are both checked
+std::vector<std::vector<std::byte>> make_dgrams(const std::vector<dgram_spec>& specs) {
+  std::vector<std::vector<std::byte>> dgrams;
+  for (std::size_t i = 0u; i < specs.size(); ++i) {
+    dgrams.emplace_back(specs[i].m_size, static_cast<std::byte>(i));
+  }
+  return dgrams;
+}
+
+std::size_t send_all(chops::net::detail::udp_send_batch& batch, int sock) {
+  std::size_t total = 0u;
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (!batch.done() && std::chrono::steady_clock::now() < end) {
+    std::error_code ec;
+    auto sent = batch.send(sock, ec);
+    REQUIRE_FALSE (ec);
+    total += sent.first;
+    if (sent.first == 0u) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  return total;
+}
+
+// checks the datagrams received on a socket against the expected datagrams, in order
+void check_received(asio::ip::udp::socket& sock,
+                    const std::vector<std::vector<std::byte>>& dgrams,
+                    const std::vector<dgram_spec>& specs, bool to_a) {
+  std::vector<std::byte> buf(2048u);
+  for (std::size_t i = 0u; i < specs.size(); ++i) {
+    if (specs[i].m_to_a != to_a) {
+      continue;
+    }
+    auto n = sock.receive(asio::mutable_buffer(buf.data(), buf.size()));
+    REQUIRE (n == dgrams[i].size());
+    REQUIRE (buf[0] == dgrams[i][0]);
+    REQUIRE (buf[n-1u] == dgrams[i][0]);
+  }
+  REQUIRE (sock.available() == 0u);
+}
+
+}
+
+SCENARIO ( "Udp send batch, with and without segmentation offload",
+           "[udp_batch_send]" ) {
+  using chops::net::detail::udp_send_batch;
+  using chops::net::detail::udp_gso_supported;
+
+  asio::io_context ioc;
+  asio::ip::udp::endpoint endp_a(asio::ip::make_address(test_addr), test_port_base);
+  asio::ip::udp::endpoint endp_b(asio::ip::make_address(test_addr), test_port_base + 1);
+  asio::ip::udp::socket recv_a(ioc, endp_a);
+  asio::ip::udp::socket recv_b(ioc, endp_b);
+  asio::ip::udp::socket sender(ioc);
+  sender.open(asio::ip::udp::v4());
+
+  // a run of 100 byte datagrams ending with a shorter one, a run to another destination,
+  // then a run of smaller datagrams back to the first destination
+  std::vector<dgram_spec> specs;
+  for (int i = 0; i < 10; ++i) {
+    specs.push_back(dgram_spec { 100u, true });
+  }
+  specs.push_back(dgram_spec { 40u, true });
+  for (int i = 0; i < 5; ++i) {
+    specs.push_back(dgram_spec { 100u, false });
+  }
+  for (int i = 0; i < 3; ++i) {
+    specs.push_back(dgram_spec { 50u, true });
+  }
+  auto dgrams = make_dgrams(specs);
+
+  udp_send_batch batch;
+  auto fill = [&] {
+    batch.clear();
+    for (std::size_t i = 0u; i < specs.size(); ++i) {
+      batch.add(dgrams[i].data(), dgrams[i].size(), specs[i].m_to_a ? endp_a : endp_b);
+    }
+  };
+
+  GIVEN ("A batch of datagrams to two destinations") {
+    WHEN ("the batch is sent without segmentation offload") {
+      fill();
+      batch.prepare(0u);
+      REQUIRE (batch.num_segmented() == 0u);
+      REQUIRE (send_all(batch, sender.native_handle()) == specs.size());
+      THEN ("every datagram is received in order") {
+        REQUIRE (batch.done());
+        REQUIRE (batch.num_sent() == specs.size());
+        check_received(recv_a, dgrams, specs, true);
+        check_received(recv_b, dgrams, specs, false);
+      }
+    }
+    AND_WHEN ("the batch is sent with segmentation offload") {
+      fill();
+      batch.prepare(1472u);
+      REQUIRE (batch.num_segmented() == (udp_gso_supported ? 3u : 0u));
+      REQUIRE (send_all(batch, sender.native_handle()) == specs.size());
+      THEN ("every datagram is received in order, with its own size") {
+        REQUIRE (batch.done());
+        check_received(recv_a, dgrams, specs, true);
+        check_received(recv_b, dgrams, specs, false);
+      }
+    }
+    AND_WHEN ("the max segment size is below some of the datagram sizes") {
+      fill();
+      batch.prepare(64u);
+      REQUIRE (batch.num_segmented() == (udp_gso_supported ? 1u : 0u));
+      REQUIRE (send_all(batch, sender.native_handle()) == specs.size());
+      THEN ("only the smaller datagrams are segmented, all are received") {
+        check_received(recv_a, dgrams, specs, true);
+        check_received(recv_b, dgrams, specs, false);
+      }
+    }
+    AND_WHEN ("a datagram in the middle of the batch cannot be sent") {
+      std::vector<std::byte> too_big(70000u);
+      batch.clear();
+      for (std::size_t i = 0u; i < 3u; ++i) {
+        batch.add(dgrams[i].data(), dgrams[i].size(), endp_a);
+      }
+      batch.add(too_big.data(), too_big.size(), endp_a);
+      batch.add(dgrams[3].data(), dgrams[3].size(), endp_a);
+      batch.prepare(0u);
+      std::error_code ec;
+      auto sent = batch.send(sender.native_handle(), ec);
+      REQUIRE_FALSE (ec);
+      REQUIRE (sent.first == 3u);
+      REQUIRE_FALSE (batch.done());
+      sent = batch.send(sender.native_handle(), ec);
+      THEN ("the datagrams before it are reported as sent") {
+        REQUIRE (ec);
+        REQUIRE (sent.first == 0u);
+        REQUIRE (batch.num_sent() == 3u);
+      }
+    }
+  } // end given
+
+  GIVEN ("An empty batch") {
+    batch.clear();
+    batch.prepare(1472u);
+    THEN ("it is done without sending") {
+      REQUIRE (batch.done());
+    }
+  } // end given
+}
+
+#endif
+
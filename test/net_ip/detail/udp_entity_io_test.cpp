@@ -73,11 +73,18 @@ using iosp = chops::net::detail::udp_entity_io_shared_ptr;
 void send_data (const vec_buf& msg_vec, int interval, const asio::ip::udp::endpoint& recv_endp,
                 std::vector<iosp>& senders, bool send_buf_only) {
 
-  // send messages through all of the senders
+  // send messages through all of the senders, the last message with a completion
+  std::vector<std::future<chops::net::send_completion> > completions;
   std::this_thread::sleep_for(std::chrono::milliseconds(10));
   for (const auto& buf : msg_vec) {
+    bool last = (&buf == &msg_vec.back());
     for (auto ioh : senders) {
-      if (send_buf_only) {
+      chops::net::udp_io_output io_out(ioh);
+      if (last) {
+        completions.push_back(send_buf_only ? io_out.send_with_completion(buf) :
+                                              io_out.send_with_completion(buf, recv_endp));
+      }
+      else if (send_buf_only) {
         ioh->send(buf);
       }
       else {
@@ -86,6 +93,11 @@ void send_data (const vec_buf& msg_vec, int interval, const asio::ip::udp::endpo
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(interval));
   }
+  for (auto& fut : completions) {
+    auto sc = fut.get();
+    assert (!sc.err);
+    assert (sc.num_bytes == msg_vec.back().size());
+  }
 
   // poll output queue size of all handlers until 0
   std::vector<chops::net::udp_io_output> io_outs;
@@ -359,3 +371,288 @@ TEST_CASE ( "Udp IO handler test, LF msgs, two-way, interval 10, senders 2, many
 }
 
 
+
+TEST_CASE ( "Udp IO handler test, batched receives",
+           "[udp_io] [receive_batch]" ) {
+
+  if constexpr (!chops::net::detail::udp_batch_receive_supported) {
+    return;
+  }
+
+  constexpr std::size_t batch_size = 16u;
+  constexpr std::size_t max_size = 64u;
+  // well under the number of small datagrams a default socket receive buffer holds
+  constexpr std::size_t num_dgrams = 3 * num_msgs;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  const auto recv_endp = make_udp_endpoint(test_addr, test_port_base);
+  auto recv_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, recv_endp);
+  REQUIRE_FALSE (recv_ptr->set_receive_batch_size(batch_size));
+
+  // IO is started after the datagrams are queued in the socket, so reads find full batches
+  std::promise<chops::net::udp_io_interface> start_prom;
+  auto start_fut = start_prom.get_future();
+  recv_ptr->start(
+      [&start_prom] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+          if (starting) {
+            start_prom.set_value(io);
+          }
+        },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+  );
+  auto io = start_fut.get();
+
+  asio::ip::udp::socket sock(ioc);
+  sock.open(asio::ip::udp::v4());
+  sock.bind(make_udp_endpoint(test_addr, test_port_base + 1));
+  std::vector<std::byte> dgram(max_size + 10u, std::byte(0x42));
+  for (std::size_t i = 0u; i < num_dgrams; ++i) {
+    sock.send_to(asio::const_buffer(dgram.data(), 10u + i % 20u), recv_endp);
+  }
+  sock.send_to(asio::const_buffer(dgram.data(), dgram.size()), recv_endp); // truncated
+  sock.send_to(asio::const_buffer(dgram.data(), 0u), recv_endp);
+
+  // only used in the IO thread until the empty datagram is received
+  std::vector<std::size_t> sizes;
+  bool senders_match = true;
+  std::promise<void> done_prom;
+  auto done_fut = done_prom.get_future();
+  auto r = io.start_io(max_size, 
+        [&, sender = sock.local_endpoint()] (asio::const_buffer buf, chops::net::udp_io_output,
+                                            asio::ip::udp::endpoint endp) {
+      sizes.push_back(buf.size());
+      senders_match = senders_match && endp == sender;
+      if (buf.size() == 0u) {
+        done_prom.set_value();
+        return false;
+      }
+      return true;
+    }
+  );
+  REQUIRE (r);
+  // the datagram ending the test may have been dropped
+  done_fut.wait_for(std::chrono::seconds(2));
+  recv_ptr->stop();
+
+  // CHECK instead of REQUIRE for counts since UDP is an unreliable protocol
+  CHECK (sizes.size() == num_dgrams + 2u);
+  REQUIRE (senders_match);
+  if (sizes.size() == num_dgrams + 2u) {
+    for (std::size_t i = 0u; i < num_dgrams; ++i) {
+      REQUIRE (sizes[i] == 10u + i % 20u);
+    }
+    REQUIRE (sizes[num_dgrams] == max_size);
+  }
+
+  auto st = recv_ptr->get_output_queue_stats();
+  REQUIRE (st.total_msgs_received == sizes.size());
+  REQUIRE (st.msgs_in_read_batches == sizes.size());
+  REQUIRE (st.max_read_batch_msgs == batch_size);
+  REQUIRE (st.num_read_batches < st.msgs_in_read_batches);
+  REQUIRE (st.total_reads == st.num_read_batches);
+  REQUIRE (st.read_buffer_bytes >= batch_size * max_size);
+  CHECK (st.num_truncated_msgs == 1u);
+  CHECK (st.num_dropped_msgs == 0u);
+
+  wk.reset();
+}
+
+TEST_CASE ( "Udp IO handler test, batched sends with segmentation offload",
+           "[udp_io] [send_batch]" ) {
+
+  if constexpr (!chops::net::detail::udp_batch_send_supported) {
+    return;
+  }
+
+  constexpr std::size_t batch_size = 32u;
+  constexpr std::size_t num_dgrams = 3 * num_msgs;
+  constexpr std::size_t dgram_size = 100u;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  const auto recv_endp = make_udp_endpoint(test_addr, test_port_base);
+  asio::ip::udp::socket recv_sock(ioc, recv_endp);
+
+  const auto send_endp = make_udp_endpoint(test_addr, test_port_base + 1);
+  auto send_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, send_endp);
+  send_ptr->set_write_batch_limits(batch_size, 0u);
+  if constexpr (chops::net::detail::udp_gso_supported) {
+    REQUIRE_FALSE (send_ptr->set_segmentation_offload(1472u));
+  }
+  std::promise<chops::net::udp_io_interface> start_prom;
+  auto start_fut = start_prom.get_future();
+  send_ptr->start(
+      [&start_prom] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+          if (starting) {
+            start_prom.set_value(io);
+          }
+        },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+  );
+  auto io = start_fut.get();
+  REQUIRE (io.start_io(recv_endp));
+
+  // sizes vary every ten datagrams, so batches have runs of equal sized datagrams; the
+  // receiving thread keeps up with the sends, since nothing is reading between them
+  std::vector<std::size_t> recvd_sizes;
+  std::vector<int> recvd_vals;
+  std::thread recv_thr([&] {
+      std::vector<std::byte> buf(2048u);
+      for (std::size_t i = 0u; i < num_dgrams; ++i) {
+        auto n = recv_sock.receive(asio::mutable_buffer(buf.data(), buf.size()));
+        recvd_sizes.push_back(n);
+        recvd_vals.push_back(std::to_integer<int>(buf[0]));
+      }
+    }
+  );
+
+  std::promise<std::pair<std::error_code, std::size_t>> comp_prom;
+  auto comp_fut = comp_prom.get_future();
+  auto out = *(io.make_io_output());
+  for (std::size_t i = 0u; i < num_dgrams; ++i) {
+    std::vector<std::byte> data(dgram_size + (i / 10u) % 3u, static_cast<std::byte>(i % 256u));
+    chops::const_shared_buffer buf(data.data(), data.size());
+    if (i + 1u == num_dgrams) {
+      out.send_with_completion(buf, [&comp_prom] (const std::error_code& err, std::size_t sz) {
+          comp_prom.set_value(std::make_pair(err, sz));
+        }
+      );
+    }
+    else {
+      out.send(buf);
+    }
+  }
+  auto comp = comp_fut.get();
+  REQUIRE_FALSE (comp.first);
+  REQUIRE (comp.second == dgram_size + ((num_dgrams - 1u) / 10u) % 3u);
+
+  recv_thr.join();
+  REQUIRE (recvd_sizes.size() == num_dgrams);
+  for (std::size_t i = 0u; i < num_dgrams; ++i) {
+    REQUIRE (recvd_sizes[i] == dgram_size + (i / 10u) % 3u);
+    REQUIRE (recvd_vals[i] == static_cast<int>(i % 256u));
+  }
+
+  auto st = send_ptr->get_output_queue_stats();
+  REQUIRE (st.total_bufs_sent == num_dgrams);
+  REQUIRE (st.total_writes < num_dgrams);
+  REQUIRE (st.max_write_batch_bufs > 1u);
+  REQUIRE (st.max_write_batch_bufs <= batch_size);
+
+  send_ptr->stop();
+  wk.reset();
+}
+
+TEST_CASE ( "Udp IO handler test, multicast receivers and sender",
+           "[udp_io] [multicast]" ) {
+
+  using chops::net::multicast_group;
+  using chops::net::udp_multicast_config;
+
+  constexpr std::size_t max_size = 64u;
+  const auto group_a = asio::ip::make_address("239.255.42.1");
+  const auto group_b = asio::ip::make_address("239.255.42.2");
+  const asio::ip::udp::endpoint mcast_endp(asio::ip::address_v4::any(), test_port_base + 20);
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  // both receivers bind the same port, only the first joins both groups
+  udp_multicast_config cfg_ab;
+  cfg_ab.groups = { multicast_group { group_a }, multicast_group { group_b } };
+  cfg_ab.receive_batch_size = 8u;
+  udp_multicast_config cfg_a;
+  cfg_a.groups = { multicast_group { group_a } };
+
+  auto recv_ab = std::make_shared<chops::net::detail::udp_entity_io>(ioc, mcast_endp);
+  recv_ab->set_multicast_config(cfg_ab);
+  auto recv_a = std::make_shared<chops::net::detail::udp_entity_io>(ioc, mcast_endp);
+  recv_a->set_multicast_config(cfg_a);
+
+  REQUIRE (recv_ab->join_multicast_group(multicast_group { group_a }) ==
+           std::make_error_code(chops::net::net_ip_errc::udp_entity_stopped));
+
+  // first byte of each datagram is the group, counts are only used in the IO thread until
+  // the receivers are stopped
+  struct counts {
+    std::size_t m_a = 0u;
+    std::size_t m_b = 0u;
+  };
+  counts cnt_ab;
+  counts cnt_a;
+  auto start_recv = [] (iosp recv, counts& cnt) {
+    std::promise<std::error_code> prom;
+    auto fut = prom.get_future();
+    recv->start(
+        [&prom, &cnt, max_size] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+            if (!starting) {
+              return;
+            }
+            auto r = io.start_io(max_size, 
+                  [&cnt] (asio::const_buffer buf, chops::net::udp_io_output, 
+                          asio::ip::udp::endpoint) {
+                if (buf.size() > 0u) {
+                  (*static_cast<const char*>(buf.data()) == 'a' ? cnt.m_a : cnt.m_b) += 1u;
+                }
+                return true;
+              }
+            );
+            prom.set_value(r ? std::error_code() : 
+                               std::make_error_code(chops::net::net_ip_errc::io_already_started));
+          },
+        [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    return fut.wait_for(std::chrono::seconds(2)) == std::future_status::ready;
+  };
+  REQUIRE (start_recv(recv_ab, cnt_ab));
+  REQUIRE (start_recv(recv_a, cnt_a));
+
+  // joining a group twice on the same interface fails, leaving and rejoining succeeds
+  REQUIRE (recv_a->join_multicast_group(multicast_group { group_a }));
+  REQUIRE_FALSE (recv_a->leave_multicast_group(multicast_group { group_a }));
+  REQUIRE_FALSE (recv_a->join_multicast_group(multicast_group { group_a }));
+
+  udp_multicast_config send_cfg;
+  send_cfg.hops = 0;
+  send_cfg.loopback = true;
+  auto send_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, 
+                                                   asio::ip::udp::endpoint());
+  send_ptr->set_multicast_config(send_cfg);
+  REQUIRE_FALSE (send_ptr->start([] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (starting) {
+          io.start_io();
+        }
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+  ));
+
+  const asio::ip::udp::endpoint dest_a(group_a, test_port_base + 20);
+  const asio::ip::udp::endpoint dest_b(group_b, test_port_base + 20);
+  auto buf_a = chops::const_shared_buffer("a", 1u);
+  auto buf_b = chops::const_shared_buffer("b", 1u);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  for (int i = 0; i < num_msgs; ++i) {
+    send_ptr->send(buf_a, dest_a);
+    send_ptr->send(buf_b, dest_b);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  send_ptr->stop();
+  recv_ab->stop();
+  recv_a->stop();
+
+  // CHECK instead of REQUIRE for counts since UDP is an unreliable protocol
+  CHECK (cnt_ab.m_a == num_msgs);
+  CHECK (cnt_ab.m_b == num_msgs);
+  CHECK (cnt_a.m_a == num_msgs);
+  REQUIRE (cnt_a.m_b == 0u);
+  REQUIRE (cnt_ab.m_a > 0u);
+  REQUIRE (cnt_a.m_a > 0u);
+
+  wk.reset();
+}
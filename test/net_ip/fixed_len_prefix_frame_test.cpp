@@ -0,0 +1,98 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test the fixed length prefix message framing class template.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include "asio/buffer.hpp"
+
+#include "utility/make_byte_array.hpp"
+
+#include "net_ip/fixed_len_prefix_frame.hpp"
+#include "net_ip/net_ip_error.hpp"
+#include "shared_test/msg_handling.hpp"
+
+SCENARIO ( "Fixed length prefix message frame",
+           "[fixed_len_prefix_frame]" ) {
+  using namespace chops::test;
+  using chops::net::fixed_len_prefix_frame;
+  using chops::net::length_endian;
+  using chops::net::msg_frame_error;
+
+  GIVEN ("A two byte big endian header, as used by the variable len test msgs") {
+    auto ba = chops::make_byte_array(0x02, 0x01); // 513 in big endian
+    asio::mutable_buffer buf(ba.data(), ba.size());
+    using frame = fixed_len_prefix_frame<2u>;
+    static_assert(frame::header_size == 2u);
+    WHEN ("the frame is called repeatedly") {
+      frame mf;
+      THEN ("the returned length toggles between the decoded length and zero") {
+        REQUIRE(mf(buf) == 513u);
+        REQUIRE(mf(buf) == 0u);
+        REQUIRE(mf(buf) == 513u);
+        REQUIRE(mf(buf) == 0u);
+        REQUIRE(mf(buf) == decode_variable_len_msg_hdr(ba.data(), 2u));
+      }
+    }
+    AND_WHEN ("the maximum message size is smaller than the message") {
+      frame mf_over(514u);
+      frame mf_fits(515u);
+      THEN ("the message frame error value is returned") {
+        REQUIRE(mf_over(buf) == msg_frame_error);
+        REQUIRE(mf_fits(buf) == 513u);
+      }
+    }
+  } // end given
+
+  GIVEN ("A header with a little endian length field at an offset") {
+    auto ba = chops::make_byte_array(0xAA, 0xBB, 0x10, 0x20, 0x00, 0xCC);
+    asio::mutable_buffer buf(ba.data(), ba.size());
+    WHEN ("the length covers the whole message, including a 6 byte header") {
+      using frame = fixed_len_prefix_frame<3u, length_endian::little, 2u, -6, 6u>;
+      static_assert(frame::header_size == 6u);
+      frame mf;
+      THEN ("the header size is subtracted from the decoded length") {
+        REQUIRE(frame::decode_length(reinterpret_cast<const unsigned char*>(ba.data())) == 0x2010u);
+        REQUIRE(mf(buf) == 0x2010u - 6u);
+        REQUIRE(mf(buf) == 0u);
+      }
+    }
+    AND_WHEN ("the decoded length is less than the adjustment") {
+      using frame = fixed_len_prefix_frame<1u, length_endian::little, 0u, -0xAB>;
+      frame mf;
+      THEN ("the message frame error value is returned") {
+        REQUIRE(mf(buf) == msg_frame_error);
+      }
+    }
+    AND_WHEN ("the body is empty") {
+      using frame = fixed_len_prefix_frame<1u, length_endian::big, 0u, -0xAA>;
+      frame mf;
+      THEN ("the message is complete after the header") {
+        REQUIRE(mf(buf) == 0u);
+        REQUIRE(mf(buf) == 0u);
+      }
+    }
+    AND_WHEN ("the length field is 8 bytes") {
+      auto ba8 = chops::make_byte_array(0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08);
+      using big = fixed_len_prefix_frame<8u>;
+      using little = fixed_len_prefix_frame<8u, length_endian::little>;
+      auto p = reinterpret_cast<const unsigned char*>(ba8.data());
+      THEN ("all of the bytes are decoded") {
+        REQUIRE(big::decode_length(p) == 0x0102030405060708ull);
+        REQUIRE(little::decode_length(p) == 0x0807060504030201ull);
+      }
+    }
+  } // end given
+}
+
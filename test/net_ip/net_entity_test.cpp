@@ -24,12 +24,14 @@
 #include <future>
 #include <cstddef> // std::size_t
 #include <iostream> // std::cerr
+#include <type_traits> // std::is_same_v
 
 #include <cassert>
 
 #include "net_ip/basic_io_interface.hpp"
 #include "net_ip/basic_io_output.hpp"
 #include "net_ip/net_entity.hpp"
+#include "net_ip/udp_multicast_config.hpp"
 
 #include "net_ip/detail/tcp_acceptor.hpp"
 #include "net_ip/detail/tcp_connector.hpp"
@@ -53,6 +55,7 @@ const char* test_port_tcp2 = "30557";
 const char* test_host_tcp = "";
 constexpr int num_msgs = 2000;
 constexpr std::chrono::milliseconds tout { 400 };
+const chops::net::multicast_group mcast_group { asio::ip::make_address("239.255.42.3") };
 
 template <typename IOT>
 struct no_start_io_state_chg {
@@ -91,6 +94,8 @@ TEST_CASE ( "Net entity default construction", "[net_entity]" ) {
                                chops::net::udp_empty_error_func));
   REQUIRE_FALSE (net_ent.start(no_start_io_state_chg<chops::net::tcp_io>(), 
                                chops::net::tcp_empty_error_func));
+  REQUIRE_FALSE (net_ent.join_multicast_group(mcast_group));
+  REQUIRE_FALSE (net_ent.leave_multicast_group(mcast_group));
   REQUIRE_FALSE (net_ent.stop());
 
 }
@@ -121,6 +126,16 @@ void test_methods (chops::net::net_entity net_ent, chops::net::err_wait_q& err_w
   REQUIRE (r3);
   REQUIRE (*r3 == 0u);
 
+  if constexpr (std::is_same_v<IOT, chops::net::udp_io>) {
+    REQUIRE (net_ent.join_multicast_group(mcast_group));
+    REQUIRE (net_ent.leave_multicast_group(mcast_group));
+  }
+  else {
+    auto r4 = net_ent.join_multicast_group(mcast_group);
+    REQUIRE_FALSE (r4);
+    REQUIRE (r4.error() == std::make_error_code(chops::net::net_ip_errc::not_udp_entity));
+  }
+
   REQUIRE (net_ent.stop());
 }
 
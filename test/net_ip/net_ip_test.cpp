@@ -461,3 +461,65 @@ TEST_CASE ( "Net IP test,  LF msgs, two-way, interval 0, 15 connectors or pairs,
                std::string_view("\n"), make_empty_lf_text_msg() );
 
 }
+
+TEST_CASE ( "Net IP test, UDP multicast receiver and sender",
+            "[net_ip] [udp_multicast]" ) {
+
+  const auto group = asio::ip::make_address("239.255.42.4");
+  const std::string port = std::to_string(udp_port_base + 10);
+  const asio::ip::udp::endpoint dest(group, udp_port_base + 10);
+
+  chops::net::worker wk;
+  wk.start();
+
+  chops::net::net_ip nip(wk.get_io_context());
+
+  chops::net::udp_multicast_config recv_cfg;
+  recv_cfg.groups = { chops::net::multicast_group { group } };
+  recv_cfg.receive_batch_size = 16u;
+  auto recv = nip.make_udp_multicast_receiver(port, recv_cfg);
+
+  chops::net::udp_multicast_config send_cfg;
+  send_cfg.hops = 0; // keep the datagrams on this host
+  auto sender = nip.make_udp_multicast_sender(send_cfg);
+
+  test_counter recv_cnt = 0;
+  std::promise<void> done_prom;
+  auto done_fut = done_prom.get_future();
+  auto r = recv.start([&recv_cnt, &done_prom] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (!starting) {
+          return;
+        }
+        io.start_io(64u, [&recv_cnt, &done_prom] (asio::const_buffer, chops::net::udp_io_output,
+                                                   asio::ip::udp::endpoint) {
+            if (++recv_cnt == num_msgs) {
+              done_prom.set_value();
+            }
+            return true;
+          }
+        );
+      },
+      chops::net::udp_empty_error_func);
+  REQUIRE (r);
+
+  auto send_fut = chops::net::make_io_output_future<chops::net::udp_io>(sender,
+        [&dest] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+          if (starting) {
+            io.start_io(dest);
+          }
+        },
+        chops::net::udp_empty_error_func);
+  auto send_out = send_fut.get();
+
+  auto buf = chops::const_shared_buffer("market data", 11u);
+  for (int i = 0; i < num_msgs; ++i) {
+    send_out.send(buf);
+  }
+
+  // CHECK instead of REQUIRE since UDP is an unreliable protocol
+  CHECK (done_fut.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+  nip.stop_all();
+  REQUIRE (recv_cnt > 0);
+
+  wk.reset();
+}
@@ -0,0 +1,140 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test the varint length prefix message framing class and varint encoding.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include "asio/buffer.hpp"
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <array>
+
+#include "utility/make_byte_array.hpp"
+
+#include "net_ip/varint_len_prefix_frame.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+namespace {
+
+// feeds the encoded prefix one byte at a time, as the TCP IO handler does, returning
+// the body size (or the frame error value)
+std::size_t frame_prefix(chops::net::varint_len_prefix_frame& mf,
+                         std::byte* prefix, std::size_t prefix_size) {
+  std::size_t ret = 0u;
+  for (std::size_t i = 0u; i < prefix_size; ++i) {
+    ret = mf(asio::mutable_buffer(prefix + i, 1u));
+    if (i + 1u < prefix_size && ret != 1u) {
+      return ret;
+    }
+  }
+  return ret;
+}
+
+}
+
+SCENARIO ( "Varint encoding",
+           "[varint_len_prefix_frame]" ) {
+  using chops::net::encode_varint;
+  using chops::net::max_varint_size;
+
+  GIVEN ("An output buffer") {
+    std::array<std::byte, max_varint_size> out;
+    WHEN ("small and multi-byte values are encoded") {
+      THEN ("the bytes follow the base 128 encoding") {
+        REQUIRE(encode_varint(0u, out.data()) == 1u);
+        REQUIRE(out[0] == std::byte(0x00));
+        REQUIRE(encode_varint(127u, out.data()) == 1u);
+        REQUIRE(out[0] == std::byte(0x7F));
+        REQUIRE(encode_varint(300u, out.data()) == 2u);
+        REQUIRE(out[0] == std::byte(0xAC));
+        REQUIRE(out[1] == std::byte(0x02));
+        REQUIRE(encode_varint(~std::uint64_t(0u), out.data()) == max_varint_size);
+        REQUIRE(out[9] == std::byte(0x01));
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Varint length prefix message frame",
+           "[varint_len_prefix_frame]" ) {
+  using chops::net::varint_len_prefix_frame;
+  using chops::net::encode_varint;
+  using chops::net::max_varint_size;
+  using chops::net::msg_frame_error;
+
+  static_assert(varint_len_prefix_frame::header_size == 1u);
+
+  GIVEN ("A frame with no maximum message size") {
+    varint_len_prefix_frame mf;
+    std::array<std::byte, max_varint_size> prefix;
+    WHEN ("prefixes of different sizes are framed") {
+      THEN ("continuation bytes return 1, then the body size and zero are returned") {
+        auto sz = encode_varint(300u, prefix.data());
+        REQUIRE(mf(asio::mutable_buffer(prefix.data(), 1u)) == 1u);
+        REQUIRE(mf(asio::mutable_buffer(prefix.data() + 1u, 1u)) == 300u);
+        REQUIRE(mf(asio::mutable_buffer(prefix.data(), sz)) == 0u);
+
+        sz = encode_varint(5u, prefix.data());
+        REQUIRE(frame_prefix(mf, prefix.data(), sz) == 5u);
+        REQUIRE(mf(asio::mutable_buffer(prefix.data(), sz)) == 0u);
+
+        sz = encode_varint(0x123456789ull, prefix.data());
+        REQUIRE(sz == 5u);
+        REQUIRE(frame_prefix(mf, prefix.data(), sz) == 0x123456789ull);
+        REQUIRE(mf(asio::mutable_buffer(prefix.data(), sz)) == 0u);
+      }
+    }
+    AND_WHEN ("the body is empty") {
+      auto sz = encode_varint(0u, prefix.data());
+      THEN ("the message is complete after the prefix") {
+        REQUIRE(frame_prefix(mf, prefix.data(), sz) == 0u);
+        REQUIRE(frame_prefix(mf, prefix.data(), sz) == 0u);
+        sz = encode_varint(7u, prefix.data());
+        REQUIRE(frame_prefix(mf, prefix.data(), sz) == 7u);
+      }
+    }
+    AND_WHEN ("a non-minimal encoding of zero is framed") {
+      auto ba = chops::make_byte_array(0x80, 0x80, 0x00);
+      THEN ("the padding bytes are accepted") {
+        REQUIRE(frame_prefix(mf, ba.data(), ba.size()) == 0u);
+      }
+    }
+    AND_WHEN ("the prefix is longer than 10 bytes or overflows 64 bits") {
+      auto too_long = chops::make_byte_array(0x80, 0x80, 0x80, 0x80, 0x80,
+                                             0x80, 0x80, 0x80, 0x80, 0x80, 0x00);
+      auto overflow = chops::make_byte_array(0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                             0xFF, 0xFF, 0xFF, 0xFF, 0x02);
+      varint_len_prefix_frame mf2;
+      THEN ("the message frame error value is returned") {
+        REQUIRE(frame_prefix(mf, too_long.data(), too_long.size()) == msg_frame_error);
+        REQUIRE(frame_prefix(mf2, overflow.data(), overflow.size()) == msg_frame_error);
+      }
+    }
+  } // end given
+
+  GIVEN ("A frame with a maximum message size") {
+    std::array<std::byte, max_varint_size> prefix;
+    WHEN ("the prefix plus body is larger than the maximum") {
+      auto sz = encode_varint(200u, prefix.data());
+      varint_len_prefix_frame mf_over(201u);
+      varint_len_prefix_frame mf_fits(202u);
+      THEN ("the message frame error value is returned") {
+        REQUIRE(frame_prefix(mf_over, prefix.data(), sz) == msg_frame_error);
+        REQUIRE(frame_prefix(mf_fits, prefix.data(), sz) == 200u);
+      }
+    }
+  } // end given
+}
+
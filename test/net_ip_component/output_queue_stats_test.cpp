@@ -54,6 +54,37 @@ SCENARIO ( "Testing accumulate_output_queue_stats for io_output objects",
 
 }
 
+SCENARIO ( "Testing combine_output_queue_stats, including cumulative traffic counts",
+           "[combine_output_queue_stats]" ) {
+
+  chops::net::output_queue_stats lhs { 1u, 10u, 2u, 4u, 3u, 1u, 5u, 50u, 2u, 7u, 70u, 9u,
+                                       256u, 3u, 12u, 8u, 1u, 0u };
+  chops::net::output_queue_stats rhs { 2u, 20u, 1u, 6u, 6u, 0u, 8u, 80u, 4u, 3u, 30u, 4u,
+                                       512u, 2u, 5u, 4u, 0u, 7u };
+
+  auto s = chops::net::combine_output_queue_stats(lhs, rhs);
+
+  REQUIRE (s.output_queue_size == 3u);
+  REQUIRE (s.bytes_in_output_queue == 30u);
+  REQUIRE (s.num_write_batches == 3u);
+  REQUIRE (s.bufs_in_write_batches == 10u);
+  REQUIRE (s.max_write_batch_bufs == 6u);
+  REQUIRE (s.num_overflows == 1u);
+  REQUIRE (s.total_bufs_sent == 13u);
+  REQUIRE (s.total_bytes_sent == 130u);
+  REQUIRE (s.total_writes == 6u);
+  REQUIRE (s.total_msgs_received == 10u);
+  REQUIRE (s.total_bytes_received == 100u);
+  REQUIRE (s.total_reads == 13u);
+  REQUIRE (s.read_buffer_bytes == 768u);
+  REQUIRE (s.num_read_batches == 5u);
+  REQUIRE (s.msgs_in_read_batches == 17u);
+  REQUIRE (s.max_read_batch_msgs == 8u);
+  REQUIRE (s.num_truncated_msgs == 1u);
+  REQUIRE (s.num_dropped_msgs == 7u);
+
+}
+
 SCENARIO ( "Testing accumulate_output_queue_stats for net_entity objects",
            "[accumulate_net_entity_output_queue_stats]" ) {
 
@@ -71,6 +102,10 @@ SCENARIO ( "Testing accumulate_output_queue_stats for net_entity objects",
   REQUIRE (s.output_queue_size == 0u);
   REQUIRE (s.bytes_in_output_queue == 0u);
 
+  s = chops::net::net_entity_output_queue_stats<chops::net::tcp_io>(ne1);
+  REQUIRE (s.output_queue_size == 0u);
+  REQUIRE (s.total_bytes_sent == 0u);
+
   chops::net::accumulate_net_entity_output_queue_stats_until<chops::net::udp_io>(ne_list.cbegin(), 
                                                                                  ne_list.cend(),
       [] (const chops::net::output_queue_stats& st) {
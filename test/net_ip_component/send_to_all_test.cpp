@@ -18,6 +18,8 @@
 #include <cstddef> // std::size_t
 
 #include <memory> // std::make_shared
+#include <thread>
+#include <vector>
 
 #include "net_ip_component/send_to_all.hpp"
 
@@ -26,6 +28,8 @@
 
 #include "shared_test/mock_classes.hpp"
 
+#include "utility/repeat.hpp"
+
 TEST_CASE ( "Testing send_to_all class", "[send_to_all]" ) {
 
   using namespace chops::test;
@@ -79,3 +83,54 @@ TEST_CASE ( "Testing send_to_all class", "[send_to_all]" ) {
   REQUIRE(tot.output_queue_size == sta.size() * io_handler_mock::qs_base);
   REQUIRE(tot.bytes_in_output_queue == sta.size() * (io_handler_mock::qs_base + 1));
 }
+
+TEST_CASE ( "Testing send_to_all class, concurrent adds, removes and sends", "[send_to_all]" ) {
+
+  using namespace chops::test;
+
+  chops::net::send_to_all<io_handler_mock> sta { };
+
+  auto ioh1 = std::make_shared<io_handler_mock>();
+  io_output_mock out1(ioh1);
+  sta.add_io_output(out1);
+
+  std::byte b(static_cast<std::byte>(0xFE));
+  chops::const_shared_buffer buf(&b, 1u);
+
+  // one sender, since the mock send is not thread-safe, while other threads add and
+  // remove their own objects; no add or remove is lost
+  constexpr int num_thrs = 4;
+  constexpr int num_iters = 200;
+  std::vector<std::shared_ptr<io_handler_mock>> iohs;
+  chops::repeat(num_thrs * num_iters, [&iohs] { iohs.push_back(std::make_shared<io_handler_mock>()); } );
+
+  std::thread sender([&sta, &buf] {
+      chops::repeat(1000, [&sta, &buf] { sta.send(buf); } );
+    }
+  );
+  std::vector<std::thread> thrs;
+  for (int t = 0; t < num_thrs; ++t) {
+    thrs.emplace_back([&sta, &iohs, t] {
+        for (int i = 0; i < num_iters; ++i) {
+          sta.add_io_output(io_output_mock(iohs[t * num_iters + i]));
+        }
+        // remove every other one of this thread's objects
+        for (int i = 0; i < num_iters; i += 2) {
+          sta.remove_io_output(io_output_mock(iohs[t * num_iters + i]));
+        }
+      }
+    );
+  }
+  for (auto& thr : thrs) {
+    thr.join();
+  }
+  sender.join();
+
+  REQUIRE (sta.size() == 1u + num_thrs * num_iters / 2u);
+  REQUIRE (ioh1->send_called);
+
+  ioh1->send_called = false;
+  sta.send(buf, out1);
+  REQUIRE_FALSE (ioh1->send_called);
+  REQUIRE (iohs[1]->send_called);
+}
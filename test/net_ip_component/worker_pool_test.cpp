@@ -0,0 +1,286 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c worker_pool class, including TCP traffic through a
+ *  @c net_ip object whose @c io_context is run by multiple threads.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2020 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch.hpp"
+
+#include <thread>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional> // std::ref
+#include <set>
+#include <vector>
+#include <cstddef> // std::size_t
+#include <memory> // std::make_shared
+
+#include "asio/post.hpp"
+
+#include "net_ip_component/worker_pool.hpp"
+#include "net_ip_component/io_output_delivery.hpp"
+#include "net_ip_component/error_delivery.hpp"
+#include "net_ip_component/io_state_change.hpp"
+
+#include "net_ip/net_ip.hpp"
+#include "net_ip/net_entity.hpp"
+
+#include "shared_test/msg_handling.hpp"
+#include "shared_test/msg_handling_start_funcs.hpp"
+
+#include "marshall/shared_buffer.hpp"
+#include "utility/repeat.hpp"
+
+#include <iostream> // std::cerr for error sink
+
+using namespace chops::test;
+
+const char* test_port = "30479";
+const char* test_host = "localhost";
+constexpr int num_msgs = 200;
+constexpr int num_conns = 8;
+
+// Catch test framework not thread-safe, all REQUIRE clauses must be in single thread
+
+std::size_t count_threads(chops::net::worker_pool& wp, std::size_t ctx_idx, int num_posts) {
+  std::mutex mut;
+  std::set<std::thread::id> ids;
+  std::atomic_int cnt { 0 };
+  std::promise<void> prom;
+  auto fut = prom.get_future();
+  chops::repeat(num_posts, [&] () {
+      asio::post(wp.get_io_context(ctx_idx), [&] () {
+          {
+            std::lock_guard<std::mutex> lk(mut);
+            ids.insert(std::this_thread::get_id());
+          }
+          // keep the thread busy so that other threads pick up the remaining handlers
+          std::this_thread::sleep_for(std::chrono::milliseconds(2));
+          if (++cnt == num_posts) {
+            prom.set_value();
+          }
+        }
+      );
+    }
+  );
+  fut.get();
+  return ids.size();
+}
+
+TEST_CASE ( "Worker pool test, threads and contexts", "[worker_pool]" ) {
+
+  {
+    chops::net::worker_pool wp(4u);
+    REQUIRE (wp.num_threads() == 4u);
+    REQUIRE (wp.num_io_contexts() == 1u);
+    REQUIRE_FALSE (wp.start());
+    REQUIRE (count_threads(wp, 0u, 100) > 1u);
+    wp.reset();
+  }
+  {
+    chops::net::worker_pool wp(4u, 2u);
+    REQUIRE (wp.num_io_contexts() == 2u);
+    REQUIRE (&wp.next_io_context(0u) == &wp.get_io_context(0u));
+    REQUIRE (&wp.next_io_context(3u) == &wp.get_io_context(1u));
+    REQUIRE_FALSE (wp.start());
+    REQUIRE (count_threads(wp, 0u, 100) <= 2u);
+    REQUIRE (count_threads(wp, 1u, 100) <= 2u);
+    wp.stop();
+  }
+  {
+    // more contexts than threads is clamped, zero threads or contexts is one
+    chops::net::worker_pool wp1(2u, 4u);
+    REQUIRE (wp1.num_io_contexts() == 2u);
+    chops::net::worker_pool wp2(0u, 0u);
+    REQUIRE (wp2.num_threads() == 1u);
+    REQUIRE (wp2.num_io_contexts() == 1u);
+  }
+  {
+    // destroyed while running, the destructor stops the pool
+    chops::net::worker_pool wp(3u, 2u);
+    REQUIRE_FALSE (wp.start());
+    REQUIRE (count_threads(wp, 1u, 10) >= 1u);
+  }
+#if defined(__linux__)
+  {
+    chops::net::worker_pool wp(2u, 1u, std::vector<int> { 0 });
+    REQUIRE_FALSE (wp.start());
+    REQUIRE (count_threads(wp, 0u, 10) >= 1u);
+    wp.reset();
+  }
+#endif
+
+}
+
+TEST_CASE ( "Worker pool test, TCP acceptor and connectors, multiple threads on one context",
+            "[worker_pool] [tcp]" ) {
+
+  chops::net::worker_pool wp(4u);
+  REQUIRE_FALSE (wp.start());
+
+  chops::net::err_wait_q err_wq;
+  auto err_fut = std::async(std::launch::async,
+        chops::net::ostream_error_sink_with_wait_queue,
+        std::ref(err_wq), std::ref(std::cerr));
+
+  auto var_msg_vec = make_msg_vec (make_variable_len_msg, "Many threads!", 'T', num_msgs);
+  {
+    chops::net::net_ip nip(wp.get_io_context());
+    auto acc = nip.make_tcp_acceptor(test_port, test_host);
+    REQUIRE (acc.is_valid());
+
+    test_counter acc_cnt = 0;
+    auto st = acc.start(chops::net::make_simple_variable_len_msg_frame_io_state_change(2,
+                                        tcp_msg_hdlr(false, acc_cnt), decode_variable_len_msg_hdr),
+                        chops::net::make_error_func_with_wait_queue<chops::net::tcp_io>(err_wq));
+    REQUIRE (st);
+
+    std::vector< chops::net::tcp_io_output > send_vec;
+    std::vector< chops::net::tcp_io_output_future > stop_fut_vec;
+    test_counter conn_cnt = 0;
+
+    chops::repeat(num_conns, [&] () {
+        auto conn = nip.make_tcp_connector(test_port, test_host);
+        auto futs = chops::net::make_io_output_future_pair<chops::net::tcp_io>(conn,
+               chops::net::make_simple_variable_len_msg_frame_io_state_change(2,
+                                        tcp_msg_hdlr(false, conn_cnt), decode_variable_len_msg_hdr),
+               chops::net::make_error_func_with_wait_queue<chops::net::tcp_io>(err_wq));
+        send_vec.emplace_back(futs.start_fut.get());
+        stop_fut_vec.emplace_back(std::move(futs.stop_fut));
+      }
+    );
+
+    // connectors send from this thread while the pool threads handle the reads
+    for (const auto& buf : var_msg_vec) {
+      for (auto io : send_vec) {
+        io.send(buf);
+      }
+    }
+    for (auto io : send_vec) {
+      io.send(make_empty_variable_len_msg());
+    }
+    for (auto& fut : stop_fut_vec) {
+      auto io = fut.get(); // acceptor closes each connection on the empty message
+    }
+
+    acc.stop();
+    nip.stop_all();
+    nip.remove_all();
+
+    REQUIRE (acc_cnt == static_cast<std::size_t>(num_conns * num_msgs));
+  }
+
+  wp.reset();
+
+  while (!err_wq.empty()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  err_wq.close();
+  auto err_cnt = err_fut.get();
+  INFO ("Num err messages in sink: " << err_cnt);
+
+}
+
+TEST_CASE ( "Worker pool test, TCP connections stopped from pool threads while sending",
+            "[worker_pool] [tcp] [stop_io]" ) {
+
+  chops::net::worker_pool wp(4u);
+  REQUIRE_FALSE (wp.start());
+
+  auto var_msg_vec = make_msg_vec (make_variable_len_msg, "Stop while sending!", 'S', num_msgs);
+  std::atomic_size_t num_sent { 0u };
+  {
+    chops::net::net_ip nip(wp.get_io_context());
+    auto acc = nip.make_tcp_acceptor(test_port, test_host);
+    REQUIRE (acc.is_valid());
+
+    test_counter acc_cnt = 0;
+    auto st = acc.start(chops::net::make_simple_variable_len_msg_frame_io_state_change(2,
+                                        tcp_msg_hdlr(false, acc_cnt), decode_variable_len_msg_hdr),
+                        [] (chops::net::tcp_io_interface, std::error_code) { } );
+    REQUIRE (st);
+
+    // each connector passes out its IO interface when started, and signals when stopped
+    std::vector< std::future<chops::net::tcp_io_interface> > start_fut_vec;
+    std::vector< std::future<void> > stop_fut_vec;
+    test_counter conn_cnt = 0;
+
+    chops::repeat(num_conns, [&] () {
+        auto start_prom = std::make_shared<std::promise<chops::net::tcp_io_interface>>();
+        auto stop_prom = std::make_shared<std::promise<void>>();
+        start_fut_vec.push_back(start_prom->get_future());
+        stop_fut_vec.push_back(stop_prom->get_future());
+        auto conn = nip.make_tcp_connector(test_port, test_host);
+        conn.start([start_prom, stop_prom, &conn_cnt] 
+                   (chops::net::tcp_io_interface io, std::size_t, bool starting) {
+            if (starting) {
+              io.start_io(2, tcp_msg_hdlr(false, conn_cnt), decode_variable_len_msg_hdr);
+              start_prom->set_value(io);
+            }
+            else {
+              stop_prom->set_value();
+            }
+          },
+          [] (chops::net::tcp_io_interface, std::error_code) { } );
+      }
+    );
+
+    std::vector<chops::net::tcp_io_interface> io_vec;
+    for (auto& fut : start_fut_vec) {
+      io_vec.push_back(fut.get());
+    }
+
+    // a thread per connection sends until its IO handler is stopped
+    std::vector<std::thread> senders;
+    for (auto io : io_vec) {
+      senders.emplace_back([io, &var_msg_vec, &num_sent] () {
+          auto io_out = io.make_io_output();
+          if (!io_out) {
+            return;
+          }
+          for (;;) {
+            for (const auto& buf : var_msg_vec) {
+              if (!io_out->send(buf)) {
+                return;
+              }
+              ++num_sent;
+            }
+          }
+        }
+      );
+    }
+
+    // each connection is stopped from a pool thread, not from its own strand, while 
+    // writes and reads are in progress
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (auto io : io_vec) {
+      asio::post(wp.get_io_context(), [io] () mutable { io.stop_io(); } );
+    }
+    for (auto& fut : stop_fut_vec) {
+      fut.get();
+    }
+    for (auto& thr : senders) {
+      thr.join();
+    }
+
+    acc.stop();
+    nip.stop_all();
+    nip.remove_all();
+  }
+
+  wp.reset();
+  REQUIRE (num_sent > 0u);
+
+}
@@ -19,7 +19,9 @@
 #include <memory> // std::shared_ptr
 #include <string_view>
 #include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
 #include <system_error>
+#include <chrono>
 
 #include "asio/ip/udp.hpp" // ip::udp::endpoint
 
@@ -57,8 +59,100 @@ struct io_handler_mock {
 
   bool send_called = false;
 
-  bool send(chops::const_shared_buffer) { send_called = true; return true; }
-  bool send(chops::const_shared_buffer, const endpoint_type&) { send_called = true; return true; }
+  std::size_t max_batch_bufs = 1u;
+
+  void set_write_batch_limits(std::size_t max_bufs, std::size_t) { max_batch_bufs = max_bufs; }
+
+  std::size_t read_buffer_size = 0u;
+
+  void set_read_buffer_size(std::size_t sz) { read_buffer_size = sz; }
+
+  std::size_t max_segment_size = 0u;
+
+  std::error_code set_segmentation_offload(std::size_t max_seg) {
+    max_segment_size = max_seg;
+    return std::error_code();
+  }
+
+  std::size_t receive_batch_size = 0u;
+
+  std::error_code set_receive_batch_size(std::size_t max_msgs) {
+    receive_batch_size = max_msgs;
+    return std::error_code();
+  }
+
+  std::size_t zero_copy_min_size = 0u;
+
+  std::error_code set_zero_copy(std::size_t min_size) {
+    zero_copy_min_size = min_size;
+    return std::error_code();
+  }
+
+  std::chrono::milliseconds read_timeout { 0 };
+  std::chrono::milliseconds write_timeout { 0 };
+
+  std::error_code set_io_timeouts(std::chrono::milliseconds rd_tout, 
+                                  std::chrono::milliseconds wr_tout) {
+    read_timeout = rd_tout;
+    write_timeout = wr_tout;
+    return std::error_code();
+  }
+
+  std::size_t max_queue_bufs = 0u;
+  chops::net::queue_overflow_policy overflow_policy = chops::net::queue_overflow_policy::reject;
+
+  void set_output_queue_limit(std::size_t max_bufs, chops::net::queue_overflow_policy policy) {
+    max_queue_bufs = max_bufs;
+    overflow_policy = policy;
+  }
+
+  chops::net::output_queue_water_marks water_marks;
+  bool water_mark_func_set = false;
+
+  template <typename F>
+  void set_output_queue_water_marks(const chops::net::output_queue_water_marks& wm, F&&) {
+    water_marks = wm;
+    water_mark_func_set = true;
+  }
+
+  chops::net::send_result send(chops::const_shared_buffer) {
+    send_called = true;
+    return chops::net::send_result::write_started;
+  }
+  chops::net::send_result send(chops::const_shared_buffer, const endpoint_type&) {
+    send_called = true;
+    return chops::net::send_result::write_started;
+  }
+
+  // the mock "writes" right away, calling the completion handler before returning
+  chops::net::send_result send_with_completion(chops::const_shared_buffer buf,
+                                               chops::net::send_completion_handler cb) {
+    send_called = true;
+    cb(std::error_code(), buf.size());
+    return chops::net::send_result::write_started;
+  }
+  chops::net::send_result send_with_completion(chops::const_shared_buffer buf, const endpoint_type&,
+                                               chops::net::send_completion_handler cb) {
+    return send_with_completion(buf, cb);
+  }
+
+  chops::net::send_result send_no_copy(const void* buf, std::size_t sz,
+                                       chops::net::buffer_release_hook release) {
+    send_called = true;
+    release(buf, sz);
+    return chops::net::send_result::write_started;
+  }
+  chops::net::send_result send_no_copy(const void* buf, std::size_t sz, const endpoint_type&,
+                                       chops::net::buffer_release_hook release) {
+    return send_no_copy(buf, sz, release);
+  }
+
+  chops::net::send_result send_file(int fd, std::uint64_t, std::size_t,
+                                    chops::net::file_release_hook release) {
+    send_called = true;
+    release(fd);
+    return chops::net::send_result::write_started;
+  }
 
   bool mf_sio_called = false;
   bool simple_var_len_sio_called = false;